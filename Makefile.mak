@@ -8,16 +8,28 @@ TESTDIR = tests
 OBJDIR = build
 BINDIR = .
 
-# Find all source files
-SOURCES = $(wildcard $(SRCDIR)/**/*.cpp) $(wildcard $(TESTDIR)/**/*.cpp) $(SRCDIR)/main.cpp
+# Find all source files; the tests also cover the benchmark comparison statistics in bench/common
+SOURCES = $(wildcard $(SRCDIR)/**/*.cpp) $(wildcard $(TESTDIR)/**/*.cpp) $(wildcard bench/common/*.cpp) $(SRCDIR)/main.cpp
 
 # Convert .cpp files to object files
 OBJECTS = $(patsubst $(SRCDIR)/%.cpp, $(OBJDIR)/%.o, $(SOURCES))
 OBJECTS := $(patsubst $(TESTDIR)/%.cpp, $(OBJDIR)/%.o, $(OBJECTS))
+OBJECTS := $(patsubst bench/common/%.cpp, $(OBJDIR)/bench_common/%.o, $(OBJECTS))
 
 # Output executable
 TARGET = $(BINDIR)/my_project
 
+# Benchmarks: library sources plus bench/, optimized and built into their own object directory
+BENCHDIR = bench
+BENCH_OBJDIR = $(OBJDIR)/bench
+BENCH_OPTFLAGS = -O3 -march=native
+BENCH_CXXFLAGS = $(CXXFLAGS) $(BENCH_OPTFLAGS) -DBENCH_COMPILE_FLAGS="\"$(CXXFLAGS) $(BENCH_OPTFLAGS)\""
+BENCH_SOURCES = $(wildcard $(SRCDIR)/**/*.cpp) $(wildcard $(BENCHDIR)/**/*.cpp) $(BENCHDIR)/main.cpp
+BENCH_OBJECTS = $(patsubst %.cpp, $(BENCH_OBJDIR)/%.o, $(BENCH_SOURCES))
+BENCH_TARGET = $(BINDIR)/my_bench
+BENCH_ARGS ?=
+BENCH_BASELINE ?= bench_baseline.json
+
 # Rule to build the project
 all: $(TARGET)
 
@@ -33,8 +45,30 @@ $(OBJDIR)/%.o: $(TESTDIR)/%.cpp
 	@mkdir -p $(dir $@)
 	$(CXX) $(CXXFLAGS) -c $< -o $@
 
+$(OBJDIR)/bench_common/%.o: bench/common/%.cpp
+	@mkdir -p $(dir $@)
+	$(CXX) $(CXXFLAGS) -c $< -o $@
+
+# Rule to build and run the benchmarks, e.g. make -f Makefile.mak bench BENCH_ARGS="--max-dim=1024 --threads=1"
+bench: $(BENCH_TARGET)
+	$(BENCH_TARGET) $(BENCH_ARGS)
+
+# Store a baseline, then gate later builds against it (run both with the same BENCH_ARGS)
+bench-baseline: $(BENCH_TARGET)
+	$(BENCH_TARGET) $(BENCH_ARGS) --save-baseline=$(BENCH_BASELINE)
+
+bench-compare: $(BENCH_TARGET)
+	$(BENCH_TARGET) $(BENCH_ARGS) --compare=$(BENCH_BASELINE)
+
+$(BENCH_TARGET): $(BENCH_OBJECTS)
+	$(CXX) $(BENCH_CXXFLAGS) -o $@ $^
+
+$(BENCH_OBJDIR)/%.o: %.cpp
+	@mkdir -p $(dir $@)
+	$(CXX) $(BENCH_CXXFLAGS) -c $< -o $@
+
 # Clean build files
 clean:
-	rm -rf $(OBJDIR) $(TARGET)
+	rm -rf $(OBJDIR) $(TARGET) $(BENCH_TARGET)
 
-.PHONY: all clean
+.PHONY: all bench bench-baseline bench-compare clean
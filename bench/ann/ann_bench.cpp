@@ -0,0 +1,215 @@
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <omp.h>
+#include "../../src/ann/ann.h"
+#include "../../src/inference/inference_model.h"
+#include "../../src/matrix/matrix.h"
+#include "ann_bench.h"
+#include "../common/compare.h"
+
+/**
+ * @brief Discards everything written to std::cout while in scope (train_epoch reports progress there).
+ */
+struct SilenceCout {
+    std::ostringstream sink;
+    std::streambuf* saved;
+    SilenceCout() : saved(std::cout.rdbuf(sink.rdbuf())) {}
+    ~SilenceCout() { std::cout.rdbuf(saved); }
+};
+
+/**
+ * @brief Formats layer sizes as "3x64x4".
+ * @param layers Layer sizes.
+ * @return The network name.
+ */
+static std::string network_name(const std::vector<int>& layers) {
+    std::string name;
+    for (size_t i = 0; i < layers.size(); i++) name += (i ? "x" : "") + std::to_string(layers[i]);
+    return name;
+}
+
+/**
+ * @brief Returns the activations of the benchmarked MLPs: ReLu hidden layers and a linear output.
+ * @param layers Layer sizes.
+ * @return One activation name per weight layer.
+ */
+static std::vector<std::string> network_activations(const std::vector<int>& layers) {
+    std::vector<std::string> activations(layers.size() - 1, "ReLu");
+    activations.back() = "linear";
+    return activations;
+}
+
+/**
+ * @brief Generates a deterministic synthetic regression set whose targets are smooth functions of the inputs.
+ * @param count Number of samples.
+ * @param inputs Input size.
+ * @param outputs Output size.
+ * @return Vector of {input, target} column-vector pairs.
+ */
+static std::vector<std::array<Matrix, 2>> synthetic_set(int count, int inputs, int outputs) {
+    std::vector<std::array<Matrix, 2>> set;
+    set.reserve(count);
+    for (int s = 0; s < count; s++) {
+        Matrix x(inputs, 1);
+        Matrix y(outputs, 1);
+        for (int r = 0; r < inputs; r++) x.set_val(r, 0, std::sin(0.7f * s + 1.3f * r));
+        for (int r = 0; r < outputs; r++) y.set_val(r, 0, 0.5f * std::cos(0.3f * s + r));
+        set.push_back({x, y});
+    }
+    return set;
+}
+
+/**
+ * @brief Benchmarks one network at the current thread count and returns its JSON result object.
+ * Training reports the epoch wall time of ANN::train_epoch and samples/s; inference reports the
+ * per-call latency of ANN::predict and of an InferenceModel copy at batch sizes 1, 2, 4, ... up to
+ * opts.max_batch, and the parameter and activation bytes each keeps resident. One more
+ * profiled epoch after the timed ones reports the Matrix allocations per training step and,
+ * with --counters, the IPC and misses per element of the step.
+ * @param layers Layer sizes.
+ * @param threads OpenMP thread count.
+ * @param opts Benchmark options.
+ * @param allocation_free Set to false if a steady-state training step allocated Matrix storage.
+ * @return The JSON object as a string.
+ */
+static std::string bench_network(const std::vector<int>& layers, int threads, const BenchOptions& opts, bool& allocation_free) {
+    SilenceCout silence; // Keep the optimizer and per-epoch messages out of the JSON on stdout
+    ANN ann(layers, network_activations(layers));
+    ann.set_optimizer("SGD", "MSE", 1e-3f);
+    ann.set_micro_batch_size(opts.micro_batch);
+    std::vector<std::array<Matrix, 2>> train_set = synthetic_set(opts.train_samples, layers.front(), layers.back());
+    long unsigned parameters = 0;
+    for (size_t i = 1; i < layers.size(); i++) parameters += (long unsigned)layers[i] * (layers[i - 1] + 1);
+
+    // Whole epochs are expensive: one warmup epoch and a few timed ones.
+    BenchOptions epoch_opts = opts;
+    epoch_opts.warmup = 1;
+    epoch_opts.min_repetitions = 3;
+    epoch_opts.max_repetitions = std::max(3, opts.min_repetitions);
+    BenchStats epoch = measure([&]() { bench_sink = ann.train_epoch(train_set, opts.train_batch); }, epoch_opts);
+    double epoch_seconds = epoch.median_us * 1e-6;
+    std::string case_name = "ann/" + network_name(layers) + "/t" + std::to_string(threads);
+    record_bench_result(case_name + "/train_epoch", epoch);
+
+    // Profiled separately so the timed epochs run without the profiling overhead.
+    ann.set_profiling(true);
+    if (opts.counters) perf_counters_set_enabled(true);
+    ann.train_epoch(train_set, opts.train_batch);
+    perf_counters_set_enabled(false);
+    ann.set_profiling(false);
+    ProfileReport profile = ann.profile_report();
+    const ProfileEntry* step = profile.find(ProfilePhase::Step, -1);
+    long unsigned steps = step ? step->calls : 0;
+    long unsigned step_allocations = step ? step->allocations : 0;
+    allocation_free = step_allocations == 0;
+    for (auto& entry : profile.entries) {
+        if (entry.allocations == 0 || entry.phase == ProfilePhase::Step) continue;
+        std::cerr << "  " << profile_phase_name(entry.phase) << " of layer " << entry.layer << ": "
+                  << entry.allocations << " allocation(s), " << entry.allocated_bytes << " bytes\n";
+    }
+
+    std::ostringstream json;
+    json << "{\"network\": \"" << network_name(layers) << "\", \"parameters\": " << parameters
+         << ", \"threads\": " << threads << ",\n     \"training\": {\"samples\": " << opts.train_samples
+         << ", \"batch_size\": " << opts.train_batch << ", \"micro_batch_size\": " << opts.micro_batch
+         << ", \"epochs\": " << epoch.repetitions << ", \"epoch_seconds_median\": " << epoch_seconds
+         << ", \"epoch_seconds_p10\": " << epoch.p10_us * 1e-6 << ", \"epoch_seconds_p90\": " << epoch.p90_us * 1e-6
+         << ", \"samples_per_second\": " << opts.train_samples / epoch_seconds
+         << ", \"allocations_per_step\": " << (steps ? double(step_allocations) / steps : 0.0)
+         << ", \"allocated_bytes_per_step\": " << (steps ? double(step->allocated_bytes) / steps : 0.0)
+         << ", \"peak_live_bytes\": " << (step ? step->peak_live_bytes : 0);
+    if (opts.counters) {
+        // The step records no traffic of its own; normalize by the floats moved by its phases.
+        // Null marks events the host cannot count.
+        PerfCounts counts = step ? step->counters : PerfCounts();
+        double elements = 0.0;
+        for (auto& entry : profile.entries) {
+            if (entry.phase != ProfilePhase::Step) elements += entry.elements();
+        }
+        json << ", \"counters\": {\"ipc\": ";
+        if (counts.ipc() > 0.0) json << counts.ipc();
+        else json << "null";
+        PerfEvent events[] = {PerfEvent::L1DMisses, PerfEvent::LLCMisses, PerfEvent::DTLBMisses, PerfEvent::BranchMisses};
+        for (PerfEvent event : events) {
+            json << ", \"" << perf_event_name(event) << "_per_element\": ";
+            if (counts.has(event) && elements > 0.0) json << counts.per_element(event, elements);
+            else json << "null";
+        }
+        json << "}";
+    }
+    json << "},\n     \"inference\": [";
+
+    // Latency percentiles need many samples per batch size.
+    BenchOptions latency_opts = opts;
+    latency_opts.min_repetitions = std::max(100, opts.min_repetitions);
+    latency_opts.max_repetitions = std::max(latency_opts.min_repetitions, opts.max_repetitions);
+    InferenceModel model(ann);
+    for (int batch = 1; batch <= opts.max_batch; batch *= 2) {
+        Matrix input(layers.front(), batch);
+        Matrix output(layers.back(), batch);
+        fill_matrix(input, 1.0f);
+        BenchStats latency = measure([&]() { ann.predict(input, output); bench_sink = output.get_val(0, 0); }, latency_opts);
+        record_bench_result(case_name + "/predict_b" + std::to_string(batch), latency);
+        BenchStats planned = measure([&]() { model.predict(input, output); bench_sink = output.get_val(0, 0); }, latency_opts);
+        record_bench_result(case_name + "/inference_model_b" + std::to_string(batch), planned);
+        json << (batch > 1 ? ",\n       " : "\n       ") << "{\"batch_size\": " << batch
+             << ", \"repetitions\": " << latency.repetitions << ", \"p50_us\": " << latency.median_us
+             << ", \"p99_us\": " << latency.p99_us << ", \"samples_per_second\": " << batch / (latency.median_us * 1e-6)
+             << ", \"inference_model_p50_us\": " << planned.median_us << ", \"inference_model_p99_us\": " << planned.p99_us << "}";
+    }
+    // Per-layer buffers of ANN::predict against the planned slots of InferenceModel at the largest batch.
+    long unsigned ann_activation_bytes = 0;
+    for (size_t i = 1; i < layers.size(); i++) ann_activation_bytes += (long unsigned)layers[i] * opts.max_batch * sizeof(float);
+    json << "],\n     \"inference_memory\": {\"batch_size\": " << opts.max_batch
+         << ", \"ann_parameter_and_gradient_bytes\": " << 3 * parameters * sizeof(float)
+         << ", \"ann_predict_activation_bytes\": " << ann_activation_bytes
+         << ", \"inference_model_bytes\": " << model.model_bytes()
+         << ", \"inference_workspace_bytes\": " << model.workspace_bytes(opts.max_batch) << "}}";
+    return json.str();
+}
+
+/**
+ * @brief Runs the end-to-end training and inference benchmark for every network and thread count
+ * and emits the results as JSON (to opts.json_path, or stdout if it is empty).
+ * @param opts Benchmark options.
+ * @return 0 on success, -1 if the output file cannot be written or, with --assert-no-alloc,
+ * if a steady-state training step allocated Matrix storage.
+ */
+int run_ann_benchmarks(const BenchOptions& opts) {
+    std::ostringstream json;
+    json << "{\"metadata\": " << bench_metadata_json() << ",\n \"results\": [";
+    int default_threads = omp_get_max_threads();
+    bool first = true;
+    int status = 0;
+    for (auto& layers : opts.networks) {
+        if (!opts.filter.empty() && network_name(layers).find(opts.filter) == std::string::npos) continue;
+        for (int threads : opts.threads) {
+            omp_set_num_threads(threads);
+            std::cerr << "Benchmarking network " << network_name(layers) << " with " << threads << " thread(s)\n";
+            bool allocation_free = true;
+            json << (first ? "\n  " : ",\n  ") << bench_network(layers, threads, opts, allocation_free);
+            first = false;
+            if (opts.assert_no_alloc && !allocation_free) {
+                std::cerr << "Network " << network_name(layers) << " allocates during training steps\n";
+                status = -1;
+            }
+        }
+    }
+    omp_set_num_threads(default_threads);
+    json << "\n]}\n";
+
+    if (opts.json_path.empty()) {
+        std::cout << "\n# ANN throughput\n" << json.str();
+        return status;
+    }
+    std::ofstream out(opts.json_path);
+    if (!out) {
+        std::cerr << "Cannot write " << opts.json_path << "\n";
+        return -1;
+    }
+    out << json.str();
+    std::cout << "\n# ANN throughput written to " << opts.json_path << "\n";
+    return status;
+}
@@ -0,0 +1,428 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <ctime>
+#include <fstream>
+#include <thread>
+#include <omp.h>
+#include <unistd.h>
+#include "../../src/matrix/bf16.h"
+#include "../../src/matrix/matrix.h"
+#include "../../src/profiling/perf_counters.h"
+#include "bench.h"
+#include "compare.h"
+
+#ifndef BENCH_COMPILE_FLAGS
+#define BENCH_COMPILE_FLAGS "unknown"
+#endif
+
+volatile float bench_sink = 0.0f;
+
+/**
+ * @brief Parses a comma-separated list of positive integers.
+ * @param text The list, e.g. "1,2,4".
+ * @return The parsed values.
+ * @throws std::runtime_error if an entry is not a positive integer.
+ */
+static std::vector<int> parse_int_list(const std::string& text) {
+    std::vector<int> values;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        int value = std::atoi(item.c_str());
+        if (value <= 0) {
+            throw std::runtime_error("Invalid value in list: " + text);
+        }
+        values.push_back(value);
+    }
+    return values;
+}
+
+/**
+ * @brief Parses a list of network shapes such as "3x64x4,784x256x10".
+ * @param text Comma-separated networks, layer sizes separated by 'x'.
+ * @return Layer sizes of every network.
+ * @throws std::runtime_error if a network has fewer than two layers or a non-positive size.
+ */
+static std::vector<std::vector<int>> parse_networks(const std::string& text) {
+    std::vector<std::vector<int>> networks;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        std::string sizes = item;
+        std::replace(sizes.begin(), sizes.end(), 'x', ',');
+        std::vector<int> layers = parse_int_list(sizes);
+        if (layers.size() < 2) {
+            throw std::runtime_error("A network needs at least an input and an output layer: " + item);
+        }
+        networks.push_back(layers);
+    }
+    return networks;
+}
+
+/**
+ * @brief Parses benchmark options of the form --name=value.
+ * Recognised options: --warmup, --min-reps, --max-reps, --min-time, --max-time (seconds),
+ * --max-dim, --threads (comma-separated), --filter, --csv, --counters and --suite (comma-separated:
+ * matrix, functions, ann, roofline, layers, graph). The ANN benchmark also takes --networks (e.g. 3x64x4,784x256x10),
+ * --train-samples, --train-batch, --micro-batch, --max-batch, --json (output file) and
+ * --assert-no-alloc; the roofline report uses --networks and --train-batch for its layer shapes
+ * and takes --stream-mb. --save-baseline=FILE stores the timings of the run and --compare=FILE
+ * checks them against a stored baseline with --threshold (percent) and --alpha; --runs repeats
+ * the selected suites.
+ * Without --threads the sweep runs powers of two up to omp_get_max_threads().
+ * @param argc Argument count.
+ * @param argv Argument values.
+ * @return The parsed options.
+ * @throws std::runtime_error on an unknown option or invalid value.
+ */
+BenchOptions parse_bench_options(int argc, char** argv) {
+    BenchOptions opts;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string name = arg;
+        std::string value;
+        size_t eq = arg.find('=');
+        if (eq != std::string::npos) {
+            name = arg.substr(0, eq);
+            value = arg.substr(eq + 1);
+        }
+
+        if (name == "--warmup") opts.warmup = std::atoi(value.c_str());
+        else if (name == "--min-reps") opts.min_repetitions = std::atoi(value.c_str());
+        else if (name == "--max-reps") opts.max_repetitions = std::atoi(value.c_str());
+        else if (name == "--min-time") opts.min_seconds = std::atof(value.c_str());
+        else if (name == "--max-time") opts.max_seconds = std::atof(value.c_str());
+        else if (name == "--max-dim") opts.max_dim = std::atoi(value.c_str());
+        else if (name == "--threads") opts.threads = parse_int_list(value);
+        else if (name == "--filter") opts.filter = value;
+        else if (name == "--csv") opts.csv = true;
+        else if (name == "--counters") opts.counters = true;
+        else if (name == "--suite") {
+            std::stringstream ss(value);
+            std::string suite;
+            while (std::getline(ss, suite, ',')) {
+                if (suite != "matrix" && suite != "functions" && suite != "ann" && suite != "roofline" && suite != "layers" &&
+                    suite != "graph") {
+                    throw std::runtime_error("Unknown benchmark suite: " + suite);
+                }
+                opts.suites.push_back(suite);
+            }
+        }
+        else if (name == "--networks") opts.networks = parse_networks(value);
+        else if (name == "--train-samples") opts.train_samples = std::atoi(value.c_str());
+        else if (name == "--train-batch") opts.train_batch = std::atoi(value.c_str());
+        else if (name == "--micro-batch") opts.micro_batch = std::atoi(value.c_str());
+        else if (name == "--max-batch") opts.max_batch = std::atoi(value.c_str());
+        else if (name == "--json") opts.json_path = value;
+        else if (name == "--assert-no-alloc") opts.assert_no_alloc = true;
+        else if (name == "--stream-mb") opts.stream_mb = std::atoi(value.c_str());
+        else if (name == "--save-baseline") opts.save_baseline_path = value;
+        else if (name == "--compare") opts.compare_path = value;
+        else if (name == "--threshold") opts.threshold_percent = std::atof(value.c_str());
+        else if (name == "--alpha") opts.alpha = std::atof(value.c_str());
+        else if (name == "--runs") opts.runs = std::atoi(value.c_str());
+        else throw std::runtime_error("Unknown benchmark option: " + arg);
+    }
+    if (opts.warmup < 0 || opts.min_repetitions <= 0 || opts.max_repetitions < opts.min_repetitions || opts.max_dim < 4) {
+        throw std::runtime_error("Invalid benchmark repetition or size options.");
+    }
+    if (opts.train_samples <= 0 || opts.train_batch <= 0 || opts.micro_batch <= 0 || opts.max_batch <= 0) {
+        throw std::runtime_error("Invalid ANN benchmark sizes.");
+    }
+    if (opts.stream_mb < 0) {
+        throw std::runtime_error("Invalid STREAM array size.");
+    }
+    if (opts.threshold_percent < 0.0 || opts.alpha <= 0.0 || opts.alpha >= 1.0 || opts.runs <= 0) {
+        throw std::runtime_error("Invalid comparison threshold or significance level.");
+    }
+
+    if (opts.networks.empty()) {
+        opts.networks = {{3, 64, 128, 64, 4}, {32, 256, 256, 10}, {784, 512, 256, 10}};
+    }
+
+    if (opts.threads.empty()) {
+        int max_threads = omp_get_max_threads();
+        for (int t = 1; t < max_threads; t *= 2) opts.threads.push_back(t);
+        opts.threads.push_back(max_threads);
+    }
+    return opts;
+}
+
+/**
+ * @brief Returns the shapes of the size sweep: column vectors (the per-sample case) and
+ * square matrices (the batched case), from 4x1 up to max_dim x max_dim.
+ * @param opts Benchmark options.
+ * @return Vector of {rows, columns} pairs.
+ */
+std::vector<std::array<int, 2>> bench_shapes(const BenchOptions& opts) {
+    std::vector<std::array<int, 2>> shapes;
+    for (int n = 4; n <= opts.max_dim; n *= 4) shapes.push_back({n, 1});
+    for (int n = 64; n <= opts.max_dim; n *= 4) shapes.push_back({n, n});
+    return shapes;
+}
+
+/**
+ * @brief Returns the p-th percentile of sorted samples, interpolating between neighbours.
+ * @param sorted Samples in ascending order.
+ * @param p Percentile in [0, 100].
+ * @return The percentile value (0 for an empty set).
+ */
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    double pos = p / 100.0 * (sorted.size() - 1);
+    size_t lower = size_t(pos);
+    size_t upper = std::min(lower + 1, sorted.size() - 1);
+    double frac = pos - lower;
+    return sorted[lower] * (1.0 - frac) + sorted[upper] * frac;
+}
+
+/**
+ * @brief Times a kernel. Runs opts.warmup untimed calls, then timed calls until both
+ * opts.min_repetitions and opts.min_seconds are reached. A case that exceeds
+ * opts.max_seconds stops early so the largest sizes of slow kernels stay bounded.
+ * @param fn The kernel invocation.
+ * @param opts Benchmark options.
+ * @param setup Optional untimed call before every run, e.g. to restore the input of an in-place kernel.
+ * @return Statistics of the timed calls.
+ */
+BenchStats measure(const std::function<void()>& fn, const BenchOptions& opts, const std::function<void()>& setup) {
+    using clock = std::chrono::steady_clock;
+    auto start = clock::now();
+    for (int i = 0; i < opts.warmup; i++) {
+        if (setup) setup();
+        fn();
+        if (std::chrono::duration<double>(clock::now() - start).count() > opts.max_seconds) break;
+    }
+
+    std::vector<double> samples;
+    double elapsed = 0.0;
+    while (int(samples.size()) < opts.max_repetitions) {
+        if (setup) setup();
+        auto t0 = clock::now();
+        fn();
+        double us = std::chrono::duration<double, std::micro>(clock::now() - t0).count();
+        samples.push_back(us);
+        elapsed += us * 1e-6;
+        if (int(samples.size()) >= opts.min_repetitions && elapsed >= opts.min_seconds) break;
+        if (elapsed >= opts.max_seconds) break;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    BenchStats stats;
+    stats.repetitions = int(samples.size());
+    stats.min_us = samples.front();
+    stats.median_us = percentile(samples, 50.0);
+    stats.p10_us = percentile(samples, 10.0);
+    stats.p90_us = percentile(samples, 90.0);
+    stats.p99_us = percentile(samples, 99.0);
+    stats.samples_us = std::move(samples);
+    return stats;
+}
+
+/**
+ * @brief Fills a matrix with deterministic, well-scaled values (no denormals, no zeros).
+ * @param m The matrix to fill.
+ * @param scale Amplitude of the values.
+ * @param offset Value added to every element.
+ */
+void fill_matrix(Matrix& m, float scale, float offset) {
+    int rows = m.get_rows_num();
+    int cols = m.get_columns_num();
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            m.set_val(r, c, offset + scale * std::sin(0.37f * r + 0.11f * c + 0.5f));
+        }
+    }
+}
+
+/**
+ * @brief Prints the column titles of the result table.
+ * @param opts Benchmark options.
+ */
+void print_bench_header(const BenchOptions& opts) {
+    if (opts.counters && !perf_counters_available()) {
+        std::cerr << "Hardware performance counters are unavailable on this host; counter columns show -\n";
+    }
+    if (opts.csv) {
+        std::cout << "kernel,rows,cols,threads,reps,median_us,p10_us,p90_us,min_us,gflops,gbps"
+                  << (opts.counters ? ",ipc,l1d_per_elem,llc_per_elem,dtlb_per_elem,branch_per_elem" : "") << "\n";
+        return;
+    }
+    std::printf("%-28s %11s %4s %6s %12s %12s %12s %9s %9s", "kernel", "shape", "thr", "reps", "median_us",
+                "p10_us", "p90_us", "GFLOP/s", "GB/s");
+    if (opts.counters) std::printf(" %6s %9s %9s %9s %9s", "IPC", "L1d/elem", "LLC/elem", "dTLB/elem", "br/elem");
+    std::printf("\n");
+}
+
+/**
+ * @brief Runs a kernel a few more times with hardware counters collected (setup excluded).
+ * @param fn The kernel invocation.
+ * @param setup Optional untimed call before every run.
+ * @param repetitions Number of counted runs.
+ * @param elements Receives the output elements of the instrumented kernels over all runs.
+ * @return Counters summed over all instrumented kernels and runs (empty if unavailable).
+ */
+static PerfCounts count_kernel(const std::function<void()>& fn, const std::function<void()>& setup,
+                               int repetitions, double& elements) {
+    perf_kernel_reset();
+    for (int rep = 0; rep < repetitions; rep++) {
+        if (setup) setup();
+        perf_counters_set_enabled(true);
+        fn();
+        perf_counters_set_enabled(false);
+    }
+    PerfCounts counts;
+    elements = 0.0;
+    for (auto& kernel : perf_kernel_report()) {
+        counts.add(kernel.counts);
+        elements += kernel.elements;
+    }
+    perf_kernel_reset();
+    return counts;
+}
+
+/**
+ * @brief Returns true if a suite should run: all suites run unless --suite selected some.
+ * @param opts Benchmark options.
+ * @param suite Suite name.
+ */
+bool bench_suite_enabled(const BenchOptions& opts, const std::string& suite) {
+    return opts.suites.empty() || std::find(opts.suites.begin(), opts.suites.end(), suite) != opts.suites.end();
+}
+
+/**
+ * @brief Escapes quotes, backslashes and control characters for a JSON string literal.
+ * @param text The raw string.
+ * @return The escaped string (without surrounding quotes).
+ */
+std::string json_escape(const std::string& text) {
+    std::string escaped;
+    for (char ch : text) {
+        if (ch == '"' || ch == '\\') {
+            escaped += '\\';
+            escaped += ch;
+        }
+        else if ((unsigned char)ch < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", ch);
+            escaped += buf;
+        }
+        else {
+            escaped += ch;
+        }
+    }
+    return escaped;
+}
+
+/**
+ * @brief Returns the first line of a command's output, or "unknown" if it fails.
+ * @param command Shell command to run.
+ */
+static std::string command_output(const char* command) {
+    std::string result;
+    FILE* pipe = popen(command, "r");
+    if (pipe == nullptr) return "unknown";
+    char buf[256];
+    if (std::fgets(buf, sizeof(buf), pipe) != nullptr) result = buf;
+    pclose(pipe);
+    while (!result.empty() && (result.back() == '\n' || result.back() == '\r')) result.pop_back();
+    return result.empty() ? "unknown" : result;
+}
+
+/**
+ * @brief Reads the CPU model name from /proc/cpuinfo.
+ * @return The model name, or "unknown" if it is not available.
+ */
+static std::string cpu_model() {
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("model name", 0) == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) return line.substr(line.find_first_not_of(' ', colon + 1));
+        }
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Describes the run as a JSON object: UTC timestamp, git revision, host (name, CPU model,
+ * logical CPUs, OpenMP threads, bf16 hardware support) and compiler (version, standard, flags).
+ * @return The JSON object as a string.
+ */
+std::string bench_metadata_json() {
+    char hostname[256] = "unknown";
+    gethostname(hostname, sizeof(hostname) - 1);
+    char timestamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::ostringstream json;
+    json << "{\"timestamp\": \"" << timestamp << "\", "
+         << "\"git_revision\": \"" << json_escape(command_output("git rev-parse --short HEAD 2>/dev/null")) << "\", "
+         << "\"host\": {\"hostname\": \"" << json_escape(hostname) << "\", "
+         << "\"cpu\": \"" << json_escape(cpu_model()) << "\", "
+         << "\"logical_cpus\": " << std::thread::hardware_concurrency() << ", "
+         << "\"omp_max_threads\": " << omp_get_max_threads() << ", "
+         << "\"bf16_hardware\": " << (bf16_hardware_supported() ? "true" : "false") << "}, "
+         << "\"compiler\": {\"version\": \"" << json_escape(__VERSION__) << "\", "
+         << "\"cplusplus\": " << __cplusplus << ", "
+         << "\"flags\": \"" << json_escape(BENCH_COMPILE_FLAGS) << "\"}}";
+    return json.str();
+}
+
+/**
+ * @brief Measures one kernel at one shape for every thread count and prints a result row each.
+ * @param kernel Kernel name (matched against --filter).
+ * @param rows Rows of the shape reported.
+ * @param cols Columns of the shape reported.
+ * @param fn The kernel invocation to time.
+ * @param flops Floating-point operations per invocation (0 if not meaningful).
+ * @param bytes Minimum bytes moved per invocation.
+ * @param opts Benchmark options.
+ * @param setup Optional untimed call before every run.
+ */
+void run_bench_case(const std::string& kernel, int rows, int cols, const std::function<void()>& fn,
+                    double flops, double bytes, const BenchOptions& opts, const std::function<void()>& setup) {
+    if (!opts.filter.empty() && kernel.find(opts.filter) == std::string::npos) return;
+
+    int default_threads = omp_get_max_threads();
+    for (int threads : opts.threads) {
+        omp_set_num_threads(threads);
+        BenchStats stats = measure(fn, opts, setup);
+        record_bench_result(kernel + "/" + std::to_string(rows) + "x" + std::to_string(cols) + "/t" + std::to_string(threads), stats);
+        double seconds = stats.median_us * 1e-6;
+        double gflops = seconds > 0.0 ? flops / seconds * 1e-9 : 0.0;
+        double gbps = seconds > 0.0 ? bytes / seconds * 1e-9 : 0.0;
+
+        if (opts.csv) {
+            std::printf("%s,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.4f,%.4f", kernel.c_str(), rows, cols, threads,
+                        stats.repetitions, stats.median_us, stats.p10_us, stats.p90_us, stats.min_us, gflops, gbps);
+        }
+        else {
+            std::string shape = std::to_string(rows) + "x" + std::to_string(cols);
+            std::printf("%-28s %11s %4d %6d %12.3f %12.3f %12.3f %9.3f %9.3f", kernel.c_str(), shape.c_str(),
+                        threads, stats.repetitions, stats.median_us, stats.p10_us, stats.p90_us, gflops, gbps);
+        }
+        if (opts.counters) {
+            double elements = 0.0;
+            PerfCounts counts = count_kernel(fn, setup, std::min(stats.repetitions, 10), elements);
+            PerfEvent events[] = {PerfEvent::L1DMisses, PerfEvent::LLCMisses, PerfEvent::DTLBMisses, PerfEvent::BranchMisses};
+            if (counts.ipc() > 0.0) std::printf(opts.csv ? ",%.3f" : " %6.2f", counts.ipc());
+            else std::printf(opts.csv ? ",%s" : " %6s", opts.csv ? "" : "-");
+            for (PerfEvent event : events) {
+                if (counts.has(event) && elements > 0.0) std::printf(opts.csv ? ",%.5f" : " %9.4f", counts.per_element(event, elements));
+                else std::printf(opts.csv ? ",%s" : " %9s", opts.csv ? "" : "-");
+            }
+        }
+        std::printf("\n");
+        std::fflush(stdout);
+    }
+    omp_set_num_threads(default_threads);
+}
@@ -0,0 +1,77 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+class Matrix; ///< Forward declaration of Matrix class
+
+/**
+ * @brief Command line options shared by all benchmarks.
+ */
+struct BenchOptions {
+    int warmup = 2; ///< Untimed runs before measuring.
+    int min_repetitions = 5; ///< Timed runs always performed (unless max_seconds is exceeded).
+    int max_repetitions = 1000; ///< Upper bound on timed runs.
+    double min_seconds = 0.2; ///< Keep repeating until this much time has been measured.
+    double max_seconds = 10.0; ///< Stop a case after this long, once at least one run has been timed.
+    int max_dim = 4096; ///< Largest matrix dimension in the size sweep.
+    std::vector<int> threads; ///< OpenMP thread counts to sweep.
+    std::string filter; ///< Only run kernels whose name contains this string.
+    bool csv = false; ///< Print comma-separated rows instead of a table.
+    bool counters = false; ///< Add IPC and misses per element from hardware counters.
+    std::vector<std::string> suites; ///< Benchmark suites to run (matrix, functions, ann, roofline, layers, graph); empty runs all.
+
+    // ANN throughput benchmark
+    std::vector<std::vector<int>> networks; ///< Layer sizes of the benchmarked MLPs.
+    int train_samples = 2048; ///< Synthetic training samples per epoch.
+    int train_batch = 32; ///< Batch size passed to ANN::train_epoch.
+    int micro_batch = 32; ///< Micro-batch size used for training.
+    int max_batch = 1024; ///< Largest inference batch size (powers of two from 1).
+    std::string json_path; ///< Write the ANN results to this file instead of stdout.
+    bool assert_no_alloc = false; ///< Fail if a steady-state training step allocates Matrix storage.
+
+    // Roofline report
+    int stream_mb = 0; ///< Size of each DRAM STREAM triad array in MiB; 0 sizes them from the last-level cache.
+
+    // Regression gate
+    std::string save_baseline_path; ///< Store the timings of this run as a baseline in this file.
+    std::string compare_path; ///< Compare the timings of this run against the baseline in this file.
+    double threshold_percent = 5.0; ///< Slowdown of the median (in percent) that fails the comparison.
+    double alpha = 0.05; ///< Significance level of the Mann-Whitney U test.
+    int runs = 1; ///< Repeat the selected suites this many times; comparisons test the per-run medians.
+};
+
+/**
+ * @brief Timing statistics of one benchmark case, in microseconds.
+ */
+struct BenchStats {
+    int repetitions = 0; ///< Number of timed runs.
+    double min_us = 0.0; ///< Fastest run.
+    double median_us = 0.0; ///< Median run.
+    double p10_us = 0.0; ///< 10th percentile.
+    double p90_us = 0.0; ///< 90th percentile.
+    double p99_us = 0.0; ///< 99th percentile.
+    std::vector<double> samples_us; ///< All timed runs, in ascending order.
+};
+
+extern volatile float bench_sink; ///< Receives kernel results so the compiler cannot drop the work.
+
+BenchOptions parse_bench_options(int argc, char** argv); ///< Parses --flag=value options; throws std::runtime_error on bad input.
+std::vector<std::array<int, 2>> bench_shapes(const BenchOptions& opts); ///< Matrix shapes of the size sweep, from 4x1 to max_dim x max_dim.
+double percentile(const std::vector<double>& sorted, double p); ///< Linearly interpolated percentile of sorted samples.
+BenchStats measure(const std::function<void()>& fn, const BenchOptions& opts,
+                   const std::function<void()>& setup = nullptr); ///< Warms up, then times fn repeatedly.
+void fill_matrix(Matrix& m, float scale, float offset = 0.0f); ///< Fills a matrix with deterministic values in [offset - scale, offset + scale].
+void print_bench_header(const BenchOptions& opts); ///< Prints the column titles of the result table.
+bool bench_suite_enabled(const BenchOptions& opts, const std::string& suite); ///< Returns true if the suite was selected with --suite.
+std::string json_escape(const std::string& text); ///< Escapes a string for use inside a JSON string literal.
+std::string bench_metadata_json(); ///< JSON object describing the host, compiler and build of this run.
+
+void run_bench_case(const std::string& kernel, int rows, int cols, const std::function<void()>& fn,
+                    double flops, double bytes, const BenchOptions& opts,
+                    const std::function<void()>& setup = nullptr); ///< Measures and prints one kernel at one shape for every thread count.
+
+#endif
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include "compare.h"
+
+static constexpr size_t min_runs_per_side = 3; // Fewer per-run medians than this always fall back to pooled repetitions
+
+static std::vector<BenchResult> results; // Cases recorded by this process, in execution order
+static std::map<std::string, size_t> result_index; // Position of each case in results
+
+/**
+ * @brief Adds one run of a case to the results: its repetitions are pooled and its median is
+ * kept separately, since repetitions within one run share that run's noise (placement, clock
+ * frequency, other load) and are not independent samples of the between-run variation.
+ * @param name Case name, unique within one run of the suites.
+ * @param stats Timings of the case.
+ */
+void record_bench_result(const std::string& name, const BenchStats& stats) {
+    auto found = result_index.find(name);
+    if (found == result_index.end()) {
+        found = result_index.emplace(name, results.size()).first;
+        results.push_back({name, {}, {}});
+    }
+    BenchResult& result = results[found->second];
+    result.samples_us.insert(result.samples_us.end(), stats.samples_us.begin(), stats.samples_us.end());
+    result.run_medians_us.push_back(stats.median_us);
+}
+
+/**
+ * @brief Returns the cases recorded in this run.
+ * @return The results in execution order.
+ */
+const std::vector<BenchResult>& bench_results() {
+    return results;
+}
+
+/**
+ * @brief Writes results as a baseline JSON file, with the metadata of this run.
+ * @param path Output file.
+ * @param results Cases to store.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void save_bench_baseline(const std::string& path, const std::vector<BenchResult>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        throw std::runtime_error("Cannot write baseline: " + path);
+    }
+    out << "{\"metadata\": " << bench_metadata_json() << ",\n \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        out << (i ? ",\n  " : "\n  ") << "{\"name\": \"" << json_escape(results[i].name) << "\", \"run_medians_us\": [";
+        for (size_t s = 0; s < results[i].run_medians_us.size(); s++) out << (s ? ", " : "") << results[i].run_medians_us[s];
+        out << "], \"samples_us\": [";
+        for (size_t s = 0; s < results[i].samples_us.size(); s++) out << (s ? ", " : "") << results[i].samples_us[s];
+        out << "]}";
+    }
+    out << "\n]}\n";
+}
+
+/**
+ * @brief Reads a JSON string literal starting at the opening quote.
+ * @param text The document.
+ * @param pos Position of the opening quote; moved past the closing quote.
+ * @return The unescaped string.
+ * @throws std::runtime_error if the string is not terminated.
+ */
+static std::string read_json_string(const std::string& text, size_t& pos) {
+    std::string value;
+    for (pos++; pos < text.size() && text[pos] != '"'; pos++) {
+        if (text[pos] == '\\' && pos + 1 < text.size()) pos++;
+        value += text[pos];
+    }
+    if (pos >= text.size()) {
+        throw std::runtime_error("Unterminated string in baseline.");
+    }
+    pos++;
+    return value;
+}
+
+/**
+ * @brief Parses the number array that follows a key, e.g. "samples_us": [1, 2].
+ * @param text The document.
+ * @param key The quoted key.
+ * @param from Search start.
+ * @param end Search limit (the start of the next result object).
+ * @param values Receives the numbers.
+ * @return Position of the closing bracket, or std::string::npos if the key is absent before end.
+ */
+static size_t read_json_numbers(const std::string& text, const std::string& key, size_t from, size_t end, std::vector<double>& values) {
+    size_t found = text.find(key, from);
+    if (found == std::string::npos || found >= end) return std::string::npos;
+    size_t open = text.find('[', found);
+    size_t close = open == std::string::npos ? open : text.find(']', open);
+    if (close == std::string::npos) {
+        throw std::runtime_error("Malformed number array in baseline.");
+    }
+    std::stringstream items(text.substr(open + 1, close - open - 1));
+    std::string item;
+    while (std::getline(items, item, ',')) values.push_back(std::atof(item.c_str()));
+    return close;
+}
+
+/**
+ * @brief Reads a baseline written by save_bench_baseline. Only the "name", "run_medians_us" and
+ * "samples_us" fields of the result objects are interpreted; the metadata is ignored.
+ * @param path Baseline file.
+ * @return The stored cases.
+ * @throws std::runtime_error if the file cannot be read or is malformed.
+ */
+std::vector<BenchResult> load_bench_baseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Cannot read baseline: " + path);
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+
+    std::vector<BenchResult> loaded;
+    size_t pos = text.find("\"results\"");
+    if (pos == std::string::npos) {
+        throw std::runtime_error("Baseline has no results: " + path);
+    }
+    const std::string name_key = "\"name\"";
+    while ((pos = text.find(name_key, pos)) != std::string::npos) {
+        pos = text.find('"', pos + name_key.size());
+        if (pos == std::string::npos) break;
+        BenchResult result;
+        result.name = read_json_string(text, pos);
+        size_t next = text.find(name_key, pos);
+        if (next == std::string::npos) next = text.size();
+        read_json_numbers(text, "\"run_medians_us\"", pos, next, result.run_medians_us);
+        if (read_json_numbers(text, "\"samples_us\"", pos, next, result.samples_us) == std::string::npos) {
+            throw std::runtime_error("Missing samples of " + result.name + " in baseline.");
+        }
+        std::sort(result.samples_us.begin(), result.samples_us.end());
+        loaded.push_back(result);
+        pos = next;
+    }
+    return loaded;
+}
+
+/**
+ * @brief Two-sided Mann-Whitney U test, using the normal approximation with tie and
+ * continuity corrections. It makes no assumption about the shape of the timing
+ * distributions, which are skewed by interrupts and frequency changes.
+ * @param a First sample.
+ * @param b Second sample.
+ * @return The p-value (1 if either sample is empty or all values are tied).
+ */
+double mann_whitney_p_value(const std::vector<double>& a, const std::vector<double>& b) {
+    double n1 = double(a.size());
+    double n2 = double(b.size());
+    if (a.empty() || b.empty()) return 1.0;
+
+    std::vector<std::pair<double, int>> pooled;
+    for (double v : a) pooled.push_back({v, 0});
+    for (double v : b) pooled.push_back({v, 1});
+    std::sort(pooled.begin(), pooled.end());
+
+    // Average ranks over ties; accumulate the tie term t^3 - t for the variance.
+    double rank_sum_a = 0.0;
+    double ties = 0.0;
+    for (size_t i = 0; i < pooled.size();) {
+        size_t j = i;
+        while (j < pooled.size() && pooled[j].first == pooled[i].first) j++;
+        double rank = (double(i) + double(j) + 1.0) / 2.0;
+        for (size_t k = i; k < j; k++) {
+            if (pooled[k].second == 0) rank_sum_a += rank;
+        }
+        double t = double(j - i);
+        ties += t * t * t - t;
+        i = j;
+    }
+
+    double u = rank_sum_a - n1 * (n1 + 1.0) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double n = n1 + n2;
+    double variance = n1 * n2 / 12.0 * ((n + 1.0) - ties / (n * (n - 1.0)));
+    if (variance <= 0.0) return 1.0;
+    double z = (std::fabs(u - mean) - 0.5) / std::sqrt(variance);
+    if (z < 0.0) z = 0.0;
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+/**
+ * @brief Returns the smallest p-value mann_whitney_p_value can give for samples of these sizes,
+ * reached when every value of one sample is below every value of the other. It is about 0.08
+ * for 3 runs per side, 0.03 for 4 and 0.012 for 5.
+ * @param n1 Size of the first sample.
+ * @param n2 Size of the second sample.
+ * @return The p-value of two fully separated samples.
+ */
+static double smallest_p_value(size_t n1, size_t n2) {
+    std::vector<double> low(n1);
+    std::vector<double> high(n2);
+    for (size_t i = 0; i < n1; i++) low[i] = double(i);
+    for (size_t i = 0; i < n2; i++) high[i] = double(n1 + i);
+    return mann_whitney_p_value(low, high);
+}
+
+/**
+ * @brief Returns the median of a sample.
+ * @param samples The sample (any order).
+ * @return The median (0 for an empty sample).
+ */
+static double median_of(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return percentile(samples, 50.0);
+}
+
+/**
+ * @brief Compares the cases present in both runs. A case regresses if its median time grew
+ * by more than the threshold and the Mann-Whitney test rejects equal distributions at alpha;
+ * requiring both keeps noisy cases and tiny but significant shifts from failing the gate.
+ * When both sides have enough runs for the test to reach alpha at all (at least three, and four
+ * per side at alpha = 0.05), the test and the medians use the per-run medians, so that
+ * run-to-run noise is part of the null hypothesis. Otherwise the pooled repetitions are tested,
+ * which overstates significance when runs differ systematically but, unlike per-run medians the
+ * test cannot reject, still flags a clear regression.
+ * @param baseline Stored cases.
+ * @param current Cases of this run.
+ * @param threshold_percent Change of the median that counts as a regression or improvement.
+ * @param alpha Significance level.
+ * @return One comparison per case of this run that has a baseline, in execution order.
+ */
+std::vector<BenchComparison> compare_bench_results(const std::vector<BenchResult>& baseline, const std::vector<BenchResult>& current,
+                                                   double threshold_percent, double alpha) {
+    std::map<std::string, const BenchResult*> stored;
+    for (auto& result : baseline) stored[result.name] = &result;
+
+    std::vector<BenchComparison> comparisons;
+    for (auto& result : current) {
+        auto found = stored.find(result.name);
+        if (found == stored.end() || found->second->samples_us.empty() || result.samples_us.empty()) continue;
+        BenchComparison comparison;
+        comparison.name = result.name;
+        size_t baseline_runs = found->second->run_medians_us.size();
+        size_t current_runs = result.run_medians_us.size();
+        comparison.per_run = baseline_runs >= min_runs_per_side && current_runs >= min_runs_per_side &&
+                             smallest_p_value(baseline_runs, current_runs) < alpha;
+        const std::vector<double>& before = comparison.per_run ? found->second->run_medians_us : found->second->samples_us;
+        const std::vector<double>& after = comparison.per_run ? result.run_medians_us : result.samples_us;
+        comparison.baseline_median_us = median_of(before);
+        comparison.current_median_us = median_of(after);
+        if (comparison.baseline_median_us > 0.0) {
+            comparison.change_percent = (comparison.current_median_us / comparison.baseline_median_us - 1.0) * 100.0;
+        }
+        comparison.p_value = mann_whitney_p_value(before, after);
+        bool significant = comparison.p_value < alpha;
+        comparison.regression = significant && comparison.change_percent > threshold_percent;
+        comparison.improvement = significant && comparison.change_percent < -threshold_percent;
+        comparisons.push_back(comparison);
+    }
+    return comparisons;
+}
+
+/**
+ * @brief Saves this run's results as a baseline (--save-baseline) and/or compares them against
+ * a stored baseline (--compare), printing a per-case speedup/slowdown table to stdout.
+ * @param opts Benchmark options.
+ * @return 0 on success, -1 if a file cannot be read or written or a case regressed.
+ */
+int run_bench_comparison(const BenchOptions& opts) {
+    try {
+        if (!opts.compare_path.empty()) {
+            std::vector<BenchResult> baseline = load_bench_baseline(opts.compare_path);
+            std::vector<BenchComparison> comparisons = compare_bench_results(baseline, bench_results(), opts.threshold_percent, opts.alpha);
+
+            std::printf("\n# Comparison against %s (threshold %.1f%%, alpha %.3g)\n", opts.compare_path.c_str(),
+                        opts.threshold_percent, opts.alpha);
+            std::printf("%-56s %14s %14s %9s %8s %9s %7s %10s\n", "case", "baseline_us", "current_us", "change", "speedup", "p",
+                        "tested", "verdict");
+            int regressions = 0;
+            int improvements = 0;
+            for (auto& c : comparisons) {
+                const char* verdict = c.regression ? "SLOWER" : (c.improvement ? "faster" : "same");
+                std::printf("%-56s %14.3f %14.3f %+8.1f%% %7.3fx %9.2g %7s %10s\n", c.name.c_str(), c.baseline_median_us,
+                            c.current_median_us, c.change_percent, c.baseline_median_us / c.current_median_us, c.p_value,
+                            c.per_run ? "runs" : "reps", verdict);
+                regressions += c.regression;
+                improvements += c.improvement;
+            }
+            std::printf("%zu cases compared, %d slower, %d faster, %zu without baseline\n", comparisons.size(), regressions,
+                        improvements, bench_results().size() - comparisons.size());
+            if (regressions > 0) {
+                std::cerr << regressions << " benchmark case(s) regressed by more than " << opts.threshold_percent << "%\n";
+                return -1;
+            }
+        }
+        if (!opts.save_baseline_path.empty()) {
+            save_bench_baseline(opts.save_baseline_path, bench_results());
+            std::cout << "\n# Baseline of " << bench_results().size() << " cases written to " << opts.save_baseline_path << "\n";
+        }
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << "\n";
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#include <string>
+#include <vector>
+#include "bench.h"
+
+/**
+ * @brief Timings of one benchmark case, identified by a name unique within a run.
+ */
+struct BenchResult {
+    std::string name; ///< Case name, e.g. "matrixMultiply/64x64/t1".
+    std::vector<double> samples_us; ///< All timed repetitions of all runs, in microseconds.
+    std::vector<double> run_medians_us; ///< Median of each run (--runs) in microseconds.
+};
+
+/**
+ * @brief Outcome of comparing one case against its baseline.
+ */
+struct BenchComparison {
+    std::string name; ///< Case name.
+    double baseline_median_us = 0.0; ///< Median of the baseline runs.
+    double current_median_us = 0.0; ///< Median of this run.
+    double change_percent = 0.0; ///< Change of the median time; positive is slower.
+    double p_value = 1.0; ///< Two-sided Mann-Whitney U p-value.
+    bool per_run = false; ///< Whether the test used per-run medians rather than pooled repetitions.
+    bool regression = false; ///< Significantly slower by more than the threshold.
+    bool improvement = false; ///< Significantly faster by more than the threshold.
+};
+
+void record_bench_result(const std::string& name, const BenchStats& stats); ///< Adds one run of a case to the results of this process.
+const std::vector<BenchResult>& bench_results(); ///< Returns the cases recorded in this run.
+void save_bench_baseline(const std::string& path, const std::vector<BenchResult>& results); ///< Writes results as a baseline JSON file; throws std::runtime_error on failure.
+std::vector<BenchResult> load_bench_baseline(const std::string& path); ///< Reads a baseline written by save_bench_baseline; throws std::runtime_error on failure.
+double mann_whitney_p_value(const std::vector<double>& a, const std::vector<double>& b); ///< Two-sided p-value that both samples come from the same distribution.
+std::vector<BenchComparison> compare_bench_results(const std::vector<BenchResult>& baseline, const std::vector<BenchResult>& current,
+                                                   double threshold_percent, double alpha); ///< Compares the cases present in both runs.
+int run_bench_comparison(const BenchOptions& opts); ///< Saves and/or compares this run's results; returns -1 on a regression.
+
+#endif
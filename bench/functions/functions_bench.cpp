@@ -0,0 +1,115 @@
+#include <iostream>
+#include "../../src/functions/functions.h"
+#include "../../src/matrix/matrix.h"
+#include "functions_bench.h"
+
+// Nominal floating-point operation counts per element: a transcendental (exp, tanh, log)
+// counts as one operation, so GFLOP/s of those kernels compares runs, not hardware peaks.
+
+/**
+ * @brief Benchmarks every activation function for one shape.
+ * The activations work in place, so the input is restored before every (untimed) run.
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @param opts Benchmark options.
+ */
+static void bench_activations(int rows, int cols, const BenchOptions& opts) {
+    Functions F;
+    Matrix source(rows, cols);
+    Matrix m(rows, cols);
+    fill_matrix(source, 3.0f);
+    double n = double(rows) * cols;
+    auto restore = [&]() { m.setValsFormMatrix(source); };
+
+    run_bench_case("ReLu", rows, cols, [&]() { F.ReLu(m); }, n, 8.0 * n, opts, restore);
+    run_bench_case("sigmoid", rows, cols, [&]() { F.sigmoid(m); }, 4.0 * n, 8.0 * n, opts, restore);
+    run_bench_case("Tanh", rows, cols, [&]() { F.Tanh(m); }, n, 8.0 * n, opts, restore);
+    run_bench_case("linear", rows, cols, [&]() { F.linear(m); }, 0.0, 8.0 * n, opts, restore);
+    run_bench_case("softmax", rows, cols, [&]() { F.softmax(m); }, 4.0 * n, 8.0 * n, opts, restore);
+    run_bench_case("softmax_columns", rows, cols, [&]() { F.softmax_columns(m); }, 4.0 * n, 8.0 * n, opts, restore);
+}
+
+/**
+ * @brief Benchmarks every loss function for one shape (columns are samples).
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @param opts Benchmark options.
+ */
+static void bench_losses(int rows, int cols, const BenchOptions& opts) {
+    Functions F;
+    Matrix logits(rows, cols);
+    Matrix predictions(rows, cols);
+    Matrix y(rows, cols);
+    Matrix m_diff(rows, cols);
+    Matrix probabilities(rows, cols);
+    Matrix gradient(rows, cols);
+    fill_matrix(logits, 3.0f);
+    predictions.setValsFormMatrix(logits);
+    F.softmax_columns(predictions);
+    for (int c = 0; c < cols; c++) y.set_val(c % rows, c, 1.0f); // One-hot targets
+    F.diff(m_diff, predictions, y);
+    double n = double(rows) * cols;
+
+    run_bench_case("diff", rows, cols, [&]() { F.diff(m_diff, predictions, y); }, n, 12.0 * n, opts);
+    run_bench_case("MSE(diff)", rows, cols, [&]() { bench_sink = F.MSE(m_diff); }, 2.0 * n, 4.0 * n, opts);
+    run_bench_case("MSE(predictions,y)", rows, cols, [&]() { bench_sink = F.MSE(predictions, y); }, 3.0 * n, 8.0 * n, opts);
+    run_bench_case("Cross_Entropy", rows, cols, [&]() { bench_sink = F.Cross_Entropy(predictions, y); }, 3.0 * n, 8.0 * n, opts);
+    run_bench_case("softmax_cross_entropy", rows, cols,
+                   [&]() { bench_sink = F.softmax_cross_entropy(logits, y, probabilities, gradient); }, 7.0 * n, 16.0 * n, opts);
+    run_bench_case("batch_metrics", rows, cols,
+                   [&]() { bench_sink = float(F.batch_metrics(predictions, y).squared_error); }, 5.0 * n, 8.0 * n, opts);
+}
+
+/**
+ * @brief Benchmarks every activation and loss derivative for one shape.
+ * softmax_derivative builds the full Jacobian of one sample, so it only runs on column shapes.
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @param opts Benchmark options.
+ */
+static void bench_derivatives(int rows, int cols, const BenchOptions& opts) {
+    Functions F;
+    Matrix m(rows, cols);
+    Matrix derivatives(rows, cols);
+    Matrix probabilities(rows, cols);
+    Matrix y(rows, cols);
+    Matrix source_gradient(rows, cols);
+    Matrix gradient(rows, cols);
+    fill_matrix(m, 3.0f);
+    probabilities.setValsFormMatrix(m);
+    F.softmax_columns(probabilities);
+    for (int c = 0; c < cols; c++) y.set_val(c % rows, c, 1.0f);
+    fill_matrix(source_gradient, 1.0f);
+    double n = double(rows) * cols;
+
+    run_bench_case("ReLu_derivative", rows, cols, [&]() { F.ReLu_derivative(derivatives, m); }, n, 8.0 * n, opts);
+    run_bench_case("sigmoid_derivative", rows, cols, [&]() { F.sigmoid_derivative(derivatives, m); }, 2.0 * n, 8.0 * n, opts);
+    run_bench_case("Tanh_derivative", rows, cols, [&]() { F.Tanh_derivative(derivatives, m); }, 3.0 * n, 8.0 * n, opts);
+    run_bench_case("linear_derivative", rows, cols, [&]() { F.linear_derivative(derivatives, m); }, 0.0, 4.0 * n, opts);
+    run_bench_case("MSE_derivative", rows, cols, [&]() { F.MSE_derivative(derivatives, m); }, 2.0 * n, 8.0 * n, opts);
+    run_bench_case("Cross_Entropy_derivative", rows, cols,
+                   [&]() { F.Cross_Entropy_derivative(derivatives, y, probabilities); }, 2.0 * n, 12.0 * n, opts);
+    run_bench_case("softmax_backward", rows, cols, [&]() { F.softmax_backward(gradient, probabilities); }, 4.0 * n, 16.0 * n, opts,
+                   [&]() { gradient.setValsFormMatrix(source_gradient); });
+    if (cols == 1) {
+        Matrix jacobian(rows, rows);
+        run_bench_case("softmax_derivative", rows, rows, [&]() { F.softmax_derivative(jacobian, probabilities); },
+                       double(rows) * rows, 4.0 * double(rows) * rows, opts);
+    }
+}
+
+/**
+ * @brief Runs all activation, loss and derivative benchmarks over the size and thread sweep.
+ * @param opts Benchmark options.
+ * @return 0 on success.
+ */
+int run_functions_benchmarks(const BenchOptions& opts) {
+    std::cout << "\n# Functions: activations, losses and derivatives\n";
+    print_bench_header(opts);
+    for (auto& [rows, cols] : bench_shapes(opts)) {
+        bench_activations(rows, cols, opts);
+        bench_losses(rows, cols, opts);
+        bench_derivatives(rows, cols, opts);
+    }
+    return 0;
+}
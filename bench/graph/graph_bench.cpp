@@ -0,0 +1,54 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../../src/graph/graph.h"
+#include "graph_bench.h"
+
+/**
+ * @brief Benchmarks a training step of an inception-style graph (a stem layer, parallel
+ * two-layer branches concatenated into a linear head) with its branches run concurrently and one
+ * after the other. Rows and columns of the reported shape are the branch width and the batch.
+ * @param branches Number of parallel branches.
+ * @param width Units of every hidden layer.
+ * @param batch Samples per batch.
+ * @param opts Benchmark options.
+ */
+static void bench_branches(int branches, int width, int batch, const BenchOptions& opts) {
+    Graph graph;
+    int in = graph.input(width);
+    int stem = graph.dense(in, width, "ReLu");
+    std::vector<int> outputs;
+    for (int b = 0; b < branches; b++) outputs.push_back(graph.dense(graph.dense(stem, width, "ReLu"), width, "ReLu"));
+    graph.dense(graph.concat(outputs), 10, "linear");
+
+    Matrix input(width, batch);
+    Matrix target(10, batch);
+    fill_matrix(input, 1.0f);
+    fill_matrix(target, 1.0f);
+    // Two GEMMs per branch layer and the stem, one for the head; backward does twice the work.
+    double forward_flops = 2.0 * batch * (double(width) * width * (2 * branches + 1) + 10.0 * width * branches);
+    double bytes = 4.0 * (double(width) * width * (2 * branches + 1) + double(width) * batch * (3 * branches + 2));
+    std::string suffix = " x" + std::to_string(branches);
+    for (bool parallel : {false, true}) {
+        graph.set_parallel_branches(parallel);
+        std::string mode = parallel ? "[concurrent]" : "[sequential]";
+        run_bench_case("Graph::forward" + mode + suffix, width, batch, [&]() { graph.forward(input); },
+                       forward_flops, bytes, opts);
+        run_bench_case("Graph::train_batch" + mode + suffix, width, batch,
+                       [&]() { graph.train_batch(input, target, 1e-4f); }, 3.0 * forward_flops, 3.0 * bytes, opts);
+    }
+}
+
+/**
+ * @brief Runs the graph benchmarks: 8 branches of 64 units on batches of 32 (small branches that
+ * cannot fill the machine one at a time) and 4 branches of 256 units on batches of 128.
+ * @param opts Benchmark options.
+ * @return 0 on success.
+ */
+int run_graph_benchmarks(const BenchOptions& opts) {
+    std::cout << "\n# Graph\n";
+    print_bench_header(opts);
+    bench_branches(8, 64, 32, opts);
+    bench_branches(4, 256, 128, opts);
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include <iostream>
+#include <string>
+#include "../../src/layers/conv2d.h"
+#include "../../src/layers/normalization.h"
+#include "../../src/layers/dropout.h"
+#include "../../src/layers/embedding.h"
+#include "../../src/layers/recurrent.h"
+#include "../../src/layers/attention.h"
+#include "../../src/random/philox.h"
+#include "layers_bench.h"
+
+/**
+ * @brief Benchmarks the forward and backward pass of one convolution geometry with the im2col
+ * and the direct kernel. Rows and columns of the reported shape are those of the output batch.
+ * @param label Geometry label appended to the kernel name, e.g. "3x3".
+ * @param shape Geometry.
+ * @param batch Samples per batch.
+ * @param opts Benchmark options.
+ */
+static void bench_conv2d(const std::string& label, const Conv2DShape& shape, int batch, const BenchOptions& opts) {
+    Conv2D conv(shape);
+    Matrix input(shape.input_size(), batch);
+    Matrix output(shape.output_size(), batch);
+    Matrix grad_output(shape.output_size(), batch);
+    Matrix grad_input(shape.input_size(), batch);
+    fill_matrix(input, 1.0f);
+    fill_matrix(grad_output, 1.0f);
+    double flops = conv.flops(batch);
+    double bytes = 4.0 * (double(shape.input_size()) * batch + double(shape.output_size()) * batch +
+                          double(shape.out_channels) * shape.patch_size());
+
+    const ConvAlgorithm algorithms[] = {ConvAlgorithm::Im2col, ConvAlgorithm::Direct};
+    const char* names[] = {"im2col", "direct"};
+    for (int a = 0; a < 2; a++) {
+        conv.set_algorithm(algorithms[a]);
+        std::string suffix = std::string("[") + names[a] + "] " + label;
+        run_bench_case("Conv2D::forward" + suffix, shape.output_size(), batch, [&]() { conv.forward(input, output); },
+                       flops, bytes, opts);
+        run_bench_case("Conv2D::backward" + suffix, shape.output_size(), batch,
+                       [&]() { conv.backward(input, grad_output, &grad_input); }, 2.0 * flops, 2.0 * bytes, opts);
+    }
+}
+
+/**
+ * @brief Benchmarks the training forward, backward and (for BatchNorm) inference pass of a
+ * normalization over a features x batch matrix.
+ * @param type BatchNorm or LayerNorm.
+ * @param features Rows of the batch.
+ * @param batch Samples per batch.
+ * @param opts Benchmark options.
+ */
+static void bench_normalization(NormType type, int features, int batch, const BenchOptions& opts) {
+    Normalization norm(type, features);
+    Matrix input(features, batch);
+    Matrix output(features, batch);
+    Matrix grad(features, batch);
+    fill_matrix(input, 1.0f);
+    fill_matrix(grad, 1.0f);
+    double elements = double(features) * batch;
+    std::string name = type == NormType::BatchNorm ? "BatchNorm" : "LayerNorm";
+    // Statistics + normalize: two reads and one write; backward: sums, then dx from x and dy.
+    run_bench_case(name + "::forward", features, batch, [&]() { norm.forward(input, output, true); },
+                   7.0 * elements, 12.0 * elements, opts);
+    run_bench_case(name + "::backward", features, batch, [&]() { norm.backward(input, grad, output); },
+                   11.0 * elements, 20.0 * elements, opts);
+    if (type == NormType::BatchNorm) {
+        run_bench_case(name + "::inference", features, batch, [&]() { norm.forward(input, output, false); },
+                       2.0 * elements, 8.0 * elements, opts);
+    }
+}
+
+/**
+ * @brief Benchmarks mask generation and the fused ReLU + dropout kernels against the plain
+ * activation they replace.
+ * @param rows Features of the layer output.
+ * @param batch Samples per batch.
+ * @param opts Benchmark options.
+ */
+static void bench_dropout(int rows, int batch, const BenchOptions& opts) {
+    Dropout dropout(0.5f, ElementwiseActivation::ReLu);
+    Matrix z(rows, batch);
+    Matrix a(rows, batch);
+    Matrix error(rows, batch);
+    fill_matrix(z, 1.0f);
+    fill_matrix(error, 1.0f);
+    long n = long(rows) * batch;
+    double elements = double(n);
+    uint64_t step = 0;
+    // One Philox block (ten rounds) per four activations; one bit written per activation.
+    run_bench_case("Dropout::generate_mask", rows, batch, [&]() { dropout.generate_mask(n, 1, step++); },
+                   30.0 * elements, elements / 8.0, opts);
+    run_bench_case("Dropout::forward", rows, batch, [&]() { dropout.forward(z, a); },
+                   2.0 * elements, 8.0 * elements + elements / 8.0, opts);
+    run_bench_case("Dropout::backward", rows, batch, [&]() { dropout.backward(a, error); },
+                   3.0 * elements, 12.0 * elements + elements / 8.0, opts);
+}
+
+/**
+ * @brief Benchmarks the embedding lookup and the sparse backward + update + reset step. The
+ * work depends on fields * dim * batch only, not on the vocabulary.
+ * @param vocab Number of IDs.
+ * @param dim Values per ID.
+ * @param fields ID rows per sample.
+ * @param batch Samples per batch.
+ * @param opts Benchmark options.
+ */
+static void bench_embedding(long vocab, int dim, int fields, int batch, const BenchOptions& opts) {
+    Embedding embedding(vocab, dim);
+    Matrix ids(fields, batch);
+    PhiloxStream rng(3, 1);
+    for (int f = 0; f < fields; f++)
+        for (int c = 0; c < batch; c++) ids.set_val(f, c, float(rng.below(uint64_t(f) * batch + c, uint32_t(vocab))));
+    Matrix output(fields * dim, batch);
+    Matrix grad(fields * dim, batch);
+    fill_matrix(grad, 1.0f);
+    embedding.forward(ids, output, true);
+    double elements = double(fields) * dim * batch;
+    // Gathered table rows in, embeddings out; backward reads the gradient and updates each used row.
+    run_bench_case("Embedding::forward", fields * dim, batch, [&]() { embedding.forward(ids, output, true); },
+                   0.0, 8.0 * elements, opts);
+    run_bench_case("Embedding::backward+update", fields * dim, batch, [&]() {
+                       embedding.backward(grad);
+                       embedding.update_weights(1e-6f);
+                       embedding.reset_gradients();
+                   }, 3.0 * elements, 20.0 * elements, opts);
+}
+
+/**
+ * @brief Benchmarks the forward and backward pass through time of one recurrent cell. Rows and
+ * columns of the reported shape are those of the hidden-state output.
+ * @param cell LSTM or GRU.
+ * @param input_size Features per step.
+ * @param hidden Hidden units.
+ * @param steps Steps per sequence.
+ * @param batch Sequences per batch.
+ * @param opts Benchmark options.
+ */
+static void bench_recurrent(RecurrentCell cell, int input_size, int hidden, int steps, int batch, const BenchOptions& opts) {
+    Recurrent layer(cell, input_size, hidden);
+    Matrix input(input_size, steps * batch);
+    Matrix output(hidden, steps * batch);
+    Matrix grad_output(hidden, steps * batch);
+    Matrix grad_input(input_size, steps * batch);
+    fill_matrix(input, 1.0f);
+    fill_matrix(grad_output, 1.0f);
+    layer.forward(input, output, steps);
+    double flops = layer.flops(steps, batch);
+    // Weights once, the input and output sequences and the stored gates of every step.
+    double bytes = 4.0 * (double(layer.gate_rows()) * (input_size + hidden) +
+                          (double(input_size) + hidden + layer.gate_rows()) * steps * batch);
+    std::string name = cell == RecurrentCell::LSTM ? "LSTM" : "GRU";
+    run_bench_case(name + "::forward", hidden, steps * batch, [&]() { layer.forward(input, output, steps); },
+                   flops, bytes, opts);
+    run_bench_case(name + "::backward", hidden, steps * batch,
+                   [&]() { layer.backward(input, grad_output, &grad_input); }, 2.0 * flops, 2.0 * bytes, opts);
+}
+
+/**
+ * @brief Benchmarks self-attention with the blocked online-softmax kernel against the
+ * materialized seq x seq scores, and the shared backward pass. Rows and columns of the reported
+ * shape are those of the output batch.
+ * @param model_dim Rows of the input and output.
+ * @param heads Number of heads.
+ * @param seq_len Positions per sample.
+ * @param batch Samples per batch.
+ * @param opts Benchmark options.
+ */
+static void bench_attention(int model_dim, int heads, int seq_len, int batch, const BenchOptions& opts) {
+    MultiHeadAttention layer(model_dim, heads);
+    Matrix input(model_dim, seq_len * batch);
+    Matrix output(model_dim, seq_len * batch);
+    Matrix grad_output(model_dim, seq_len * batch);
+    Matrix grad_input(model_dim, seq_len * batch);
+    fill_matrix(input, 1.0f);
+    fill_matrix(grad_output, 1.0f);
+    double flops = layer.flops(seq_len, batch);
+    // Weights, input, Q/K/V, context and output; the materialized kernel also writes and reads
+    // the probabilities of every head twice.
+    double bytes = 4.0 * (4.0 * model_dim * model_dim + 6.0 * model_dim * double(seq_len) * batch);
+    double score_bytes = 4.0 * 3.0 * double(seq_len) * seq_len * heads * batch;
+    std::string suffix = " seq" + std::to_string(seq_len);
+    layer.set_algorithm(AttentionAlgorithm::Materialized);
+    run_bench_case("Attention::forward[materialized]" + suffix, model_dim, seq_len * batch,
+                   [&]() { layer.forward(input, output, seq_len); }, flops, bytes + score_bytes, opts);
+    layer.set_algorithm(AttentionAlgorithm::Blocked);
+    run_bench_case("Attention::forward[blocked]" + suffix, model_dim, seq_len * batch,
+                   [&]() { layer.forward(input, output, seq_len); }, flops, bytes, opts);
+    run_bench_case("Attention::backward" + suffix, model_dim, seq_len * batch,
+                   [&]() { layer.backward(input, grad_output, &grad_input); }, 2.5 * flops, 2.0 * bytes, opts);
+}
+
+/**
+ * @brief Runs the layer benchmarks: 3x3, pointwise 1x1 and 5x5 convolutions on 32x32 inputs,
+ * batch and layer normalization and ReLU dropout of a 512 x 256 activation, a 4-field
+ * embedding lookup into a 100000 x 64 table, LSTM and GRU layers of 256 units over 32 steps, and
+ * 4-head self-attention of width 64 over 256 and 1024 positions.
+ * @param opts Benchmark options.
+ * @return 0 on success.
+ */
+int run_layers_benchmarks(const BenchOptions& opts) {
+    std::cout << "\n# Layers\n";
+    print_bench_header(opts);
+    bench_conv2d("3x3", Conv2DShape{16, 32, 32, 16, 3, 3, 1, 1, 1}, 8, opts);
+    bench_conv2d("1x1", Conv2DShape{32, 16, 16, 64, 1, 1, 1, 0, 1}, 8, opts);
+    bench_conv2d("5x5", Conv2DShape{3, 32, 32, 16, 5, 5, 1, 2, 1}, 8, opts);
+    bench_normalization(NormType::BatchNorm, 512, 256, opts);
+    bench_normalization(NormType::LayerNorm, 512, 256, opts);
+    bench_dropout(512, 256, opts);
+    bench_embedding(100000, 64, 4, 256, opts);
+    bench_recurrent(RecurrentCell::LSTM, 128, 256, 32, 32, opts);
+    bench_recurrent(RecurrentCell::GRU, 128, 256, 32, 32, opts);
+    bench_attention(64, 4, 256, 8, opts);
+    bench_attention(64, 4, 1024, 2, opts);
+    return 0;
+}
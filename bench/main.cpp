@@ -0,0 +1,40 @@
+#include <iostream>
+#include <stdexcept>
+#include "matrix/matrix_bench.h"
+#include "functions/functions_bench.h"
+#include "ann/ann_bench.h"
+#include "roofline/roofline_bench.h"
+#include "layers/layers_bench.h"
+#include "graph/graph_bench.h"
+#include "common/compare.h"
+
+int main(int argc, char** argv)
+{
+    BenchOptions opts;
+    try {
+        opts = parse_bench_options(argc, argv);
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << "\n";
+        std::cerr << "Usage: my_bench [--filter=NAME] [--max-dim=N] [--threads=1,2,4] [--warmup=N] "
+                     "[--min-reps=N] [--max-reps=N] [--min-time=SEC] [--max-time=SEC] [--csv] [--counters]\n"
+                     "                [--suite=matrix,functions,ann,roofline,layers,graph] [--networks=3x64x4,...] [--train-samples=N] "
+                     "[--train-batch=N] [--micro-batch=N] [--max-batch=N] [--json=FILE]\n"
+                     "                [--assert-no-alloc] [--stream-mb=N] [--save-baseline=FILE] [--compare=FILE] "
+                     "[--threshold=PERCENT] [--alpha=P] [--runs=N]\n";
+        return 1;
+    }
+
+    int status = 0;
+    for (int run = 0; run < opts.runs; run++) {
+        if (opts.runs > 1) std::cerr << "Run " << run + 1 << " of " << opts.runs << "\n";
+        if (bench_suite_enabled(opts, "matrix") && run_matrix_benchmarks(opts) != 0) status = -1;
+        if (bench_suite_enabled(opts, "functions") && run_functions_benchmarks(opts) != 0) status = -1;
+        if (bench_suite_enabled(opts, "ann") && run_ann_benchmarks(opts) != 0) status = -1;
+        if (bench_suite_enabled(opts, "roofline") && run_roofline_benchmarks(opts) != 0) status = -1;
+        if (bench_suite_enabled(opts, "layers") && run_layers_benchmarks(opts) != 0) status = -1;
+        if (bench_suite_enabled(opts, "graph") && run_graph_benchmarks(opts) != 0) status = -1;
+    }
+    if (run_bench_comparison(opts) != 0) status = -1;
+    return status;
+}
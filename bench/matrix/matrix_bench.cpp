@@ -0,0 +1,111 @@
+#include <iostream>
+#include "../../src/matrix/matrix.h"
+#include "../../src/matrix/sparse.h"
+#include "matrix_bench.h"
+
+/**
+ * @brief Benchmarks matrixMultiply and the allocating operator* for one shape.
+ * The left operand is square (rows x rows) and the right one is rows x cols, so a
+ * column shape measures the per-sample matrix-vector product of a dense layer.
+ * @param rows Rows of both operands.
+ * @param cols Columns of the right operand and the result.
+ * @param opts Benchmark options.
+ */
+static void bench_matrix_multiply(int rows, int cols, const BenchOptions& opts) {
+    Matrix a(rows, rows);
+    Matrix b(rows, cols);
+    Matrix c(rows, cols);
+    fill_matrix(a, 1.0f);
+    fill_matrix(b, 1.0f);
+    double flops = 2.0 * rows * rows * cols;
+    double bytes = 4.0 * (double(rows) * rows + 2.0 * rows * cols);
+
+    run_bench_case("matrixMultiply", rows, cols, [&]() { c.matrixMultiply(a, b); }, flops, bytes, opts);
+    run_bench_case("operator*(Matrix,Matrix)", rows, cols, [&]() { Matrix r = a * b; bench_sink = r.get_val(0, 0); }, flops, bytes, opts);
+}
+
+/**
+ * @brief Benchmarks transpose and every element-wise operator for one shape.
+ * In-place operators restore their operand before every (untimed) run so repeated
+ * calls do not drift into overflow or denormals.
+ * @param rows Number of rows.
+ * @param cols Number of columns.
+ * @param opts Benchmark options.
+ */
+static void bench_element_wise(int rows, int cols, const BenchOptions& opts) {
+    Matrix a(rows, cols);
+    Matrix b(rows, cols);
+    Matrix c(rows, cols);
+    Matrix v(rows, 1);
+    fill_matrix(a, 1.0f, 2.0f);
+    fill_matrix(b, 1.0f, 2.0f);
+    fill_matrix(v, 1.0f);
+    double n = double(rows) * cols;
+    auto restore = [&]() { c.setValsFormMatrix(a); };
+    auto keep = [](Matrix&& m) { bench_sink = m.get_val(0, 0); };
+
+    run_bench_case("transpose", rows, cols, [&]() { keep(transpose(a)); }, 0.0, 8.0 * n, opts);
+
+    run_bench_case("operator+=", rows, cols, [&]() { c += b; }, n, 12.0 * n, opts, restore);
+    run_bench_case("operator-=", rows, cols, [&]() { c -= b; }, n, 12.0 * n, opts, restore);
+    run_bench_case("operator*=(scalar)", rows, cols, [&]() { c *= 1.5; }, n, 8.0 * n, opts, restore);
+    run_bench_case("operator/=(scalar)", rows, cols, [&]() { c /= 1.5; }, n, 8.0 * n, opts, restore);
+
+    run_bench_case("operator+(Matrix,Matrix)", rows, cols, [&]() { keep(a + b); }, n, 12.0 * n, opts);
+    run_bench_case("operator-(Matrix,Matrix)", rows, cols, [&]() { keep(a - b); }, n, 12.0 * n, opts);
+    run_bench_case("operator^", rows, cols, [&]() { keep(a ^ b); }, n, 12.0 * n, opts);
+    run_bench_case("elementWiseMultiply", rows, cols, [&]() { c.elementWiseMultiply(a, b); }, n, 12.0 * n, opts);
+    run_bench_case("operator*(Matrix,scalar)", rows, cols, [&]() { keep(a * 1.5); }, n, 8.0 * n, opts);
+    run_bench_case("operator*(scalar,Matrix)", rows, cols, [&]() { keep(1.5 * a); }, n, 8.0 * n, opts);
+    run_bench_case("operator/(Matrix,scalar)", rows, cols, [&]() { keep(a / 1.5); }, n, 8.0 * n, opts);
+    run_bench_case("operator+(Matrix,scalar)", rows, cols, [&]() { keep(a + 1.5); }, n, 8.0 * n, opts);
+    run_bench_case("operator+(scalar,Matrix)", rows, cols, [&]() { keep(1.5 + a); }, n, 8.0 * n, opts);
+    run_bench_case("operator-(Matrix,scalar)", rows, cols, [&]() { keep(a - 1.5); }, n, 8.0 * n, opts);
+    run_bench_case("operator-(scalar,Matrix)", rows, cols, [&]() { keep(1.5 - a); }, n, 8.0 * n, opts);
+    run_bench_case("addColumnVector", rows, cols, [&]() { c.addColumnVector(v); }, n, 8.0 * n + 4.0 * rows, opts, restore);
+}
+
+/**
+ * @brief Benchmarks a first layer on a 1% dense input batch: the dense product against the CSR
+ * forward product and the CSR weight-gradient accumulation.
+ * @param out Neurons of the layer.
+ * @param features Input features.
+ * @param batch Samples per batch.
+ * @param opts Benchmark options.
+ */
+static void bench_sparse_first_layer(int out, int features, int batch, const BenchOptions& opts) {
+    Matrix weights(out, features);
+    Matrix input(features, batch);
+    Matrix z(out, batch);
+    Matrix errors(out, batch);
+    Matrix gradient(out, features);
+    fill_matrix(weights, 1.0f);
+    fill_matrix(errors, 1.0f);
+    for (int c = 0; c < batch; c++)
+        for (int k = 0; k < features / 100; k++) input.set_val(int((long(c) * 7919 + long(k) * 104729) % features), c, 1.0f);
+    CSRMatrix sparse(0, 0);
+    sparse.convertTransposedFrom(input);
+    double nnz = double(sparse.get_nnz());
+    run_bench_case("matrixMultiply(dense input)", out, batch, [&]() { z.matrixMultiply(weights, input); },
+                   2.0 * out * features * batch, 4.0 * (double(out) * features + double(features) * batch + double(out) * batch), opts);
+    run_bench_case("matrixMultiplyCSRTransposeB", out, batch, [&]() { z.matrixMultiplyCSRTransposeB(weights, sparse); },
+                   2.0 * out * nnz, 4.0 * out * nnz + 8.0 * nnz + 4.0 * out * batch, opts);
+    run_bench_case("addMatrixProductCSR", out, features, [&]() { gradient.addMatrixProductCSR(errors, sparse); },
+                   2.0 * out * nnz, 8.0 * out * nnz + 8.0 * nnz + 4.0 * out * batch, opts);
+}
+
+/**
+ * @brief Runs all matrix kernel benchmarks over the size and thread sweep.
+ * @param opts Benchmark options.
+ * @return 0 on success.
+ */
+int run_matrix_benchmarks(const BenchOptions& opts) {
+    std::cout << "\n# Matrix kernels\n";
+    print_bench_header(opts);
+    for (auto& [rows, cols] : bench_shapes(opts)) {
+        bench_matrix_multiply(rows, cols, opts);
+        bench_element_wise(rows, cols, opts);
+    }
+    bench_sparse_first_layer(128, 4096, 128, opts);
+    return 0;
+}
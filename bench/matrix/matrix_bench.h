@@ -0,0 +1,3 @@
+#include "../common/bench.h"
+
+int run_matrix_benchmarks(const BenchOptions& opts);
@@ -0,0 +1,492 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <omp.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "../../src/functions/functions.h"
+#include "../../src/matrix/matrix.h"
+#include "roofline_bench.h"
+#include "../common/compare.h"
+
+/**
+ * @brief Sustained bandwidth of one level of the memory hierarchy.
+ */
+struct BandwidthRoof {
+    const char* level; ///< "L1", "L2", "L3" or "DRAM".
+    double capacity_bytes; ///< Working set that still fits the level (all threads together).
+    double gbps; ///< STREAM triad bandwidth with a working set of half the capacity.
+};
+
+/**
+ * @brief Peak compute and memory throughput of the host at one thread count.
+ */
+struct MachinePeaks {
+    double gflops = 0.0; ///< Peak single-precision GFLOP/s (FMA probe).
+    std::vector<BandwidthRoof> roofs; ///< Bandwidth roofs from L1 to DRAM.
+
+    /// Roof of the smallest level that holds a working set (DRAM if none does).
+    const BandwidthRoof& roof_for(double bytes) const {
+        for (auto& roof : roofs) {
+            if (bytes <= roof.capacity_bytes) return roof;
+        }
+        return roofs.back();
+    }
+};
+
+/**
+ * @brief One kernel measured against the roofline.
+ */
+struct RooflineRow {
+    std::string kernel; ///< Kernel name.
+    std::string shape; ///< Shape description, e.g. "256x784 * 784x32".
+    const char* level = ""; ///< Memory level whose bandwidth bounds the kernel.
+    bool memory_bound = false; ///< Whether the intensity is left of that level's ridge point.
+    double median_us = 0.0; ///< Median time per call.
+    double gflops = 0.0; ///< Attained GFLOP/s.
+    double gbps = 0.0; ///< Attained GB/s of compulsory traffic.
+    double intensity = 0.0; ///< Arithmetic intensity in flop/byte.
+    double roof_gflops = 0.0; ///< min(peak GFLOP/s, intensity * peak GB/s).
+    double fraction = 0.0; ///< Attained GFLOP/s as a share of the roof (GB/s of the level for kernels without flops).
+};
+
+static constexpr int fma_chains = 12; // Independent accumulators: enough to cover FMA latency times throughput
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx512f")))
+static float fma_probe_avx512(long iterations) {
+    __m512 acc[fma_chains];
+    for (int c = 0; c < fma_chains; c++) acc[c] = _mm512_set1_ps(1.0f + 1e-3f * c);
+    const __m512 mul = _mm512_set1_ps(0.9999999f);
+    const __m512 add = _mm512_set1_ps(1e-7f);
+    for (long it = 0; it < iterations; it++) {
+        for (int c = 0; c < fma_chains; c++) acc[c] = _mm512_fmadd_ps(acc[c], mul, add);
+    }
+    alignas(64) float lanes[16];
+    float sum = 0.0f;
+    for (int c = 0; c < fma_chains; c++) {
+        _mm512_store_ps(lanes, acc[c]);
+        for (int l = 0; l < 16; l++) sum += lanes[l];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static float fma_probe_avx2(long iterations) {
+    __m256 acc[fma_chains];
+    for (int c = 0; c < fma_chains; c++) acc[c] = _mm256_set1_ps(1.0f + 1e-3f * c);
+    const __m256 mul = _mm256_set1_ps(0.9999999f);
+    const __m256 add = _mm256_set1_ps(1e-7f);
+    for (long it = 0; it < iterations; it++) {
+        for (int c = 0; c < fma_chains; c++) acc[c] = _mm256_fmadd_ps(acc[c], mul, add);
+    }
+    alignas(32) float lanes[8];
+    float sum = 0.0f;
+    for (int c = 0; c < fma_chains; c++) {
+        _mm256_store_ps(lanes, acc[c]);
+        for (int l = 0; l < 8; l++) sum += lanes[l];
+    }
+    return sum;
+}
+#endif
+
+/**
+ * @brief Returns the float lanes of the widest FMA vector the CPU supports (1 without FMA).
+ */
+static int fma_lanes() {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx512f")) return 16;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return 8;
+#endif
+    return 1;
+}
+
+/**
+ * @brief Runs independent FMA chains in the widest vector registers the CPU supports.
+ * @param iterations Number of passes over all chains.
+ * @return Sum of the accumulators, so the work cannot be dropped.
+ */
+static float fma_probe(long iterations) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (fma_lanes() == 16) return fma_probe_avx512(iterations);
+    if (fma_lanes() == 8) return fma_probe_avx2(iterations);
+#endif
+    float acc[fma_chains];
+    for (int c = 0; c < fma_chains; c++) acc[c] = 1.0f + 1e-3f * c;
+    for (long it = 0; it < iterations; it++) {
+        for (int c = 0; c < fma_chains; c++) acc[c] = std::fma(acc[c], 0.9999999f, 1e-7f);
+    }
+    float sum = 0.0f;
+    for (int c = 0; c < fma_chains; c++) sum += acc[c];
+    return sum;
+}
+
+/**
+ * @brief Measures the peak FLOP/s of the current thread count: every thread runs its own FMA chains.
+ * @param opts Benchmark options.
+ * @return Peak GFLOP/s from the fastest run.
+ */
+static double measure_peak_gflops(const BenchOptions& opts) {
+    const long iterations = 1L << 20;
+    int threads = omp_get_max_threads();
+    BenchStats stats = measure([&]() {
+        float total = 0.0f;
+        #pragma omp parallel reduction(+ : total)
+        total += fma_probe(iterations);
+        bench_sink = total;
+    }, opts);
+    double flops = 2.0 * threads * iterations * fma_chains * fma_lanes();
+    return flops / (stats.min_us * 1e-6) * 1e-9;
+}
+
+/**
+ * @brief Measures STREAM triad bandwidth (a = b + s * c) over arrays of n floats. Counts 12 bytes
+ * per element (two loads and one store), as STREAM does. Small arrays are swept repeatedly inside
+ * one parallel region so every timed call moves at least 64 MiB; with a static schedule each thread
+ * touches the same elements in every sweep, so its share stays in its own caches.
+ * @param n Elements per array.
+ * @param opts Benchmark options.
+ * @return GB/s from the fastest run.
+ */
+static double triad_gbps(long n, const BenchOptions& opts) {
+    std::unique_ptr<float[]> a(new float[n]);
+    std::unique_ptr<float[]> b(new float[n]);
+    std::unique_ptr<float[]> c(new float[n]);
+    // First touch from the same threads and schedule as the triad places pages near them.
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++) {
+        a[i] = 0.0f;
+        b[i] = 1.0f;
+        c[i] = 2.0f;
+    }
+    const float scalar = 3.0f;
+    float* pa = a.get();
+    const float* pb = b.get();
+    const float* pc = c.get();
+    long sweeps = std::max(1L, (64L << 20) / (12 * n));
+    BenchStats stats = measure([&]() {
+        #pragma omp parallel
+        {
+            for (long sweep = 0; sweep < sweeps; sweep++) {
+                #pragma omp for schedule(static) nowait
+                for (long i = 0; i < n; i++) pa[i] = pb[i] + scalar * pc[i];
+            }
+        }
+        bench_sink = pa[n / 2];
+    }, opts);
+    return 12.0 * n * sweeps / (stats.min_us * 1e-6) * 1e-9;
+}
+
+/**
+ * @brief Returns a cache size from sysconf, or a fallback where the C library does not report it.
+ * @param name The sysconf name.
+ * @param fallback Size to assume.
+ * @return The size in bytes.
+ */
+static double cache_size(int name, double fallback) {
+    long size = name >= 0 ? sysconf(name) : -1;
+    return size > 0 ? double(size) : fallback;
+}
+
+/**
+ * @brief Measures the bandwidth roofs of the current thread count. Cache levels are probed with
+ * a working set of half their capacity (L1 and L2 are private, so their capacity scales with the
+ * threads); DRAM with three arrays of --stream-mb MiB, or, by default, arrays totalling four times
+ * the last-level cache (at least 64 MiB each, at most a quarter of physical memory).
+ * @param opts Benchmark options.
+ * @return The roofs from L1 to DRAM.
+ */
+static std::vector<BandwidthRoof> measure_bandwidth_roofs(const BenchOptions& opts) {
+#ifdef _SC_LEVEL1_DCACHE_SIZE
+    double l1 = cache_size(_SC_LEVEL1_DCACHE_SIZE, 32768.0);
+    double l2 = cache_size(_SC_LEVEL2_CACHE_SIZE, 1048576.0);
+    double l3 = cache_size(_SC_LEVEL3_CACHE_SIZE, 33554432.0);
+#else
+    double l1 = cache_size(-1, 32768.0);
+    double l2 = cache_size(-1, 1048576.0);
+    double l3 = cache_size(-1, 33554432.0);
+#endif
+    int threads = omp_get_max_threads();
+    std::vector<BandwidthRoof> roofs = {{"L1", l1 * threads, 0.0}, {"L2", l2 * threads, 0.0}, {"L3", l3, 0.0}};
+    for (auto& roof : roofs) roof.gbps = triad_gbps(long(roof.capacity_bytes / 2 / 12), opts);
+
+    double array_bytes = double(opts.stream_mb) * 1048576.0;
+    if (opts.stream_mb == 0) {
+        double memory = double(sysconf(_SC_PHYS_PAGES)) * double(sysconf(_SC_PAGE_SIZE));
+        array_bytes = std::max(64.0 * 1048576.0, std::min(4.0 * l3, memory / 4.0) / 3.0);
+    }
+    roofs.push_back({"DRAM", 1e300, triad_gbps(long(array_bytes / sizeof(float)), opts)});
+    return roofs;
+}
+
+/**
+ * @brief Times one kernel and places it under the roofline.
+ * @param kernel Kernel name.
+ * @param shape Shape description.
+ * @param fn The kernel invocation.
+ * @param flops Floating-point operations per call.
+ * @param bytes Compulsory bytes read and written per call.
+ * @param footprint Bytes of distinct data touched, which selects the memory level.
+ * @param peaks Host peaks at the current thread count.
+ * @param opts Benchmark options.
+ * @param setup Optional untimed call before every run.
+ * @return The measured row.
+ */
+static RooflineRow roofline_case(const std::string& kernel, const std::string& shape, const std::function<void()>& fn,
+                                 double flops, double bytes, double footprint, const MachinePeaks& peaks, const BenchOptions& opts,
+                                 const std::function<void()>& setup = nullptr) {
+    BenchStats stats = measure(fn, opts, setup);
+    record_bench_result("roofline/" + kernel + "/" + shape + "/t" + std::to_string(omp_get_max_threads()), stats);
+    RooflineRow row;
+    row.kernel = kernel;
+    row.shape = shape;
+    row.median_us = stats.median_us;
+    double seconds = stats.median_us * 1e-6;
+    row.gflops = seconds > 0.0 ? flops / seconds * 1e-9 : 0.0;
+    row.gbps = seconds > 0.0 ? bytes / seconds * 1e-9 : 0.0;
+    row.intensity = flops / bytes;
+    const BandwidthRoof& roof = peaks.roof_for(footprint);
+    row.level = roof.level;
+    row.memory_bound = row.intensity * roof.gbps < peaks.gflops;
+    row.roof_gflops = std::min(peaks.gflops, row.intensity * roof.gbps);
+    if (flops > 0.0) row.fraction = row.roof_gflops > 0.0 ? row.gflops / row.roof_gflops : 0.0;
+    else row.fraction = row.gbps / roof.gbps; // Pure data movement: only the bandwidth roof applies
+    return row;
+}
+
+/**
+ * @brief Measures the kernels of one dense layer's training step at its ANN shape.
+ * Weights are out x in and activations are in x batch (samples are columns), as in ANN.
+ * @param in Input size of the layer.
+ * @param out Output size of the layer.
+ * @param batch Samples per batch.
+ * @param peaks Host peaks at the current thread count.
+ * @param opts Benchmark options.
+ * @param rows Receives one row per kernel.
+ */
+static void layer_cases(int in, int out, int batch, const MachinePeaks& peaks, const BenchOptions& opts,
+                        std::vector<RooflineRow>& rows) {
+    Functions F;
+    Matrix w(out, in);
+    Matrix a(in, batch);
+    Matrix z(out, batch);
+    Matrix z_source(out, batch);
+    Matrix delta(out, batch);
+    Matrix derivative(out, batch);
+    Matrix delta_prev(in, batch);
+    Matrix dw(out, in);
+    Matrix bias(out, 1);
+    fill_matrix(w, 0.1f);
+    fill_matrix(a, 1.0f);
+    fill_matrix(z_source, 2.0f);
+    fill_matrix(delta, 0.5f);
+    fill_matrix(dw, 1e-3f);
+    fill_matrix(bias, 0.1f);
+    z.setValsFormMatrix(z_source);
+    double gemm_flops = 2.0 * out * in * batch;
+    double gemm_bytes = 4.0 * (double(out) * in + double(in) * batch + double(out) * batch);
+    double n = double(out) * batch;
+    double weights = double(out) * in;
+    std::string dims = std::to_string(out) + "x" + std::to_string(in);
+    std::string act = std::to_string(out) + "x" + std::to_string(batch);
+    auto restore = [&]() { z.setValsFormMatrix(z_source); };
+    auto keep = [&](const RooflineRow& row) { rows.push_back(row); };
+    auto selected = [&](const char* kernel) { return opts.filter.empty() || std::string(kernel).find(opts.filter) != std::string::npos; };
+
+    if (selected("matrixMultiply"))
+        keep(roofline_case("matrixMultiply", dims + " * " + std::to_string(in) + "x" + std::to_string(batch),
+                           [&]() { z.matrixMultiply(w, a); }, gemm_flops, gemm_bytes, gemm_bytes, peaks, opts));
+    if (selected("addColumnVector"))
+        keep(roofline_case("addColumnVector", act, [&]() { z.addColumnVector(bias); }, n, 8.0 * n + 4.0 * out, 4.0 * n + 4.0 * out, peaks, opts, restore));
+    if (selected("ReLu"))
+        keep(roofline_case("ReLu", act, [&]() { F.ReLu(z); }, n, 8.0 * n, 4.0 * n, peaks, opts, restore));
+    if (selected("Tanh"))
+        keep(roofline_case("Tanh", act, [&]() { F.Tanh(z); }, n, 8.0 * n, 4.0 * n, peaks, opts, restore));
+    if (selected("ReLu_derivative"))
+        keep(roofline_case("ReLu_derivative", act, [&]() { F.ReLu_derivative(derivative, z_source); }, n, 8.0 * n, 8.0 * n, peaks, opts));
+    if (selected("elementWiseMultiply"))
+        keep(roofline_case("elementWiseMultiply", act, [&]() { derivative.elementWiseMultiply(delta, z_source); }, n, 12.0 * n, 12.0 * n, peaks, opts));
+    if (selected("matrixMultiplyTransposeB"))
+        keep(roofline_case("matrixMultiplyTransposeB", act + " * (" + std::to_string(in) + "x" + std::to_string(batch) + ")^T",
+                           [&]() { dw.matrixMultiplyTransposeB(delta, a); }, gemm_flops, gemm_bytes, gemm_bytes, peaks, opts));
+    if (selected("matrixMultiplyTransposeA"))
+        keep(roofline_case("matrixMultiplyTransposeA", "(" + dims + ")^T * " + act,
+                           [&]() { delta_prev.matrixMultiplyTransposeA(w, delta); }, gemm_flops, gemm_bytes, gemm_bytes, peaks, opts));
+    if (selected("addScaled"))
+        keep(roofline_case("addScaled", dims, [&]() { w.addScaled(dw, -1e-3f); }, 2.0 * weights, 12.0 * weights, 8.0 * weights, peaks, opts));
+}
+
+/**
+ * @brief Measures the remaining Matrix and Functions kernels of one dense layer at its ANN shape:
+ * copies and transposes, element-wise updates, the sigmoid activation and the reductions.
+ * Weights are out x in and activations are out x batch, as in layer_cases().
+ * @param in Input size of the layer.
+ * @param out Output size of the layer.
+ * @param batch Samples per batch.
+ * @param peaks Host peaks at the current thread count.
+ * @param opts Benchmark options.
+ * @param rows Receives one row per kernel.
+ */
+static void elementwise_cases(int in, int out, int batch, const MachinePeaks& peaks, const BenchOptions& opts,
+                              std::vector<RooflineRow>& rows) {
+    Functions F;
+    Matrix w(out, in);
+    Matrix dw(out, in);
+    Matrix dw_accumulated(out, in);
+    Matrix z(out, batch);
+    Matrix z_source(out, batch);
+    Matrix a(out, batch);
+    Matrix db(out, 1);
+    fill_matrix(w, 0.1f);
+    fill_matrix(dw, 1e-3f);
+    fill_matrix(z_source, 2.0f);
+    z.setValsFormMatrix(z_source);
+    double n = double(out) * batch;
+    double weights = double(out) * in;
+    std::string dims = std::to_string(out) + "x" + std::to_string(in);
+    std::string act = std::to_string(out) + "x" + std::to_string(batch);
+    auto restore = [&]() { z.setValsFormMatrix(z_source); };
+    auto keep = [&](const RooflineRow& row) { rows.push_back(row); };
+    auto selected = [&](const char* kernel) { return opts.filter.empty() || std::string(kernel).find(opts.filter) != std::string::npos; };
+
+    if (selected("setValsFormMatrix"))
+        keep(roofline_case("setValsFormMatrix", act, [&]() { a.setValsFormMatrix(z_source); }, 0.0, 8.0 * n, 8.0 * n, peaks, opts));
+    if (selected("transpose"))
+        keep(roofline_case("transpose", dims, [&]() { bench_sink = transpose(w).get_val(0, 0); }, 0.0, 8.0 * weights, 8.0 * weights, peaks, opts));
+    if (selected("operator+="))
+        keep(roofline_case("operator+=", dims, [&]() { dw_accumulated += dw; }, weights, 12.0 * weights, 8.0 * weights, peaks, opts));
+    if (selected("operator-="))
+        keep(roofline_case("operator-=", dims, [&]() { dw_accumulated -= dw; }, weights, 12.0 * weights, 8.0 * weights, peaks, opts));
+    if (selected("operator*="))
+        keep(roofline_case("operator*=", act, [&]() { z *= 0.5; }, n, 8.0 * n, 4.0 * n, peaks, opts, restore));
+    if (selected("sigmoid"))
+        keep(roofline_case("sigmoid", act, [&]() { F.sigmoid(z); }, n, 8.0 * n, 4.0 * n, peaks, opts, restore));
+    if (selected("setValsFromColumnSum"))
+        keep(roofline_case("setValsFromColumnSum", act, [&]() { db.setValsFromColumnSum(z_source); }, n, 4.0 * n + 4.0 * out, 4.0 * n + 4.0 * out, peaks, opts));
+    if (selected("allFinite"))
+        keep(roofline_case("allFinite", dims, [&]() { bench_sink = dw.allFinite() ? 1.0f : 0.0f; }, 0.0, 4.0 * weights, 4.0 * weights, peaks, opts));
+}
+
+/**
+ * @brief Measures the output-layer kernels of a network: softmax and its backward product, the
+ * error signal and the loss reductions, on classes x batch predictions.
+ * @param classes Output size of the network.
+ * @param batch Samples per batch.
+ * @param peaks Host peaks at the current thread count.
+ * @param opts Benchmark options.
+ * @param rows Receives one row per kernel.
+ */
+static void output_cases(int classes, int batch, const MachinePeaks& peaks, const BenchOptions& opts, std::vector<RooflineRow>& rows) {
+    Functions F;
+    Matrix logits(classes, batch);
+    Matrix probabilities(classes, batch);
+    Matrix y(classes, batch);
+    Matrix gradient(classes, batch);
+    Matrix gradient_source(classes, batch);
+    Matrix diff(classes, batch);
+    fill_matrix(logits, 2.0f);
+    fill_matrix(gradient_source, 0.5f);
+    probabilities.setValsFormMatrix(logits);
+    F.softmax_columns(probabilities);
+    for (int c = 0; c < batch; c++) y.set_val(c % classes, c, 1.0f); // One-hot targets
+    double n = double(classes) * batch;
+    std::string act = std::to_string(classes) + "x" + std::to_string(batch);
+    auto keep = [&](const RooflineRow& row) { rows.push_back(row); };
+    auto selected = [&](const char* kernel) { return opts.filter.empty() || std::string(kernel).find(opts.filter) != std::string::npos; };
+
+    // exp and log count as one flop each
+    if (selected("softmax_columns"))
+        keep(roofline_case("softmax_columns", act, [&]() { F.softmax_columns(gradient); }, 5.0 * n, 8.0 * n, 4.0 * n, peaks, opts,
+                           [&]() { gradient.setValsFormMatrix(logits); }));
+    if (selected("softmax_backward"))
+        keep(roofline_case("softmax_backward", act, [&]() { F.softmax_backward(gradient, probabilities); }, 4.0 * n, 12.0 * n, 8.0 * n, peaks, opts,
+                           [&]() { gradient.setValsFormMatrix(gradient_source); }));
+    if (selected("diff"))
+        keep(roofline_case("diff", act, [&]() { F.diff(diff, probabilities, y); }, n, 12.0 * n, 12.0 * n, peaks, opts));
+    if (selected("MSE"))
+        keep(roofline_case("MSE", act, [&]() { bench_sink = F.MSE(diff); }, 2.0 * n, 4.0 * n, 4.0 * n, peaks, opts));
+    if (selected("Cross_Entropy"))
+        keep(roofline_case("Cross_Entropy", act, [&]() { bench_sink = F.Cross_Entropy(probabilities, y); }, 3.0 * n, 8.0 * n, 8.0 * n, peaks, opts));
+}
+
+/**
+ * @brief Prints the roofline table of one thread count, then the kernels with the most headroom.
+ * @param rows Measured kernels.
+ * @param peaks Host peaks.
+ * @param threads Thread count.
+ * @param opts Benchmark options.
+ */
+static void print_roofline(const std::vector<RooflineRow>& rows, const MachinePeaks& peaks, int threads, const BenchOptions& opts) {
+    if (opts.csv) {
+        for (auto& row : rows) {
+            std::printf("%s,\"%s\",%d,%.3f,%.4f,%.4f,%.5f,%s,%s,%.4f,%.2f\n", row.kernel.c_str(), row.shape.c_str(), threads,
+                        row.median_us, row.gflops, row.gbps, row.intensity, row.level,
+                        row.memory_bound ? "memory" : "compute", row.roof_gflops, row.fraction * 100.0);
+        }
+        return;
+    }
+    std::printf("\nthreads=%d  peak %.2f GFLOP/s (FMA); STREAM triad", threads, peaks.gflops);
+    for (auto& roof : peaks.roofs) {
+        std::printf(" %s %.2f GB/s (ridge %.2f flop/B)%s", roof.level, roof.gbps, peaks.gflops / roof.gbps,
+                    &roof == &peaks.roofs.back() ? "\n" : ",");
+    }
+    std::printf("%-26s %-28s %12s %9s %9s %9s %5s %8s %10s %7s\n", "kernel", "shape", "median_us", "GFLOP/s", "GB/s",
+                "flop/B", "level", "bound", "roof", "%roof");
+    for (auto& row : rows) {
+        std::printf("%-26s %-28s %12.3f %9.3f %9.3f %9.4f %5s %8s %10.3f %6.1f%%\n", row.kernel.c_str(), row.shape.c_str(),
+                    row.median_us, row.gflops, row.gbps, row.intensity, row.level, row.memory_bound ? "memory" : "compute",
+                    row.roof_gflops, row.fraction * 100.0);
+    }
+
+    // Time that reaching the roof would save, per call: the order in which to optimize.
+    std::vector<const RooflineRow*> headroom;
+    for (auto& row : rows) headroom.push_back(&row);
+    auto saving = [](const RooflineRow* row) { return row->median_us * (1.0 - std::min(1.0, row->fraction)); };
+    std::sort(headroom.begin(), headroom.end(), [&](const RooflineRow* x, const RooflineRow* y) { return saving(x) > saving(y); });
+    std::printf("\nLargest headroom (time saved per call at the roof):\n");
+    for (size_t i = 0; i < headroom.size() && i < 10; i++) {
+        std::printf("  %-26s %-28s %10.3f us (%5.1f%% of roof)\n", headroom[i]->kernel.c_str(), headroom[i]->shape.c_str(),
+                    saving(headroom[i]), headroom[i]->fraction * 100.0);
+    }
+}
+
+/**
+ * @brief Measures the host's peak FLOP/s and memory bandwidth, then places the Matrix and
+ * Functions kernels of every layer of the benchmark networks (at --train-batch samples),
+ * and the softmax and loss kernels of their output layers, under that roofline, for every
+ * thread count. Kernels without flops (copies, transposes, allFinite) are rated against
+ * the bandwidth of their memory level.
+ * Bytes are compulsory traffic (every operand read or written once), so the arithmetic
+ * intensity is an upper bound and a low share of the roof points at cache reuse or
+ * vectorization problems.
+ * @param opts Benchmark options.
+ * @return 0 on success.
+ */
+int run_roofline_benchmarks(const BenchOptions& opts) {
+    std::cout << "\n# Roofline\n";
+    if (opts.csv) std::cout << "kernel,shape,threads,median_us,gflops,gbps,intensity,level,bound,roof_gflops,percent_of_roof\n";
+    int default_threads = omp_get_max_threads();
+    for (int threads : opts.threads) {
+        omp_set_num_threads(threads);
+        MachinePeaks peaks;
+        peaks.gflops = measure_peak_gflops(opts);
+        peaks.roofs = measure_bandwidth_roofs(opts);
+
+        std::vector<RooflineRow> rows;
+        for (auto& layers : opts.networks) {
+            for (size_t i = 1; i < layers.size(); i++) {
+                layer_cases(layers[i - 1], layers[i], opts.train_batch, peaks, opts, rows);
+                elementwise_cases(layers[i - 1], layers[i], opts.train_batch, peaks, opts, rows);
+            }
+            output_cases(layers.back(), opts.train_batch, peaks, opts, rows);
+        }
+        print_roofline(rows, peaks, threads, opts);
+        std::fflush(stdout);
+    }
+    omp_set_num_threads(default_threads);
+    return 0;
+}
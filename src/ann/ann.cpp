@@ -1,20 +1,25 @@
 #include "ann.h"
+#include "../random/philox.h"
 #include <iostream>
 #include <cstring>
 #include <cmath>
+#include <algorithm>
+
+static constexpr uint64_t dropout_stream_base = uint64_t(1) << 62; // Keeps mask streams apart from tensor and sampler streams
+
 /**
  * @brief Constructs an ANN with the given layer sizes and activation functions.
  * Initializes weights, biases, and function maps.
  * @param layer_sizes Vector of integers specifying the size of each layer.
  * @param activations Vector of strings specifying the activation function for each layer.
  */
-ANN::ANN(std::vector<int> layer_sizes, std::vector<std::string> activations){
+ANN::ANN(std::vector<int> layer_sizes, std::vector<std::string> activations) : dz_workspace(0, 0), batch_inputs(0, 0), batch_targets(0, 0), embedding_grad(0, 0), inference_embedded(0, 0), sparse_batch(0, 0), bf16_operand(0, 0), error_bf16(0, 0), work_a(0, 0), work_error(0, 0) {
 
     activation_map["ReLu"] = [&](Matrix& m) { F.ReLu(m); };
     derivative_map["ReLu"] = [&](Matrix& m_derivatives, Matrix& m) { F.ReLu_derivative(m_derivatives, m); };
     activation_map["sigmoid"] = [&](Matrix& m) { F.sigmoid(m); };
     derivative_map["sigmoid"] = [&](Matrix& m_derivatives, Matrix& m) { F.sigmoid_derivative(m_derivatives, m); };
-    activation_map["softmax"] = [&](Matrix& m) { F.softmax(m); };
+    activation_map["softmax"] = [&](Matrix& m) { F.softmax_columns(m); };
     derivative_map["softmax"] = [&](Matrix& m_derivatives, Matrix& m) { F.softmax_derivative(m_derivatives, m); };
     activation_map["Tanh"] = [&](Matrix& m) { F.Tanh(m); };
     derivative_map["Tanh"] = [&](Matrix& m_derivatives, Matrix& m) { F.Tanh_derivative(m_derivatives, m); };
@@ -34,6 +39,7 @@ ANN::ANN(std::vector<int> layer_sizes, std::vector<std::string> activations){
         dz_values.push_back(Matrix(layer_sizes[i], 1));
         a_values.push_back(Matrix(layer_sizes[i], 1));
         error_signals.push_back(Matrix(layer_sizes[i], 1));
+        inference_values.push_back(Matrix(layer_sizes[i], 1));
 
         db_accumulated.push_back(Matrix(layer_sizes[i], 1)); 
         db_temp.push_back(Matrix(layer_sizes[i], 1));
@@ -42,6 +48,11 @@ ANN::ANN(std::vector<int> layer_sizes, std::vector<std::string> activations){
         
         activation_functions.push_back(activation_map[activations[i - 1]]);
         derivatives_functions.push_back(derivative_map[activations[i - 1]]);
+        softmax_layers.push_back(activations[i - 1] == "softmax");
+        norms.push_back(nullptr);
+        norm_inputs.push_back(Matrix(0, 0));
+        activation_names.push_back(activations[i - 1]);
+        dropouts.push_back(nullptr);
         
     }
 
@@ -61,6 +72,22 @@ ANN::ANN(std::vector<int> layer_sizes, std::vector<std::string> activations){
     }
 
     this->learning_rate = 0.01f; // Default learning rate
+    this->batch_columns = 1;
+    this->micro_batch_size = 1;
+    this->sampler.set_seed(random_seed());
+    this->epochs_trained = 0;
+    this->dropout_seed = random_seed();
+    this->dropout_passes = 0;
+    this->sparse_input = false;
+    this->checkpoint_interval = 1;
+    this->checkpoint_memory_budget = 0;
+    this->active_checkpoint_interval = 1;
+    this->mixed_precision = false;
+    this->loss_scale = 1.0f;
+    this->loss_scale_growth_interval = 2000;
+    this->good_steps = 0;
+    this->skipped_steps = 0;
+    this->profiler.set_layers(int(weights.size()));
     this->loss_function = new char[4]; // Allocate memory for "MSE"
     strcpy(this->loss_function, "MSE");
     
@@ -78,38 +105,486 @@ ANN::ANN(std::vector<int> layer_sizes, std::vector<std::string> activations){
 
 /**
  * @brief Performs a forward pass through the network.
- * @param input Input matrix to the network.
+ * Each column of the input is one sample; the training buffers are resized to the batch.
+ * With checkpointing enabled only every k-th layer output is kept, the others live in the
+ * segment workspace and are recomputed by backprop(). Every pass draws new dropout masks,
+ * which the recomputation reuses.
+ * @param input Input matrix to the network (input size x batch).
  */
 void ANN::forward(Matrix& input) {
-    a_values[0].setValsFormMatrix(input); // Input layer
+    TRACE_SCOPE("forward_pass");
+    sparse_input = false;
+    prepare_batch(input.get_columns_num());
+    if (embedding) {
+        if (input.get_rows_num() != input_rows()) {
+            throw std::runtime_error("Input dimensions do not match the embedding fields.");
+        }
+        embedding->forward(input, a_values[0], true); // Input layer from the ID rows
+    }
+    else {
+        a_values[0].setValsFormMatrix(input); // Input layer
+    }
+    forward_layers(input.get_columns_num());
+}
+
+/**
+ * @brief Performs a forward pass over a sparse batch. The first layer multiplies its weights
+ * by the nonzeros only and no dense input is materialized; backprop() then accumulates the
+ * first-layer weight gradient only in the columns of features present in the batch.
+ * @param input Sparse batch, one sample per row and one input feature per column.
+ * @throws std::runtime_error if the columns do not match the input layer or an embedding is set.
+ */
+void ANN::forward(const CSRMatrix& input) {
+    TRACE_SCOPE("forward_pass");
+    if (embedding) {
+        throw std::runtime_error("Sparse inputs cannot be combined with an input embedding.");
+    }
+    if (input.get_columns_num() != weights[0].get_columns_num()) {
+        throw std::runtime_error("Input dimensions do not match the input layer size.");
+    }
+    sparse_input = true;
+    sparse_batch = input; // Reuses the capacity of the previous batch
+    prepare_batch(input.get_rows_num());
+    forward_layers(input.get_rows_num());
+}
+
+/**
+ * @brief Runs the layers of a forward pass once the input layer is in place.
+ * @param batch Number of samples in the batch.
+ */
+void ANN::forward_layers(int batch) {
     for (size_t i = 0; i < weights.size(); i++) {
-        z_values[i].matrixMultiply(weights[i], a_values[i]);
-        z_values[i] += biases[i];
-        a_values[i+1].setValsFormMatrix(z_values[i]); // Copy z_values to a_values
-        activation_functions[i]( a_values[i+1] ); // Apply the activation function
+        PROFILE_SCOPE(profiler, ProfilePhase::Forward, int(i), profile_flops(ProfilePhase::Forward, int(i)), profile_bytes(ProfilePhase::Forward, int(i)));
+        if (dropouts[i]) {
+            uint64_t stream = dropout_stream_base + dropout_passes * weights.size() + i;
+            dropouts[i]->generate_mask(long(weights[i].get_rows_num()) * batch, dropout_seed, stream);
+        }
+        if (mixed_precision) forward_layer_bf16(i);
+        else forward_layer(i, node_a(i), node_z(i + 1), node_a(i + 1));
+        if (norms[i]) norms[i]->update_running_stats(); // Not on recompute, so each batch counts once
     }
+    dropout_passes++;
     //a_values.back().printMatrix();
 }
 
+/**
+ * @brief Computes one layer: z = W * input + b and a = f(z). For a normalized layer
+ * W * input + b is kept in norm_inputs and z is its normalization (batch statistics).
+ * After a sparse forward the first layer reads sparse_batch instead of its input buffer.
+ * @param i Layer index.
+ * @param input Output of the previous layer (or the network input).
+ * @param z Buffer receiving the pre-activation.
+ * @param a Buffer receiving the activation.
+ */
+void ANN::forward_layer(size_t i, Matrix& input, Matrix& z, Matrix& a) {
+    Matrix& linear = norms[i] ? norm_inputs[i] : z;
+    linear.resize(weights[i].get_rows_num(), batch_columns);
+    a.resize(weights[i].get_rows_num(), batch_columns);
+    if (i == 0 && sparse_input) {
+        linear.matrixMultiplyCSRTransposeB(weights[0], sparse_batch);
+    }
+    else {
+        linear.matrixMultiply(weights[i], input);
+    }
+    activate_layer(i, linear, z, a);
+}
+
+/**
+ * @brief Mixed-precision version of forward_layer: bf16 weights times the bf16 layer input,
+ * accumulated in fp32. A hidden layer is computed in place in work_a and stored as bf16 in
+ * node_z_bf16 / node_a_bf16; the output layer keeps fp32 buffers (rounded to bf16 precision)
+ * because the loss reads them.
+ * @param i Layer index.
+ */
+void ANN::forward_layer_bf16(size_t i) {
+    bool output = i + 1 == weights.size();
+    Matrix& z = output ? z_values.back() : work_a;
+    Matrix& a = output ? a_values.back() : work_a;
+    Matrix& linear = norms[i] ? norm_inputs[i] : z;
+    linear.resize(weights[i].get_rows_num(), batch_columns);
+    a.resize(weights[i].get_rows_num(), batch_columns);
+    if (i == 0 && sparse_input) {
+        linear.matrixMultiplyCSRTransposeB(weights[0], sparse_batch); // fp32 weights for the sparse input
+    }
+    else if (i == 0) {
+        bf16_operand.convertTransposedFrom(a_values[0]);
+        linear.matrixMultiplyBF16(weights_bf16[0], bf16_operand);
+    }
+    else {
+        linear.matrixMultiplyBF16(weights_bf16[i], node_a_bf16(i));
+    }
+    if (output) {
+        activate_layer(i, linear, z, a);
+        z.roundToBF16();
+        a.roundToBF16();
+    }
+    else {
+        activate_layer(i, linear, z, a, &node_z_bf16(i + 1));
+        node_a_bf16(i + 1).convertTransposedFrom(a);
+    }
+}
+
+/**
+ * @brief Finishes a layer from its product W * input: adds the bias, normalizes (keeping
+ * the normalization input in linear) and applies the activation or the fused dropout.
+ * @param i Layer index.
+ * @param linear W * input; becomes W * input + b.
+ * @param z Buffer receiving the pre-activation (the same as linear without normalization).
+ * @param a Buffer receiving the activation; may be z, which is then activated in place.
+ * @param stored_z If not null, receives a bf16 copy of z before the activation.
+ */
+void ANN::activate_layer(size_t i, Matrix& linear, Matrix& z, Matrix& a, BF16Matrix* stored_z) {
+    linear.addColumnVector(biases[i]);
+    if (norms[i]) norms[i]->forward(linear, z, true);
+    if (stored_z) stored_z->convertTransposedFrom(z);
+    if (dropouts[i]) {
+        dropouts[i]->forward(z, a); // Activation and mask in one pass
+    }
+    else {
+        if (&a != &z) a.setValsFormMatrix(z); // Copy z_values to a_values
+        activation_functions[i](a); // Apply the activation function
+    }
+}
 
 /**
  * @brief Performs backpropagation to compute gradients.
+ * Gradients are summed over the columns of the batch. With checkpointing enabled the
+ * network is walked one segment at a time from the output backwards: the layer outputs
+ * inside a segment are recomputed from its stored checkpoint, then back-propagated.
  */
 void ANN::backprop() {
-    for (int i = weights.size() - 1; i > 0; i--) {
-        dw_temp[i] = error_signals[i] * transpose(a_values[i]); // Gradient for weights
-        db_temp[i] = error_signals[i]; // Gradient for biases
+    TRACE_SCOPE("backprop");
+    size_t layers = weights.size();
+    size_t k = active_checkpoint_interval;
+    if (k <= 1) {
+        for (size_t i = layers; i-- > 0;) {
+            PROFILE_SCOPE(profiler, ProfilePhase::Backward, int(i), profile_flops(ProfilePhase::Backward, int(i)), profile_bytes(ProfilePhase::Backward, int(i)));
+            if (mixed_precision) backward_layer_bf16(i);
+            else backward_layer(i, a_values[i], i > 0 ? &z_values[i - 1] : nullptr);
+        }
+        return;
+    }
+
+    size_t last_segment = ((layers - 1) / k) * k;
+    for (long segment = long(last_segment); segment >= 0; segment -= long(k)) {
+        size_t start = size_t(segment);
+        size_t end = std::min(start + k, layers);
+        // The last segment is still in the workspace from the forward pass.
+        if (start != last_segment) {
+            for (size_t i = start; i + 1 < end; i++) {
+                PROFILE_SCOPE(profiler, ProfilePhase::Recompute, int(i), profile_flops(ProfilePhase::Recompute, int(i)), profile_bytes(ProfilePhase::Recompute, int(i)));
+                if (mixed_precision) forward_layer_bf16(i);
+                else forward_layer(i, node_a(i), node_z(i + 1), node_a(i + 1));
+            }
+        }
+        for (size_t i = end; i-- > start;) {
+            PROFILE_SCOPE(profiler, ProfilePhase::Backward, int(i), profile_flops(ProfilePhase::Backward, int(i)), profile_bytes(ProfilePhase::Backward, int(i)));
+            if (mixed_precision) backward_layer_bf16(i);
+            else backward_layer(i, node_a(i), i > 0 ? &node_z(i) : nullptr);
+        }
+    }
+}
+
+/**
+ * @brief Computes the gradients of layer i and back-propagates its error signal to layer i-1.
+ * @param i Layer index.
+ * @param input Input of layer i (output of layer i-1).
+ * @param z_prev Pre-activation of layer i-1, or nullptr for the first layer.
+ */
+void ANN::backward_layer(size_t i, Matrix& input, Matrix* z_prev) {
+    if (norms[i]) norms[i]->backward(norm_inputs[i], error_signals[i], error_signals[i]); // dL/dz to dL/d(W a + b)
+    if (i == 0 && sparse_input) {
+        dw_accumulated[0].addMatrixProductCSR(error_signals[0], sparse_batch); // Only the columns of features in the batch
+    }
+    else {
+        dw_temp[i].matrixMultiplyTransposeB(error_signals[i], input); // Gradient for weights (e * a^T)
         dw_accumulated[i] += dw_temp[i]; // Accumulate gradients for weights
-        db_accumulated[i] += db_temp[i]; // Accumulate gradients for biases
-        error_signals[i-1].matrixMultiply(transpose(weights[i]), error_signals[i]); // Backpropagate the error signal
-        derivatives_functions[i](dz_values[i-1], z_values[i-1]); // Calculate the derivative of the activation function
+    }
+    db_temp[i].setValsFromColumnSum(error_signals[i]); // Gradient for biases
+    db_accumulated[i] += db_temp[i]; // Accumulate gradients for biases
+    if (i == 0) {
+        if (embedding) {
+            embedding_grad.resize(weights[0].get_columns_num(), error_signals[0].get_columns_num());
+            embedding_grad.matrixMultiplyTransposeA(weights[0], error_signals[0]);
+            embedding->backward(embedding_grad);
+        }
+        return;
+    }
+
+    error_signals[i-1].matrixMultiplyTransposeA(weights[i], error_signals[i]); // Backpropagate the error signal (W^T * e)
+    if (softmax_layers[i-1]) {
+        F.softmax_backward(error_signals[i-1], input); // Jacobian-vector product, no n x n Jacobian
+    }
+    else if (dropouts[i-1]) {
+        dropouts[i-1]->backward(input, error_signals[i-1]); // Mask and activation derivative in one pass
+    }
+    else {
+        // With checkpointing the hidden-layer derivatives share one workspace buffer.
+        Matrix& dz = (active_checkpoint_interval > 1) ? dz_workspace : dz_values[i-1];
+        dz.resize(z_prev->get_rows_num(), z_prev->get_columns_num());
+        derivatives_functions[i-1](dz, *z_prev); // Calculate the derivative of the activation function
         // Element-wise multiplication of the error signal with the derivative
-        error_signals[i-1].elementWiseMultiply(error_signals[i-1], dz_values[i-1]); // Element-wise multiplication
+        error_signals[i-1].elementWiseMultiply(error_signals[i-1], dz); // Element-wise multiplication
     }
-    // Calculate gradients for the first layer
-    dw_temp[0] = error_signals[0] * transpose(a_values[0]); 
-    db_temp[0] = error_signals[0];
-        
+}
+
+/**
+ * @brief Mixed-precision version of backward_layer. The error signal of a hidden layer is
+ * widened from error_bf16 into work_error and its input activation (then pre-activation)
+ * from bf16 storage into work_a; gradients accumulate in fp32. The error signal of layer
+ * i-1 is computed from the bf16 transposed weights and stored back into error_bf16.
+ * @param i Layer index.
+ */
+void ANN::backward_layer_bf16(size_t i) {
+    bool output = i + 1 == weights.size();
+    Matrix& error = output ? error_signals.back() : work_error;
+    if (!output) error_bf16.convertTransposedTo(error);
+    if (norms[i]) norms[i]->backward(norm_inputs[i], error, error); // dL/dz to dL/d(W a + b)
+    Matrix* input = &a_values[0];
+    if (i > 0) {
+        node_a_bf16(i).convertTransposedTo(work_a);
+        input = &work_a;
+    }
+    if (i == 0 && sparse_input) {
+        dw_accumulated[0].addMatrixProductCSR(error, sparse_batch);
+    }
+    else {
+        dw_temp[i].matrixMultiplyTransposeB(error, *input); // Gradient for weights (e * a^T)
+        dw_accumulated[i] += dw_temp[i];
+    }
+    db_temp[i].setValsFromColumnSum(error); // Gradient for biases
+    db_accumulated[i] += db_temp[i];
+    if (i == 0) {
+        if (embedding) {
+            // fp32 weights: the result only feeds the sparse fp32 row gradients.
+            embedding_grad.resize(weights[0].get_columns_num(), error.get_columns_num());
+            embedding_grad.matrixMultiplyTransposeA(weights[0], error);
+            embedding->backward(embedding_grad);
+        }
+        return;
+    }
+
+    // error_bf16 still holds the error signal unless the output or a normalization changed it.
+    const BF16Matrix* operand = &error_bf16;
+    if (output || norms[i]) {
+        bf16_operand.convertTransposedFrom(error);
+        operand = &bf16_operand;
+    }
+    work_error.resize(weights[i].get_columns_num(), batch_columns); // The fp32 error of layer i is no longer read
+    work_error.matrixMultiplyBF16(weights_t_bf16[i], *operand);
+    if (softmax_layers[i-1]) {
+        F.softmax_backward(work_error, work_a);
+    }
+    else if (dropouts[i-1]) {
+        dropouts[i-1]->backward(work_a, work_error);
+    }
+    else {
+        // The activation is no longer needed: widen the pre-activation over it and take the
+        // element-wise derivative in place.
+        node_z_bf16(i).convertTransposedTo(work_a);
+        derivatives_functions[i-1](work_a, work_a);
+        work_error.elementWiseMultiply(work_error, work_a);
+    }
+    error_bf16.convertTransposedFrom(work_error);
+}
+
+/**
+ * @brief Returns whether the output of a layer (node) is kept from forward until backprop.
+ * The network input, the network output and every checkpoint_interval-th node are kept.
+ * @param node Index into a_values (0 is the network input).
+ */
+bool ANN::is_resident(size_t node) {
+    size_t k = active_checkpoint_interval;
+    return k <= 1 || node % k == 0 || node == weights.size();
+}
+
+/**
+ * @brief Returns the buffer holding the activation of a node (stored or segment workspace).
+ * @param node Index into a_values (0 is the network input).
+ */
+Matrix& ANN::node_a(size_t node) {
+    return is_resident(node) ? a_values[node] : segment_a[node % active_checkpoint_interval - 1];
+}
+
+/**
+ * @brief Returns the buffer holding the pre-activation that produced a node.
+ * @param node Index into a_values, at least 1.
+ */
+Matrix& ANN::node_z(size_t node) {
+    return is_resident(node) ? z_values[node - 1] : segment_z[node % active_checkpoint_interval - 1];
+}
+
+/**
+ * @brief Returns the bf16 activation of a hidden node in mixed precision (stored or segment workspace).
+ * @param node Index into a_values, between 1 and the number of layers - 1.
+ */
+BF16Matrix& ANN::node_a_bf16(size_t node) {
+    return is_resident(node) ? a_bf16[node] : segment_a_bf16[node % active_checkpoint_interval - 1];
+}
+
+/**
+ * @brief Returns the bf16 pre-activation that produced a hidden node in mixed precision.
+ * @param node Index into a_values, between 1 and the number of layers - 1.
+ */
+BF16Matrix& ANN::node_z_bf16(size_t node) {
+    return is_resident(node) ? z_bf16[node - 1] : segment_z_bf16[node % active_checkpoint_interval - 1];
+}
+
+/**
+ * @brief Sizes the training buffers for a batch and lays out the checkpoint storage.
+ * Buffers of nodes that are not kept are released; their values live in the k-1
+ * segment workspace buffers instead, and hidden-layer derivatives share dz_workspace. In mixed
+ * precision the hidden layers have no fp32 buffers: their values are stored in bf16 and widened
+ * into the shared work buffers. Nothing is reallocated if neither the batch width nor the
+ * checkpoint interval changed.
+ * @param batch Number of samples (columns) in the batch.
+ */
+void ANN::prepare_batch(int batch) {
+    int interval = choose_checkpoint_interval(batch);
+    int input_columns = sparse_input ? 0 : batch; // A sparse batch is not expanded
+    if (batch == batch_columns && interval == active_checkpoint_interval &&
+        a_values[0].get_columns_num() == input_columns) {
+        return;
+    }
+    batch_columns = batch;
+    active_checkpoint_interval = interval;
+
+    a_values[0].resize(a_values[0].get_rows_num(), input_columns);
+    for (size_t node = 1; node <= weights.size(); node++) {
+        int rows = weights[node - 1].get_rows_num();
+        bool output = node == weights.size();
+        bool bf16 = mixed_precision && !output;
+        if (is_resident(node) && !bf16) {
+            a_values[node].resize(rows, batch);
+            z_values[node - 1].resize(rows, batch);
+        }
+        else {
+            a_values[node] = Matrix(rows, 0);
+            z_values[node - 1] = Matrix(rows, 0);
+        }
+        if (bf16 && !is_resident(node)) {
+            a_bf16[node] = BF16Matrix(0, 0);
+            z_bf16[node - 1] = BF16Matrix(0, 0);
+        }
+        if ((interval <= 1 && !bf16) || output) dz_values[node - 1].resize(rows, batch);
+        else dz_values[node - 1] = Matrix(rows, 0);
+        if (bf16) error_signals[node - 1] = Matrix(rows, 0);
+        else error_signals[node - 1].resize(rows, batch);
+        if (norms[node - 1]) norm_inputs[node - 1].resize(rows, batch);
+    }
+    int slots = std::max(interval - 1, 0);
+    segment_a.assign(mixed_precision ? 0 : slots, Matrix(0, 0));
+    segment_z.assign(mixed_precision ? 0 : slots, Matrix(0, 0));
+    segment_a_bf16.assign(mixed_precision ? slots : 0, BF16Matrix(0, 0));
+    segment_z_bf16.assign(mixed_precision ? slots : 0, BF16Matrix(0, 0));
+}
+
+/**
+ * @brief Picks the checkpoint interval for a batch.
+ * Without a memory budget the configured interval is used. With a budget, the smallest
+ * interval whose estimated activation memory fits is chosen (1 means nothing is recomputed);
+ * if none fits, the interval with the smallest footprint is used.
+ * @param batch Number of samples (columns) in the batch.
+ * @return The checkpoint interval.
+ */
+int ANN::choose_checkpoint_interval(int batch) {
+    if (checkpoint_memory_budget == 0) return checkpoint_interval;
+
+    int best_interval = 1;
+    long unsigned best_bytes = estimate_activation_bytes(1, batch);
+    for (int interval = 1; interval <= int(weights.size()); interval++) {
+        long unsigned bytes = estimate_activation_bytes(interval, batch);
+        if (bytes <= checkpoint_memory_budget) return interval;
+        if (bytes < best_bytes) {
+            best_bytes = bytes;
+            best_interval = interval;
+        }
+    }
+    return best_interval;
+}
+
+/**
+ * @brief Estimates the bytes of activation storage (a and z) for a checkpoint interval.
+ * In mixed precision the hidden layers are stored in bf16 and computed through two fp32
+ * work buffers (work_a and work_error).
+ * @param interval Checkpoint interval.
+ * @param batch Number of samples (columns) in the batch.
+ */
+long unsigned ANN::estimate_activation_bytes(int interval, int batch) {
+    long unsigned values = sparse_input ? 0 : a_values[0].get_rows_num(); // A sparse input is not expanded
+    long unsigned bf16_values = 0;
+    long unsigned widest = 0;
+    for (size_t node = 1; node <= weights.size(); node++) {
+        long unsigned rows = weights[node - 1].get_rows_num();
+        bool output = node == weights.size();
+        widest = std::max(widest, rows);
+        if (interval <= 1 || node % interval == 0 || output) {
+            if (mixed_precision && !output) bf16_values += 2 * rows;
+            else values += 2 * rows;
+        }
+        if (norms[node - 1]) values += rows; // Normalization inputs are kept for every layer
+    }
+    if (interval > 1) (mixed_precision ? bf16_values : values) += 2 * (interval - 1) * widest;
+    if (mixed_precision) values += 2 * widest;
+    return (values * sizeof(float) + bf16_values * sizeof(uint16_t)) * batch;
+}
+
+/**
+ * @brief Enables activation checkpointing with a fixed interval.
+ * Only the output of every interval-th layer (plus the network input and output) is kept
+ * between forward() and backprop(); the layers in between are recomputed during backprop.
+ * @param interval Interval between stored layer outputs; 0 or 1 keeps every layer.
+ */
+void ANN::set_checkpointing(int interval) {
+    if (interval < 0) {
+        throw std::runtime_error("Checkpoint interval must not be negative.");
+    }
+    checkpoint_interval = std::max(interval, 1);
+    checkpoint_memory_budget = 0;
+    batch_columns = -1; // Re-layout the buffers on the next forward pass
+}
+
+/**
+ * @brief Chooses the checkpoint interval automatically from an activation memory budget.
+ * The interval is re-evaluated whenever the batch width changes.
+ * @param bytes Budget for the stored activations and the recompute workspace; 0 disables.
+ */
+void ANN::set_checkpoint_memory_budget(long unsigned bytes) {
+    checkpoint_memory_budget = bytes;
+    batch_columns = -1; // Re-layout the buffers on the next forward pass
+}
+
+/**
+ * @brief Returns the checkpoint interval used for the current batch (1 = no checkpointing).
+ */
+int ANN::get_checkpoint_interval() {
+    return active_checkpoint_interval;
+}
+
+/**
+ * @brief Returns the bytes currently held by the activation buffers used for training
+ * (a, z and dz values and the checkpoint segment workspace; in mixed precision also the
+ * bf16 storage of the hidden layers and error signal and the fp32 work buffers).
+ */
+long unsigned ANN::activation_memory_bytes() {
+    long unsigned values = 0;
+    for (auto& m : a_values) values += (long unsigned)m.get_rows_num() * m.get_columns_num();
+    for (auto& m : z_values) values += (long unsigned)m.get_rows_num() * m.get_columns_num();
+    for (auto& m : dz_values) values += (long unsigned)m.get_rows_num() * m.get_columns_num();
+    for (auto& m : segment_a) values += (long unsigned)m.get_rows_num() * m.get_columns_num();
+    for (auto& m : segment_z) values += (long unsigned)m.get_rows_num() * m.get_columns_num();
+    for (auto& m : norm_inputs) values += (long unsigned)m.get_rows_num() * m.get_columns_num();
+    values += (long unsigned)dz_workspace.get_rows_num() * dz_workspace.get_columns_num();
+    values += (long unsigned)embedding_grad.get_rows_num() * embedding_grad.get_columns_num();
+    for (Matrix* m : {&work_a, &work_error}) values += (long unsigned)m->get_rows_num() * m->get_columns_num();
+    long unsigned bf16_bytes = error_bf16.memory_bytes() + bf16_operand.memory_bytes();
+    for (auto* stored : {&a_bf16, &z_bf16, &segment_a_bf16, &segment_z_bf16}) {
+        for (auto& m : *stored) bf16_bytes += m.memory_bytes();
+    }
+    long unsigned mask_bytes = 0;
+    for (auto& d : dropouts) mask_bytes += d ? d->mask_bytes() : 0;
+    long unsigned sparse_bytes = sparse_input ? sparse_batch.memory_bytes() : 0;
+    return values * sizeof(float) + bf16_bytes + mask_bytes + sparse_bytes;
 }
 
 
@@ -146,11 +621,116 @@ void ANN::set_optimizer(std::string optimizer, std::string loss_function, float
  */
 void ANN::update_weights() {
     for (size_t i = 0; i < weights.size(); i++) {
-        weights[i] -= dw_accumulated[i] * learning_rate;
-        biases[i] -= db_accumulated[i] * learning_rate;
+        PROFILE_SCOPE(profiler, ProfilePhase::UpdateWeights, int(i), profile_flops(ProfilePhase::UpdateWeights, int(i)), profile_bytes(ProfilePhase::UpdateWeights, int(i)));
+        weights[i].addScaled(dw_accumulated[i], -learning_rate);
+        biases[i].addScaled(db_accumulated[i], -learning_rate);
+        if (norms[i]) norms[i]->update_weights(learning_rate);
+    }
+    if (embedding) embedding->update_weights(learning_rate); // Only the rows the batch used
+    if (mixed_precision) {
+        PROFILE_SCOPE(profiler, ProfilePhase::UpdateWeights, -1, 0.0, profile_bytes(ProfilePhase::UpdateWeights, -1));
+        refresh_bf16_weights();
     }
 }
 
+/**
+ * @brief Enables or disables mixed-precision training.
+ * In mixed precision the activations, pre-activations and error signals of the hidden layers
+ * are stored as bfloat16 (sample-major, half the bytes of fp32) and widened into shared fp32
+ * work buffers by the kernels that read them. Layer products run on bf16 copies of the
+ * weights with fp32 accumulation (AVX512-BF16 when the CPU has it, an emulated path
+ * otherwise). The network input and output, normalization inputs, weights, gradients and
+ * optimizer state stay in fp32.
+ * The output error signal is multiplied by a dynamic loss scale so small gradients survive
+ * bf16 storage; unscale_gradients() undoes the scale and skips steps that overflowed.
+ * @param enabled Whether mixed precision is used.
+ * @param initial_loss_scale Starting loss scale.
+ * @param growth_interval Number of overflow-free steps after which the loss scale is doubled.
+ */
+void ANN::set_mixed_precision(bool enabled, float initial_loss_scale, int growth_interval) {
+    if (enabled && (initial_loss_scale <= 0.0f || growth_interval <= 0)) {
+        throw std::runtime_error("Loss scale and growth interval must be greater than zero.");
+    }
+    mixed_precision = enabled;
+    loss_scale = enabled ? initial_loss_scale : 1.0f;
+    loss_scale_growth_interval = growth_interval;
+    good_steps = 0;
+    skipped_steps = 0;
+    batch_columns = -1; // Re-layout the buffers on the next forward pass
+    a_bf16.assign(enabled ? weights.size() + 1 : 0, BF16Matrix(0, 0));
+    z_bf16.assign(enabled ? weights.size() : 0, BF16Matrix(0, 0));
+    segment_a_bf16.clear();
+    segment_z_bf16.clear();
+    error_bf16 = BF16Matrix(0, 0);
+    bf16_operand = BF16Matrix(0, 0);
+    work_a = Matrix(0, 0);
+    work_error = Matrix(0, 0);
+    dz_workspace = Matrix(0, 0);
+    if (!enabled) {
+        weights_bf16.clear();
+        weights_t_bf16.clear();
+        return;
+    }
+
+    weights_bf16.assign(weights.size(), BF16Matrix(0, 0));
+    weights_t_bf16.assign(weights.size(), BF16Matrix(0, 0));
+    refresh_bf16_weights();
+}
+
+/**
+ * @brief Re-rounds the bf16 weight copies from the fp32 master weights.
+ */
+void ANN::refresh_bf16_weights() {
+    for (size_t i = 0; i < weights.size(); i++) {
+        weights_bf16[i].convertFrom(weights[i]);
+        weights_t_bf16[i].convertTransposedFrom(weights[i]);
+    }
+}
+
+/**
+ * @brief Removes the loss scale from the accumulated gradients before an optimizer step.
+ * If any gradient overflowed, the gradients are discarded, the loss scale is halved and
+ * the step should be skipped. After loss_scale_growth_interval clean steps the scale is doubled.
+ * Does nothing when mixed precision is disabled.
+ * @return True if the optimizer step should be taken.
+ */
+bool ANN::unscale_gradients() {
+    if (!mixed_precision) return true;
+
+    bool finite = true;
+    for (size_t i = 0; i < dw_accumulated.size() && finite; i++) {
+        finite = dw_accumulated[i].allFinite() && db_accumulated[i].allFinite() && (!norms[i] || norms[i]->gradients_finite());
+    }
+    if (embedding) finite = finite && embedding->gradients_finite();
+    if (!finite) {
+        loss_scale = std::max(loss_scale * 0.5f, 1.0f);
+        good_steps = 0;
+        skipped_steps++;
+        reset_gradients();
+        return false;
+    }
+
+    for (size_t i = 0; i < dw_accumulated.size(); i++) {
+        dw_accumulated[i] /= loss_scale;
+        db_accumulated[i] /= loss_scale;
+        if (norms[i]) norms[i]->scale_gradients(1.0f / loss_scale);
+    }
+    if (embedding) embedding->scale_gradients(1.0f / loss_scale);
+    if (++good_steps >= loss_scale_growth_interval) {
+        loss_scale *= 2.0f;
+        good_steps = 0;
+    }
+    return true;
+}
+
+float ANN::get_loss_scale() {
+    return loss_scale;
+}
+
+long unsigned ANN::get_skipped_steps() {
+    return skipped_steps;
+}
+
 /**
  * @brief Resets all accumulated gradients to zero.
  */
@@ -158,19 +738,24 @@ void ANN::reset_gradients() {
     for (size_t i = 0; i < dw_accumulated.size(); i++) {
         dw_accumulated[i].resetWithVal(0.0f);
         db_accumulated[i].resetWithVal(0.0f);
+        if (norms[i]) norms[i]->reset_gradients();
     }
+    if (embedding) embedding->reset_gradients();
 }
 
 void ANN::average_gradients(int batch_size) {
     for (size_t i = 0; i < dw_accumulated.size(); i++) {
         dw_accumulated[i] /= batch_size;
         db_accumulated[i] /= batch_size;
+        if (norms[i]) norms[i]->scale_gradients(1.0f / batch_size);
     }
+    if (embedding) embedding->scale_gradients(1.0f / batch_size);
 }
 
 void ANN::clip_gradients(float max_norm){
     
     for (long unsigned grad_idx =0; grad_idx < dw_accumulated.size(); grad_idx++){
+        PROFILE_SCOPE(profiler, ProfilePhase::ClipGradients, int(grad_idx), profile_flops(ProfilePhase::ClipGradients, int(grad_idx)), profile_bytes(ProfilePhase::ClipGradients, int(grad_idx)));
         float sum = 0.0f;
         for (int row = 0; row < dw_accumulated[grad_idx].get_rows_num(); row++) {
             for (int col = 0; col < dw_accumulated[grad_idx].get_columns_num(); col++) {
@@ -182,12 +767,16 @@ void ANN::clip_gradients(float max_norm){
                 sum += db_accumulated[grad_idx].get_val(row, col) * db_accumulated[grad_idx].get_val(row, col);
             }
         }
+        if (norms[grad_idx]) sum += float(norms[grad_idx]->gradient_squared_norm()); // gamma and beta belong to the layer
+        if (grad_idx == 0 && embedding) sum += float(embedding->gradient_squared_norm()); // So does the input embedding
 
         float norm = std::sqrt(sum);
         if (norm > max_norm) {
             float scale = max_norm / norm;
             dw_accumulated[grad_idx] *= scale;
             db_accumulated[grad_idx] *= scale;
+            if (norms[grad_idx]) norms[grad_idx]->scale_gradients(scale);
+            if (grad_idx == 0 && embedding) embedding->scale_gradients(scale);
         }
 
     }
@@ -197,28 +786,45 @@ void ANN::clip_gradients(float max_norm){
 
 /**
  * @brief Calculates the loss and prepares error signals for backpropagation.
- * @param target Target output matrix.
- * @return Computed loss value.
+ * @param target Target output matrix (output size x batch).
+ * @return Computed loss value, summed over the samples of the batch.
  */
 float ANN::calcualte_loss(Matrix& target) {
     if (a_values.back().get_rows_num() != target.get_rows_num() || a_values.back().get_columns_num() != target.get_columns_num()) {
         throw std::runtime_error("Output dimensions must match target dimensions for loss calculation.");
     }
+    PROFILE_SCOPE(profiler, ProfilePhase::Loss, -1, profile_flops(ProfilePhase::Loss, -1), profile_bytes(ProfilePhase::Loss, -1));
     float loss = 0.0f;
     
+    int batch = target.get_columns_num();
     if (strcmp(loss_function, "MSE") == 0) {
         F.diff(error_signals.back(), a_values.back(), target);
-        loss = F.MSE(error_signals.back());
+        loss = F.MSE(error_signals.back()) * batch; // Summed over the samples of the batch
         F.MSE_derivative(error_signals.back(), error_signals.back());
-        derivatives_functions[derivatives_functions.size()-1](dz_values[dz_values.size() - 1], z_values[dz_values.size() - 1]);
-        error_signals[error_signals.size()-1].elementWiseMultiply(error_signals[error_signals.size()-1], dz_values[dz_values.size()-1]);
-    
+        // MSE_derivative averages over the whole matrix; keep per-sample gradients, which
+        // backprop sums and average_gradients divides by the batch size.
+        if (batch > 1) error_signals.back() *= batch;
+        if (softmax_layers.back()) {
+            F.softmax_backward(error_signals.back(), a_values.back());
+        }
+        else {
+            derivatives_functions[derivatives_functions.size()-1](dz_values[dz_values.size() - 1], z_values[dz_values.size() - 1]);
+            error_signals[error_signals.size()-1].elementWiseMultiply(error_signals[error_signals.size()-1], dz_values[dz_values.size()-1]);
+        }
+    }
+    else if (softmax_layers.back()) { // Cross-Entropy Loss on a softmax output
+        // Fused log-sum-exp softmax + cross-entropy; the error signal is p - y directly.
+        loss = F.softmax_cross_entropy(z_values.back(), target, a_values.back(), error_signals.back());
     }
     else { // Cross-Entropy Loss
-        // assuming softmax or sigmoid activation in the last layer
+        // assuming sigmoid activation in the last layer
         F.diff(error_signals.back(), a_values.back(), target);
         loss = F.Cross_Entropy(a_values.back(), target);
     }
+    if (mixed_precision) {
+        error_signals.back() *= loss_scale; // Scaled so small gradients survive bf16 storage
+        error_signals.back().roundToBF16();
+    }
     //std::cout << "Loss: " << loss << "\n";
     return loss;
 }
@@ -227,40 +833,421 @@ float ANN::get_output_val(int row, int col){
     return a_values.back().get_val(row, col);
 }
 
+float ANN::get_weight_gradient(int layer, int row, int col){
+    return dw_accumulated[layer].get_val(row, col);
+}
+
 float ANN::train_epoch(std::vector<std::array<Matrix, 2>>& train_set, int batch_size){
+    if (batch_size <= 0) {
+        throw std::runtime_error("Invalid batch size.");
+    }
+    TRACE_SCOPE("train_epoch");
+    int num_batches = int((train_set.size() + batch_size - 1) / batch_size);
+    std::cout << "Training with batch size: " << batch_size << " (micro-batch size: " << micro_batch_size << ")\n";
+    std::cout << "Number of training batches: " << num_batches << "\n";
     
-    std::cout << "Training with batch size: " << batch_size << "\n";
-    std::cout << "Number of training batches: " << int(train_set.size()/ batch_size) << "\n";
-    
+    const std::vector<long unsigned>& order = sampler.epoch_order(train_set.size(), epochs_trained++);
     float running_loss = 0.0f;
     int ct = 0;
-    for (int batch_num=0; batch_num < int(train_set.size()/ batch_size); batch_num++){
+    for (int batch_num=0; batch_num < num_batches; batch_num++){
+        PROFILE_SCOPE(profiler, ProfilePhase::Step, -1, 0.0, 0.0);
+        long unsigned first = (long unsigned)batch_num * batch_size;
+        int samples = int(std::min<long unsigned>(batch_size, train_set.size() - first)); // The last batch may be partial
         reset_gradients();
-        for (int sample_num=0; sample_num< batch_size; sample_num++){
-            auto& [x, y] = train_set[batch_num * batch_size + sample_num];
-            forward(x);
-            running_loss += calcualte_loss(y);
-            ct++;
+        // Gradients of all micro-batches accumulate before a single optimizer step.
+        for (int offset = 0; offset < samples; offset += micro_batch_size){
+            int micro = std::min(micro_batch_size, samples - offset);
+            if (micro == 1) {
+                auto& [x, y] = train_set[order[first + offset]];
+                forward(x);
+                running_loss += calcualte_loss(y);
+            }
+            else {
+                gather_batch(train_set, &order[first + offset], micro, batch_inputs, batch_targets);
+                forward(batch_inputs);
+                running_loss += calcualte_loss(batch_targets);
+            }
+            ct += micro;
             backprop();
         }
-        average_gradients(batch_size);
+        average_gradients(samples);
+        if (!unscale_gradients()) continue; // Overflow under mixed precision: skip this step
         clip_gradients(1.0f); // Clip gradients to prevent exploding gradients
         update_weights();
     }
-    std::cout << "ct: " << ct << " int(train_set.size()/ batch_size): "<<int(train_set.size()/ batch_size)<<"\n";
     return running_loss / ct;
 }
 
+/**
+ * @brief Sets the number of samples processed per forward/backprop pass during training.
+ * Micro-batches run as one matrix product per layer; the gradients of all micro-batches in
+ * a training batch accumulate before a single clip/update step, so the optimizer still sees
+ * the full batch. Choose it so a micro-batch's activations stay in cache.
+ * @param micro_batch Samples per pass (1 processes one sample at a time).
+ */
+void ANN::set_micro_batch_size(int micro_batch) {
+    if (micro_batch <= 0) {
+        throw std::runtime_error("Micro-batch size must be greater than zero.");
+    }
+    micro_batch_size = micro_batch;
+}
+
+/**
+ * @brief Sets the order in which train_epoch visits the training samples. Shuffled orders are
+ * drawn per epoch from the sampler seed (the global random seed at construction), so training
+ * runs are reproducible; samples are gathered through the indices and never moved.
+ * @param mode Sequential, Shuffle or BlockShuffle.
+ * @param block_size Contiguous samples kept together by BlockShuffle.
+ */
+void ANN::set_sampler(SamplerMode mode, long unsigned block_size) {
+    sampler.set_mode(mode, block_size);
+}
+
+/**
+ * @brief Sets the seed of the per-epoch permutations of train_epoch.
+ * @param seed The seed.
+ */
+void ANN::set_sampler_seed(uint64_t seed) {
+    sampler.set_seed(seed);
+}
+
+/**
+ * @brief Inserts a normalization between W a + b and the activation of a layer, or replaces the
+ * existing one. Training normalizes with the statistics of each micro-batch (a BatchNorm needs
+ * at least two samples per micro-batch); evaluate() and predict() use the running statistics.
+ * gamma and beta are trained with the layer's weights and clipped together with them.
+ * @param layer Weight layer index (0 is the first hidden layer).
+ * @param type BatchNorm or LayerNorm.
+ * @param epsilon Added to the variance for numerical stability.
+ * @param momentum Weight of each batch in the BatchNorm running statistics.
+ * @throws std::runtime_error if the layer does not exist.
+ */
+void ANN::set_normalization(int layer, NormType type, float epsilon, float momentum) {
+    if (layer < 0 || layer >= int(weights.size())) {
+        throw std::runtime_error("Layer index out of range.");
+    }
+    norms[layer] = std::make_unique<Normalization>(type, weights[layer].get_rows_num(), epsilon, momentum);
+    batch_columns = -1; // Size the normalization buffer on the next forward pass
+}
+
+/**
+ * @brief Export step for serving: folds every BatchNorm, with its running statistics, into the
+ * weights and biases of its layer and removes it, so inference runs the plain dense layers
+ * (LayerNorm layers depend on each sample and stay). Further training continues without them.
+ * @return Number of folded layers.
+ */
+int ANN::fold_batch_norm() {
+    int folded = 0;
+    for (size_t i = 0; i < weights.size(); i++) {
+        if (!norms[i] || norms[i]->get_type() != NormType::BatchNorm) continue;
+        norms[i]->fold_into(weights[i], biases[i]);
+        norms[i].reset();
+        norm_inputs[i] = Matrix(0, 0);
+        folded++;
+    }
+    if (mixed_precision && folded > 0) refresh_bf16_weights();
+    batch_columns = -1;
+    return folded;
+}
+
+/**
+ * @brief Returns the normalization of a layer, e.g. to inspect gamma or the running statistics.
+ * @param layer Weight layer index.
+ * @return The normalization, or nullptr if the layer has none.
+ * @throws std::runtime_error if the layer does not exist.
+ */
+Normalization* ANN::get_normalization(int layer) {
+    if (layer < 0 || layer >= int(weights.size())) {
+        throw std::runtime_error("Layer index out of range.");
+    }
+    return norms[layer].get();
+}
+
+/**
+ * @brief Enables inverted dropout on the output of a hidden layer. During training each forward
+ * pass keeps every activation of the layer with probability 1 - rate and scales the kept ones by
+ * 1 / (1 - rate); the mask is stored as one bit per activation and applied in the activation
+ * kernels. evaluate() and predict() do not run any dropout code.
+ * @param layer Weight layer index of a hidden layer (not the output layer).
+ * @param rate Drop probability in [0, 1); 0 removes the dropout.
+ * @throws std::runtime_error if the layer is not a hidden layer with an element-wise activation.
+ */
+void ANN::set_dropout(int layer, float rate) {
+    if (layer < 0 || layer + 1 >= int(weights.size())) {
+        throw std::runtime_error("Dropout applies to hidden layers only.");
+    }
+    if (rate == 0.0f) {
+        dropouts[layer].reset();
+        return;
+    }
+    const std::string& name = activation_names[layer];
+    ElementwiseActivation activation;
+    if (name == "ReLu") activation = ElementwiseActivation::ReLu;
+    else if (name == "sigmoid") activation = ElementwiseActivation::Sigmoid;
+    else if (name == "Tanh") activation = ElementwiseActivation::Tanh;
+    else if (name == "linear") activation = ElementwiseActivation::Linear;
+    else throw std::runtime_error("Dropout needs an element-wise activation, not " + name + ".");
+    dropouts[layer] = std::make_unique<Dropout>(rate, activation);
+}
+
+/**
+ * @brief Sets the seed of the dropout masks and restarts their sequence, so the masks of a run
+ * can be replayed.
+ * @param seed The seed.
+ */
+void ANN::set_dropout_seed(uint64_t seed) {
+    dropout_seed = seed;
+    dropout_passes = 0;
+}
+
+/**
+ * @brief Replaces the dense input with an embedding lookup: each input sample becomes a column
+ * of categorical IDs (one field per row, IDs stored as floats), and the first layer receives
+ * the concatenated dim-wide rows of a vocab x dim table. Equivalent to one-hot encoding every
+ * field into a vocab-wide input, but forward gathers O(dim) values per ID, and backprop and the
+ * optimizer step touch only the table rows the batch used.
+ * @param vocab Number of IDs.
+ * @param dim Values per ID; the input layer size must be a multiple of it.
+ * @throws std::runtime_error if the input layer size is not a multiple of dim.
+ */
+void ANN::set_embedding(long vocab, int dim) {
+    if (dim <= 0 || weights[0].get_columns_num() % dim != 0) {
+        throw std::runtime_error("The input layer size must be a multiple of the embedding dimension.");
+    }
+    embedding = std::make_unique<Embedding>(vocab, dim);
+}
+
+/**
+ * @brief Returns the input embedding.
+ * @return The embedding, or nullptr if the input is dense.
+ */
+Embedding* ANN::get_embedding() {
+    return embedding.get();
+}
 
+/**
+ * @brief Returns the number of rows of an input sample.
+ * @return ID fields with an embedding, the input layer size otherwise.
+ */
+int ANN::input_rows() {
+    int size = weights[0].get_columns_num();
+    return embedding ? size / embedding->get_dim() : size;
+}
+
+/**
+ * @brief Copies the indexed samples of a data set into the columns of a batch.
+ * @param set Vector of {input, target} column-vector pairs.
+ * @param indices Samples to gather, in column order.
+ * @param count Number of samples to gather.
+ * @param inputs Matrix resized to (input size x count) receiving the inputs.
+ * @param targets Matrix resized to (output size x count) receiving the targets.
+ * @throws std::runtime_error if a sample does not match the network dimensions.
+ */
+void ANN::gather_batch(std::vector<std::array<Matrix, 2>>& set, const long unsigned* indices, int count, Matrix& inputs, Matrix& targets) {
+    auto& [x, y] = set.at(indices[0]);
+    if (x.get_rows_num() != input_rows() || y.get_rows_num() != weights.back().get_rows_num()) {
+        throw std::runtime_error("Samples must be column vectors matching the network dimensions.");
+    }
+    gather_samples(set, indices, count, inputs, targets); // Checks that all samples share this shape
+}
+
+
+/**
+ * @brief Evaluates the network on a data set and returns the per-sample loss.
+ * Uses the batched inference-only path, so no training buffers are modified.
+ * @param eval_set Vector of {input, target} column-vector pairs.
+ * @return Loss under the configured loss function, averaged per sample.
+ */
 float ANN::run_evaluation(std::vector<std::array<Matrix, 2>>& eval_set){
-    float running_loss = 0.0f;
-    for (long unsigned sample_idx =0; sample_idx < eval_set.size(); sample_idx++){
-        auto& [x, y] = eval_set[sample_idx];
-        forward(x);
-        running_loss += calcualte_loss(y);
+    return evaluate(eval_set).loss;
+}
+
+/**
+ * @brief Runs a batched forward pass without touching any training state.
+ * Each column of the input is one sample. Layer outputs are written to inference_values,
+ * whose buffers are resized to the batch width and reused between calls.
+ * @param input Input matrix (input size x batch).
+ */
+void ANN::infer(Matrix& input) {
+    if (input.get_rows_num() != input_rows()) {
+        throw std::runtime_error("Input dimensions do not match the input layer size.");
+    }
+    if (embedding) embedding->forward(input, inference_embedded, false);
+    infer_layers(embedding ? &inference_embedded : &input, nullptr, input.get_columns_num());
+}
+
+/**
+ * @brief Layer loop of the inference path.
+ * @param input Dense input of the first layer, or nullptr.
+ * @param sparse Sparse input of the first layer (one sample per row) if input is nullptr.
+ * @param batch Number of samples.
+ */
+void ANN::infer_layers(Matrix* input, const CSRMatrix* sparse, int batch) {
+    for (size_t i = 0; i < weights.size(); i++) {
+        inference_values[i].resize(weights[i].get_rows_num(), batch);
+        if (i == 0 && !input) inference_values[0].matrixMultiplyCSRTransposeB(weights[0], *sparse);
+        else inference_values[i].matrixMultiply(weights[i], i == 0 ? *input : inference_values[i - 1]);
+        inference_values[i].addColumnVector(biases[i]);
+        if (norms[i]) norms[i]->forward(inference_values[i], inference_values[i], false); // Running statistics
+        activation_functions[i](inference_values[i]);
     }
+}
 
-    return running_loss / eval_set.size();
+/**
+ * @brief Inference-only forward pass over a batch of samples.
+ * @param input Input matrix (input size x batch), one sample per column.
+ * @param output Matrix receiving the network outputs (output size x batch).
+ * @throws std::runtime_error if the output dimensions do not match.
+ */
+void ANN::predict(Matrix& input, Matrix& output) {
+    infer(input);
+    output.setValsFormMatrix(inference_values.back());
+}
+
+/**
+ * @brief Inference-only forward pass over a sparse batch; the first layer reads only the nonzeros.
+ * @param input Sparse batch, one sample per row and one input feature per column.
+ * @param output Matrix receiving the network outputs (output size x batch).
+ * @throws std::runtime_error if the dimensions do not match or an embedding is set.
+ */
+void ANN::predict(const CSRMatrix& input, Matrix& output) {
+    if (embedding || input.get_columns_num() != weights[0].get_columns_num()) {
+        throw std::runtime_error("Input dimensions do not match the input layer size.");
+    }
+    infer_layers(nullptr, &input, input.get_rows_num());
+    output.setValsFormMatrix(inference_values.back());
+}
+
+/**
+ * @brief Enables or disables profiling of forward, backprop, calcualte_loss, clip_gradients
+ * and update_weights. Recorded aggregates are kept when profiling is disabled.
+ * @param enabled Whether to record.
+ */
+void ANN::set_profiling(bool enabled) {
+    profiler.set_enabled(enabled);
+}
+
+/**
+ * @brief Returns the profiling aggregates: wall time, calls, FLOPs, bytes and share of the total
+ * per (phase, layer) pair, e.g. the backward pass of layer 1. Network-level phases use layer -1.
+ * @return The profile report.
+ */
+ProfileReport ANN::profile_report() {
+    return profiler.report();
+}
+
+/**
+ * @brief Clears the profiling aggregates.
+ */
+void ANN::reset_profile() {
+    profiler.reset();
+}
+
+/**
+ * @brief Nominal floating-point operations of one call of a phase for the current batch.
+ * Counts multiply-adds as two operations and an activation or derivative as one per element.
+ * @param phase The profiled phase.
+ * @param layer Weight layer index (-1 for network-level phases).
+ * @return Number of operations.
+ */
+double ANN::profile_flops(ProfilePhase phase, int layer) {
+    double batch = batch_columns;
+    double out = layer >= 0 ? weights[layer].get_rows_num() : weights.back().get_rows_num();
+    double in = layer >= 0 ? weights[layer].get_columns_num() : 0.0;
+    double inputs = (layer == 0 && sparse_input) ? double(sparse_batch.get_nnz()) : in * batch; // Input values the layer reads
+    switch (phase) {
+        case ProfilePhase::Forward:
+        case ProfilePhase::Recompute:
+            return 2.0 * out * inputs + 2.0 * out * batch + (norms[layer] ? 5.0 * out * batch : 0.0); // W a, bias, activation, normalization
+        case ProfilePhase::Loss:
+            return 4.0 * out * batch;
+        case ProfilePhase::Backward:
+            // dW = e a^T, db, accumulation, and for hidden layers W^T e with the activation derivative
+            return 2.0 * out * inputs + out * batch + 2.0 * (out * in + out) + (layer > 0 ? 2.0 * in * out * batch + 2.0 * in * batch : 0.0) +
+                   (norms[layer] ? 9.0 * out * batch : 0.0);
+        case ProfilePhase::ClipGradients:
+            return 2.0 * (out * in + out);
+        case ProfilePhase::UpdateWeights:
+            return 2.0 * (out * in + out);
+        default:
+            return 0.0;
+    }
+}
+
+/**
+ * @brief Minimum bytes read and written by one call of a phase for the current batch
+ * (every operand touched once, no cache reuse assumed).
+ * @param phase The profiled phase.
+ * @param layer Weight layer index (-1 for network-level phases).
+ * @return Number of bytes.
+ */
+double ANN::profile_bytes(ProfilePhase phase, int layer) {
+    double batch = batch_columns;
+    double element = sizeof(float);
+    if (layer < 0) {
+        if (phase == ProfilePhase::Loss) return 3.0 * element * weights.back().get_rows_num() * batch;
+        double parameters = 0.0; // bf16 refresh of every weight matrix
+        for (auto& w : weights) parameters += double(w.get_rows_num()) * w.get_columns_num();
+        return (element + 2.0 * sizeof(uint16_t)) * parameters;
+    }
+    double out = weights[layer].get_rows_num();
+    double in = weights[layer].get_columns_num();
+    double inputs = (layer == 0 && sparse_input) ? double(sparse_batch.get_nnz()) : in * batch; // Input values the layer reads
+    switch (phase) {
+        case ProfilePhase::Forward:
+        case ProfilePhase::Recompute:
+            return element * (out * in + out + inputs + 2.0 * out * batch + (norms[layer] ? out * batch : 0.0));
+        case ProfilePhase::Backward:
+            return element * (inputs + out * batch + 3.0 * (out * in + out) + (layer > 0 ? out * in + 2.0 * in * batch : 0.0) +
+                              (norms[layer] ? 2.0 * out * batch : 0.0));
+        case ProfilePhase::ClipGradients:
+            return element * (out * in + out);
+        case ProfilePhase::UpdateWeights:
+            return 3.0 * element * (out * in + out);
+        default:
+            return 0.0;
+    }
+}
+
+/**
+ * @brief Evaluates the network on a data set in batches without computing any gradients.
+ * Samples are gathered into batches of up to batch_size columns so every layer runs as one
+ * multi-threaded matrix product. Metrics are reduced per batch in a fixed order, so the
+ * results are identical for any number of threads.
+ * @param eval_set Vector of {input, target} column-vector pairs.
+ * @param batch_size Number of samples evaluated per forward pass.
+ * @return Loss, MSE, cross-entropy and accuracy over the whole set.
+ */
+EvalMetrics ANN::evaluate(std::vector<std::array<Matrix, 2>>& eval_set, int batch_size) {
+    if (batch_size <= 0) {
+        throw std::runtime_error("Invalid batch size.");
+    }
+    TRACE_SCOPE("evaluate");
+    EvalMetrics result;
+    if (eval_set.empty()) return result;
+
+    int output_rows = weights.back().get_rows_num();
+    double squared_error = 0.0;
+    double cross_entropy = 0.0;
+    long unsigned correct = 0;
+
+    const std::vector<long unsigned>& order = eval_sampler.epoch_order(eval_set.size(), 0);
+    for (long unsigned first = 0; first < eval_set.size(); first += batch_size) {
+        int batch = int(std::min<long unsigned>(batch_size, eval_set.size() - first));
+        gather_batch(eval_set, &order[first], batch, batch_inputs, batch_targets);
+        infer(batch_inputs);
+        BatchMetrics metrics = F.batch_metrics(inference_values.back(), batch_targets);
+        squared_error += metrics.squared_error;
+        cross_entropy += metrics.cross_entropy;
+        correct += metrics.correct;
+    }
+
+    result.samples = eval_set.size();
+    result.mse = float(squared_error / (double(output_rows) * result.samples));
+    result.cross_entropy = float(cross_entropy / result.samples);
+    result.accuracy = float(double(correct) / result.samples);
+    result.loss = (strcmp(loss_function, "MSE") == 0) ? result.mse : result.cross_entropy;
+    return result;
 }
 
 void ANN::train_model(std::vector<std::array<Matrix, 2>>& train_set, std::vector<std::array<Matrix, 2>>& eval_set, int epochs, long unsigned batch_size) {
@@ -272,9 +1259,15 @@ void ANN::train_model(std::vector<std::array<Matrix, 2>>& train_set, std::vector
     }
     
     for (int epoch = 0; epoch < epochs; epoch++) {
-        float train_loss = train_epoch(train_set, batch_size);
-        float eval_loss = run_evaluation(eval_set);
+        float train_loss;
+        float eval_loss;
+        {
+            TRACE_SCOPE("epoch", "ann", epoch);
+            train_loss = train_epoch(train_set, batch_size);
+            eval_loss = run_evaluation(eval_set);
+        }
         std::cout << "Epoch " << epoch + 1 << ": Train Loss = " << train_loss << ", Eval Loss = " << eval_loss << "\n";
+        if (trace_enabled()) trace_flush(); // Bound the per-thread trace buffers to one epoch
     }
 }
 
@@ -1,13 +1,35 @@
 #ifndef ANN_H
 #define ANN_H
 
+#include <array>
 #include <functional>
+#include <memory>
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include "../matrix/matrix.h"
+#include "../matrix/bf16.h"
+#include "../matrix/sparse.h"
 #include "../functions/functions.h"
+#include "../profiling/profiler.h"
+#include "../data/sampler.h"
+#include "../layers/normalization.h"
+#include "../layers/dropout.h"
+#include "../layers/embedding.h"
 
 
+/**
+ * @struct EvalMetrics
+ * @brief Aggregated results of an inference-only evaluation run.
+ */
+struct EvalMetrics {
+    float loss = 0.0f; ///< Per-sample loss under the configured loss function.
+    float mse = 0.0f; ///< Mean squared error over all outputs.
+    float cross_entropy = 0.0f; ///< Mean per-sample cross-entropy.
+    float accuracy = 0.0f; ///< Fraction of samples whose predicted class matches the target.
+    long unsigned samples = 0; ///< Number of evaluated samples.
+};
+
 /**
  * @class ANN
  * @brief Implements an Artificial Neural Network with customizable layers and activations.
@@ -18,6 +40,7 @@ public:
     ~ANN(); // Destructor
 
     void forward(Matrix& input); // Forward pass
+    void forward(const CSRMatrix& input); // Forward pass of a sparse batch, one sample per row
     void backprop(); // Backpropagation
     void set_optimizer(std::string optimizer = "SGD", std::string loss_function = "MSE", float learning_rate = 0.01f); // Set optimizer and loss function
     void update_weights(); // Update weights using gradients
@@ -25,12 +48,61 @@ public:
     void reset_gradients(); // Reset gradients for backpropagation
     void average_gradients(int batch_size);
     void clip_gradients(float max_norm); // Clip gradients to prevent exploding gradients
+    void set_mixed_precision(bool enabled, float initial_loss_scale = 65536.0f, int growth_interval = 2000); // bf16 layer products and hidden-layer storage, fp32 master weights
+    bool unscale_gradients(); // Undo loss scaling; returns false (and skips the step) on overflow
+    float get_loss_scale();
+    long unsigned get_skipped_steps();
     float get_output_val(int row, int col);
+    float get_weight_gradient(int layer, int row, int col); // Accumulated gradient of one weight
+    void set_checkpointing(int interval); // Keep every interval-th layer's activations, recompute the rest in backprop
+    void set_checkpoint_memory_budget(long unsigned bytes); // Choose the checkpoint interval from an activation memory budget
+    int get_checkpoint_interval(); // Interval used for the current batch size
+    long unsigned activation_memory_bytes(); // Bytes held by the training activation buffers
     float train_epoch(std::vector<std::array<Matrix, 2>>& train_set, int batch_size);
+    void set_micro_batch_size(int micro_batch_size); // Samples per forward/backprop pass; gradients accumulate over the batch
+    void set_sampler(SamplerMode mode, long unsigned block_size = 64); // Per-epoch sample order of train_epoch (sequential by default)
+    void set_sampler_seed(uint64_t seed); // Seed of the per-epoch permutations
+    void set_normalization(int layer, NormType type, float epsilon = 1e-5f, float momentum = 0.1f); // Normalize the pre-activation of a layer
+    int fold_batch_norm(); // Fold every BatchNorm into its layer's weights and biases for inference; returns the number folded
+    Normalization* get_normalization(int layer); // Normalization of a layer, or nullptr
+    void set_dropout(int layer, float rate); // Inverted dropout on the output of a hidden layer during training (0 removes it)
+    void set_dropout_seed(uint64_t seed); // Seed of the dropout masks; restarts the mask sequence
+    void set_embedding(long vocab, int dim); // Inputs become rows of categorical IDs looked up in a vocab x dim table
+    Embedding* get_embedding(); // Input embedding, or nullptr
     float run_evaluation(std::vector<std::array<Matrix, 2>>& eval_set);
+    EvalMetrics evaluate(std::vector<std::array<Matrix, 2>>& eval_set, int batch_size = 256); // Batched inference-only evaluation
+    void predict(Matrix& input, Matrix& output); // Inference-only forward pass over a batch of column samples
+    void predict(const CSRMatrix& input, Matrix& output); // Inference-only forward pass over a sparse batch, one sample per row
+    void set_profiling(bool enabled); // Record per-layer, per-phase time, FLOPs and bytes of training steps
+    ProfileReport profile_report(); // Aggregates recorded since the last reset_profile()
+    void reset_profile();
     void train_model(std::vector<std::array<Matrix, 2>>& train_set, std::vector<std::array<Matrix, 2>>& eval_set, int epochs, long unsigned batch_size);
 
 private:
+    friend class InferenceModel; // Copies the trained parameters into an inference-only model
+
+    void infer(Matrix& input); // Batched forward pass into inference_values, no training state touched
+    void infer_layers(Matrix* input, const CSRMatrix* sparse, int batch); // Layer loop of infer for a dense or sparse first layer
+    void forward_layers(int batch); // Layer loop of forward once the input is in place
+    int input_rows(); // Rows of an input sample (ID fields with an embedding)
+    void gather_batch(std::vector<std::array<Matrix, 2>>& set, const long unsigned* indices, int count, Matrix& inputs, Matrix& targets);
+    void refresh_bf16_weights(); // Re-round the bf16 weight copies from the fp32 master weights
+    void prepare_batch(int batch_columns); // Size the training buffers for a batch and the checkpoint layout
+    int choose_checkpoint_interval(int batch_columns); // Interval from checkpoint_interval or the memory budget
+    long unsigned estimate_activation_bytes(int interval, int batch_columns);
+    bool is_resident(size_t node); // Whether a layer output is kept between forward and backprop
+    Matrix& node_a(size_t node); // Activation of a layer output (input for node 0)
+    Matrix& node_z(size_t node); // Pre-activation that produced a layer output
+    BF16Matrix& node_a_bf16(size_t node); // bf16 activation of a hidden layer output in mixed precision
+    BF16Matrix& node_z_bf16(size_t node); // bf16 pre-activation that produced a hidden layer output
+    void forward_layer(size_t i, Matrix& input, Matrix& z, Matrix& a); // z = W a_in + b, a = f(z)
+    void forward_layer_bf16(size_t i); // forward_layer reading and storing hidden layer outputs in bf16
+    void activate_layer(size_t i, Matrix& linear, Matrix& z, Matrix& a, BF16Matrix* stored_z = nullptr); // Bias, normalization and activation of W a_in
+    void backward_layer(size_t i, Matrix& input, Matrix* z_prev); // Gradients of layer i and error signal of layer i-1
+    void backward_layer_bf16(size_t i); // backward_layer reading and storing hidden layer values in bf16
+    double profile_flops(ProfilePhase phase, int layer); // Nominal FLOPs of one call of a phase for the current batch
+    double profile_bytes(ProfilePhase phase, int layer); // Minimum bytes moved by one call of a phase
+
     Functions F; // Functions object for activations/losses
     float learning_rate; // Learning rate for weight updates
     char *loss_function; // Loss function to be used (e.g., "MSE", "Cross_Entropy")
@@ -46,8 +118,52 @@ private:
     std::vector<Matrix> db_accumulated; // Accumulated gradients for biases
     std::vector<Matrix> db_temp; // Temporary gradients for biases
     std::vector<Matrix> error_signals; // Error signals for backpropagation
+    std::vector<Matrix> segment_z; // Recomputed pre-activations inside a checkpoint segment
+    std::vector<Matrix> segment_a; // Recomputed activations inside a checkpoint segment
+    Matrix dz_workspace; // Shared derivative buffer for hidden layers when checkpointing
+    int batch_columns; // Number of samples (columns) the training buffers are sized for
+    int checkpoint_interval; // Requested interval between stored layer outputs (<= 1 stores all)
+    long unsigned checkpoint_memory_budget; // Activation memory budget in bytes (0 = use checkpoint_interval)
+    int active_checkpoint_interval; // Interval used for the current batch
+    std::vector<Matrix> inference_values; // Per-layer outputs of the batched inference path
+    int micro_batch_size; // Samples per forward/backprop pass in train_epoch
+    Matrix batch_inputs; // Gathered input batch for micro-batches and evaluation
+    Matrix batch_targets; // Gathered target batch for micro-batches and evaluation
+    Sampler sampler; // Order in which train_epoch visits the training samples
+    Sampler eval_sampler; // Sequential order of evaluate
+    long unsigned epochs_trained; // Epochs run by train_epoch; selects the sampler's permutation
     std::vector<std::function<void(Matrix&)>> activation_functions; // Activation functions
     std::vector<std::function<void(Matrix&, Matrix&)>> derivatives_functions; // Activation derivatives
+    std::vector<bool> softmax_layers; // Layers whose activation is softmax (back-propagated without the Jacobian)
+    std::vector<std::unique_ptr<Normalization>> norms; // Optional normalization between W a + b and the activation of each layer
+    std::vector<Matrix> norm_inputs; // W a + b of normalized layers, kept for the normalization backward
+    std::vector<std::string> activation_names; // Activation of each layer, as given to the constructor
+    std::vector<std::unique_ptr<Dropout>> dropouts; // Optional dropout fused with the activation of each hidden layer
+    uint64_t dropout_seed; // Seed of the dropout masks
+    long unsigned dropout_passes; // Training forward passes so far; selects the mask streams
+    std::unique_ptr<Embedding> embedding; // Optional lookup producing the input of the first layer from ID rows
+    Matrix embedding_grad; // dL/d(first layer input), back-propagated into the embedding
+    Matrix inference_embedded; // Looked-up input of the batched inference path
+    CSRMatrix sparse_batch; // Input of the last forward pass when it was sparse
+    bool sparse_input; // Whether the first layer reads sparse_batch instead of a_values[0]
+
+    bool mixed_precision; // bf16 products and hidden-layer activations and error signals, fp32 master weights and gradients
+    float loss_scale; // Dynamic loss scale applied to the output error signal in mixed precision
+    int loss_scale_growth_interval; // Number of overflow-free steps before the loss scale is doubled
+    int good_steps; // Overflow-free steps since the last loss scale change
+    long unsigned skipped_steps; // Optimizer steps skipped because of gradient overflow
+    std::vector<BF16Matrix> weights_bf16; // bf16 copies of the weights for the forward pass
+    std::vector<BF16Matrix> weights_t_bf16; // bf16 copies of the transposed weights for backpropagation
+    BF16Matrix bf16_operand; // bf16 copy of the activation or error signal entering the current product, sample-major
+    std::vector<BF16Matrix> a_bf16; // Hidden-layer outputs in mixed precision, sample-major (a_values keeps the input and output)
+    std::vector<BF16Matrix> z_bf16; // Hidden-layer pre-activations in mixed precision, sample-major
+    std::vector<BF16Matrix> segment_a_bf16; // Recomputed bf16 activations inside a checkpoint segment
+    std::vector<BF16Matrix> segment_z_bf16; // Recomputed bf16 pre-activations inside a checkpoint segment
+    BF16Matrix error_bf16; // Error signal passed between hidden layers in mixed precision, sample-major
+    Matrix work_a; // fp32 values of the hidden layer being computed or back-propagated in mixed precision
+    Matrix work_error; // fp32 error signal of the hidden layer being back-propagated
+
+    Profiler profiler; // Opt-in per-layer, per-phase timing
 
 };
 
@@ -0,0 +1,164 @@
+#include "sampler.h"
+#include "../random/philox.h"
+#include "../profiling/trace.h"
+#include <algorithm>
+#include <stdexcept>
+
+static constexpr uint64_t sampler_stream_base = uint64_t(1) << 63; // Keeps epoch streams apart from tensor streams
+static constexpr long unsigned shuffle_chunk = 4096; // Random words generated per batch during a shuffle
+
+/**
+ * @brief Creates a sampler that visits the whole data set (one shard).
+ * @param mode Order of the samples.
+ * @param block_size Samples per block in BlockShuffle mode.
+ * @param seed Seed of the per-epoch permutations; workers sharing a data set must share it.
+ */
+Sampler::Sampler(SamplerMode mode, long unsigned block_size, uint64_t seed) : mode(mode), block_size(0), seed(seed), shard(0), num_shards(1) {
+    set_mode(mode, block_size);
+}
+
+/**
+ * @brief Changes the order of the samples.
+ * @param mode Order of the samples.
+ * @param block_size Samples per block in BlockShuffle mode (ignored otherwise). Blocks of a few
+ * pages of samples keep reads sequential for cache and mmap-backed data sets.
+ * @throws std::runtime_error if block_size is zero.
+ */
+void Sampler::set_mode(SamplerMode mode, long unsigned block_size) {
+    if (block_size == 0) {
+        throw std::runtime_error("Sampler block size must be greater than zero.");
+    }
+    this->mode = mode;
+    this->block_size = block_size;
+}
+
+/**
+ * @brief Changes the seed of the per-epoch permutations.
+ * @param seed The seed.
+ */
+void Sampler::set_seed(uint64_t seed) {
+    this->seed = seed;
+}
+
+/**
+ * @brief Restricts the order to one shard for data-parallel workers. The epoch permutation is
+ * split into num_shards contiguous slices whose sizes differ by at most one; together they
+ * cover every sample exactly once.
+ * @param shard Index of this worker's shard.
+ * @param num_shards Number of workers.
+ * @throws std::runtime_error if shard is not in [0, num_shards).
+ */
+void Sampler::set_shard(int shard, int num_shards) {
+    if (num_shards <= 0 || shard < 0 || shard >= num_shards) {
+        throw std::runtime_error("Shard index must be in [0, num_shards).");
+    }
+    this->shard = shard;
+    this->num_shards = num_shards;
+}
+
+/**
+ * @brief Computes the indices this shard visits in an epoch. The result depends only on the
+ * mode, seed, epoch and shard, so an epoch can be replayed (e.g. after resuming training).
+ * @param dataset_size Number of samples in the data set.
+ * @param epoch Epoch number, selecting the random stream.
+ * @return The indices, valid until the next call; storage is reused across epochs.
+ */
+const std::vector<long unsigned>& Sampler::epoch_order(long unsigned dataset_size, long unsigned epoch) {
+    TRACE_SCOPE("sampler_epoch_order", "data");
+    order.resize(dataset_size);
+    uint64_t stream = sampler_stream_base + epoch;
+    if (mode == SamplerMode::BlockShuffle) {
+        long unsigned num_blocks = (dataset_size + block_size - 1) / block_size;
+        blocks.resize(num_blocks);
+        for (long unsigned b = 0; b < num_blocks; b++) blocks[b] = b;
+        shuffle_indices(blocks.data(), num_blocks, seed, stream, random_words);
+        long unsigned next = 0;
+        for (long unsigned b : blocks) {
+            long unsigned end = std::min(dataset_size, (b + 1) * block_size);
+            for (long unsigned i = b * block_size; i < end; i++) order[next++] = i;
+        }
+    }
+    else {
+        for (long unsigned i = 0; i < dataset_size; i++) order[i] = i;
+        if (mode == SamplerMode::Shuffle) shuffle_indices(order.data(), dataset_size, seed, stream, random_words);
+    }
+
+    if (num_shards > 1) {
+        long unsigned first = dataset_size * (long unsigned)shard / (long unsigned)num_shards;
+        long unsigned end = dataset_size * (long unsigned)(shard + 1) / (long unsigned)num_shards;
+        std::copy(order.begin() + first, order.begin() + end, order.begin());
+        order.resize(end - first);
+    }
+    return order;
+}
+
+/**
+ * @brief Shuffles indices in place with the Fisher-Yates algorithm; the swap partners are drawn
+ * in batches from the Philox stream (seed, stream), so a shuffle is reproducible from its seed.
+ * @param indices Values to permute.
+ * @param n Number of values (below 2^32).
+ * @param seed Seed of the random stream.
+ * @param stream Stream id.
+ * @param scratch Buffer for the random words, reused across calls.
+ * @throws std::runtime_error if n does not fit the 32-bit swap bounds.
+ */
+void shuffle_indices(long unsigned* indices, long unsigned n, uint64_t seed, uint64_t stream, std::vector<uint32_t>& scratch) {
+    if (n > 0xFFFFFFFFul) {
+        throw std::runtime_error("Cannot shuffle more than 2^32 - 1 indices.");
+    }
+    if (n < 2) return;
+    PhiloxStream rng(seed, stream);
+    scratch.resize(std::min(shuffle_chunk, n - 1));
+    long unsigned drawn = 0;
+    for (long unsigned i = n - 1; i > 0;) {
+        long unsigned count = std::min<long unsigned>(scratch.size(), i);
+        rng.fill_bits(drawn, long(count), scratch.data());
+        for (long unsigned k = 0; k < count; k++, i--) {
+            // Multiply-shift maps the word to [0, i]; the bias is below (i + 1) / 2^32.
+            long unsigned j = (long unsigned)((uint64_t(scratch[k]) * (i + 1)) >> 32);
+            std::swap(indices[i], indices[j]);
+        }
+        drawn += count;
+    }
+}
+
+/**
+ * @brief Copies the indexed samples into the columns of a batch. The batch is resized in place,
+ * which reuses its storage once it has held a batch of this size, so gathering a shuffled
+ * batch costs one pass over the selected samples and no allocation.
+ * @param set Vector of {input, target} column-vector pairs.
+ * @param indices Samples to gather, in column order.
+ * @param count Number of samples.
+ * @param inputs Matrix resized to (input size x count) receiving the inputs.
+ * @param targets Matrix resized to (output size x count) receiving the targets.
+ * @throws std::runtime_error if an index is out of range or the samples differ in shape.
+ */
+void gather_samples(std::vector<std::array<Matrix, 2>>& set, const long unsigned* indices, int count, Matrix& inputs, Matrix& targets) {
+    TRACE_SCOPE("load_batch");
+    if (count <= 0) {
+        throw std::runtime_error("Batch must contain at least one sample.");
+    }
+    for (int col = 0; col < count; col++) {
+        if (indices[col] >= set.size()) {
+            throw std::runtime_error("Sample index out of range.");
+        }
+    }
+    int input_rows = set[indices[0]][0].get_rows_num();
+    int output_rows = set[indices[0]][1].get_rows_num();
+    for (int col = 0; col < count; col++) {
+        auto& [x, y] = set[indices[col]];
+        if (x.get_rows_num() != input_rows || x.get_columns_num() != 1 ||
+            y.get_rows_num() != output_rows || y.get_columns_num() != 1) {
+            throw std::runtime_error("Samples must be column vectors of equal size.");
+        }
+    }
+
+    inputs.resize(input_rows, count);
+    targets.resize(output_rows, count);
+    #pragma omp parallel for
+    for (int col = 0; col < count; col++) {
+        auto& [x, y] = set[indices[col]];
+        inputs.setColumnFromMatrix(col, x);
+        targets.setColumnFromMatrix(col, y);
+    }
+}
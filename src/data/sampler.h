@@ -0,0 +1,50 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "../matrix/matrix.h"
+
+/**
+ * @brief Order in which a Sampler visits the samples of an epoch.
+ */
+enum class SamplerMode {
+    Sequential, ///< 0, 1, 2, ... every epoch.
+    Shuffle, ///< A uniform random permutation per epoch.
+    BlockShuffle ///< Contiguous blocks of block_size samples in random order; order inside a block is kept.
+};
+
+/**
+ * @class Sampler
+ * @brief Produces the per-epoch sample order of a data set as an index permutation.
+ *
+ * Orders are drawn from the Philox stream (seed, epoch), so every worker that shares the seed
+ * computes the same global permutation without communication and takes its own shard of it.
+ * The samples themselves are never moved; batches are gathered through the indices.
+ */
+class Sampler {
+    public:
+        Sampler(SamplerMode mode = SamplerMode::Sequential, long unsigned block_size = 64, uint64_t seed = 0);
+
+        void set_mode(SamplerMode mode, long unsigned block_size = 64); ///< Changes the order; block_size is used by BlockShuffle.
+        void set_seed(uint64_t seed); ///< Changes the seed of the per-epoch permutations.
+        void set_shard(int shard, int num_shards); ///< Restricts the order to shard of num_shards disjoint contiguous slices.
+        const std::vector<long unsigned>& epoch_order(long unsigned dataset_size, long unsigned epoch); ///< Indices this shard visits in an epoch.
+        SamplerMode get_mode() const { return mode; } ///< Current mode.
+
+    private:
+        SamplerMode mode; ///< Order of the samples.
+        long unsigned block_size; ///< Samples per block in BlockShuffle mode.
+        uint64_t seed; ///< Seed of the per-epoch Philox streams.
+        int shard; ///< Index of this worker's shard.
+        int num_shards; ///< Number of shards the epoch is split into.
+        std::vector<long unsigned> order; ///< Order of the last epoch, reused across epochs.
+        std::vector<long unsigned> blocks; ///< Block permutation scratch of BlockShuffle, reused across epochs.
+        std::vector<uint32_t> random_words; ///< Random bits of the Fisher-Yates swaps, reused across epochs.
+};
+
+void shuffle_indices(long unsigned* indices, long unsigned n, uint64_t seed, uint64_t stream, std::vector<uint32_t>& scratch); ///< Fisher-Yates shuffle from a Philox stream.
+void gather_samples(std::vector<std::array<Matrix, 2>>& set, const long unsigned* indices, int count, Matrix& inputs, Matrix& targets); ///< Copies the indexed samples into the columns of a preallocated batch.
+
+#endif
@@ -1,6 +1,7 @@
 #include "functions.h"
 #include <cmath>
 #include <iostream>
+#include <vector>
 
 /**
  * @brief Applies the ReLU activation function element-wise.
@@ -23,14 +24,43 @@ void Functions::sigmoid(Matrix& m){
  * @param m The matrix to apply softmax on.
  */
 void Functions::softmax(Matrix& m){
+    int n = m.columns*m.rows;
+    if (n == 0) return;
+
+    // Subtracting the maximum keeps std::exp from overflowing on large logits.
+    float max_val = m.matrix_vals[0];
+    for (int i = 1; i < n; i++) max_val = std::max(max_val, m.matrix_vals[i]);
+
     float sum_of_exp = 0.0f;
-    for (int i = 0; i < m.columns*m.rows; i++){
-        m.matrix_vals[i] = std::exp(m.matrix_vals[i]);
+    for (int i = 0; i < n; i++){
+        m.matrix_vals[i] = std::exp(m.matrix_vals[i] - max_val);
         sum_of_exp += m.matrix_vals[i];
-    } 
-    m /= sum_of_exp;
+    }
+    float inv_sum = 1.0f / sum_of_exp;
+    for (int i = 0; i < n; i++) m.matrix_vals[i] *= inv_sum;
 }
 
+/**
+ * @brief Applies the softmax function to each column of the matrix independently.
+ * Every column holds one sample, so a batch of logits can be normalized in one call.
+ * @param m The matrix to apply softmax on (classes x batch).
+ */
+void Functions::softmax_columns(Matrix& m){
+    #pragma omp parallel for
+    for (int c = 0; c < m.columns; c++) {
+        float max_val = m.matrix_vals[c];
+        for (int r = 1; r < m.rows; r++) max_val = std::max(max_val, m.matrix_vals[r * m.columns + c]);
+
+        float sum_of_exp = 0.0f;
+        for (int r = 0; r < m.rows; r++) {
+            float e = std::exp(m.matrix_vals[r * m.columns + c] - max_val);
+            m.matrix_vals[r * m.columns + c] = e;
+            sum_of_exp += e;
+        }
+        float inv_sum = 1.0f / sum_of_exp;
+        for (int r = 0; r < m.rows; r++) m.matrix_vals[r * m.columns + c] *= inv_sum;
+    }
+}
 
 /**
  * @brief Applies the hyperbolic tangent function element-wise.
@@ -126,6 +156,122 @@ float Functions::Cross_Entropy(Matrix& predictions, Matrix& y) {
     return cross_entropy;
 }
 
+/**
+ * @brief Fused softmax and cross-entropy over a batch of logits (classes x batch).
+ * Each column is normalized with a log-sum-exp, so large logits cannot overflow, and
+ * log(p) is taken directly as z - lse instead of a separate std::log pass. The loops run
+ * over rows with the batch columns innermost so every pass vectorizes across samples.
+ * The gradient of the loss w.r.t. the logits is p - y, so the softmax Jacobian is never formed.
+ * @param logits The matrix of pre-softmax values.
+ * @param y The matrix of ground truth values.
+ * @param probabilities The matrix receiving the softmax probabilities (must not alias the logits).
+ * @param gradient The matrix receiving p - y.
+ * @return The cross-entropy loss summed over the batch columns.
+ * @throws std::runtime_error if the dimensions of the matrices do not match.
+ */
+float Functions::softmax_cross_entropy(Matrix& logits, Matrix& y, Matrix& probabilities, Matrix& gradient) {
+    if (logits.rows != y.rows || logits.columns != y.columns ||
+        probabilities.rows != y.rows || probabilities.columns != y.columns ||
+        gradient.rows != y.rows || gradient.columns != y.columns) {
+        throw std::runtime_error("Matrix dimensions must match for softmax cross entropy calculation.");
+    }
+
+    int rows = logits.rows;
+    int cols = logits.columns;
+    const float* z = logits.matrix_vals.data();
+    const float* t = y.matrix_vals.data();
+    float* p = probabilities.matrix_vals.data();
+    float* g = gradient.matrix_vals.data();
+    std::vector<float> max_val(z, z + cols);
+    std::vector<float> sum_of_exp(cols, 0.0f);
+    std::vector<float> column_loss(cols, 0.0f);
+    float* mx = max_val.data();
+    float* se = sum_of_exp.data();
+    float* cl = column_loss.data();
+
+    for (int r = 1; r < rows; r++) {
+        #pragma omp simd
+        for (int c = 0; c < cols; c++) mx[c] = std::max(mx[c], z[r * cols + c]);
+    }
+    for (int r = 0; r < rows; r++) {
+        #pragma omp simd
+        for (int c = 0; c < cols; c++) {
+            float e = std::exp(z[r * cols + c] - mx[c]);
+            p[r * cols + c] = e;
+            se[c] += e;
+        }
+    }
+    for (int c = 0; c < cols; c++) {
+        mx[c] += std::log(se[c]); // mx now holds the log-sum-exp of the column.
+        se[c] = 1.0f / se[c];
+    }
+    for (int r = 0; r < rows; r++) {
+        #pragma omp simd
+        for (int c = 0; c < cols; c++) {
+            int i = r * cols + c;
+            float prob = p[i] * se[c];
+            cl[c] -= t[i] * (z[i] - mx[c]);
+            p[i] = prob;
+            g[i] = prob - t[i];
+        }
+    }
+
+    float loss = 0.0f;
+    for (int c = 0; c < cols; c++) loss += cl[c];
+    return loss;
+}
+
+/**
+ * @brief Computes evaluation metrics over a batch whose columns are samples.
+ * Each column is reduced by a single thread into its own slot and the slots are then
+ * summed in column order, so the result does not depend on the number of threads.
+ * A sample counts as correct when the arg-max of the prediction matches the arg-max of
+ * the target; single-output models are thresholded at 0.5 instead.
+ * @param predictions The matrix of predicted values (outputs x batch).
+ * @param y The matrix of ground truth values (outputs x batch).
+ * @return The summed squared error, summed cross-entropy and number of correct samples.
+ * @throws std::runtime_error if the dimensions of predictions and ground truth do not match.
+ */
+BatchMetrics Functions::batch_metrics(Matrix& predictions, Matrix& y) {
+    if (predictions.rows != y.rows || predictions.columns != y.columns) {
+        throw std::runtime_error("Matrix dimensions must match for metrics calculation.");
+    }
+
+    int rows = predictions.rows;
+    int cols = predictions.columns;
+    std::vector<double> squared_error(cols, 0.0);
+    std::vector<double> cross_entropy(cols, 0.0);
+    std::vector<int> correct(cols, 0);
+
+    #pragma omp parallel for
+    for (int c = 0; c < cols; c++) {
+        double se = 0.0;
+        double ce = 0.0;
+        int pred_class = 0;
+        int true_class = 0;
+        for (int r = 0; r < rows; r++) {
+            float p = predictions.matrix_vals[r * cols + c];
+            float t = y.matrix_vals[r * cols + c];
+            se += (p - t) * (p - t);
+            if (t > 0) ce -= t * std::log(std::max(p, 0.0f) + 1e-9f);
+            if (p > predictions.matrix_vals[pred_class * cols + c]) pred_class = r;
+            if (t > y.matrix_vals[true_class * cols + c]) true_class = r;
+        }
+        squared_error[c] = se;
+        cross_entropy[c] = ce;
+        if (rows == 1) correct[c] = (predictions.matrix_vals[c] >= 0.5f) == (y.matrix_vals[c] >= 0.5f);
+        else correct[c] = pred_class == true_class;
+    }
+
+    BatchMetrics metrics;
+    for (int c = 0; c < cols; c++) {
+        metrics.squared_error += squared_error[c];
+        metrics.cross_entropy += cross_entropy[c];
+        metrics.correct += correct[c];
+    }
+    return metrics;
+}
+
 /**
  * @brief Computes the derivative of the ReLU function.
  * @param m_derivatives The matrix to store the derivatives.
@@ -147,7 +293,9 @@ void Functions::ReLu_derivative(Matrix& m_derivatives, Matrix& m){
  * @param m The matrix of input values.
  */
 void Functions::sigmoid_derivative(Matrix& m_derivatives, Matrix& m){
-    m_derivatives.elementWiseMultiply(m, 1.0 - m);
+    for (int i = 0; i < m.columns*m.rows; i++) {
+        m_derivatives.matrix_vals[i] = m.matrix_vals[i] * (1.0f - m.matrix_vals[i]);
+    }
 }
 
 
@@ -218,4 +366,33 @@ void Functions::softmax_derivative(Matrix& m_derivatives, Matrix& m) {
             }
         }
     }
-}   
\ No newline at end of file
+}
+
+/**
+ * @brief Back-propagates a gradient through a softmax, column by column.
+ * Computes J^T g = p * (g - sum(g * p)) for every column, which is the same as multiplying
+ * by the softmax_derivative Jacobian but costs O(n) instead of O(n^2) per sample.
+ * @param gradient The gradient w.r.t. the softmax output; overwritten with the gradient w.r.t. its input.
+ * @param probabilities The softmax output (classes x batch).
+ * @throws std::runtime_error if the dimensions of the matrices do not match.
+ */
+void Functions::softmax_backward(Matrix& gradient, Matrix& probabilities) {
+    if (gradient.rows != probabilities.rows || gradient.columns != probabilities.columns) {
+        throw std::runtime_error("Matrix dimensions must match for softmax backward calculation.");
+    }
+
+    int rows = gradient.rows;
+    int cols = gradient.columns;
+    std::vector<float> dot(cols, 0.0f);
+    for (int r = 0; r < rows; r++) {
+        #pragma omp simd
+        for (int c = 0; c < cols; c++) dot[c] += gradient.matrix_vals[r * cols + c] * probabilities.matrix_vals[r * cols + c];
+    }
+    for (int r = 0; r < rows; r++) {
+        #pragma omp simd
+        for (int c = 0; c < cols; c++) {
+            int i = r * cols + c;
+            gradient.matrix_vals[i] = probabilities.matrix_vals[i] * (gradient.matrix_vals[i] - dot[c]);
+        }
+    }
+}
@@ -3,6 +3,16 @@
 
 #include "../matrix/matrix.h"
 
+/**
+ * @struct BatchMetrics
+ * @brief Evaluation metrics summed over the columns (samples) of a batch.
+ */
+struct BatchMetrics {
+    double squared_error = 0.0; ///< Sum of squared errors over all elements.
+    double cross_entropy = 0.0; ///< Sum of per-sample cross-entropy losses.
+    int correct = 0; ///< Number of samples whose predicted class matches the target.
+};
+
 /**
  * @class Functions
  * @brief Implements various activation functions, loss functions, and their derivatives.
@@ -14,6 +24,7 @@ class Functions {
         void ReLu(Matrix& m); ///< Applies the ReLU activation function element-wise.
         void sigmoid(Matrix& m); ///< Applies the sigmoid activation function element-wise.
         void softmax(Matrix& m); ///< Applies the softmax function to the matrix.
+        void softmax_columns(Matrix& m); ///< Applies the softmax function to each column (sample) of the matrix.
         void Tanh(Matrix& m); ///< Applies the hyperbolic tangent function element-wise.
         void linear(Matrix& m); ///< Applies the linear activation function element-wise.
 
@@ -22,6 +33,10 @@ class Functions {
         float MSE(Matrix& m_diff); ///< Computes the Mean Squared Error (MSE) from the difference matrix.
         float MSE(Matrix& predictions, Matrix& y); ///< Computes the MSE between predictions and ground truth.
         float Cross_Entropy(Matrix& predictions, Matrix& y); ///< Computes the cross-entropy loss.
+        float softmax_cross_entropy(Matrix& logits, Matrix& y, Matrix& probabilities, Matrix& gradient); ///< Fused per-column softmax and cross-entropy with its gradient w.r.t. the logits.
+
+        // Evaluation metrics
+        BatchMetrics batch_metrics(Matrix& predictions, Matrix& y); ///< Computes squared error, cross-entropy and accuracy counts over a batch.
 
         // Derivatives of activation and loss functions
         void ReLu_derivative(Matrix& m_derivatives, Matrix& m); ///< Computes the derivative of the ReLU function.
@@ -29,6 +44,7 @@ class Functions {
         void Tanh_derivative(Matrix& m_derivatives, Matrix& m); ///< Computes the derivative of the Tanh function.
         void linear_derivative(Matrix& m_derivatives, Matrix& m); ///< Computes the derivative of the linear function.
         void softmax_derivative(Matrix& m_derivatives, Matrix& m); ///< Computes the derivative of the softmax function.
+        void softmax_backward(Matrix& gradient, Matrix& probabilities); ///< Multiplies a gradient by the softmax Jacobian of each column without forming it.
         void MSE_derivative(Matrix& m_derivatives, Matrix& m_diff); ///< Computes the derivative of the MSE loss.
         void Cross_Entropy_derivative(Matrix& m_derivatives, Matrix& y, Matrix& y_pred); ///< Computes the derivative of the cross-entropy loss.
 
@@ -0,0 +1,479 @@
+#include "graph.h"
+#include "../matrix/tensor.h"
+#include "../profiling/trace.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+/**
+ * @brief Returns whether Graph::dense accepts an activation name.
+ */
+static bool known_activation(const std::string& name) {
+    return name == "ReLu" || name == "sigmoid" || name == "Tanh" || name == "linear" || name == "softmax";
+}
+
+/**
+ * @brief Applies an activation in place; softmax normalizes each column (sample).
+ */
+static void apply_activation(Functions& F, const std::string& name, Matrix& m) {
+    if (name == "ReLu") F.ReLu(m);
+    else if (name == "sigmoid") F.sigmoid(m);
+    else if (name == "Tanh") F.Tanh(m);
+    else if (name == "softmax") F.softmax_columns(m);
+    else F.linear(m);
+}
+
+/**
+ * @brief Writes the element-wise derivative of an activation into derivatives (not used for
+ * softmax, which is back-propagated with Functions::softmax_backward). Functions::sigmoid_derivative
+ * expects the activated values, the others the pre-activation z.
+ */
+static void activation_derivative(Functions& F, const std::string& name, Matrix& derivatives, Matrix& z, Matrix& output) {
+    if (name == "ReLu") F.ReLu_derivative(derivatives, z);
+    else if (name == "sigmoid") F.sigmoid_derivative(derivatives, output);
+    else if (name == "Tanh") F.Tanh_derivative(derivatives, z);
+    else F.linear_derivative(derivatives, z);
+}
+
+/**
+ * @brief Constructs an empty graph with MSE loss and concurrent branches.
+ */
+Graph::Graph()
+    : output_node(-1), loss_function("MSE"), parallel_branches(true), output_delta(false), batch_columns(0), batch_input(nullptr) {}
+
+/**
+ * @brief Throws if id does not name a node of the graph.
+ */
+void Graph::check_node(int id) const {
+    if (id < 0 || id >= int(nodes.size())) {
+        throw std::runtime_error("Graph node " + std::to_string(id) + " does not exist.");
+    }
+}
+
+/**
+ * @brief Appends a node after its inputs, registers it as a consumer of each distinct input
+ * and places it one level above its deepest input.
+ * @return The id of the new node.
+ */
+int Graph::add_node(GraphOp op, const std::vector<int>& from, int rows) {
+    int id = int(nodes.size());
+    GraphNode node;
+    node.op = op;
+    node.inputs = from;
+    node.rows = rows;
+    for (int producer : from) node.level = std::max(node.level, nodes[producer].level + 1);
+    for (int producer : from) {
+        std::vector<int>& consumers = nodes[producer].consumers;
+        if (std::find(consumers.begin(), consumers.end(), id) == consumers.end()) consumers.push_back(id);
+    }
+    nodes.push_back(std::move(node));
+    if (int(levels.size()) <= nodes[id].level) levels.resize(nodes[id].level + 1);
+    levels[nodes[id].level].push_back(id);
+    return id;
+}
+
+/**
+ * @brief Adds the input node. A graph has exactly one input, added first.
+ * @param rows Features of a sample.
+ * @return The id of the input node (0).
+ * @throws std::runtime_error if the graph already has nodes or rows is not positive.
+ */
+int Graph::input(int rows) {
+    if (!nodes.empty()) {
+        throw std::runtime_error("The graph input must be its first and only input node.");
+    }
+    if (rows <= 0) {
+        throw std::runtime_error("Layer sizes must be greater than zero.");
+    }
+    return add_node(GraphOp::Input, {}, rows);
+}
+
+/**
+ * @brief Adds a fully connected layer f(W x + b) reading one node. Weights are He-uniform over
+ * the input width, U(-sqrt(6 / inputs), sqrt(6 / inputs)), and biases start like ANN's.
+ * @param from Input node.
+ * @param units Output features.
+ * @param activation ReLu, sigmoid, Tanh, linear or softmax.
+ * @return The id of the new node.
+ * @throws std::runtime_error if from does not exist, units is not positive or the activation is unknown.
+ */
+int Graph::dense(int from, int units, const std::string& activation) {
+    check_node(from);
+    if (units <= 0) {
+        throw std::runtime_error("Layer sizes must be greater than zero.");
+    }
+    if (!known_activation(activation)) {
+        throw std::runtime_error("Unsupported activation: " + activation);
+    }
+    int id = add_node(GraphOp::Dense, {from}, units);
+    GraphNode& node = nodes[id];
+    int inputs = nodes[from].rows;
+    node.activation = activation;
+    node.weights.resize(units, inputs);
+    node.weights.randomHeUniformInit(); // Limit sqrt(6 / rows): fan_in is taken from the rows
+    node.weights *= std::sqrt(double(units) / inputs);
+    Tensor(node.weights).transpose(0, 1).copy_to(node.weights_t);
+    node.bias.resize(units, 1);
+    node.bias.resetWithVal(0.01f * std::sqrt(2.0f / units));
+    node.weight_gradient.resize(units, inputs);
+    node.weight_gradient.resetWithVal(0.0f);
+    node.bias_gradient.resize(units, 1);
+    node.bias_gradient.resetWithVal(0.0f);
+    return id;
+}
+
+/**
+ * @brief Adds the element-wise sum of nodes, e.g. a residual connection x + f(x).
+ * @param from At least two nodes with the same number of features.
+ * @return The id of the new node.
+ * @throws std::runtime_error if a node does not exist or the sizes differ.
+ */
+int Graph::add(const std::vector<int>& from) {
+    if (from.size() < 2) {
+        throw std::runtime_error("Add needs at least two inputs.");
+    }
+    for (int producer : from) {
+        check_node(producer);
+        if (nodes[producer].rows != nodes[from[0]].rows) {
+            throw std::runtime_error("Add inputs must have the same number of features.");
+        }
+    }
+    return add_node(GraphOp::Add, from, nodes[from[0]].rows);
+}
+
+/**
+ * @brief Adds the concatenation of nodes along the features: the rows of from[0], then those of
+ * from[1], and so on.
+ * @param from Nodes to concatenate (a node may appear more than once).
+ * @return The id of the new node.
+ * @throws std::runtime_error if from is empty or a node does not exist.
+ */
+int Graph::concat(const std::vector<int>& from) {
+    if (from.empty()) {
+        throw std::runtime_error("Concat needs at least one input.");
+    }
+    int rows = 0;
+    for (int producer : from) {
+        check_node(producer);
+        rows += nodes[producer].rows;
+    }
+    return add_node(GraphOp::Concat, from, rows);
+}
+
+/**
+ * @brief Splits a node into consecutive row ranges, one Slice node per part.
+ * @param from Node to split.
+ * @param sizes Features of each part; they must add up to the features of from.
+ * @return The ids of the parts, in order.
+ * @throws std::runtime_error if from does not exist or the sizes do not cover it exactly.
+ */
+std::vector<int> Graph::split(int from, const std::vector<int>& sizes) {
+    check_node(from);
+    int total = 0;
+    for (int size : sizes) {
+        if (size <= 0) {
+            throw std::runtime_error("Split sizes must be greater than zero.");
+        }
+        total += size;
+    }
+    if (total != nodes[from].rows) {
+        throw std::runtime_error("Split sizes must add up to the features of the input.");
+    }
+    std::vector<int> parts;
+    int begin = 0;
+    for (int size : sizes) {
+        int id = add_node(GraphOp::Slice, {from}, size);
+        nodes[id].begin = begin;
+        begin += size;
+        parts.push_back(id);
+    }
+    return parts;
+}
+
+/**
+ * @brief Selects the node whose values forward() returns and the loss compares with the targets.
+ * @param node Output node; it must not feed other nodes.
+ * @throws std::runtime_error if the node does not exist or has consumers.
+ */
+void Graph::set_output(int node) {
+    check_node(node);
+    if (!nodes[node].consumers.empty()) {
+        throw std::runtime_error("The graph output must not feed other nodes.");
+    }
+    output_node = node;
+}
+
+/**
+ * @brief Sets the loss function.
+ * @param loss_function "MSE", or "Cross_Entropy" for a Dense output with a softmax or sigmoid
+ * activation (the error signal is then p - y).
+ * @throws std::runtime_error for other names.
+ */
+void Graph::set_loss(const std::string& loss_function) {
+    if (loss_function != "MSE" && loss_function != "Cross_Entropy") {
+        throw std::runtime_error("Unsupported loss function: " + loss_function);
+    }
+    this->loss_function = loss_function;
+}
+
+/**
+ * @brief Chooses whether the independent nodes of a level run concurrently. When they do, each
+ * node runs on one thread of the team (its kernels' own parallel regions are nested and run
+ * serially), which pays off when the branches are too small to fill the machine one at a time.
+ * A level with a single node always runs its kernels on the whole team.
+ * @param enabled True to run branches concurrently.
+ */
+void Graph::set_parallel_branches(bool enabled) {
+    parallel_branches = enabled;
+}
+
+/**
+ * @brief Returns a node by id.
+ * @throws std::runtime_error if the node does not exist.
+ */
+GraphNode& Graph::node(int id) {
+    check_node(id);
+    return nodes[id];
+}
+
+/**
+ * @brief Sizes the buffers of every node for a batch. Matrix::resize keeps the storage when the
+ * size does not grow, so batches of one size allocate only once.
+ */
+void Graph::prepare(int batch) {
+    batch_columns = batch;
+    for (GraphNode& node : nodes) {
+        if (node.op == GraphOp::Input) continue;
+        node.output.resize(node.rows, batch);
+        node.grad.resize(node.rows, batch);
+        node.partial.resize(node.rows, batch);
+        if (node.op == GraphOp::Dense) {
+            node.z.resize(node.rows, batch);
+            node.delta.resize(node.rows, batch);
+        }
+    }
+}
+
+/**
+ * @brief Runs the nodes of one level, concurrently when branches are enabled and the level has
+ * more than one node. Nodes of a level only read lower levels (forward) or higher levels
+ * (backward) and write their own buffers.
+ */
+void Graph::run_level(const std::vector<int>& level, bool backward) {
+    const int count = int(level.size());
+    if (!parallel_branches || count == 1) {
+        for (int id : level) {
+            if (backward) backward_node(id);
+            else forward_node(id);
+        }
+        return;
+    }
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int k = 0; k < count; k++) {
+        if (backward) backward_node(level[k]);
+        else forward_node(level[k]);
+    }
+}
+
+/**
+ * @brief Runs the graph on a batch, level by level.
+ * @param input Batch, input rows x N (one sample per column).
+ * @return The values of the output node, rows x N.
+ * @throws std::runtime_error if the graph has no input or the batch does not match it.
+ */
+Matrix& Graph::forward(Matrix& input) {
+    TRACE_SCOPE("graph_forward");
+    if (nodes.size() < 2) {
+        throw std::runtime_error("The graph needs an input and at least one layer.");
+    }
+    if (input.get_rows_num() != nodes[0].rows) {
+        throw std::runtime_error("Input dimensions do not match the graph input.");
+    }
+    batch_input = &input;
+    prepare(input.get_columns_num());
+    for (size_t level = 1; level < levels.size(); level++) run_level(levels[level], false);
+    return nodes[output_node < 0 ? nodes.size() - 1 : output_node].output;
+}
+
+/**
+ * @brief Computes the output of one node from its inputs.
+ */
+void Graph::forward_node(int id) {
+    GraphNode& node = nodes[id];
+    auto value = [&](int producer) -> Matrix& { return producer == 0 ? *batch_input : nodes[producer].output; };
+    const long batch = batch_columns;
+    switch (node.op) {
+        case GraphOp::Dense:
+            node.z.matrixMultiplyTransposeA(node.weights_t, value(node.inputs[0]));
+            node.z.addColumnVector(node.bias);
+            node.output.setValsFormMatrix(node.z);
+            apply_activation(F, node.activation, node.output);
+            break;
+        case GraphOp::Add:
+            node.output.setValsFormMatrix(value(node.inputs[0]));
+            for (size_t k = 1; k < node.inputs.size(); k++) node.output += value(node.inputs[k]);
+            break;
+        case GraphOp::Concat: {
+            // Rows are contiguous in row-major storage, so each input is one block copy.
+            float* out = node.output.data();
+            for (int producer : node.inputs) {
+                const Matrix& in = value(producer);
+                out = std::copy(in.data(), in.data() + long(in.get_rows_num()) * batch, out);
+            }
+            break;
+        }
+        case GraphOp::Slice: {
+            const Matrix& in = value(node.inputs[0]);
+            const float* first = in.data() + long(node.begin) * batch;
+            std::copy(first, first + long(node.rows) * batch, node.output.data());
+            break;
+        }
+        case GraphOp::Input:
+            break;
+    }
+}
+
+/**
+ * @brief Computes the loss of the output node and its error signal, like ANN::calcualte_loss.
+ * @param target Targets, output rows x N.
+ * @return The loss summed over the samples of the batch.
+ * @throws std::runtime_error if the target does not match the output, or cross-entropy is used
+ * on an output that is not a softmax or sigmoid Dense node.
+ */
+float Graph::calculate_loss(Matrix& target) {
+    GraphNode& out = nodes[output_node < 0 ? nodes.size() - 1 : output_node];
+    if (out.output.get_rows_num() != target.get_rows_num() || out.output.get_columns_num() != target.get_columns_num()) {
+        throw std::runtime_error("Output dimensions must match target dimensions for loss calculation.");
+    }
+    if (!out.consumers.empty()) {
+        throw std::runtime_error("The graph output must not feed other nodes.");
+    }
+    int batch = target.get_columns_num();
+    output_delta = false;
+    if (loss_function == "MSE") {
+        F.diff(out.grad, out.output, target);
+        float loss = F.MSE(out.grad) * batch; // Summed over the samples of the batch
+        F.MSE_derivative(out.grad, out.grad);
+        if (batch > 1) out.grad *= batch; // Per-sample gradients, averaged by update_weights
+        return loss;
+    }
+    if (out.op != GraphOp::Dense || (out.activation != "softmax" && out.activation != "sigmoid")) {
+        throw std::runtime_error("Cross_Entropy needs a softmax or sigmoid Dense output.");
+    }
+    output_delta = true;
+    if (out.activation == "softmax") {
+        return F.softmax_cross_entropy(out.z, target, out.output, out.delta); // delta = p - y
+    }
+    F.diff(out.delta, out.output, target);
+    return F.Cross_Entropy(out.output, target);
+}
+
+/**
+ * @brief Back-propagates the error signal set by calculate_loss() through the levels in
+ * reverse order.
+ */
+void Graph::backward() {
+    TRACE_SCOPE("graph_backward");
+    for (size_t level = levels.size(); level-- > 1;) run_level(levels[level], true);
+}
+
+/**
+ * @brief Back-propagates through one node: sums the gradient contributions of its consumers
+ * (W^T delta of a Dense consumer, the gradient of an Add, the matching rows of a Concat, the
+ * slice of a Slice) and, for a Dense node, computes delta and the parameter gradients.
+ */
+void Graph::backward_node(int id) {
+    GraphNode& node = nodes[id];
+    const long batch = batch_columns;
+    const bool loss_delta = output_delta && node.consumers.empty() && id == (output_node < 0 ? int(nodes.size()) - 1 : output_node);
+    const bool loss_grad = !output_delta && node.consumers.empty() && id == (output_node < 0 ? int(nodes.size()) - 1 : output_node);
+    if (!loss_delta && !loss_grad) node.grad.resetWithVal(0.0f);
+    for (int consumer_id : node.consumers) {
+        GraphNode& consumer = nodes[consumer_id];
+        int offset = 0; // First row of the operand in a Concat
+        for (int producer : consumer.inputs) {
+            if (producer == id) {
+                switch (consumer.op) {
+                    case GraphOp::Dense:
+                        node.partial.matrixMultiplyTransposeA(consumer.weights, consumer.delta); // W^T delta
+                        node.grad += node.partial;
+                        break;
+                    case GraphOp::Add:
+                        node.grad += consumer.grad;
+                        break;
+                    case GraphOp::Concat: {
+                        const float* src = consumer.grad.data() + long(offset) * batch;
+                        float* dst = node.grad.data();
+                        for (long e = 0; e < long(node.rows) * batch; e++) dst[e] += src[e];
+                        break;
+                    }
+                    case GraphOp::Slice: {
+                        const float* src = consumer.grad.data();
+                        float* dst = node.grad.data() + long(consumer.begin) * batch;
+                        for (long e = 0; e < long(consumer.rows) * batch; e++) dst[e] += src[e];
+                        break;
+                    }
+                    case GraphOp::Input:
+                        break;
+                }
+            }
+            offset += nodes[producer].rows;
+        }
+    }
+    if (node.op != GraphOp::Dense) return;
+
+    if (!loss_delta) {
+        if (node.activation == "softmax") {
+            node.delta.setValsFormMatrix(node.grad);
+            F.softmax_backward(node.delta, node.output);
+        }
+        else {
+            activation_derivative(F, node.activation, node.partial, node.z, node.output);
+            node.delta.elementWiseMultiply(node.grad, node.partial);
+        }
+    }
+    Matrix& input = node.inputs[0] == 0 ? *batch_input : nodes[node.inputs[0]].output;
+    node.weight_gradient.matrixMultiplyTransposeB(node.delta, input);
+    node.bias_gradient.setValsFromColumnSum(node.delta);
+}
+
+/**
+ * @brief Applies one SGD step to every Dense node with the gradients of the last backward()
+ * averaged over the batch, and refreshes the transposed weights.
+ * @param learning_rate Step size.
+ */
+void Graph::update_weights(float learning_rate) {
+    float step = -learning_rate / std::max(batch_columns, 1);
+    for (GraphNode& node : nodes) {
+        if (node.op != GraphOp::Dense) continue;
+        node.weights.addScaled(node.weight_gradient, step);
+        node.bias.addScaled(node.bias_gradient, step);
+        Tensor(node.weights).transpose(0, 1).copy_to(node.weights_t);
+    }
+}
+
+/**
+ * @brief Re-derives the transposed weights of every Dense node from its weights. forward()
+ * reads only the transposed copy, which dense() and update_weights() keep current; call this
+ * after editing weights through node().
+ */
+void Graph::refresh_weights() {
+    for (GraphNode& node : nodes) {
+        if (node.op == GraphOp::Dense) Tensor(node.weights).transpose(0, 1).copy_to(node.weights_t);
+    }
+}
+
+/**
+ * @brief Runs one training step on a batch.
+ * @param input Batch, input rows x N.
+ * @param target Targets, output rows x N.
+ * @param learning_rate Step size.
+ * @return The loss averaged over the samples of the batch.
+ */
+float Graph::train_batch(Matrix& input, Matrix& target, float learning_rate) {
+    forward(input);
+    float loss = calculate_loss(target);
+    backward();
+    update_weights(learning_rate);
+    return loss / input.get_columns_num();
+}
@@ -0,0 +1,99 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <string>
+#include <vector>
+#include "../matrix/matrix.h"
+#include "../functions/functions.h"
+
+/**
+ * @brief Operation of a Graph node.
+ */
+enum class GraphOp {
+    Input, ///< The batch given to Graph::forward.
+    Dense, ///< f(W x + b) of one input.
+    Add, ///< Element-wise sum of inputs of equal size (residual connections).
+    Concat, ///< Inputs stacked along the features (rows), in order.
+    Slice ///< Rows [begin, begin + rows) of one input; Graph::split creates one per part.
+};
+
+/**
+ * @struct GraphNode
+ * @brief One node of a Graph: its operation, its edges, its parameters and its batch buffers.
+ */
+struct GraphNode {
+    GraphOp op = GraphOp::Input; ///< Operation.
+    std::vector<int> inputs; ///< Producer nodes, in operand order.
+    std::vector<int> consumers; ///< Nodes reading this one (once per operand that refers to it).
+    int rows = 0; ///< Features of the output.
+    int level = 0; ///< 1 + the highest level of the inputs; nodes of one level are independent.
+    int begin = 0; ///< First input row of a Slice.
+    std::string activation; ///< Activation of a Dense node (ReLu, sigmoid, Tanh, linear, softmax).
+    Matrix weights{0, 0}; ///< Dense weights, rows x input rows.
+    Matrix weights_t{0, 0}; ///< W^T for the row-streaming forward GEMM; refreshed whenever the weights change.
+    Matrix bias{0, 0}; ///< Dense bias, rows x 1.
+    Matrix weight_gradient{0, 0}; ///< dL/dW summed over the last batch.
+    Matrix bias_gradient{0, 0}; ///< dL/db summed over the last batch.
+    Matrix z{0, 0}; ///< Dense pre-activation of the last batch.
+    Matrix output{0, 0}; ///< Output of the last batch, rows x N.
+    Matrix grad{0, 0}; ///< dL/doutput, summed over the consumers.
+    Matrix delta{0, 0}; ///< Dense dL/dz.
+    Matrix partial{0, 0}; ///< One consumer's contribution to grad, or the activation derivative.
+};
+
+/**
+ * @class Graph
+ * @brief Network whose layers form a directed acyclic graph instead of a chain.
+ *
+ * Nodes are added after their inputs, so the insertion order is topological. Each node gets a
+ * level one above its deepest input; forward runs the levels in order and backward in reverse,
+ * and the nodes within a level (independent branches) run concurrently, one per OpenMP thread,
+ * when the level has more than one node. Backward is pull-based: a node sums the contributions
+ * of its consumers into its own gradient, so no two nodes of a level write the same buffer.
+ * Batches have one sample per column, like ANN.
+ */
+class Graph {
+    public:
+        Graph(); ///< Empty graph.
+
+        int input(int rows); ///< Adds the input node; returns its id.
+        int dense(int from, int units, const std::string& activation); ///< Adds f(W from + b) with He-uniform weights; returns its id.
+        int add(const std::vector<int>& from); ///< Adds the sum of nodes of equal size; returns its id.
+        int concat(const std::vector<int>& from); ///< Adds the row-wise concatenation of nodes; returns its id.
+        std::vector<int> split(int from, const std::vector<int>& sizes); ///< Adds consecutive row slices of a node; returns their ids.
+        void set_output(int node); ///< Selects the node compared with the targets (the last node by default).
+        void set_loss(const std::string& loss_function); ///< MSE or Cross_Entropy (on a softmax or sigmoid Dense output).
+        void set_parallel_branches(bool enabled); ///< Runs the nodes of a level concurrently (default) or one after the other.
+
+        Matrix& forward(Matrix& input); ///< Runs all nodes on a batch; returns the output node's values.
+        float calculate_loss(Matrix& target); ///< Loss summed over the batch; sets the output gradient.
+        void backward(); ///< Sets the gradients of every Dense node (summed over the batch).
+        void update_weights(float learning_rate); ///< SGD step with the gradients averaged over the batch.
+        void refresh_weights(); ///< Re-derives the transposed weights after Dense weights were edited through node().
+        float train_batch(Matrix& input, Matrix& target, float learning_rate); ///< forward, loss, backward and update; returns the mean loss.
+
+        int node_count() const { return int(nodes.size()); } ///< Number of nodes.
+        int level_count() const { return int(levels.size()); } ///< Number of levels (the input is level 0).
+        const std::vector<int>& level_nodes(int level) const { return levels[level]; } ///< Nodes that run together.
+        GraphNode& node(int id); ///< Node by id (weights, gradients and outputs of the last batch).
+
+    private:
+        int add_node(GraphOp op, const std::vector<int>& from, int rows); ///< Appends a node and links its edges.
+        void check_node(int id) const; ///< Throws if id is not a node.
+        void run_level(const std::vector<int>& level, bool backward); ///< Runs forward_node or backward_node on each node of a level.
+        void prepare(int batch); ///< Sizes every node's buffers for the batch.
+        void forward_node(int id);
+        void backward_node(int id);
+
+        Functions F; ///< Activations, losses and their derivatives.
+        std::vector<GraphNode> nodes; ///< Nodes in insertion (topological) order.
+        std::vector<std::vector<int>> levels; ///< Node ids per level.
+        int output_node; ///< Node compared with the targets (-1: the last node).
+        std::string loss_function; ///< MSE or Cross_Entropy.
+        bool parallel_branches; ///< Whether the nodes of a level run concurrently.
+        bool output_delta; ///< The loss set dL/dz of the output node directly (softmax or sigmoid cross-entropy).
+        int batch_columns; ///< Samples of the last forward pass.
+        Matrix* batch_input; ///< Input of the last forward pass.
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "inference_model.h"
+#include "../matrix/tensor.h"
+#include "../profiling/trace.h"
+#include <algorithm>
+#include <stdexcept>
+
+static constexpr int small_batch = 64; // Below this many samples the layer products run sample-major
+
+/**
+ * @brief Applies an activation in place; softmax normalizes each column (sample). Functions
+ * holds no state, so a local instance keeps InferenceModel::predict const.
+ */
+static void apply_activation(const std::string& name, Matrix& m) {
+    Functions F;
+    if (name == "ReLu") F.ReLu(m);
+    else if (name == "sigmoid") F.sigmoid(m);
+    else if (name == "Tanh") F.Tanh(m);
+    else if (name == "softmax") F.softmax_columns(m);
+    else F.linear(m);
+}
+
+/**
+ * @brief Returns the bytes of activation storage held by the workspace.
+ */
+long unsigned InferenceWorkspace::bytes() const {
+    long unsigned elements = transposed_capacity;
+    for (long reserved : capacity) elements += reserved;
+    return elements * sizeof(float);
+}
+
+/**
+ * @brief Copies the parameters of a trained network. BatchNorm layers are folded into the copied
+ * weights and biases with their running statistics; the network itself is not changed.
+ * @param ann Trained network.
+ * @throws std::runtime_error if the network uses an embedding or a LayerNorm, which have no
+ * inference-only form here.
+ */
+InferenceModel::InferenceModel(ANN& ann) {
+    if (ann.embedding) {
+        throw std::runtime_error("InferenceModel does not support input embeddings.");
+    }
+    layer_sizes.push_back(ann.weights[0].get_columns_num());
+    for (size_t i = 0; i < ann.weights.size(); i++) {
+        Matrix weights = ann.weights[i];
+        Matrix bias = ann.biases[i];
+        if (ann.norms[i]) {
+            if (ann.norms[i]->get_type() != NormType::BatchNorm) {
+                throw std::runtime_error("InferenceModel supports only BatchNorm, which it folds into the weights.");
+            }
+            ann.norms[i]->fold_into(weights, bias);
+        }
+        Matrix transposed(weights.get_columns_num(), weights.get_rows_num());
+        Tensor(weights).transpose(0, 1).copy_to(transposed);
+        weights_t.push_back(transposed);
+        biases.push_back(bias);
+        activations.push_back(ann.activation_names[i]);
+        layer_sizes.push_back(weights.get_rows_num());
+    }
+
+    // Layer i writes hidden value i and layer i + 1 reads it; the last layer writes the caller's output.
+    std::vector<BufferLifetime> hidden;
+    for (int i = 0; i + 1 < num_layers(); i++) hidden.push_back(BufferLifetime{layer_sizes[i + 1], i, i + 1});
+    plan = plan_buffers(hidden);
+}
+
+/**
+ * @brief Returns the bytes of the weights and biases.
+ */
+long unsigned InferenceModel::model_bytes() const {
+    long unsigned elements = 0;
+    for (int i = 0; i < num_layers(); i++) elements += (long unsigned)(layer_sizes[i] + 1) * layer_sizes[i + 1];
+    return elements * sizeof(float);
+}
+
+/**
+ * @brief Returns the bytes of activation storage a workspace needs for a batch.
+ * @param batch Samples per request.
+ */
+long unsigned InferenceModel::workspace_bytes(int batch) const {
+    long transposed = batch > 1 && batch < small_batch ? widest_layer() : 0;
+    return (long unsigned)(plan.total_size() + transposed) * batch * sizeof(float);
+}
+
+/**
+ * @brief Reserves every slot of the plan for a batch, and the sample-major product of small
+ * batches. Buffers keep their storage when a later batch is smaller, so steady-state requests
+ * do not allocate.
+ */
+void InferenceModel::prepare(InferenceWorkspace& workspace, int batch) const {
+    while (workspace.buffers.size() < plan.slot_size.size()) {
+        workspace.buffers.push_back(Matrix(0, 0));
+        workspace.capacity.push_back(0);
+    }
+    for (size_t s = 0; s < plan.slot_size.size(); s++) {
+        long needed = plan.slot_size[s] * batch;
+        if (needed <= workspace.capacity[s]) continue;
+        workspace.buffers[s].resize(int(plan.slot_size[s]), batch);
+        workspace.capacity[s] = needed;
+    }
+    long transposed = batch > 1 && batch < small_batch ? long(widest_layer()) * batch : 0;
+    if (transposed > workspace.transposed_capacity) {
+        workspace.transposed.resize(widest_layer(), batch);
+        workspace.transposed_capacity = transposed;
+    }
+}
+
+/**
+ * @brief Returns the outputs of the widest layer.
+ */
+int InferenceModel::widest_layer() const {
+    return *std::max_element(layer_sizes.begin() + 1, layer_sizes.end());
+}
+
+/**
+ * @brief Forward pass of a batch. The model is only read (the method is const), so requests
+ * with different workspaces may run concurrently.
+ * @param input Input matrix (input size x batch), one sample per column.
+ * @param output Matrix receiving the network outputs (output size x batch).
+ * @param workspace Activation buffers of this request.
+ * @throws std::runtime_error if the input or output dimensions do not match.
+ */
+void InferenceModel::predict(Matrix& input, Matrix& output, InferenceWorkspace& workspace) const {
+    TRACE_SCOPE("inference_predict");
+    const int batch = input.get_columns_num();
+    if (input.get_rows_num() != input_size()) {
+        throw std::runtime_error("Input dimensions do not match the input layer size.");
+    }
+    if (output.get_rows_num() != output_size() || output.get_columns_num() != batch) {
+        throw std::runtime_error("Output dimensions do not match the output layer size and batch.");
+    }
+    prepare(workspace, batch);
+    Matrix* in = &input;
+    for (int i = 0; i < num_layers(); i++) {
+        Matrix& out = i + 1 == num_layers() ? output : workspace.buffers[plan.slot[i]];
+        if (batch >= small_batch) {
+            out.resize(layer_sizes[i + 1], batch); // Within the slot's reserved storage
+            out.matrixMultiplyTransposeA(weights_t[i], *in);
+        }
+        else {
+            // X^T W^T streams the rows of W^T with the outputs as the inner loop, where W^T X
+            // would run an inner loop of batch. A 1 x n row has the storage of an n x 1 column,
+            // so a single sample needs no transpose.
+            Matrix& sample_major = batch == 1 ? out : workspace.transposed;
+            sample_major.resize(batch, layer_sizes[i + 1]);
+            sample_major.matrixMultiplyTransposeA(*in, weights_t[i]);
+            if (batch == 1) out.resize(layer_sizes[i + 1], 1);
+            else Tensor(sample_major).transpose(0, 1).copy_to(out);
+        }
+        out.addColumnVector(biases[i]);
+        apply_activation(activations[i], out);
+        in = &out;
+    }
+}
+
+/**
+ * @brief Forward pass of a batch with the model's own workspace.
+ * @param input Input matrix (input size x batch), one sample per column.
+ * @param output Matrix receiving the network outputs (output size x batch).
+ * @throws std::runtime_error if the input or output dimensions do not match.
+ */
+void InferenceModel::predict(Matrix& input, Matrix& output) {
+    predict(input, output, own_workspace);
+}
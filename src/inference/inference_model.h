@@ -0,0 +1,66 @@
+#ifndef INFERENCE_MODEL_H
+#define INFERENCE_MODEL_H
+
+#include <string>
+#include <vector>
+#include "../matrix/matrix.h"
+#include "../ann/ann.h"
+#include "memory_plan.h"
+
+/**
+ * @class InferenceWorkspace
+ * @brief Activation buffers of one in-flight request to an InferenceModel.
+ *
+ * A model is read-only during predict, so concurrent requests share one model and each brings
+ * its own workspace. The buffers grow to the largest batch seen and are reused afterwards.
+ */
+class InferenceWorkspace {
+    public:
+        InferenceWorkspace() = default; ///< Empty workspace; sized by the first predict.
+        long unsigned bytes() const; ///< Bytes of activation storage held.
+
+    private:
+        friend class InferenceModel;
+        std::vector<Matrix> buffers; ///< One matrix per slot of the model's memory plan.
+        std::vector<long> capacity; ///< Elements reserved per buffer.
+        Matrix transposed{0, 0}; ///< Sample-major layer output of batches of 2 to 63 samples.
+        long transposed_capacity = 0; ///< Elements reserved in transposed.
+};
+
+/**
+ * @class InferenceModel
+ * @brief Inference-only copy of a trained ANN: weights, biases and activations, and no gradient,
+ * error-signal or per-layer activation state.
+ *
+ * The hidden-layer outputs of a forward pass are assigned to shared buffers by plan_buffers():
+ * layer i reads the output of layer i - 1 and writes its own, so two ping-pong buffers sized to
+ * the widest hidden layers of alternate depth hold all of them, and the last layer writes into
+ * the caller's output. Inference-mode BatchNorm is folded into the copied weights.
+ */
+class InferenceModel {
+    public:
+        explicit InferenceModel(ANN& ann); ///< Copies the parameters of a trained network.
+
+        void predict(Matrix& input, Matrix& output, InferenceWorkspace& workspace) const; ///< Forward pass of a batch of column samples with the buffers of one request.
+        void predict(Matrix& input, Matrix& output); ///< Forward pass with the model's own workspace.
+
+        int input_size() const { return layer_sizes.front(); } ///< Features of an input sample.
+        int output_size() const { return layer_sizes.back(); } ///< Outputs of a sample.
+        int num_layers() const { return int(layer_sizes.size()) - 1; } ///< Weight layers.
+        const MemoryPlan& memory_plan() const { return plan; } ///< Slots of the hidden-layer outputs.
+        long unsigned model_bytes() const; ///< Bytes of parameter storage (weights and biases).
+        long unsigned workspace_bytes(int batch) const; ///< Bytes of activation storage one request needs for a batch.
+
+    private:
+        void prepare(InferenceWorkspace& workspace, int batch) const; ///< Reserves the plan's slots for a batch.
+        int widest_layer() const; ///< Outputs of the widest layer.
+
+        std::vector<int> layer_sizes; ///< Input size, then the outputs of every layer.
+        std::vector<Matrix> weights_t; ///< W^T per layer (inputs x outputs) for the row-streaming GEMM.
+        std::vector<Matrix> biases; ///< Bias per layer.
+        std::vector<std::string> activations; ///< Activation per layer.
+        MemoryPlan plan; ///< Slot of every hidden-layer output.
+        InferenceWorkspace own_workspace; ///< Buffers of predict(input, output).
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "memory_plan.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+/**
+ * @brief Returns the elements per sample over all slots of the plan.
+ */
+long MemoryPlan::total_size() const {
+    return std::accumulate(slot_size.begin(), slot_size.end(), 0L);
+}
+
+/**
+ * @brief Assigns values to buffers so that no two values live at the same step share one.
+ * Values are placed in order of their first step; a value takes the smallest free slot that
+ * already fits it, else the largest free slot (which grows), else a new slot. A layer chain,
+ * where step i reads value i - 1 and writes value i, gets two ping-pong slots.
+ * @param values Size and live range of every value.
+ * @return The slot of every value and the size of every slot.
+ * @throws std::runtime_error if a value has a negative size or ends before it starts.
+ */
+MemoryPlan plan_buffers(const std::vector<BufferLifetime>& values) {
+    for (const BufferLifetime& value : values) {
+        if (value.size < 0 || value.last < value.first) {
+            throw std::runtime_error("Buffer lifetimes must have a non-negative size and end after they start.");
+        }
+    }
+    std::vector<int> order(values.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return values[a].first < values[b].first; });
+
+    MemoryPlan plan;
+    plan.slot.assign(values.size(), -1);
+    std::vector<int> busy_until; // Last step of the value each slot holds
+    for (int v : order) {
+        const BufferLifetime& value = values[v];
+        int fitting = -1; // Smallest free slot that holds the value
+        int largest = -1; // Largest free slot
+        for (int s = 0; s < int(plan.slot_size.size()); s++) {
+            if (busy_until[s] >= value.first) continue;
+            if (plan.slot_size[s] >= value.size && (fitting < 0 || plan.slot_size[s] < plan.slot_size[fitting])) fitting = s;
+            if (largest < 0 || plan.slot_size[s] > plan.slot_size[largest]) largest = s;
+        }
+        int s = fitting >= 0 ? fitting : largest;
+        if (s < 0) {
+            s = int(plan.slot_size.size());
+            plan.slot_size.push_back(0);
+            busy_until.push_back(0);
+        }
+        plan.slot_size[s] = std::max(plan.slot_size[s], value.size);
+        busy_until[s] = value.last;
+        plan.slot[v] = s;
+    }
+    return plan;
+}
@@ -0,0 +1,27 @@
+#ifndef MEMORY_PLAN_H
+#define MEMORY_PLAN_H
+
+#include <vector>
+
+/**
+ * @brief Size and live range of one intermediate value of a static execution order.
+ */
+struct BufferLifetime {
+    long size = 0; ///< Elements per sample.
+    int first = 0; ///< Step that writes the value.
+    int last = 0; ///< Last step that reads it (the value is live in [first, last]).
+};
+
+/**
+ * @struct MemoryPlan
+ * @brief Assignment of values to shared buffers: values whose live ranges do not overlap share a slot.
+ */
+struct MemoryPlan {
+    std::vector<int> slot; ///< Slot of every value, in the order the values were given.
+    std::vector<long> slot_size; ///< Elements per sample of every slot (the largest value it holds).
+    long total_size() const; ///< Elements per sample over all slots.
+};
+
+MemoryPlan plan_buffers(const std::vector<BufferLifetime>& values); ///< Greedy interval assignment of values to reused slots.
+
+#endif
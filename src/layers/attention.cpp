@@ -0,0 +1,406 @@
+#include "attention.h"
+#include "../functions/fast_math.h"
+#include "../matrix/tensor.h"
+#include "../profiling/perf_counters.h"
+#include "../random/philox.h"
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+static constexpr int query_block = 32; // Queries per tile: rows of the score tile and of the output accumulator
+static constexpr int key_block = 128; // Keys per tile: the score tile stays in L1 (16 KB)
+
+/**
+ * @brief Creates the layer with uniform weights drawn from the global seed and zero biases.
+ * @param model_dim Rows of the input and output.
+ * @param heads Number of heads; must divide model_dim.
+ * @throws std::runtime_error if a size is not positive or heads does not divide model_dim.
+ */
+MultiHeadAttention::MultiHeadAttention(int model_dim, int heads)
+    : model_dim(model_dim), heads(heads), algorithm(AttentionAlgorithm::Blocked), seq_len(0), batch(0), qkv_weights(0, 0),
+      qkv_bias(0, 0), output_weights(0, 0), output_bias(0, 0), qkv_weight_gradient(0, 0), qkv_bias_gradient(0, 0),
+      output_weight_gradient(0, 0), output_bias_gradient(0, 0), qkv_weights_t(0, 0), output_weights_t(0, 0), qkv(0, 0),
+      context(0, 0), log_sum_exp(0, 0), scores(0, 0), context_gradient(0, 0), qkv_gradient(0, 0) {
+    if (model_dim <= 0 || heads <= 0 || model_dim % heads != 0) {
+        throw std::runtime_error("Attention heads must divide a positive model dimension.");
+    }
+    qkv_weights.resize(3 * model_dim, model_dim);
+    qkv_bias.resize(3 * model_dim, 1);
+    output_weights.resize(model_dim, model_dim);
+    output_bias.resize(model_dim, 1);
+    qkv_weight_gradient.resize(3 * model_dim, model_dim);
+    qkv_bias_gradient.resize(3 * model_dim, 1);
+    output_weight_gradient.resize(model_dim, model_dim);
+    output_bias_gradient.resize(model_dim, 1);
+    for (Matrix* m : {&qkv_bias, &output_bias, &qkv_weight_gradient, &qkv_bias_gradient, &output_weight_gradient, &output_bias_gradient}) {
+        m->resetWithVal(0.0f);
+    }
+    float limit = 1.0f / std::sqrt(float(model_dim));
+    PhiloxStream rng(random_seed(), next_random_stream());
+    long qkv_count = long(long(qkv_weights.get_rows_num()) * qkv_weights.get_columns_num());
+    rng.fill_uniform(0, qkv_count, qkv_weights.data(), -limit, limit);
+    rng.fill_uniform(uint64_t(qkv_count), long(long(output_weights.get_rows_num()) * output_weights.get_columns_num()), output_weights.data(), -limit, limit);
+}
+
+/**
+ * @brief Selects the attention kernel. Both compute the same values; Materialized stores the
+ * N * heads * seq^2 probabilities and is kept as the baseline of the blocked kernel.
+ * @param algorithm Blocked or Materialized.
+ */
+void MultiHeadAttention::set_algorithm(AttentionAlgorithm algorithm) {
+    this->algorithm = algorithm;
+}
+
+/**
+ * @brief Returns the FLOPs of one forward pass: the Q/K/V and output projections plus Q K^T and
+ * P V of every head.
+ * @param seq_len Positions per sample.
+ * @param batch Samples in the batch.
+ */
+double MultiHeadAttention::flops(int seq_len, int batch) const {
+    double columns = double(seq_len) * batch;
+    return 2.0 * 4.0 * model_dim * double(model_dim) * columns + 4.0 * double(seq_len) * seq_len * model_dim * batch;
+}
+
+/**
+ * @brief Sizes the buffers for seq_len x batch. Matrix::resize and std::vector::resize keep the
+ * storage when the size does not grow.
+ */
+void MultiHeadAttention::prepare(int seq_len, int batch) {
+    this->seq_len = seq_len;
+    this->batch = batch;
+    const int columns = seq_len * batch;
+    qkv.resize(3 * model_dim, columns);
+    context.resize(model_dim, columns);
+    log_sum_exp.resize(heads, columns);
+    if (algorithm == AttentionAlgorithm::Materialized) scores.resize(batch * heads * seq_len, seq_len);
+    scratch.resize(size_t(omp_get_max_threads()) * (2 * query_block * key_block + query_block * head_dim() + 2 * query_block));
+}
+
+/**
+ * @brief Writes scale * Q K^T of one tile into s (row stride key_block): queries q[0, qn) and
+ * keys k[0, kn), where row d of Q and K (d < dim) starts stride floats after row d - 1.
+ */
+static void score_tile(const float* q, const float* k, long stride, int dim, int qn, int kn, float scale, float* s) {
+    for (int i = 0; i < qn; i++) std::fill(s + i * key_block, s + i * key_block + kn, 0.0f);
+    for (int d = 0; d < dim; d++) {
+        const float* q_row = q + d * stride;
+        const float* __restrict__ k_row = k + d * stride;
+        for (int i = 0; i < qn; i++) {
+            const float qv = q_row[i] * scale;
+            float* __restrict__ s_row = s + i * key_block;
+            #pragma omp simd
+            for (int j = 0; j < kn; j++) s_row[j] += qv * k_row[j];
+        }
+    }
+}
+
+/**
+ * @brief Runs self-attention over a batch of sequences: Q, K, V = W_qkv x + b_qkv as one GEMM,
+ * softmax(Q K^T / sqrt(head_dim)) V per head and sample, then W_o context + b_o.
+ * @param input Sequences, model_dim x (N * seq), column n * seq + t = position t of sample n.
+ * @param output Receives model_dim x (N * seq); resized.
+ * @param seq_len Positions per sample.
+ * @throws std::runtime_error if the input does not match model_dim and seq_len.
+ */
+void MultiHeadAttention::forward(const Matrix& input, Matrix& output, int seq_len) {
+    if (seq_len <= 0 || input.get_rows_num() != model_dim || input.get_columns_num() % seq_len != 0) {
+        throw std::runtime_error("Attention input must be model_dim x (batch * seq_len).");
+    }
+    prepare(seq_len, input.get_columns_num() / seq_len);
+    Tensor(qkv_weights).transpose(0, 1).copy_to(qkv_weights_t);
+    Tensor(output_weights).transpose(0, 1).copy_to(output_weights_t);
+
+    qkv.matrixMultiplyTransposeA(qkv_weights_t, input);
+    qkv.addColumnVector(qkv_bias);
+    if (algorithm == AttentionAlgorithm::Blocked) blocked_forward();
+    else materialized_forward();
+    output.resize(model_dim, input.get_columns_num());
+    output.matrixMultiplyTransposeA(output_weights_t, context);
+    output.addColumnVector(output_bias);
+}
+
+/**
+ * @brief Online-softmax attention. A work item is one query tile of one head of one sample; for
+ * each key tile it computes the scores, raises the running maximum of every query, rescales the
+ * running sum and output accumulator by exp(old max - new max) and adds the tile's P V. Each
+ * query's output is divided by its sum once at the end, and max + log(sum) is kept for backward.
+ */
+void MultiHeadAttention::blocked_forward() {
+    const int dim = head_dim();
+    const long columns = long(seq_len) * batch;
+    const long query_tiles = (seq_len + query_block - 1) / query_block;
+    const long work = long(batch) * heads * query_tiles;
+    const long per_thread = long(scratch.size()) / omp_get_max_threads();
+    const float scale = 1.0f / std::sqrt(float(dim));
+    const float* values = qkv.data();
+    float* out = context.data();
+    float* lse = log_sum_exp.data();
+    float* tiles = scratch.data();
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("MultiHeadAttention::blocked_forward", double(model_dim) * columns);
+        float* s_tile = tiles + omp_get_thread_num() * per_thread;
+        float* acc = s_tile + 2 * query_block * key_block;
+        float* row_max = acc + query_block * dim;
+        float* row_sum = row_max + query_block;
+        #pragma omp for nowait
+        for (long item = 0; item < work; item++) {
+            const long pair = item / query_tiles;
+            const int h = int(pair % heads);
+            const long first = (pair / heads) * seq_len; // first column of the sample
+            const int q0 = int(item % query_tiles) * query_block;
+            const int qn = std::min(query_block, seq_len - q0);
+            const float* q = values + long(h) * dim * columns + first;
+            const float* k = values + (long(model_dim) + long(h) * dim) * columns + first;
+            const float* v = values + (2L * model_dim + long(h) * dim) * columns + first;
+            std::fill(acc, acc + qn * dim, 0.0f);
+            std::fill(row_max, row_max + qn, std::numeric_limits<float>::lowest());
+            std::fill(row_sum, row_sum + qn, 0.0f);
+            for (int k0 = 0; k0 < seq_len; k0 += key_block) {
+                const int kn = std::min(key_block, seq_len - k0);
+                score_tile(q + q0, k + k0, columns, dim, qn, kn, scale, s_tile);
+                for (int i = 0; i < qn; i++) {
+                    float* __restrict__ s = s_tile + i * key_block;
+                    float m = row_max[i];
+                    #pragma omp simd reduction(max:m)
+                    for (int j = 0; j < kn; j++) m = s[j] > m ? s[j] : m;
+                    const float correction = exp_approx(row_max[i] - m); // 0 on the first tile
+                    float sum = 0.0f;
+                    #pragma omp simd reduction(+:sum)
+                    for (int j = 0; j < kn; j++) {
+                        s[j] = exp_approx(s[j] - m);
+                        sum += s[j];
+                    }
+                    row_sum[i] = row_sum[i] * correction + sum;
+                    row_max[i] = m;
+                    float* a = acc + i * dim;
+                    for (int d = 0; d < dim; d++) {
+                        const float* __restrict__ v_row = v + d * columns + k0;
+                        float dot = 0.0f;
+                        #pragma omp simd reduction(+:dot)
+                        for (int j = 0; j < kn; j++) dot += s[j] * v_row[j];
+                        a[d] = a[d] * correction + dot;
+                    }
+                }
+            }
+            for (int d = 0; d < dim; d++) {
+                float* out_row = out + (long(h) * dim + d) * columns + first + q0;
+                for (int i = 0; i < qn; i++) out_row[i] = acc[i * dim + d] / row_sum[i];
+            }
+            float* lse_row = lse + long(h) * columns + first + q0;
+            for (int i = 0; i < qn; i++) lse_row[i] = row_max[i] + std::log(row_sum[i]);
+        }
+    }
+}
+
+/**
+ * @brief Reference attention: writes the full seq x seq probability matrix of every head and
+ * sample into scores, then multiplies it by V. Same results as blocked_forward().
+ */
+void MultiHeadAttention::materialized_forward() {
+    const int dim = head_dim();
+    const long columns = long(seq_len) * batch;
+    const long pairs = long(batch) * heads;
+    const long seq = seq_len;
+    const float scale = 1.0f / std::sqrt(float(dim));
+    const float* values = qkv.data();
+    float* probabilities = scores.data();
+    float* out = context.data();
+    float* lse = log_sum_exp.data();
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("MultiHeadAttention::materialized_forward", double(model_dim) * columns);
+        #pragma omp for nowait
+        for (long pair = 0; pair < pairs; pair++) {
+            const int h = int(pair % heads);
+            const long first = (pair / heads) * seq;
+            const float* q = values + long(h) * dim * columns + first;
+            const float* k = values + (long(model_dim) + long(h) * dim) * columns + first;
+            const float* v = values + (2L * model_dim + long(h) * dim) * columns + first;
+            float* p = probabilities + pair * seq * seq;
+            std::fill(p, p + seq * seq, 0.0f);
+            for (int d = 0; d < dim; d++) {
+                const float* __restrict__ k_row = k + d * columns;
+                for (long i = 0; i < seq; i++) {
+                    const float qv = q[d * columns + i] * scale;
+                    float* __restrict__ row = p + i * seq;
+                    #pragma omp simd
+                    for (long j = 0; j < seq; j++) row[j] += qv * k_row[j];
+                }
+            }
+            for (long i = 0; i < seq; i++) {
+                float* __restrict__ row = p + i * seq;
+                float m = std::numeric_limits<float>::lowest();
+                #pragma omp simd reduction(max:m)
+                for (long j = 0; j < seq; j++) m = row[j] > m ? row[j] : m;
+                float sum = 0.0f;
+                #pragma omp simd reduction(+:sum)
+                for (long j = 0; j < seq; j++) {
+                    row[j] = exp_approx(row[j] - m);
+                    sum += row[j];
+                }
+                const float inv_sum = 1.0f / sum;
+                #pragma omp simd
+                for (long j = 0; j < seq; j++) row[j] *= inv_sum;
+                lse[long(h) * columns + first + i] = m + std::log(sum);
+            }
+            for (int d = 0; d < dim; d++) {
+                const float* __restrict__ v_row = v + d * columns;
+                float* out_row = out + (long(h) * dim + d) * columns + first;
+                for (long i = 0; i < seq; i++) {
+                    const float* __restrict__ row = p + i * seq;
+                    float dot = 0.0f;
+                    #pragma omp simd reduction(+:dot)
+                    for (long j = 0; j < seq; j++) dot += row[j] * v_row[j];
+                    out_row[i] = dot;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Back-propagates through the layer. The output projection and its gradients are GEMMs;
+ * the attention gradients are computed tile by tile from the recomputed scores and the stored
+ * log-sum-exp (the same for both kernels); the Q/K/V projection gradients are GEMMs again.
+ * @param input Input of the last forward pass.
+ * @param grad_output dL/doutput, model_dim x (N * seq).
+ * @param grad_input If not null, receives dL/dinput; resized.
+ * @throws std::runtime_error if the shapes do not match the last forward pass.
+ */
+void MultiHeadAttention::backward(const Matrix& input, const Matrix& grad_output, Matrix* grad_input) {
+    const int columns = seq_len * batch;
+    if (seq_len == 0 || input.get_rows_num() != model_dim || input.get_columns_num() != columns || grad_output.get_rows_num() != model_dim ||
+        grad_output.get_columns_num() != columns) {
+        throw std::runtime_error("Attention gradient does not match the last forward pass.");
+    }
+    output_weight_gradient.matrixMultiplyTransposeB(grad_output, context);
+    output_bias_gradient.setValsFromColumnSum(grad_output);
+    context_gradient.resize(model_dim, columns);
+    context_gradient.matrixMultiplyTransposeA(output_weights, grad_output);
+    qkv_gradient.resize(3 * model_dim, columns);
+    blocked_backward();
+    qkv_weight_gradient.matrixMultiplyTransposeB(qkv_gradient, input);
+    qkv_bias_gradient.setValsFromColumnSum(qkv_gradient);
+    if (grad_input) {
+        grad_input->resize(model_dim, columns);
+        grad_input->matrixMultiplyTransposeA(qkv_weights, qkv_gradient);
+    }
+}
+
+/**
+ * @brief Tiled attention backward, one work item per head and sample (dK and dV sum over all
+ * query tiles). Per tile: P = exp(S - lse), dV += P^T dO, dP = dO V^T,
+ * dS = P (dP - rowsum(dO * O)) / sqrt(head_dim), dQ += dS K and dK += dS^T Q.
+ */
+void MultiHeadAttention::blocked_backward() {
+    const int dim = head_dim();
+    const long columns = long(seq_len) * batch;
+    const long pairs = long(batch) * heads;
+    const long per_thread = long(scratch.size()) / omp_get_max_threads();
+    const float scale = 1.0f / std::sqrt(float(dim));
+    const float* values = qkv.data();
+    const float* out = context.data();
+    const float* out_grad = context_gradient.data();
+    const float* lse = log_sum_exp.data();
+    float* grads = qkv_gradient.data();
+    float* tiles = scratch.data();
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("MultiHeadAttention::blocked_backward", 3.0 * model_dim * columns);
+        float* p_tile = tiles + omp_get_thread_num() * per_thread;
+        float* dp_tile = p_tile + query_block * key_block;
+        float* delta = dp_tile + query_block * key_block;
+        #pragma omp for nowait
+        for (long pair = 0; pair < pairs; pair++) {
+            const int h = int(pair % heads);
+            const long first = (pair / heads) * seq_len;
+            const long q_offset = long(h) * dim * columns + first;
+            const long k_offset = (long(model_dim) + long(h) * dim) * columns + first;
+            const long v_offset = (2L * model_dim + long(h) * dim) * columns + first;
+            const float* q = values + q_offset;
+            const float* k = values + k_offset;
+            const float* v = values + v_offset;
+            const float* o = out + q_offset; // context rows match the Q rows of the head
+            const float* d_o = out_grad + q_offset;
+            const float* pair_lse = lse + long(h) * columns + first;
+            float* dq = grads + q_offset;
+            float* dk = grads + k_offset;
+            float* dv = grads + v_offset;
+            for (int d = 0; d < dim; d++) {
+                std::fill(dq + d * columns, dq + d * columns + seq_len, 0.0f);
+                std::fill(dk + d * columns, dk + d * columns + seq_len, 0.0f);
+                std::fill(dv + d * columns, dv + d * columns + seq_len, 0.0f);
+            }
+            for (int q0 = 0; q0 < seq_len; q0 += query_block) {
+                const int qn = std::min(query_block, seq_len - q0);
+                std::fill(delta, delta + qn, 0.0f);
+                for (int d = 0; d < dim; d++) {
+                    for (int i = 0; i < qn; i++) delta[i] += d_o[d * columns + q0 + i] * o[d * columns + q0 + i];
+                }
+                for (int k0 = 0; k0 < seq_len; k0 += key_block) {
+                    const int kn = std::min(key_block, seq_len - k0);
+                    score_tile(q + q0, k + k0, columns, dim, qn, kn, scale, p_tile);
+                    for (int i = 0; i < qn; i++) {
+                        float* __restrict__ p = p_tile + i * key_block;
+                        const float offset = pair_lse[q0 + i];
+                        #pragma omp simd
+                        for (int j = 0; j < kn; j++) p[j] = exp_approx(p[j] - offset);
+                        std::fill(dp_tile + i * key_block, dp_tile + i * key_block + kn, 0.0f);
+                    }
+                    for (int d = 0; d < dim; d++) {
+                        const float* __restrict__ v_row = v + d * columns + k0;
+                        float* __restrict__ dv_row = dv + d * columns + k0;
+                        for (int i = 0; i < qn; i++) {
+                            const float g = d_o[d * columns + q0 + i];
+                            const float* __restrict__ p = p_tile + i * key_block;
+                            float* __restrict__ dp = dp_tile + i * key_block;
+                            #pragma omp simd
+                            for (int j = 0; j < kn; j++) {
+                                dv_row[j] += g * p[j];
+                                dp[j] += g * v_row[j];
+                            }
+                        }
+                    }
+                    for (int i = 0; i < qn; i++) {
+                        const float* __restrict__ p = p_tile + i * key_block;
+                        float* __restrict__ ds = dp_tile + i * key_block;
+                        const float row_delta = delta[i];
+                        #pragma omp simd
+                        for (int j = 0; j < kn; j++) ds[j] = p[j] * (ds[j] - row_delta) * scale;
+                    }
+                    for (int d = 0; d < dim; d++) {
+                        const float* __restrict__ k_row = k + d * columns + k0;
+                        float* __restrict__ dk_row = dk + d * columns + k0;
+                        for (int i = 0; i < qn; i++) {
+                            const float* __restrict__ ds = dp_tile + i * key_block;
+                            const float qv = q[d * columns + q0 + i];
+                            float dot = 0.0f;
+                            #pragma omp simd reduction(+:dot)
+                            for (int j = 0; j < kn; j++) {
+                                dot += ds[j] * k_row[j];
+                                dk_row[j] += qv * ds[j];
+                            }
+                            dq[d * columns + q0 + i] += dot;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Applies one SGD step, weights -= learning_rate * gradient. The gradients are sums over
+ * the batch and the positions.
+ * @param learning_rate Step size.
+ */
+void MultiHeadAttention::update_weights(float learning_rate) {
+    qkv_weights.addScaled(qkv_weight_gradient, -learning_rate);
+    qkv_bias.addScaled(qkv_bias_gradient, -learning_rate);
+    output_weights.addScaled(output_weight_gradient, -learning_rate);
+    output_bias.addScaled(output_bias_gradient, -learning_rate);
+}
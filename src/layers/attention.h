@@ -0,0 +1,77 @@
+#ifndef ATTENTION_H
+#define ATTENTION_H
+
+#include "../matrix/matrix.h"
+#include <vector>
+
+/**
+ * @brief Kernel used by MultiHeadAttention for softmax(Q K^T / sqrt(head_dim)) V.
+ */
+enum class AttentionAlgorithm {
+    Blocked, ///< Query x key tiles with an online softmax; scores never leave the tile.
+    Materialized ///< Full seq x seq score matrix per head and sample, then softmax and a product with V.
+};
+
+/**
+ * @class MultiHeadAttention
+ * @brief Multi-head self-attention layer over a batch of sequences.
+ *
+ * A sequence batch is a model_dim x (N * seq) matrix whose column n * seq + t holds position t of
+ * sample n, so the positions of one sample are contiguous in every row. Q, K and V come from one
+ * GEMM with their weights stacked (3 * model_dim rows); the output projection is a second GEMM.
+ * The Blocked kernel keeps, per query, the running maximum and sum of the softmax and rescales
+ * its accumulated output when a later key tile raises the maximum, so memory is O(seq) per head
+ * instead of O(seq^2). Backward recomputes the score tiles from the stored log-sum-exp.
+ */
+class MultiHeadAttention {
+    public:
+        MultiHeadAttention(int model_dim, int heads); ///< Uniform(-1/sqrt(model_dim), 1/sqrt(model_dim)) weights, zero biases.
+
+        void forward(const Matrix& input, Matrix& output, int seq_len); ///< output (model_dim x (N * seq)) = W_o attention(input) + b_o.
+        void backward(const Matrix& input, const Matrix& grad_output, Matrix* grad_input); ///< Sets the gradients (summed over the batch) and optionally grad_input.
+        void update_weights(float learning_rate); ///< Applies one SGD step with the current gradients.
+
+        void set_algorithm(AttentionAlgorithm algorithm); ///< Selects the attention kernel (Blocked by default).
+        int get_heads() const { return heads; } ///< Number of heads.
+        int head_dim() const { return model_dim / heads; } ///< Rows of Q, K and V per head.
+        Matrix& get_qkv_weights() { return qkv_weights; } ///< Stacked W_q, W_k, W_v, (3 * model_dim) x model_dim.
+        Matrix& get_qkv_bias() { return qkv_bias; } ///< Stacked Q, K and V biases, (3 * model_dim) x 1.
+        Matrix& get_output_weights() { return output_weights; } ///< W_o, model_dim x model_dim.
+        Matrix& get_output_bias() { return output_bias; } ///< Output bias, model_dim x 1.
+        Matrix& get_qkv_weight_gradient() { return qkv_weight_gradient; } ///< Gradient of the stacked Q, K, V weights.
+        Matrix& get_qkv_bias_gradient() { return qkv_bias_gradient; } ///< Gradient of the stacked Q, K, V biases.
+        Matrix& get_output_weight_gradient() { return output_weight_gradient; } ///< Gradient of W_o.
+        Matrix& get_output_bias_gradient() { return output_bias_gradient; } ///< Gradient of the output bias.
+        double flops(int seq_len, int batch) const; ///< Multiply-add FLOPs of one forward pass (projections and attention).
+
+    private:
+        void prepare(int seq_len, int batch); ///< Sizes the buffers for the batch.
+        void blocked_forward();
+        void materialized_forward();
+        void blocked_backward();
+
+        int model_dim; ///< Rows of the input and output.
+        int heads; ///< Number of heads.
+        AttentionAlgorithm algorithm; ///< Selected attention kernel.
+        int seq_len; ///< Positions per sample of the last forward pass.
+        int batch; ///< Samples of the last forward pass.
+        Matrix qkv_weights; ///< W_q, W_k, W_v stacked, (3 * model_dim) x model_dim.
+        Matrix qkv_bias; ///< Q, K and V biases, (3 * model_dim) x 1.
+        Matrix output_weights; ///< W_o, model_dim x model_dim.
+        Matrix output_bias; ///< b_o, model_dim x 1.
+        Matrix qkv_weight_gradient; ///< dL/dW_qkv.
+        Matrix qkv_bias_gradient; ///< dL/db_qkv.
+        Matrix output_weight_gradient; ///< dL/dW_o.
+        Matrix output_bias_gradient; ///< dL/db_o.
+        Matrix qkv_weights_t; ///< W_qkv^T for the row-streaming projection GEMM.
+        Matrix output_weights_t; ///< W_o^T for the row-streaming output GEMM.
+        Matrix qkv; ///< Q, K and V of the last forward pass, (3 * model_dim) x (N * seq).
+        Matrix context; ///< Attention output before W_o, model_dim x (N * seq).
+        Matrix log_sum_exp; ///< Softmax normalizer of every query, heads x (N * seq).
+        Matrix scores; ///< Materialized kernel only: (N * heads * seq) x seq probabilities.
+        Matrix context_gradient; ///< dL/dcontext.
+        Matrix qkv_gradient; ///< dL/d(Q, K, V).
+        std::vector<float> scratch; ///< Per-thread tiles (scores, probabilities, accumulators).
+};
+
+#endif
@@ -0,0 +1,397 @@
+#include "conv2d.h"
+#include "../profiling/perf_counters.h"
+#include "../random/philox.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+/**
+ * @brief Returns the output height of the convolution.
+ * @return (H + 2 padding - dilation (kernel_h - 1) - 1) / stride + 1.
+ */
+int Conv2DShape::out_height() const {
+    return (height + 2 * padding - dilation * (kernel_h - 1) - 1) / stride + 1;
+}
+
+/**
+ * @brief Returns the output width of the convolution.
+ * @return (W + 2 padding - dilation (kernel_w - 1) - 1) / stride + 1.
+ */
+int Conv2DShape::out_width() const {
+    return (width + 2 * padding - dilation * (kernel_w - 1) - 1) / stride + 1;
+}
+
+/**
+ * @brief Calls fn(output_offset, input_offset, length) for every contiguous run of output
+ * elements that kernel tap (kh, kw) reads from the input, skipping taps that fall in the padding.
+ * Offsets are relative to one channel plane of a batch (pixel-major, batch-minor). With stride 1
+ * a whole output row is one run of (valid width * batch) elements; otherwise each pixel is a run
+ * of batch elements. The im2col, col2im and direct kernels all iterate through this.
+ * @param s Geometry.
+ * @param batch Samples in the batch.
+ * @param kh Kernel row.
+ * @param kw Kernel column.
+ * @param fn Callback taking (long output_offset, long input_offset, long length).
+ */
+template <typename Fn>
+static void for_each_span(const Conv2DShape& s, int batch, int kh, int kw, Fn fn) {
+    const int out_h = s.out_height();
+    const int out_w = s.out_width();
+    const int h_shift = kh * s.dilation - s.padding;
+    const int w_shift = kw * s.dilation - s.padding;
+    // Output columns whose input column ow * stride + w_shift lies in [0, W).
+    const int ow_first = w_shift >= 0 ? 0 : (-w_shift + s.stride - 1) / s.stride;
+    const int ow_end = (s.width - 1 - w_shift) < 0 ? 0 : std::min(out_w, (s.width - 1 - w_shift) / s.stride + 1);
+    if (ow_first >= ow_end) return;
+    for (int oh = 0; oh < out_h; oh++) {
+        int ih = oh * s.stride + h_shift;
+        if (ih < 0 || ih >= s.height) continue;
+        if (s.stride == 1) {
+            fn(long(oh * out_w + ow_first) * batch, long(ih * s.width + ow_first + w_shift) * batch, long(ow_end - ow_first) * batch);
+        }
+        else {
+            for (int ow = ow_first; ow < ow_end; ow++) {
+                fn(long(oh * out_w + ow) * batch, long(ih * s.width + ow * s.stride + w_shift) * batch, long(batch));
+            }
+        }
+    }
+}
+
+/**
+ * @brief Creates the layer with He-uniform filters (fan-in C * kernel_h * kernel_w) and zero biases.
+ * @param shape Geometry of the convolution.
+ * @throws std::runtime_error if a dimension is not positive or the kernel does not fit the padded input.
+ */
+Conv2D::Conv2D(const Conv2DShape& shape)
+    : shape(shape), algorithm(ConvAlgorithm::Auto), weights(0, 0), bias(0, 0), weight_gradient(0, 0), bias_gradient(0, 0),
+      weights_t(0, 0), columns(0, 0), column_gradient(0, 0) {
+    if (shape.in_channels <= 0 || shape.height <= 0 || shape.width <= 0 || shape.out_channels <= 0 || shape.kernel_h <= 0 ||
+        shape.kernel_w <= 0 || shape.stride <= 0 || shape.padding < 0 || shape.dilation <= 0) {
+        throw std::runtime_error("Convolution dimensions must be positive.");
+    }
+    if (shape.out_height() <= 0 || shape.out_width() <= 0) {
+        throw std::runtime_error("Convolution kernel does not fit the padded input.");
+    }
+    weights.resize(shape.out_channels, shape.patch_size());
+    weight_gradient.resize(shape.out_channels, shape.patch_size());
+    weights_t.resize(shape.patch_size(), shape.out_channels);
+    bias.resize(shape.out_channels, 1);
+    bias_gradient.resize(shape.out_channels, 1);
+    bias.resetWithVal(0.0f);
+    weight_gradient.resetWithVal(0.0f);
+    bias_gradient.resetWithVal(0.0f);
+    float limit = std::sqrt(6.0f / shape.patch_size());
+    PhiloxStream(random_seed(), next_random_stream()).fill_uniform(0, long(long(weights.get_rows_num()) * weights.get_columns_num()), weights.data(), -limit, limit);
+}
+
+/**
+ * @brief Selects the kernel used by forward and backward.
+ * @param algorithm Auto, Im2col or Direct; all give the same results up to rounding.
+ */
+void Conv2D::set_algorithm(ConvAlgorithm algorithm) {
+    this->algorithm = algorithm;
+}
+
+/**
+ * @brief Returns true for 1x1 kernels with stride 1 and no padding, whose im2col matrix is the
+ * input itself viewed as C x (H * W * N).
+ */
+bool Conv2D::is_pointwise() const {
+    return shape.kernel_h == 1 && shape.kernel_w == 1 && shape.stride == 1 && shape.padding == 0;
+}
+
+/**
+ * @brief Returns the kernel used for this geometry. Auto picks the direct kernel for 3x3 and
+ * strided 1x1 filters, where unfolding would copy the input up to 9 times for little GEMM
+ * work per element, and im2col + GEMM for larger filters. Pointwise 1x1 filters need no
+ * unfolding and take the GEMM path, which then multiplies the input itself.
+ */
+ConvAlgorithm Conv2D::active_algorithm() const {
+    if (algorithm != ConvAlgorithm::Auto) return algorithm;
+    bool small = (shape.kernel_h == 3 && shape.kernel_w == 3) || (shape.kernel_h == 1 && shape.kernel_w == 1);
+    return small && !is_pointwise() ? ConvAlgorithm::Direct : ConvAlgorithm::Im2col;
+}
+
+/**
+ * @brief Returns the FLOPs of one forward pass (one multiply and one add per tap).
+ * @param batch Samples in the batch.
+ */
+double Conv2D::flops(int batch) const {
+    return 2.0 * shape.out_channels * shape.patch_size() * double(shape.out_height()) * shape.out_width() * batch;
+}
+
+/**
+ * @brief Unfolds the input patches: row (c, kh, kw) of columns holds, for every output pixel and
+ * sample, the input value under that tap (zero in the padding).
+ * @param input Input batch, (C * H * W) x batch.
+ * @param batch Samples in the batch.
+ */
+void Conv2D::im2col(const Matrix& input, int batch) {
+    const long plane = long(shape.height) * shape.width * batch;
+    const long row_length = long(shape.out_height()) * shape.out_width() * batch;
+    const int taps = shape.kernel_h * shape.kernel_w;
+    columns.resize(shape.patch_size(), int(row_length));
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Conv2D::im2col", double(shape.patch_size()) * row_length);
+        #pragma omp for nowait
+        for (int r = 0; r < shape.patch_size(); r++) {
+            int c = r / taps;
+            const float* x = input.data() + c * plane;
+            float* row = columns.data() + long(r) * row_length;
+            std::fill(row, row + row_length, 0.0f);
+            for_each_span(shape, batch, (r % taps) / shape.kernel_w, r % shape.kernel_w, [&](long out, long in, long length) {
+                std::copy(x + in, x + in + length, row + out);
+            });
+        }
+    }
+}
+
+/**
+ * @brief Folds column_gradient back onto the input gradient, summing the taps that read the same
+ * input element. Each thread owns whole input channels, so no two threads write the same element.
+ * @param grad_input Receives the input gradient, resized to (C * H * W) x batch.
+ * @param batch Samples in the batch.
+ */
+void Conv2D::col2im(Matrix& grad_input, int batch) {
+    const long plane = long(shape.height) * shape.width * batch;
+    const long row_length = long(shape.out_height()) * shape.out_width() * batch;
+    const int taps = shape.kernel_h * shape.kernel_w;
+    grad_input.resize(shape.input_size(), batch);
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Conv2D::col2im", double(shape.input_size()) * batch);
+        #pragma omp for nowait
+        for (int c = 0; c < shape.in_channels; c++) {
+            float* dx = grad_input.data() + c * plane;
+            std::fill(dx, dx + plane, 0.0f);
+            for (int t = 0; t < taps; t++) {
+                const float* row = column_gradient.data() + long(c * taps + t) * row_length;
+                for_each_span(shape, batch, t / shape.kernel_w, t % shape.kernel_w, [&](long out, long in, long length) {
+                    for (long i = 0; i < length; i++) dx[in + i] += row[out + i];
+                });
+            }
+        }
+    }
+}
+
+/**
+ * @brief Adds four filter taps times one input run to four output channels, loading each input
+ * element once (register blocking over output channels).
+ */
+static inline void axpy4(float* __restrict__ y0, float* __restrict__ y1, float* __restrict__ y2, float* __restrict__ y3,
+                         const float* w, const float* __restrict__ x, long length) {
+    const float w0 = w[0], w1 = w[1], w2 = w[2], w3 = w[3];
+    for (long i = 0; i < length; i++) {
+        float xv = x[i];
+        y0[i] += w0 * xv;
+        y1[i] += w1 * xv;
+        y2[i] += w2 * xv;
+        y3[i] += w3 * xv;
+    }
+}
+
+/**
+ * @brief Dot product with eight independent partial sums, so the reduction vectorizes without
+ * reassociating floating-point math (the ANN build does not use -ffast-math).
+ */
+static inline float dot8(const float* __restrict__ a, const float* __restrict__ b, long length) {
+    float partial[8] = {};
+    long i = 0;
+    for (; i + 8 <= length; i += 8) {
+        for (int j = 0; j < 8; j++) partial[j] += a[i + j] * b[i + j];
+    }
+    float sum = 0.0f;
+    for (; i < length; i++) sum += a[i] * b[i];
+    for (int j = 0; j < 8; j++) sum += partial[j];
+    return sum;
+}
+
+/**
+ * @brief Direct convolution: for every tap, adds weight times the shifted input plane to the
+ * output plane, four output channels at a time. No unfolded copy of the input is made.
+ * @param input Input batch.
+ * @param output Output batch viewed as out_channels x (OH * OW * batch).
+ * @param batch Samples in the batch.
+ */
+void Conv2D::direct_forward(const Matrix& input, Matrix& output, int batch) {
+    const long plane = long(shape.height) * shape.width * batch;
+    const long out_plane = long(shape.out_height()) * shape.out_width() * batch;
+    const int taps = shape.kernel_h * shape.kernel_w;
+    const int blocks = (shape.out_channels + 3) / 4;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Conv2D::direct_forward", double(shape.out_channels) * out_plane);
+        #pragma omp for nowait
+        for (int block = 0; block < blocks; block++) {
+            int first = block * 4;
+            int count = std::min(4, shape.out_channels - first);
+            float* y[4];
+            for (int j = 0; j < 4; j++) {
+                // Pointers past a partial block alias its last channel and are never written.
+                y[j] = output.data() + (first + std::min(j, count - 1)) * out_plane;
+            }
+            for (int j = 0; j < count; j++) std::fill(y[j], y[j] + out_plane, bias.data()[first + j]);
+            for (int c = 0; c < shape.in_channels; c++) {
+                const float* x = input.data() + c * plane;
+                for (int t = 0; t < taps; t++) {
+                    float w[4];
+                    for (int j = 0; j < 4; j++) w[j] = j < count ? weights.data()[long(first + j) * shape.patch_size() + c * taps + t] : 0.0f;
+                    for_each_span(shape, batch, t / shape.kernel_w, t % shape.kernel_w, [&](long out, long in, long length) {
+                        if (count == 4) {
+                            axpy4(y[0] + out, y[1] + out, y[2] + out, y[3] + out, w, x + in, length);
+                        }
+                        else {
+                            for (int j = 0; j < count; j++) {
+                                float* yj = y[j] + out;
+                                for (long i = 0; i < length; i++) yj[i] += w[j] * x[in + i];
+                            }
+                        }
+                    });
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Direct backward pass: filter gradients as dot products of output-gradient runs with
+ * input runs (threads own output channels), input gradients as the transposed axpy (threads
+ * own input channels). Biases are handled by the caller.
+ * @param input Input batch of the forward pass.
+ * @param grad_output Output gradient viewed as out_channels x (OH * OW * batch).
+ * @param grad_input Receives the input gradient, or nullptr to skip it.
+ * @param batch Samples in the batch.
+ */
+void Conv2D::direct_backward(const Matrix& input, const Matrix& grad_output, Matrix* grad_input, int batch) {
+    const long plane = long(shape.height) * shape.width * batch;
+    const long out_plane = long(shape.out_height()) * shape.out_width() * batch;
+    const int taps = shape.kernel_h * shape.kernel_w;
+    if (grad_input) grad_input->resize(shape.input_size(), batch);
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Conv2D::direct_backward", double(shape.out_channels) * shape.patch_size());
+        #pragma omp for nowait
+        for (int o = 0; o < shape.out_channels; o++) {
+            const float* dy = grad_output.data() + o * out_plane;
+            for (int c = 0; c < shape.in_channels; c++) {
+                const float* x = input.data() + c * plane;
+                for (int t = 0; t < taps; t++) {
+                    float sum = 0.0f;
+                    for_each_span(shape, batch, t / shape.kernel_w, t % shape.kernel_w, [&](long out, long in, long length) {
+                        sum += dot8(dy + out, x + in, length);
+                    });
+                    weight_gradient.data()[long(o) * shape.patch_size() + c * taps + t] = sum;
+                }
+            }
+        }
+        if (grad_input) {
+            #pragma omp for nowait
+            for (int c = 0; c < shape.in_channels; c++) {
+                float* dx = grad_input->data() + c * plane;
+                std::fill(dx, dx + plane, 0.0f);
+                for (int o = 0; o < shape.out_channels; o++) {
+                    const float* dy = grad_output.data() + o * out_plane;
+                    for (int t = 0; t < taps; t++) {
+                        float w = weights.data()[long(o) * shape.patch_size() + c * taps + t];
+                        for_each_span(shape, batch, t / shape.kernel_w, t % shape.kernel_w, [&](long out, long in, long length) {
+                            for (long i = 0; i < length; i++) dx[in + i] += w * dy[out + i];
+                        });
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Computes output = conv(input) + bias.
+ * @param input Input batch, (C * H * W) x N, one sample per column.
+ * @param output Resized to (out_channels * OH * OW) x N.
+ * @throws std::runtime_error if the input does not have input_size() rows.
+ */
+void Conv2D::forward(Matrix& input, Matrix& output) {
+    if (input.get_rows_num() != shape.input_size()) {
+        throw std::runtime_error("Convolution input must have in_channels * height * width rows.");
+    }
+    const int batch = input.get_columns_num();
+    const long out_plane = long(shape.out_height()) * shape.out_width() * batch;
+    output.resize(shape.out_channels, int(out_plane));
+    ConvAlgorithm kernel = active_algorithm();
+    if (kernel == ConvAlgorithm::Direct) {
+        direct_forward(input, output, batch);
+    }
+    else {
+        for (int r = 0; r < shape.patch_size(); r++) {
+            for (int o = 0; o < shape.out_channels; o++) weights_t.data()[r * shape.out_channels + o] = weights.data()[o * shape.patch_size() + r];
+        }
+        if (is_pointwise()) {
+            input.reshape(shape.in_channels, int(out_plane));
+            output.matrixMultiplyTransposeA(weights_t, input);
+            input.reshape(shape.input_size(), batch);
+        }
+        else {
+            im2col(input, batch);
+            output.matrixMultiplyTransposeA(weights_t, columns);
+        }
+        #pragma omp parallel for
+        for (int o = 0; o < shape.out_channels; o++) {
+            float* y = output.data() + o * out_plane;
+            for (long i = 0; i < out_plane; i++) y[i] += bias.data()[o];
+        }
+    }
+    output.reshape(shape.output_size(), batch);
+}
+
+/**
+ * @brief Back-propagates an output gradient. Filter and bias gradients are summed over the
+ * batch and replace the previous ones. The im2col path unfolds the input again rather than
+ * keeping the forward pass's columns alive between the passes.
+ * @param input Input batch of the forward pass.
+ * @param grad_output dL/doutput, (out_channels * OH * OW) x N.
+ * @param grad_input Receives dL/dinput, (C * H * W) x N; nullptr for a first layer.
+ * @throws std::runtime_error if the batch shapes do not match the layer.
+ */
+void Conv2D::backward(Matrix& input, Matrix& grad_output, Matrix* grad_input) {
+    if (input.get_rows_num() != shape.input_size() || grad_output.get_rows_num() != shape.output_size() || grad_output.get_columns_num() != input.get_columns_num()) {
+        throw std::runtime_error("Convolution gradient does not match the layer and input batch.");
+    }
+    const int batch = input.get_columns_num();
+    const long out_plane = long(shape.out_height()) * shape.out_width() * batch;
+    grad_output.reshape(shape.out_channels, int(out_plane));
+    bias_gradient.setValsFromColumnSum(grad_output);
+    ConvAlgorithm kernel = active_algorithm();
+    if (kernel == ConvAlgorithm::Direct) {
+        direct_backward(input, grad_output, grad_input, batch);
+    }
+    else if (is_pointwise()) {
+        input.reshape(shape.in_channels, int(out_plane));
+        weight_gradient.matrixMultiplyTransposeB(grad_output, input);
+        input.reshape(shape.input_size(), batch);
+        if (grad_input) {
+            grad_input->resize(shape.in_channels, int(out_plane));
+            grad_input->matrixMultiplyTransposeA(weights, grad_output);
+            grad_input->reshape(shape.input_size(), batch);
+        }
+    }
+    else {
+        im2col(input, batch);
+        weight_gradient.matrixMultiplyTransposeB(grad_output, columns);
+        if (grad_input) {
+            column_gradient.resize(shape.patch_size(), int(out_plane));
+            column_gradient.matrixMultiplyTransposeA(weights, grad_output);
+            col2im(*grad_input, batch);
+        }
+    }
+    grad_output.reshape(shape.output_size(), batch);
+}
+
+/**
+ * @brief Applies one SGD step, weights -= learning_rate * gradient. The gradients are sums over
+ * the batch, so pass the learning rate divided by the batch size for a mean-gradient step.
+ * @param learning_rate Step size.
+ */
+void Conv2D::update_weights(float learning_rate) {
+    weights.addScaled(weight_gradient, -learning_rate);
+    bias.addScaled(bias_gradient, -learning_rate);
+}
@@ -0,0 +1,81 @@
+#ifndef CONV2D_H
+#define CONV2D_H
+
+#include "../matrix/matrix.h"
+
+/**
+ * @brief Geometry of a 2D convolution over channel-major (C x H x W) samples.
+ */
+struct Conv2DShape {
+    int in_channels = 1; ///< Input channels C.
+    int height = 1; ///< Input height H.
+    int width = 1; ///< Input width W.
+    int out_channels = 1; ///< Output channels (filters).
+    int kernel_h = 1; ///< Kernel height.
+    int kernel_w = 1; ///< Kernel width.
+    int stride = 1; ///< Step between output positions, in input pixels.
+    int padding = 0; ///< Zero padding on every border.
+    int dilation = 1; ///< Spacing between kernel taps.
+
+    int out_height() const; ///< Output height: (H + 2 padding - dilation (kernel_h - 1) - 1) / stride + 1.
+    int out_width() const; ///< Output width.
+    int input_size() const { return in_channels * height * width; } ///< Rows of an input batch.
+    int output_size() const { return out_channels * out_height() * out_width(); } ///< Rows of an output batch.
+    int patch_size() const { return in_channels * kernel_h * kernel_w; } ///< Inputs seen by one output (rows of the im2col matrix).
+};
+
+/**
+ * @brief Kernel used by Conv2D.
+ */
+enum class ConvAlgorithm {
+    Auto, ///< Direct for 3x3 and strided 1x1 kernels, GEMM on the input for pointwise 1x1, im2col + GEMM otherwise.
+    Im2col, ///< Unfold patches into a matrix and multiply (any geometry).
+    Direct ///< Loop over the kernel taps without unfolding (register-blocked over output channels).
+};
+
+/**
+ * @class Conv2D
+ * @brief 2D convolution layer with stride, padding and dilation.
+ *
+ * Batches are matrices with one sample per column, like the rest of the project: an input
+ * batch is (C * H * W) x N and an output batch is (out_channels * OH * OW) x N, both
+ * channel-major. Because the batch index is the fastest-moving one, the output viewed as
+ * out_channels x (OH * OW * N) is exactly weights x im2col(input), so the GEMM writes the
+ * output layout directly.
+ */
+class Conv2D {
+    public:
+        Conv2D(const Conv2DShape& shape); ///< Creates the layer with He-uniform weights and zero biases.
+
+        void forward(Matrix& input, Matrix& output); ///< output = conv(input) + bias; output is resized to output_size() x N.
+        void backward(Matrix& input, Matrix& grad_output, Matrix* grad_input); ///< Sets the gradients (summed over the batch) and optionally grad_input.
+        void update_weights(float learning_rate); ///< Applies one SGD step with the current gradients.
+
+        void set_algorithm(ConvAlgorithm algorithm); ///< Selects the kernel (Auto by default).
+        ConvAlgorithm active_algorithm() const; ///< Kernel that Auto resolves to for this geometry.
+        const Conv2DShape& get_shape() const { return shape; } ///< Geometry of the layer.
+        Matrix& get_weights() { return weights; } ///< Filters, out_channels x (C * kernel_h * kernel_w).
+        Matrix& get_bias() { return bias; } ///< Biases, out_channels x 1.
+        Matrix& get_weight_gradient() { return weight_gradient; } ///< Gradient of the filters from the last backward.
+        Matrix& get_bias_gradient() { return bias_gradient; } ///< Gradient of the biases from the last backward.
+        double flops(int batch) const; ///< Multiply-add FLOPs of one forward pass over a batch.
+
+    private:
+        bool is_pointwise() const; ///< 1x1 kernel, stride 1, no padding: the input already is the im2col matrix.
+        void im2col(const Matrix& input, int batch); ///< Unfolds the input patches into columns.
+        void col2im(Matrix& grad_input, int batch); ///< Folds column_gradient back onto the input (summing overlaps).
+        void direct_forward(const Matrix& input, Matrix& output, int batch);
+        void direct_backward(const Matrix& input, const Matrix& grad_output, Matrix* grad_input, int batch);
+
+        Conv2DShape shape; ///< Geometry of the layer.
+        ConvAlgorithm algorithm; ///< Requested kernel.
+        Matrix weights; ///< Filters, out_channels x patch_size.
+        Matrix bias; ///< Biases, out_channels x 1.
+        Matrix weight_gradient; ///< dL/dweights summed over the batch.
+        Matrix bias_gradient; ///< dL/dbias summed over the batch.
+        Matrix weights_t; ///< Transposed filters for the row-streaming forward GEMM.
+        Matrix columns; ///< im2col matrix, patch_size x (OH * OW * N).
+        Matrix column_gradient; ///< Gradient of the im2col matrix.
+};
+
+#endif
@@ -0,0 +1,230 @@
+#include "dropout.h"
+#include "../profiling/perf_counters.h"
+#include "../random/philox.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+static constexpr long mask_chunk_words = 64; // Mask words (4096 activations) per work item of generate_mask
+
+/**
+ * @brief Packs 64 random words into keep bits: bit b is set if bits[b] < threshold.
+ */
+static inline uint64_t pack_keep_bits(const uint32_t* bits, int count, uint64_t threshold) {
+    uint64_t word = 0;
+    for (int b = 0; b < count; b++) word |= uint64_t(bits[b] < threshold) << b;
+    return word;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * @brief AVX-512 version of pack_keep_bits for a full word: four unsigned compares yield the
+ * 64 bits directly as mask registers.
+ */
+__attribute__((target("avx512f")))
+static inline uint64_t pack_keep_bits_avx512(const uint32_t* bits, uint32_t threshold) {
+    __m512i t = _mm512_set1_epi32(int(threshold));
+    uint64_t m0 = _mm512_cmplt_epu32_mask(_mm512_loadu_si512(bits), t);
+    uint64_t m1 = _mm512_cmplt_epu32_mask(_mm512_loadu_si512(bits + 16), t);
+    uint64_t m2 = _mm512_cmplt_epu32_mask(_mm512_loadu_si512(bits + 32), t);
+    uint64_t m3 = _mm512_cmplt_epu32_mask(_mm512_loadu_si512(bits + 48), t);
+    return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+#endif
+
+/**
+ * @brief Expands a mask word into 64 factors, scale for kept and 0 for dropped activations.
+ * Multiplying by the factors instead of selecting keeps the kernels vectorizable; the halves
+ * are shifted as 32-bit lanes, which vectorize better than 64-bit shifts.
+ */
+static inline void expand_mask_word(uint64_t bits, float scale, float* factor) {
+    const uint32_t low = uint32_t(bits);
+    const uint32_t high = uint32_t(bits >> 32);
+    #pragma omp simd
+    for (int b = 0; b < 32; b++) {
+        factor[b] = float((low >> b) & 1u) * scale;
+        factor[b + 32] = float((high >> b) & 1u) * scale;
+    }
+}
+
+/**
+ * @brief Computes a[i] = f(z[i]) * scale for kept activations and 0 for dropped ones, one mask
+ * word (64 activations) at a time.
+ */
+template <typename Activation>
+static void masked_forward(const float* z, float* a, const uint64_t* mask, long n, float scale, Activation f) {
+    const long words = (n + 63) / 64;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Dropout::forward", double(n));
+        #pragma omp for nowait
+        for (long w = 0; w < words; w++) {
+            alignas(64) float factor[64];
+            expand_mask_word(mask[w], scale, factor);
+            const long first = w * 64;
+            const int count = int(std::min<long>(64, n - first));
+            #pragma omp simd
+            for (int b = 0; b < count; b++) {
+                a[first + b] = f(z[first + b]) * factor[b];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Computes e[i] *= f'(a[i] / scale) * scale for kept activations and e[i] = 0 for dropped
+ * ones; derivative(y) returns f' in terms of the activation output y = f(z).
+ */
+template <typename Derivative>
+static void masked_backward(const float* a, float* e, const uint64_t* mask, long n, float scale, Derivative derivative) {
+    const long words = (n + 63) / 64;
+    const float keep = 1.0f / scale;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Dropout::backward", double(n));
+        #pragma omp for nowait
+        for (long w = 0; w < words; w++) {
+            alignas(64) float factor[64];
+            expand_mask_word(mask[w], scale, factor);
+            const long first = w * 64;
+            const int count = int(std::min<long>(64, n - first));
+            #pragma omp simd
+            for (int b = 0; b < count; b++) {
+                e[first + b] *= derivative(a[first + b] * keep) * factor[b];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Creates a dropout for the output of an element-wise activation. No mask is drawn yet.
+ * @param rate Probability of dropping each activation.
+ * @param activation Activation fused into the forward and backward kernels.
+ * @throws std::runtime_error if rate is not in [0, 1).
+ */
+Dropout::Dropout(float rate, ElementwiseActivation activation)
+    : rate(rate), scale(1.0f), activation(activation), mask_length(0) {
+    if (!(rate >= 0.0f && rate < 1.0f)) {
+        throw std::runtime_error("Dropout rate must be in [0, 1).");
+    }
+    scale = 1.0f / (1.0f - rate);
+}
+
+/**
+ * @brief Draws a new mask for n activations. Activation i is kept if 32 random bits of element i
+ * of the Philox stream fall below (1 - rate) * 2^32. The random words of a chunk are generated
+ * in one batch (AVX-512 when available) and compared to the threshold 16 at a time.
+ * @param n Number of activations (rows * columns of the layer output).
+ * @param seed Seed of the random stream.
+ * @param stream Stream id; use a fresh one per layer and training step.
+ */
+void Dropout::generate_mask(long n, uint64_t seed, uint64_t stream) {
+    const long words = (n + 63) / 64;
+    mask.resize(words);
+    mask_length = n;
+    if (n == 0) return;
+    const uint64_t threshold = uint64_t(double(1.0f - rate) * 4294967296.0);
+    if (threshold > 0xFFFFFFFFull) { // Nothing is dropped
+        std::fill(mask.begin(), mask.end(), ~uint64_t(0));
+        if (n % 64) mask.back() = (uint64_t(1) << (n % 64)) - 1;
+        return;
+    }
+
+    const PhiloxStream rng(seed, stream);
+    const long chunks = (words + mask_chunk_words - 1) / mask_chunk_words;
+#if defined(__x86_64__) || defined(__i386__)
+    const bool simd = philox_simd_supported();
+#else
+    const bool simd = false;
+#endif
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Dropout::generate_mask", double(n));
+        uint32_t bits[mask_chunk_words * 64];
+        #pragma omp for nowait
+        for (long c = 0; c < chunks; c++) {
+            const long first_word = c * mask_chunk_words;
+            const long count_words = std::min(mask_chunk_words, words - first_word);
+            const long first = first_word * 64;
+            const long count = std::min(count_words * 64, n - first);
+            rng.fill_bits(uint64_t(first), count, bits);
+            for (long w = 0; w < count_words; w++) {
+                const int length = int(std::min<long>(64, count - w * 64));
+#if defined(__x86_64__) || defined(__i386__)
+                if (simd && length == 64) {
+                    mask[first_word + w] = pack_keep_bits_avx512(bits + w * 64, uint32_t(threshold));
+                    continue;
+                }
+#endif
+                mask[first_word + w] = pack_keep_bits(bits + w * 64, length, threshold);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Applies the activation and the mask in one pass: a = f(z) / (1 - rate) where the mask
+ * keeps the activation, 0 elsewhere.
+ * @param z Pre-activation of the layer.
+ * @param a Receives the layer output; resized to the dimensions of z.
+ * @throws std::runtime_error if the mask does not cover z.
+ */
+void Dropout::forward(const Matrix& z, Matrix& a) const {
+    const long n = long(z.get_rows_num()) * z.get_columns_num();
+    if (n != mask_length) {
+        throw std::runtime_error("Dropout mask does not match the layer output.");
+    }
+    a.resize(z.get_rows_num(), z.get_columns_num());
+    const float* in = z.data();
+    float* out = a.data();
+    const uint64_t* bits = mask.data();
+    switch (activation) {
+        case ElementwiseActivation::ReLu:
+            masked_forward(in, out, bits, n, scale, [](float v) { return std::max(0.0f, v); });
+            break;
+        case ElementwiseActivation::Sigmoid:
+            masked_forward(in, out, bits, n, scale, [](float v) { return float(1.0 / (1.0 + std::exp(-v))); });
+            break;
+        case ElementwiseActivation::Tanh:
+            masked_forward(in, out, bits, n, scale, [](float v) { return std::tanh(v); });
+            break;
+        case ElementwiseActivation::Linear:
+            masked_forward(in, out, bits, n, scale, [](float v) { return v; });
+            break;
+    }
+}
+
+/**
+ * @brief Back-propagates through the mask and the activation in one pass. The derivative is
+ * computed from the layer output (ReLU: a > 0, sigmoid: s (1 - s), tanh: 1 - t^2 with s and t
+ * the undropped output), so the pre-activation is not needed and no transcendental is evaluated.
+ * @param a Output of forward() for the current mask.
+ * @param error dL/da on input, dL/dz on output.
+ * @throws std::runtime_error if the shapes do not match the mask.
+ */
+void Dropout::backward(const Matrix& a, Matrix& error) const {
+    const long n = long(a.get_rows_num()) * a.get_columns_num();
+    if (n != mask_length || error.get_rows_num() != a.get_rows_num() || error.get_columns_num() != a.get_columns_num()) {
+        throw std::runtime_error("Dropout mask does not match the layer output.");
+    }
+    const float* out = a.data();
+    float* e = error.data();
+    const uint64_t* bits = mask.data();
+    switch (activation) {
+        case ElementwiseActivation::ReLu:
+            masked_backward(out, e, bits, n, scale, [](float y) { return y > 0.0f ? 1.0f : 0.0f; });
+            break;
+        case ElementwiseActivation::Sigmoid:
+            masked_backward(out, e, bits, n, scale, [](float y) { return y * (1.0f - y); });
+            break;
+        case ElementwiseActivation::Tanh:
+            masked_backward(out, e, bits, n, scale, [](float y) { return 1.0f - y * y; });
+            break;
+        case ElementwiseActivation::Linear:
+            masked_backward(out, e, bits, n, scale, [](float) { return 1.0f; });
+            break;
+    }
+}
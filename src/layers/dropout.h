@@ -0,0 +1,50 @@
+#ifndef DROPOUT_H
+#define DROPOUT_H
+
+#include <cstdint>
+#include <vector>
+#include "../matrix/matrix.h"
+
+/**
+ * @brief Element-wise activation fused into the dropout kernels.
+ */
+enum class ElementwiseActivation {
+    ReLu, ///< max(0, z)
+    Sigmoid, ///< 1 / (1 + exp(-z))
+    Tanh, ///< tanh(z)
+    Linear ///< z
+};
+
+/**
+ * @class Dropout
+ * @brief Inverted dropout on the output of an element-wise activation, with a bit-packed mask.
+ *
+ * A mask keeps each activation with probability 1 - rate and is stored as one bit per activation
+ * (32x smaller than a float mask). Bits are drawn from the Philox stream (seed, stream), generated
+ * 16 blocks at a time with AVX-512 when available, so a mask is reproducible and independent of
+ * the thread count. Kept activations are scaled by 1 / (1 - rate), so inference uses the layer
+ * unchanged and never runs any dropout code. The forward kernel computes the activation and
+ * applies the mask in one pass; the backward kernel multiplies the error signal by the activation
+ * derivative (taken from the layer output) and the mask in one pass.
+ */
+class Dropout {
+    public:
+        Dropout(float rate, ElementwiseActivation activation); ///< rate is the probability of dropping an activation, in [0, 1).
+
+        void generate_mask(long n, uint64_t seed, uint64_t stream); ///< Draws the keep bits of n activations from stream (seed, stream).
+        void forward(const Matrix& z, Matrix& a) const; ///< a = activation(z) * mask / (1 - rate); a is resized to z.
+        void backward(const Matrix& a, Matrix& error) const; ///< error *= activation'(z) * mask / (1 - rate), with a the output of forward().
+        bool kept(long index) const { return (mask[index >> 6] >> (index & 63)) & 1; } ///< Whether activation index survives.
+        long mask_size() const { return mask_length; } ///< Number of activations covered by the mask.
+        long unsigned mask_bytes() const { return mask.size() * sizeof(uint64_t); } ///< Storage of the mask.
+        float get_rate() const { return rate; } ///< Drop probability.
+
+    private:
+        float rate; ///< Probability of dropping an activation.
+        float scale; ///< 1 / (1 - rate), applied to kept activations.
+        ElementwiseActivation activation; ///< Activation fused into the kernels.
+        std::vector<uint64_t> mask; ///< Keep bits, bit i % 64 of word i / 64 for activation i (row-major).
+        long mask_length; ///< Number of activations covered by the mask.
+};
+
+#endif
@@ -0,0 +1,197 @@
+#include "embedding.h"
+#include "../profiling/perf_counters.h"
+#include "../random/philox.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+static constexpr long embedding_block = 64; // Samples per work item of the gather kernel
+static constexpr long max_float_id = 1L << 24; // Largest count of consecutive integers a float holds exactly
+
+/**
+ * @brief Creates an embedding table with standard normal values drawn from the global seed.
+ * @param vocab Number of IDs.
+ * @param dim Values per ID.
+ * @throws std::runtime_error if a dimension is not positive or vocab exceeds 2^24.
+ */
+Embedding::Embedding(long vocab, int dim)
+    : vocab(vocab), dim(dim), table(0, 0), fields(0), batch(0) {
+    if (vocab <= 0 || dim <= 0) {
+        throw std::runtime_error("Embedding dimensions must be greater than zero.");
+    }
+    if (vocab > max_float_id) {
+        throw std::runtime_error("Embedding vocabulary exceeds the IDs a float input holds exactly (2^24).");
+    }
+    table.resize(int(vocab), dim);
+    PhiloxStream(random_seed(), next_random_stream()).fill_normal(0, vocab * dim, table.data());
+    row_slot.assign(vocab, -1);
+}
+
+/**
+ * @brief Converts a fields x batch matrix of IDs to table rows, field-major.
+ * @throws std::runtime_error if an ID is not an integer in [0, vocab).
+ */
+void Embedding::read_ids(const Matrix& ids, std::vector<long>& rows) const {
+    const long n = long(ids.get_rows_num()) * ids.get_columns_num();
+    rows.resize(n);
+    for (long e = 0; e < n; e++) {
+        float id = ids.data()[e];
+        if (!(id >= 0.0f && id < float(vocab)) || id != std::floor(id)) {
+            throw std::runtime_error("Embedding ID " + std::to_string(id) + " is not an integer in [0, " + std::to_string(vocab) + ").");
+        }
+        rows[e] = long(id);
+    }
+}
+
+/**
+ * @brief Looks up the IDs: output(f * dim + d, c) = table(ids(f, c), d). Work items are blocks
+ * of samples, so each output row is written in contiguous runs while the table rows of the
+ * block stay in cache across d.
+ * @param ids IDs, one categorical field per row and one sample per column.
+ * @param output Receives the (fields * dim) x batch embeddings; resized.
+ * @param training Keeps the IDs for backward() when true.
+ * @throws std::runtime_error if an ID is out of range.
+ */
+void Embedding::forward(const Matrix& ids, Matrix& output, bool training) {
+    std::vector<long>& rows = training ? indices : inference_indices;
+    read_ids(ids, rows);
+    const int id_rows = ids.get_rows_num();
+    const long samples = ids.get_columns_num();
+    if (training) {
+        fields = id_rows;
+        batch = int(samples);
+    }
+    output.resize(id_rows * dim, int(samples));
+    const float* values = table.data();
+    float* out = output.data();
+    const long* id = rows.data();
+    const long blocks = (samples + embedding_block - 1) / embedding_block;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Embedding::forward", double(id_rows) * dim * samples);
+        #pragma omp for nowait
+        for (long block = 0; block < blocks; block++) {
+            const long first = block * embedding_block;
+            const long last = std::min(samples, first + embedding_block);
+            for (int f = 0; f < id_rows; f++) {
+                const long* field_ids = id + long(f) * samples;
+                for (int d = 0; d < dim; d++) {
+                    float* out_row = out + (long(f) * dim + d) * samples;
+                    for (long c = first; c < last; c++) out_row[c] = values[field_ids[c] * dim + d];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Accumulates the gradient of the last training forward into the rows it used. A serial
+ * pass assigns every distinct row a gradient slot (repeated IDs share one); the sums are then
+ * parallel over d, so no two threads write the same slot value. Untouched rows cost nothing.
+ * @param grad_output dL/doutput, (fields * dim) x batch.
+ * @throws std::runtime_error if grad_output does not match the last training forward.
+ */
+void Embedding::backward(const Matrix& grad_output) {
+    if (grad_output.get_rows_num() != fields * dim || grad_output.get_columns_num() != batch) {
+        throw std::runtime_error("Embedding gradient does not match the last training forward.");
+    }
+    const long entries = long(fields) * batch;
+    entry_slots.resize(entries);
+    for (long e = 0; e < entries; e++) {
+        long row = indices[e];
+        if (row_slot[row] < 0) {
+            row_slot[row] = int(touched.size());
+            touched.push_back(row);
+        }
+        entry_slots[e] = row_slot[row];
+    }
+    row_gradients.resize(touched.size() * dim, 0.0f); // New slots start at zero
+
+    const float* grad = grad_output.data();
+    float* sums = row_gradients.data();
+    const int* slot = entry_slots.data();
+    const long samples = batch;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Embedding::backward", double(entries) * dim);
+        #pragma omp for nowait
+        for (int d = 0; d < dim; d++) {
+            for (int f = 0; f < fields; f++) {
+                const float* grad_row = grad + (long(f) * dim + d) * samples;
+                const int* field_slots = slot + long(f) * samples;
+                for (long c = 0; c < samples; c++) sums[long(field_slots[c]) * dim + d] += grad_row[c];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Applies one SGD step to the rows that have a gradient. A row without a gradient would
+ * receive a zero update, so skipping it is exact and the step costs O(touched rows * dim).
+ * @param learning_rate Step size.
+ */
+void Embedding::update_weights(float learning_rate) {
+    const long slots = long(touched.size());
+    float* values = table.data();
+    const float* sums = row_gradients.data();
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Embedding::update_weights", double(slots) * dim);
+        #pragma omp for nowait
+        for (long s = 0; s < slots; s++) {
+            float* row = values + touched[s] * dim;
+            const float* gradient = sums + s * dim;
+            for (int d = 0; d < dim; d++) row[d] -= learning_rate * gradient[d];
+        }
+    }
+}
+
+/**
+ * @brief Clears the sparse gradients; only the slots of the touched rows are released.
+ */
+void Embedding::reset_gradients() {
+    for (long row : touched) row_slot[row] = -1;
+    touched.clear();
+    row_gradients.clear();
+}
+
+/**
+ * @brief Multiplies the accumulated gradients by a factor (averaging, unscaling, clipping).
+ * @param scale Factor.
+ */
+void Embedding::scale_gradients(float scale) {
+    for (float& g : row_gradients) g *= scale;
+}
+
+/**
+ * @brief Checks the accumulated gradients for overflow.
+ * @return True if every gradient is finite.
+ */
+bool Embedding::gradients_finite() {
+    for (float g : row_gradients) {
+        if (!std::isfinite(g)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Computes the squared L2 norm of the accumulated gradients.
+ * @return Sum of the squares of the gradients of the touched rows.
+ */
+double Embedding::gradient_squared_norm() {
+    double sum = 0.0;
+    for (float g : row_gradients) sum += double(g) * g;
+    return sum;
+}
+
+/**
+ * @brief Returns one accumulated gradient value.
+ * @param row Table row (ID).
+ * @param d Column of the row.
+ * @return The gradient, or 0 if the row was not used since the last reset.
+ */
+float Embedding::get_row_gradient(long row, int d) const {
+    int slot = row_slot.at(row);
+    return slot < 0 ? 0.0f : row_gradients[long(slot) * dim + d];
+}
@@ -0,0 +1,52 @@
+#ifndef EMBEDDING_H
+#define EMBEDDING_H
+
+#include <vector>
+#include "../matrix/matrix.h"
+
+/**
+ * @class Embedding
+ * @brief Lookup table mapping categorical IDs to dense vectors, with sparse row gradients.
+ *
+ * The input is a fields x batch matrix of IDs (one categorical feature per row, stored as
+ * floats, so IDs are exact up to 2^24) and the output stacks the looked-up rows of all fields
+ * into a (fields * dim) x batch matrix. This replaces a one-hot input multiplied by a dense
+ * vocab-wide weight matrix: forward gathers dim values per ID, and backward accumulates the
+ * gradient only into the rows used by the batch, so a sample costs O(dim) instead of
+ * O(vocab * dim). The optimizer step likewise touches only those rows.
+ */
+class Embedding {
+    public:
+        Embedding(long vocab, int dim); ///< Table of vocab rows of dim values, standard normal from the global seed.
+
+        void forward(const Matrix& ids, Matrix& output, bool training); ///< Gathers the rows of ids into output; training keeps the IDs for backward().
+        void backward(const Matrix& grad_output); ///< Adds dL/doutput of the last training forward into the gradients of the used rows.
+        void update_weights(float learning_rate); ///< SGD step on the rows with a gradient; other rows are not touched.
+        void reset_gradients(); ///< Clears the sparse gradients (cost proportional to the touched rows).
+        void scale_gradients(float scale); ///< Multiplies the accumulated gradients by scale.
+        bool gradients_finite(); ///< Returns true if no accumulated gradient is infinite or NaN.
+        double gradient_squared_norm(); ///< Sum of the squared accumulated gradients.
+
+        long get_vocab() const { return vocab; } ///< Number of IDs.
+        int get_dim() const { return dim; } ///< Values per ID.
+        Matrix& get_table() { return table; } ///< vocab x dim table, one row per ID.
+        const std::vector<long>& get_touched_rows() const { return touched; } ///< Rows with a gradient, in order of first use.
+        float get_row_gradient(long row, int d) const; ///< Accumulated gradient of table(row, d); 0 for untouched rows.
+
+    private:
+        void read_ids(const Matrix& ids, std::vector<long>& rows) const;
+
+        long vocab; ///< Number of rows of the table.
+        int dim; ///< Columns of the table.
+        Matrix table; ///< Embedding vectors, row-major, one row per ID.
+        std::vector<long> indices; ///< IDs of the last training forward, field-major (field * batch + sample).
+        std::vector<long> inference_indices; ///< IDs of the last inference forward.
+        int fields; ///< ID rows of the last training forward.
+        int batch; ///< Samples of the last training forward.
+        std::vector<int> row_slot; ///< Slot of each table row in row_gradients, -1 if untouched.
+        std::vector<long> touched; ///< Table row of each slot.
+        std::vector<float> row_gradients; ///< Gradient rows, slot-major (slot * dim + d).
+        std::vector<int> entry_slots; ///< Slot of each looked-up ID of the current backward.
+};
+
+#endif
@@ -0,0 +1,382 @@
+#include "normalization.h"
+#include "../profiling/perf_counters.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+static constexpr int layer_norm_block = 256; // Samples per work item of the LayerNorm kernels
+
+/**
+ * @brief Shifted sums of a row: sum of (x - shift) and of (x - shift)^2. Shifting by a sample of
+ * the row keeps the single-pass variance accurate when the mean is large. The reductions are
+ * vectorized (lane-wise partial sums), so the rounding depends on the SIMD width of the build
+ * but not on the thread count.
+ */
+static inline void shifted_sums(const float* __restrict__ x, long n, float shift, float& sum, float& squares) {
+    float s = 0.0f, q = 0.0f;
+    #pragma omp simd reduction(+:s, q)
+    for (long i = 0; i < n; i++) {
+        float d = x[i] - shift;
+        s += d;
+        q += d * d;
+    }
+    sum = s;
+    squares = q;
+}
+
+/**
+ * @brief Sums of dy and of dy * (x - mean) * inv_std over a row (vectorized like shifted_sums).
+ */
+static inline void gradient_sums(const float* __restrict__ x, const float* __restrict__ dy, long n, float mean, float inv_std,
+                                 float& sum, float& dot) {
+    float s = 0.0f, d = 0.0f;
+    #pragma omp simd reduction(+:s, d)
+    for (long i = 0; i < n; i++) {
+        s += dy[i];
+        d += dy[i] * (x[i] - mean);
+    }
+    sum = s;
+    dot = d * inv_std;
+}
+
+/**
+ * @brief Creates a normalization layer with the identity affine map.
+ * @param type BatchNorm or LayerNorm.
+ * @param features Number of rows of the normalized matrices.
+ * @param epsilon Added to the variance for numerical stability.
+ * @param momentum Weight of each new batch in the running statistics (BatchNorm).
+ * @throws std::runtime_error if features is not positive, epsilon is negative or momentum is not in [0, 1].
+ */
+Normalization::Normalization(NormType type, int features, float epsilon, float momentum)
+    : type(type), features(features), epsilon(epsilon), momentum(momentum), batch(0),
+      gamma(std::max(features, 0), 1), beta(std::max(features, 0), 1), gamma_gradient(std::max(features, 0), 1),
+      beta_gradient(std::max(features, 0), 1), running_mean(std::max(features, 0), 1), running_var(std::max(features, 0), 1) {
+    if (features <= 0) {
+        throw std::runtime_error("Normalization needs at least one feature.");
+    }
+    if (epsilon < 0.0f || momentum < 0.0f || momentum > 1.0f) {
+        throw std::runtime_error("Normalization needs epsilon >= 0 and momentum in [0, 1].");
+    }
+    gamma.resetWithVal(1.0f);
+    running_var.resetWithVal(1.0f);
+}
+
+/**
+ * @brief Normalizes a batch and applies the affine map. In training mode the statistics of the
+ * batch are used and cached for backward(); a BatchNorm in inference mode uses the running
+ * statistics instead. Every value is read twice and written once.
+ * @param input Features x batch matrix.
+ * @param output Receives the result, resized to the input dimensions; may be the input itself.
+ * @param training Whether to use (and cache) the batch statistics.
+ * @throws std::runtime_error if the input has the wrong number of rows, or a training batch
+ * of a BatchNorm has fewer than two samples.
+ */
+void Normalization::forward(const Matrix& input, Matrix& output, bool training) {
+    if (input.get_rows_num() != features) {
+        throw std::runtime_error("Normalization input must have one row per feature.");
+    }
+    if (&output != &input) output.resize(input.get_rows_num(), input.get_columns_num());
+    if (type == NormType::LayerNorm) {
+        layer_norm_forward(input, output);
+        if (training) batch = input.get_columns_num();
+        return;
+    }
+    if (training) {
+        if (input.get_columns_num() < 2) {
+            throw std::runtime_error("BatchNorm needs at least two samples per batch in training; raise the micro-batch size.");
+        }
+        batch_norm_forward(input, output);
+        batch = input.get_columns_num();
+        return;
+    }
+
+    const int n = input.get_columns_num();
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("BatchNorm::inference", double(features) * n);
+        #pragma omp for nowait
+        for (int r = 0; r < features; r++) {
+            float scale = gamma.data()[r] / std::sqrt(running_var.data()[r] + epsilon);
+            float shift = beta.data()[r] - running_mean.data()[r] * scale;
+            const float* x = input.data() + long(r) * n;
+            float* y = output.data() + long(r) * n;
+            for (int j = 0; j < n; j++) y[j] = x[j] * scale + shift;
+        }
+    }
+}
+
+/**
+ * @brief BatchNorm with batch statistics: per feature row, one shifted-sum pass for the mean and
+ * variance, then y = x * scale + shift with scale and shift folding gamma, beta and the statistics.
+ */
+void Normalization::batch_norm_forward(const Matrix& input, Matrix& output) {
+    const int n = input.get_columns_num();
+    mean.resize(features);
+    variance.resize(features);
+    inv_std.resize(features);
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("BatchNorm::forward", double(features) * n);
+        #pragma omp for nowait
+        for (int r = 0; r < features; r++) {
+            const float* x = input.data() + long(r) * n;
+            float* y = output.data() + long(r) * n;
+            float sum, squares;
+            shifted_sums(x, n, x[0], sum, squares);
+            float shifted_mean = sum / n;
+            mean[r] = x[0] + shifted_mean;
+            variance[r] = std::max(squares / n - shifted_mean * shifted_mean, 0.0f);
+            inv_std[r] = 1.0f / std::sqrt(variance[r] + epsilon);
+            float scale = gamma.data()[r] * inv_std[r];
+            float shift = beta.data()[r] - mean[r] * scale;
+            for (int j = 0; j < n; j++) y[j] = x[j] * scale + shift;
+        }
+    }
+}
+
+/**
+ * @brief LayerNorm: statistics per sample (column). The features of a sample are strided in the
+ * row-major layout, so each thread takes a block of samples and walks the rows, accumulating the
+ * shifted sums of all samples of the block at once (unit stride, vectorizable); a second walk
+ * writes the normalized, scaled and shifted values.
+ */
+void Normalization::layer_norm_forward(const Matrix& input, Matrix& output) {
+    const int n = input.get_columns_num();
+    const int blocks = (n + layer_norm_block - 1) / layer_norm_block;
+    mean.resize(n);
+    inv_std.resize(n);
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("LayerNorm::forward", double(features) * n);
+        #pragma omp for nowait
+        for (int b = 0; b < blocks; b++) {
+            const int first = b * layer_norm_block;
+            const int count = std::min(layer_norm_block, n - first);
+            const float* shift = input.data() + first; // Row 0 of the block
+            float* sum = mean.data() + first;
+            float* squares = inv_std.data() + first;
+            std::fill(sum, sum + count, 0.0f);
+            std::fill(squares, squares + count, 0.0f);
+            for (int r = 0; r < features; r++) {
+                const float* x = input.data() + long(r) * n + first;
+                for (int j = 0; j < count; j++) {
+                    float d = x[j] - shift[j];
+                    sum[j] += d;
+                    squares[j] += d * d;
+                }
+            }
+            for (int j = 0; j < count; j++) {
+                float shifted_mean = sum[j] / features;
+                float variance = std::max(squares[j] / features - shifted_mean * shifted_mean, 0.0f);
+                sum[j] = shift[j] + shifted_mean;
+                squares[j] = 1.0f / std::sqrt(variance + epsilon);
+            }
+            for (int r = 0; r < features; r++) {
+                const float* x = input.data() + long(r) * n + first;
+                float* y = output.data() + long(r) * n + first;
+                const float g = gamma.data()[r];
+                const float s = beta.data()[r];
+                for (int j = 0; j < count; j++) y[j] = (x[j] - sum[j]) * squares[j] * g + s;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Blends the batch statistics of the last training forward pass into the running mean and
+ * the running (unbiased) variance used at inference. Does nothing for a LayerNorm. Kept apart from
+ * forward() so that recomputing a layer (activation checkpointing) does not count a batch twice.
+ */
+void Normalization::update_running_stats() {
+    if (type != NormType::BatchNorm || batch < 2) return;
+    float correction = float(batch) / float(batch - 1);
+    for (int r = 0; r < features; r++) {
+        running_mean.data()[r] += momentum * (mean[r] - running_mean.data()[r]);
+        running_var.data()[r] += momentum * (correction * variance[r] - running_var.data()[r]);
+    }
+}
+
+/**
+ * @brief Back-propagates through the last training forward pass. The gamma and beta gradients are
+ * added to the accumulated ones (summed over the samples, like the dense layer gradients).
+ * @param input Input of that forward pass.
+ * @param grad_output dL/doutput.
+ * @param grad_input Receives dL/dinput, resized to the input dimensions; may be grad_output.
+ * @throws std::runtime_error if the shapes differ from the last training forward pass.
+ */
+void Normalization::backward(const Matrix& input, const Matrix& grad_output, Matrix& grad_input) {
+    if (input.get_rows_num() != features || input.get_columns_num() != batch || grad_output.get_rows_num() != features || grad_output.get_columns_num() != batch) {
+        throw std::runtime_error("Normalization backward must match the last training forward pass.");
+    }
+    if (&grad_input != &grad_output) grad_input.resize(features, batch);
+    if (type == NormType::BatchNorm) batch_norm_backward(input, grad_output, grad_input);
+    else layer_norm_backward(input, grad_output, grad_input);
+}
+
+/**
+ * @brief BatchNorm backward per feature row: one pass for sum(dy) and sum(dy * xhat), then
+ * dx = gamma * inv_std * (dy - (sum(dy) + xhat * sum(dy * xhat)) / N).
+ */
+void Normalization::batch_norm_backward(const Matrix& input, const Matrix& grad_output, Matrix& grad_input) {
+    const int n = batch;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("BatchNorm::backward", double(features) * n);
+        #pragma omp for nowait
+        for (int r = 0; r < features; r++) {
+            const float* x = input.data() + long(r) * n;
+            const float* dy = grad_output.data() + long(r) * n;
+            float* dx = grad_input.data() + long(r) * n;
+            float sum, dot;
+            gradient_sums(x, dy, n, mean[r], inv_std[r], sum, dot);
+            gamma_gradient.data()[r] += dot;
+            beta_gradient.data()[r] += sum;
+            const float k = gamma.data()[r] * inv_std[r];
+            const float mean_dy = sum / n;
+            const float mean_dot = dot / n;
+            for (int j = 0; j < n; j++) {
+                float xhat = (x[j] - mean[r]) * inv_std[r];
+                dx[j] = k * (dy[j] - mean_dy - xhat * mean_dot);
+            }
+        }
+    }
+}
+
+/**
+ * @brief LayerNorm backward. gamma and beta gradients are row reductions; the input gradient
+ * needs, per sample, sum(g) and sum(g * xhat) with g = gamma * dy, which are accumulated for a
+ * block of samples while walking the rows, then dx = inv_std * (g - (sum(g) + xhat * sum(g * xhat)) / D).
+ */
+void Normalization::layer_norm_backward(const Matrix& input, const Matrix& grad_output, Matrix& grad_input) {
+    const int n = batch;
+    const int blocks = (n + layer_norm_block - 1) / layer_norm_block;
+    column_sum.resize(n);
+    column_dot.resize(n);
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("LayerNorm::backward", double(features) * n);
+        // Parameter gradients first: grad_input may overwrite grad_output below.
+        #pragma omp for
+        for (int r = 0; r < features; r++) {
+            const float* x = input.data() + long(r) * n;
+            const float* dy = grad_output.data() + long(r) * n;
+            const float* m = mean.data();
+            const float* s = inv_std.data();
+            float sum = 0.0f, dot = 0.0f;
+            #pragma omp simd reduction(+:sum, dot)
+            for (int j = 0; j < n; j++) {
+                sum += dy[j];
+                dot += dy[j] * (x[j] - m[j]) * s[j];
+            }
+            gamma_gradient.data()[r] += dot;
+            beta_gradient.data()[r] += sum;
+        }
+        #pragma omp for nowait
+        for (int b = 0; b < blocks; b++) {
+            const int first = b * layer_norm_block;
+            const int count = std::min(layer_norm_block, n - first);
+            const float* m = mean.data() + first;
+            const float* s = inv_std.data() + first;
+            float* sum = column_sum.data() + first;
+            float* dot = column_dot.data() + first;
+            std::fill(sum, sum + count, 0.0f);
+            std::fill(dot, dot + count, 0.0f);
+            for (int r = 0; r < features; r++) {
+                const float* x = input.data() + long(r) * n + first;
+                const float* dy = grad_output.data() + long(r) * n + first;
+                const float g = gamma.data()[r];
+                for (int j = 0; j < count; j++) {
+                    float gdy = g * dy[j];
+                    sum[j] += gdy;
+                    dot[j] += gdy * (x[j] - m[j]) * s[j];
+                }
+            }
+            for (int j = 0; j < count; j++) {
+                sum[j] /= features;
+                dot[j] /= features;
+            }
+            for (int r = 0; r < features; r++) {
+                const float* x = input.data() + long(r) * n + first;
+                const float* dy = grad_output.data() + long(r) * n + first;
+                float* dx = grad_input.data() + long(r) * n + first;
+                const float g = gamma.data()[r];
+                for (int j = 0; j < count; j++) {
+                    float xhat = (x[j] - m[j]) * s[j];
+                    dx[j] = s[j] * (g * dy[j] - sum[j] - xhat * dot[j]);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Applies one SGD step to gamma and beta.
+ * @param learning_rate Step size.
+ */
+void Normalization::update_weights(float learning_rate) {
+    gamma.addScaled(gamma_gradient, -learning_rate);
+    beta.addScaled(beta_gradient, -learning_rate);
+}
+
+/**
+ * @brief Sets the accumulated gradients to zero.
+ */
+void Normalization::reset_gradients() {
+    gamma_gradient.resetWithVal(0.0f);
+    beta_gradient.resetWithVal(0.0f);
+}
+
+/**
+ * @brief Multiplies the accumulated gradients by a factor (averaging, unscaling, clipping).
+ * @param scale The factor.
+ */
+void Normalization::scale_gradients(float scale) {
+    gamma_gradient *= scale;
+    beta_gradient *= scale;
+}
+
+/**
+ * @brief Checks the accumulated gradients for overflow.
+ * @return True if every gradient is finite.
+ */
+bool Normalization::gradients_finite() {
+    return gamma_gradient.allFinite() && beta_gradient.allFinite();
+}
+
+/**
+ * @brief Computes the squared L2 norm of the accumulated gradients.
+ * @return Sum of the squares of the gamma and beta gradients.
+ */
+double Normalization::gradient_squared_norm() {
+    double sum = 0.0;
+    for (int r = 0; r < features; r++) {
+        sum += double(gamma_gradient.data()[r]) * gamma_gradient.data()[r];
+        sum += double(beta_gradient.data()[r]) * beta_gradient.data()[r];
+    }
+    return sum;
+}
+
+/**
+ * @brief Folds this BatchNorm, in inference mode, into the linear layer z = weights * a + bias
+ * that feeds it: with scale = gamma / sqrt(running_var + epsilon), row r of the weights is
+ * multiplied by scale[r] and bias[r] becomes (bias[r] - running_mean[r]) * scale[r] + beta[r].
+ * The folded layer computes what the pair computed, so inference skips the normalization.
+ * @param weights Weights of the preceding layer, features x inputs.
+ * @param bias Bias of the preceding layer, features x 1.
+ * @throws std::runtime_error for a LayerNorm (its statistics depend on the sample) or mismatched shapes.
+ */
+void Normalization::fold_into(Matrix& weights, Matrix& bias) {
+    if (type != NormType::BatchNorm) {
+        throw std::runtime_error("Only BatchNorm can be folded into a linear layer.");
+    }
+    if (weights.get_rows_num() != features || bias.get_rows_num() != features || bias.get_columns_num() != 1) {
+        throw std::runtime_error("Folded layer must have one weight row and one bias per feature.");
+    }
+    const int inputs = weights.get_columns_num();
+    for (int r = 0; r < features; r++) {
+        float scale = gamma.data()[r] / std::sqrt(running_var.data()[r] + epsilon);
+        float* w = weights.data() + long(r) * inputs;
+        for (int c = 0; c < inputs; c++) w[c] *= scale;
+        bias.data()[r] = (bias.data()[r] - running_mean.data()[r]) * scale + beta.data()[r];
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef NORMALIZATION_H
+#define NORMALIZATION_H
+
+#include <vector>
+#include "../matrix/matrix.h"
+
+/**
+ * @brief Axis a Normalization layer computes its statistics over.
+ */
+enum class NormType {
+    BatchNorm, ///< Per feature (row) over the samples of the batch; running statistics for inference.
+    LayerNorm ///< Per sample (column) over its features; identical in training and inference.
+};
+
+/**
+ * @class Normalization
+ * @brief Batch or layer normalization of a features x batch matrix with a learned per-feature
+ * scale (gamma) and shift (beta).
+ *
+ * Each kernel makes one pass over the input for the mean and variance (shifted sums, so the
+ * single pass does not cancel catastrophically) and one fused normalize + affine pass; the
+ * backward pass likewise reduces the two gradient sums in one pass and writes grad_input in the
+ * next. The normalized values are not stored: backward recomputes them from the input and the
+ * cached statistics. A BatchNorm in inference mode is an affine map per feature and can be
+ * folded into the preceding linear layer with fold_into().
+ */
+class Normalization {
+    public:
+        Normalization(NormType type, int features, float epsilon = 1e-5f, float momentum = 0.1f); ///< gamma = 1, beta = 0, running mean 0 and variance 1.
+
+        void forward(const Matrix& input, Matrix& output, bool training); ///< output = gamma * normalized(input) + beta; output may be input.
+        void update_running_stats(); ///< Blends the statistics of the last training forward into the running ones (BatchNorm).
+        void backward(const Matrix& input, const Matrix& grad_output, Matrix& grad_input); ///< Adds the gamma/beta gradients (summed over the batch) and sets grad_input, which may be grad_output.
+        void update_weights(float learning_rate); ///< Applies one SGD step with the accumulated gradients.
+        void reset_gradients(); ///< Sets the accumulated gradients to zero.
+        void scale_gradients(float scale); ///< Multiplies the accumulated gradients by scale.
+        bool gradients_finite(); ///< Returns true if no accumulated gradient is infinite or NaN.
+        double gradient_squared_norm(); ///< Sum of the squared accumulated gradients.
+        void fold_into(Matrix& weights, Matrix& bias); ///< Rewrites the preceding linear layer so it also applies this inference-mode BatchNorm.
+
+        NormType get_type() const { return type; } ///< Normalization axis.
+        Matrix& get_gamma() { return gamma; } ///< Scales, features x 1.
+        Matrix& get_beta() { return beta; } ///< Shifts, features x 1.
+        Matrix& get_gamma_gradient() { return gamma_gradient; } ///< Accumulated gradient of gamma.
+        Matrix& get_beta_gradient() { return beta_gradient; } ///< Accumulated gradient of beta.
+        Matrix& get_running_mean() { return running_mean; } ///< Inference mean of each feature (BatchNorm).
+        Matrix& get_running_var() { return running_var; } ///< Inference variance of each feature (BatchNorm).
+
+    private:
+        void batch_norm_forward(const Matrix& input, Matrix& output);
+        void layer_norm_forward(const Matrix& input, Matrix& output);
+        void batch_norm_backward(const Matrix& input, const Matrix& grad_output, Matrix& grad_input);
+        void layer_norm_backward(const Matrix& input, const Matrix& grad_output, Matrix& grad_input);
+
+        NormType type; ///< Normalization axis.
+        int features; ///< Rows of the normalized matrices.
+        float epsilon; ///< Added to the variance before the square root.
+        float momentum; ///< Weight of a new batch in the running statistics.
+        int batch; ///< Samples of the last training forward pass.
+        Matrix gamma; ///< Per-feature scale.
+        Matrix beta; ///< Per-feature shift.
+        Matrix gamma_gradient; ///< dL/dgamma summed over the batches since the last reset.
+        Matrix beta_gradient; ///< dL/dbeta summed over the batches since the last reset.
+        Matrix running_mean; ///< Exponential average of the batch means (BatchNorm).
+        Matrix running_var; ///< Exponential average of the unbiased batch variances (BatchNorm).
+        std::vector<float> mean; ///< Means of the last training forward (per feature or per sample).
+        std::vector<float> variance; ///< Biased batch variances of the last training forward (BatchNorm).
+        std::vector<float> inv_std; ///< 1 / sqrt(variance + epsilon) of the last training forward.
+        std::vector<float> column_sum; ///< Per-sample sum of gamma * grad_output (LayerNorm backward).
+        std::vector<float> column_dot; ///< Per-sample sum of gamma * grad_output * normalized input (LayerNorm backward).
+};
+
+#endif
@@ -0,0 +1,398 @@
+#include "recurrent.h"
+#include "../functions/fast_math.h"
+#include "../matrix/tensor.h"
+#include "../profiling/perf_counters.h"
+#include "../random/philox.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+/**
+ * @brief Creates the layer. Weights and biases are uniform in +-1/sqrt(hidden_size); the LSTM
+ * forget gate bias starts at 1 so the cell state is kept early in training.
+ * @param cell LSTM or GRU.
+ * @param input_size Features per step.
+ * @param hidden_size Hidden units.
+ * @throws std::runtime_error if a size is not positive.
+ */
+Recurrent::Recurrent(RecurrentCell cell, int input_size, int hidden_size)
+    : cell(cell), input_size(input_size), hidden_size(hidden_size), gates(cell == RecurrentCell::LSTM ? 4 : 3), steps(0), batch(0),
+      input_weights(0, 0), recurrent_weights(0, 0), bias(0, 0), recurrent_bias(0, 0), input_weight_gradient(0, 0),
+      recurrent_weight_gradient(0, 0), bias_gradient(0, 0), recurrent_bias_gradient(0, 0), input_weights_t(0, 0),
+      recurrent_weights_t(0, 0), projection(0, 0), cells(0, 0), candidates(0, 0), previous_hidden(0, 0), step_hidden(0, 0),
+      step_gates(0, 0), zero_state(0, 0), gate_gradient(0, 0), recurrent_gate_gradient(0, 0), step_gradient(0, 0),
+      hidden_gradient(0, 0), carry_gradient(0, 0) {
+    if (input_size <= 0 || hidden_size <= 0) {
+        throw std::runtime_error("Recurrent layer sizes must be positive.");
+    }
+    const int rows = gate_rows();
+    input_weights.resize(rows, input_size);
+    recurrent_weights.resize(rows, hidden_size);
+    bias.resize(rows, 1);
+    recurrent_bias.resize(hidden_size, 1);
+    input_weight_gradient.resize(rows, input_size);
+    recurrent_weight_gradient.resize(rows, hidden_size);
+    bias_gradient.resize(rows, 1);
+    recurrent_bias_gradient.resize(hidden_size, 1);
+    input_weights_t.resize(input_size, rows);
+    recurrent_weights_t.resize(hidden_size, rows);
+    input_weight_gradient.resetWithVal(0.0f);
+    recurrent_weight_gradient.resetWithVal(0.0f);
+    bias_gradient.resetWithVal(0.0f);
+    recurrent_bias_gradient.resetWithVal(0.0f);
+
+    float limit = 1.0f / std::sqrt(float(hidden_size));
+    PhiloxStream rng(random_seed(), next_random_stream());
+    long offset = 0;
+    for (Matrix* m : {&input_weights, &recurrent_weights, &bias, &recurrent_bias}) {
+        long n = long(long(m->get_rows_num()) * m->get_columns_num());
+        rng.fill_uniform(uint64_t(offset), n, m->data(), -limit, limit);
+        offset += n;
+    }
+    if (cell == RecurrentCell::LSTM) {
+        for (int j = 0; j < hidden_size; j++) bias.data()[hidden_size + j] = 1.0f;
+    }
+}
+
+/**
+ * @brief Returns the FLOPs of the GEMMs of one forward pass: the input projection of every step
+ * and the recurrent projection of every step after the first.
+ * @param steps Steps per sequence.
+ * @param batch Sequences in the batch.
+ */
+double Recurrent::flops(int steps, int batch) const {
+    return 2.0 * gate_rows() * (double(input_size) * steps + double(hidden_size) * std::max(steps - 1, 0)) * batch;
+}
+
+/**
+ * @brief Sizes the buffers for steps x batch. Matrix::resize keeps the storage when the size
+ * does not grow, so training on batches of one shape allocates only on the first pass.
+ */
+void Recurrent::prepare(int steps, int batch) {
+    this->steps = steps;
+    this->batch = batch;
+    const int columns = steps * batch;
+    const int rows = gate_rows();
+    projection.resize(rows, columns);
+    if (cell == RecurrentCell::LSTM) cells.resize(hidden_size, columns);
+    else candidates.resize(hidden_size, columns);
+    previous_hidden.resize(hidden_size, columns);
+    step_hidden.resize(hidden_size, batch);
+    step_gates.resize(rows, batch);
+    if (zero_state.get_rows_num() != hidden_size || zero_state.get_columns_num() != batch) {
+        zero_state.resize(hidden_size, batch);
+        zero_state.resetWithVal(0.0f);
+    }
+}
+
+/**
+ * @brief Runs the layer over a batch of sequences. The input projections of all steps are one
+ * GEMM (W_x x + bias for every column); each step adds the stacked recurrent projection W_h h_prev
+ * and runs the fused gate kernel.
+ * @param input Sequences, input_size x (steps * N), column t * N + n = step t of sample n.
+ * @param output Receives the hidden state of every step, hidden x (steps * N); resized.
+ * @param steps Steps per sequence.
+ * @throws std::runtime_error if the input does not match input_size and steps.
+ */
+void Recurrent::forward(const Matrix& input, Matrix& output, int steps) {
+    if (steps <= 0 || input.get_rows_num() != input_size || input.get_columns_num() % steps != 0) {
+        throw std::runtime_error("Recurrent input must be input_size x (steps * batch).");
+    }
+    prepare(steps, input.get_columns_num() / steps);
+    output.resize(hidden_size, input.get_columns_num());
+    Tensor(input_weights).transpose(0, 1).copy_to(input_weights_t);
+    Tensor(recurrent_weights).transpose(0, 1).copy_to(recurrent_weights_t);
+
+    projection.matrixMultiplyTransposeA(input_weights_t, input);
+    projection.addColumnVector(bias);
+    step_hidden.resetWithVal(0.0f);
+    for (int t = 0; t < steps; t++) {
+        if (t == 0) step_gates.resetWithVal(0.0f); // W_h h_prev with h_prev = 0
+        else step_gates.matrixMultiplyTransposeA(recurrent_weights_t, step_hidden);
+        if (cell == RecurrentCell::LSTM) lstm_step_forward(t, output);
+        else gru_step_forward(t, output);
+    }
+}
+
+/**
+ * @brief Fused LSTM step: activates the gates (input projection + step_gates) in place in
+ * projection, updates the cell state and writes h into step_hidden, output and previous_hidden.
+ */
+void Recurrent::lstm_step_forward(int t, Matrix& output) {
+    const int h = hidden_size;
+    const long n = batch;
+    const long sequence = long(steps) * batch;
+    const long step = long(t) * batch;
+    float* proj = projection.data();
+    const float* recurrent = step_gates.data();
+    float* cell_state = cells.data();
+    const float* zero = zero_state.data();
+    float* hidden = step_hidden.data();
+    float* out = output.data();
+    float* previous = previous_hidden.data();
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Recurrent::lstm_step", double(h) * n);
+        #pragma omp for nowait
+        for (int j = 0; j < h; j++) {
+            float* __restrict__ gi = proj + long(j) * sequence + step;
+            float* __restrict__ gf = proj + long(h + j) * sequence + step;
+            float* __restrict__ gg = proj + long(2 * h + j) * sequence + step;
+            float* __restrict__ go = proj + long(3 * h + j) * sequence + step;
+            const float* __restrict__ ri = recurrent + long(j) * n;
+            const float* __restrict__ rf = recurrent + long(h + j) * n;
+            const float* __restrict__ rg = recurrent + long(2 * h + j) * n;
+            const float* __restrict__ ro = recurrent + long(3 * h + j) * n;
+            const float* __restrict__ c_prev = t > 0 ? cell_state + long(j) * sequence + step - n : zero + long(j) * n;
+            float* __restrict__ c = cell_state + long(j) * sequence + step;
+            float* __restrict__ h_row = hidden + long(j) * n;
+            if (t == 0) std::fill(previous + long(j) * sequence, previous + long(j) * sequence + n, 0.0f);
+            #pragma omp simd
+            for (long s = 0; s < n; s++) {
+                float i = sigmoid_approx(gi[s] + ri[s]);
+                float f = sigmoid_approx(gf[s] + rf[s]);
+                float g = tanh_approx(gg[s] + rg[s]);
+                float o = sigmoid_approx(go[s] + ro[s]);
+                float c_new = f * c_prev[s] + i * g;
+                gi[s] = i;
+                gf[s] = f;
+                gg[s] = g;
+                go[s] = o;
+                c[s] = c_new;
+                h_row[s] = o * tanh_approx(c_new);
+            }
+            std::copy(h_row, h_row + n, out + long(j) * sequence + step);
+            if (t + 1 < steps) std::copy(h_row, h_row + n, previous + long(j) * sequence + step + n);
+        }
+    }
+}
+
+/**
+ * @brief Fused GRU step: activates r, z and n in place in projection, keeps W_hn h_prev + b_hn
+ * in candidates for backward and writes h into step_hidden, output and previous_hidden.
+ */
+void Recurrent::gru_step_forward(int t, Matrix& output) {
+    const int h = hidden_size;
+    const long n = batch;
+    const long sequence = long(steps) * batch;
+    const long step = long(t) * batch;
+    float* proj = projection.data();
+    const float* recurrent = step_gates.data();
+    const float* reset_bias = recurrent_bias.data();
+    float* candidate = candidates.data();
+    float* hidden = step_hidden.data();
+    float* out = output.data();
+    float* previous = previous_hidden.data();
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Recurrent::gru_step", double(h) * n);
+        #pragma omp for nowait
+        for (int j = 0; j < h; j++) {
+            float* __restrict__ gr = proj + long(j) * sequence + step;
+            float* __restrict__ gz = proj + long(h + j) * sequence + step;
+            float* __restrict__ gn = proj + long(2 * h + j) * sequence + step;
+            const float* __restrict__ rr = recurrent + long(j) * n;
+            const float* __restrict__ rz = recurrent + long(h + j) * n;
+            const float* __restrict__ rn = recurrent + long(2 * h + j) * n;
+            float* __restrict__ hn = candidate + long(j) * sequence + step;
+            float* __restrict__ h_row = hidden + long(j) * n; // h_prev on entry
+            const float b = reset_bias[j];
+            if (t == 0) std::fill(previous + long(j) * sequence, previous + long(j) * sequence + n, 0.0f);
+            #pragma omp simd
+            for (long s = 0; s < n; s++) {
+                float r = sigmoid_approx(gr[s] + rr[s]);
+                float z = sigmoid_approx(gz[s] + rz[s]);
+                float recurrent_n = rn[s] + b;
+                float candidate_n = tanh_approx(gn[s] + r * recurrent_n);
+                gr[s] = r;
+                gz[s] = z;
+                gn[s] = candidate_n;
+                hn[s] = recurrent_n;
+                h_row[s] = (1.0f - z) * candidate_n + z * h_row[s];
+            }
+            std::copy(h_row, h_row + n, out + long(j) * sequence + step);
+            if (t + 1 < steps) std::copy(h_row, h_row + n, previous + long(j) * sequence + step + n);
+        }
+    }
+}
+
+/**
+ * @brief Back-propagates through time. Each step (last to first) runs one fused kernel that
+ * turns dL/dh into the gate pre-activation gradients, and one GEMM W_h^T for dL/dh_prev; the
+ * weight gradients and grad_input are then single GEMMs over all steps, like the forward input
+ * projection. All buffers were sized by forward().
+ * @param input Input of the last forward pass.
+ * @param grad_output dL/doutput, hidden x (steps * N).
+ * @param grad_input If not null, receives dL/dinput (input_size x (steps * N)); resized.
+ * @throws std::runtime_error if the shapes do not match the last forward pass.
+ */
+void Recurrent::backward(const Matrix& input, const Matrix& grad_output, Matrix* grad_input) {
+    const int columns = steps * batch;
+    if (steps == 0 || input.get_rows_num() != input_size || input.get_columns_num() != columns || grad_output.get_rows_num() != hidden_size ||
+        grad_output.get_columns_num() != columns) {
+        throw std::runtime_error("Recurrent gradient does not match the last forward pass.");
+    }
+    const int rows = gate_rows();
+    gate_gradient.resize(rows, columns);
+    if (cell == RecurrentCell::GRU) recurrent_gate_gradient.resize(rows, columns);
+    step_gradient.resize(rows, batch);
+    hidden_gradient.resize(hidden_size, batch);
+    carry_gradient.resize(hidden_size, batch);
+    hidden_gradient.resetWithVal(0.0f);
+    carry_gradient.resetWithVal(0.0f);
+    for (int t = steps - 1; t >= 0; t--) {
+        if (cell == RecurrentCell::LSTM) lstm_step_backward(t, grad_output);
+        else gru_step_backward(t, grad_output);
+        if (t > 0) hidden_gradient.matrixMultiplyTransposeA(recurrent_weights, step_gradient); // dL/dh_prev = W_h^T g
+    }
+
+    Matrix& recurrent_grads = cell == RecurrentCell::LSTM ? gate_gradient : recurrent_gate_gradient;
+    input_weight_gradient.matrixMultiplyTransposeB(gate_gradient, input);
+    recurrent_weight_gradient.matrixMultiplyTransposeB(recurrent_grads, previous_hidden);
+    bias_gradient.setValsFromColumnSum(gate_gradient);
+    if (cell == RecurrentCell::GRU) {
+        for (int j = 0; j < hidden_size; j++) {
+            const float* row = recurrent_gate_gradient.data() + long(2 * hidden_size + j) * columns;
+            float sum = 0.0f;
+            for (int c = 0; c < columns; c++) sum += row[c];
+            recurrent_bias_gradient.data()[j] = sum;
+        }
+    }
+    if (grad_input) {
+        grad_input->resize(input_size, columns);
+        grad_input->matrixMultiplyTransposeA(input_weights, gate_gradient);
+    }
+}
+
+/**
+ * @brief Fused LSTM backward step: dh = grad_output + W_h^T g_{t+1}, then the cell and gate
+ * gradients; writes the gate pre-activation gradients into gate_gradient and step_gradient and
+ * dL/dc_prev into carry_gradient.
+ */
+void Recurrent::lstm_step_backward(int t, const Matrix& grad_output) {
+    const int h = hidden_size;
+    const long n = batch;
+    const long sequence = long(steps) * batch;
+    const long step = long(t) * batch;
+    const float* proj = projection.data();
+    const float* cell_state = cells.data();
+    const float* zero = zero_state.data();
+    const float* grad_out = grad_output.data();
+    const float* through_gemm = hidden_gradient.data();
+    float* carry = carry_gradient.data();
+    float* grads = gate_gradient.data();
+    float* step_grads = step_gradient.data();
+    const bool last = t == steps - 1;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Recurrent::lstm_step_backward", double(h) * n);
+        #pragma omp for nowait
+        for (int j = 0; j < h; j++) {
+            const float* __restrict__ i = proj + long(j) * sequence + step;
+            const float* __restrict__ f = proj + long(h + j) * sequence + step;
+            const float* __restrict__ g = proj + long(2 * h + j) * sequence + step;
+            const float* __restrict__ o = proj + long(3 * h + j) * sequence + step;
+            const float* __restrict__ c = cell_state + long(j) * sequence + step;
+            const float* __restrict__ c_prev = t > 0 ? c - n : zero + long(j) * n;
+            const float* __restrict__ dh_out = grad_out + long(j) * sequence + step;
+            const float* __restrict__ dh_next = last ? zero + long(j) * n : through_gemm + long(j) * n;
+            float* __restrict__ dc_carry = carry + long(j) * n;
+            float* __restrict__ di = grads + long(j) * sequence + step;
+            float* __restrict__ df = grads + long(h + j) * sequence + step;
+            float* __restrict__ dg = grads + long(2 * h + j) * sequence + step;
+            float* __restrict__ dout = grads + long(3 * h + j) * sequence + step;
+            float* __restrict__ si = step_grads + long(j) * n;
+            float* __restrict__ sf = step_grads + long(h + j) * n;
+            float* __restrict__ sg = step_grads + long(2 * h + j) * n;
+            float* __restrict__ so = step_grads + long(3 * h + j) * n;
+            #pragma omp simd
+            for (long s = 0; s < n; s++) {
+                float dh = dh_out[s] + dh_next[s];
+                float tc = tanh_approx(c[s]);
+                float dc = dc_carry[s] + dh * o[s] * (1.0f - tc * tc);
+                float grad_i = dc * g[s] * i[s] * (1.0f - i[s]);
+                float grad_f = dc * c_prev[s] * f[s] * (1.0f - f[s]);
+                float grad_g = dc * i[s] * (1.0f - g[s] * g[s]);
+                float grad_o = dh * tc * o[s] * (1.0f - o[s]);
+                dc_carry[s] = dc * f[s];
+                di[s] = si[s] = grad_i;
+                df[s] = sf[s] = grad_f;
+                dg[s] = sg[s] = grad_g;
+                dout[s] = so[s] = grad_o;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Fused GRU backward step: dh = grad_output + W_h^T g_{t+1} + z_{t+1} dh_{t+1}, then the
+ * gate gradients. The input-side gradient of n is dL/d(x_n) while the recurrent side receives
+ * r * dL/d(x_n), so the two are kept in gate_gradient and recurrent_gate_gradient.
+ */
+void Recurrent::gru_step_backward(int t, const Matrix& grad_output) {
+    const int h = hidden_size;
+    const long n = batch;
+    const long sequence = long(steps) * batch;
+    const long step = long(t) * batch;
+    const float* proj = projection.data();
+    const float* candidate = candidates.data();
+    const float* previous = previous_hidden.data();
+    const float* zero = zero_state.data();
+    const float* grad_out = grad_output.data();
+    const float* through_gemm = hidden_gradient.data();
+    float* carry = carry_gradient.data();
+    float* grads = gate_gradient.data();
+    float* recurrent_grads = recurrent_gate_gradient.data();
+    float* step_grads = step_gradient.data();
+    const bool last = t == steps - 1;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Recurrent::gru_step_backward", double(h) * n);
+        #pragma omp for nowait
+        for (int j = 0; j < h; j++) {
+            const float* __restrict__ r = proj + long(j) * sequence + step;
+            const float* __restrict__ z = proj + long(h + j) * sequence + step;
+            const float* __restrict__ cn = proj + long(2 * h + j) * sequence + step;
+            const float* __restrict__ hn = candidate + long(j) * sequence + step;
+            const float* __restrict__ h_prev = previous + long(j) * sequence + step;
+            const float* __restrict__ dh_out = grad_out + long(j) * sequence + step;
+            const float* __restrict__ dh_next = last ? zero + long(j) * n : through_gemm + long(j) * n;
+            float* __restrict__ dh_carry = carry + long(j) * n;
+            float* __restrict__ dr = grads + long(j) * sequence + step;
+            float* __restrict__ dz = grads + long(h + j) * sequence + step;
+            float* __restrict__ dn = grads + long(2 * h + j) * sequence + step;
+            float* __restrict__ rr = recurrent_grads + long(j) * sequence + step;
+            float* __restrict__ rz = recurrent_grads + long(h + j) * sequence + step;
+            float* __restrict__ rn = recurrent_grads + long(2 * h + j) * sequence + step;
+            float* __restrict__ sr = step_grads + long(j) * n;
+            float* __restrict__ sz = step_grads + long(h + j) * n;
+            float* __restrict__ sn = step_grads + long(2 * h + j) * n;
+            #pragma omp simd
+            for (long s = 0; s < n; s++) {
+                float dh = dh_out[s] + dh_next[s] + dh_carry[s];
+                float grad_n = dh * (1.0f - z[s]) * (1.0f - cn[s] * cn[s]);
+                float grad_z = dh * (h_prev[s] - cn[s]) * z[s] * (1.0f - z[s]);
+                float grad_r = grad_n * hn[s] * r[s] * (1.0f - r[s]);
+                float grad_hn = grad_n * r[s];
+                dh_carry[s] = dh * z[s];
+                dr[s] = rr[s] = sr[s] = grad_r;
+                dz[s] = rz[s] = sz[s] = grad_z;
+                dn[s] = grad_n;
+                rn[s] = sn[s] = grad_hn;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Applies one SGD step, weights -= learning_rate * gradient. The gradients are sums over
+ * the batch and the steps, so pass the learning rate divided by the batch size for a
+ * mean-gradient step.
+ * @param learning_rate Step size.
+ */
+void Recurrent::update_weights(float learning_rate) {
+    input_weights.addScaled(input_weight_gradient, -learning_rate);
+    recurrent_weights.addScaled(recurrent_weight_gradient, -learning_rate);
+    bias.addScaled(bias_gradient, -learning_rate);
+    if (cell == RecurrentCell::GRU) recurrent_bias.addScaled(recurrent_bias_gradient, -learning_rate);
+}
@@ -0,0 +1,82 @@
+#ifndef RECURRENT_H
+#define RECURRENT_H
+
+#include "../matrix/matrix.h"
+
+/**
+ * @brief Cell of a Recurrent layer.
+ */
+enum class RecurrentCell {
+    LSTM, ///< Gates i, f, g, o: c = f c_prev + i g, h = o tanh(c).
+    GRU ///< Gates r, z, n: n = tanh(x_n + r (W_hn h_prev + b_hn)), h = (1 - z) n + z h_prev.
+};
+
+/**
+ * @class Recurrent
+ * @brief LSTM or GRU layer over a batch of sequences.
+ *
+ * A sequence batch is a matrix of input_size x (steps * N) whose column t * N + n holds step t
+ * of sample n, so the input projections of all steps are one GEMM with all gate weights stacked
+ * (4 * hidden rows for the LSTM, 3 * hidden for the GRU). Each step then needs one stacked
+ * recurrent GEMM and one fused kernel that applies the gate nonlinearities and the state update.
+ * The hidden and cell states start at zero for every batch. Backward through time works on
+ * buffers sized by the forward pass; repeated batches of the same shape do not allocate.
+ */
+class Recurrent {
+    public:
+        Recurrent(RecurrentCell cell, int input_size, int hidden_size); ///< Uniform(-1/sqrt(hidden), 1/sqrt(hidden)) weights; LSTM forget bias 1.
+
+        void forward(const Matrix& input, Matrix& output, int steps); ///< output (hidden x (steps * N)) = hidden state of every step.
+        void backward(const Matrix& input, const Matrix& grad_output, Matrix* grad_input); ///< Sets the gradients (summed over batch and time) and optionally grad_input.
+        void update_weights(float learning_rate); ///< Applies one SGD step with the current gradients.
+
+        RecurrentCell get_cell() const { return cell; } ///< LSTM or GRU.
+        int gate_rows() const { return gates * hidden_size; } ///< Rows of the stacked gate weights.
+        Matrix& get_input_weights() { return input_weights; } ///< Stacked input weights, gate_rows() x input_size.
+        Matrix& get_recurrent_weights() { return recurrent_weights; } ///< Stacked recurrent weights, gate_rows() x hidden_size.
+        Matrix& get_bias() { return bias; } ///< Gate biases, gate_rows() x 1.
+        Matrix& get_recurrent_bias() { return recurrent_bias; } ///< Bias inside the GRU reset product, hidden x 1 (unused by the LSTM).
+        Matrix& get_input_weight_gradient() { return input_weight_gradient; } ///< Gradient of the input weights from the last backward.
+        Matrix& get_recurrent_weight_gradient() { return recurrent_weight_gradient; } ///< Gradient of the recurrent weights from the last backward.
+        Matrix& get_bias_gradient() { return bias_gradient; } ///< Gradient of the gate biases from the last backward.
+        Matrix& get_recurrent_bias_gradient() { return recurrent_bias_gradient; } ///< Gradient of the GRU reset-product bias.
+        double flops(int steps, int batch) const; ///< Multiply-add FLOPs of the GEMMs of one forward pass.
+
+    private:
+        void prepare(int steps, int batch); ///< Sizes the sequence and per-step buffers.
+        void lstm_step_forward(int t, Matrix& output);
+        void gru_step_forward(int t, Matrix& output);
+        void lstm_step_backward(int t, const Matrix& grad_output);
+        void gru_step_backward(int t, const Matrix& grad_output);
+
+        RecurrentCell cell; ///< LSTM or GRU.
+        int input_size; ///< Features per step.
+        int hidden_size; ///< Hidden units.
+        int gates; ///< Gates per hidden unit (4 or 3).
+        int steps; ///< Steps of the last forward pass.
+        int batch; ///< Samples of the last forward pass.
+        Matrix input_weights; ///< W_x, gate_rows x input_size.
+        Matrix recurrent_weights; ///< W_h, gate_rows x hidden_size.
+        Matrix bias; ///< Gate biases, added to the input projection.
+        Matrix recurrent_bias; ///< b_hn of the GRU candidate.
+        Matrix input_weight_gradient; ///< dL/dW_x.
+        Matrix recurrent_weight_gradient; ///< dL/dW_h.
+        Matrix bias_gradient; ///< dL/dbias.
+        Matrix recurrent_bias_gradient; ///< dL/db_hn.
+        Matrix input_weights_t; ///< W_x^T for the row-streaming projection GEMM.
+        Matrix recurrent_weights_t; ///< W_h^T for the row-streaming step GEMM.
+        Matrix projection; ///< gate_rows x (steps * N): input projections, overwritten with the activated gates.
+        Matrix cells; ///< LSTM cell state of every step, hidden x (steps * N).
+        Matrix candidates; ///< GRU W_hn h_prev + b_hn of every step, hidden x (steps * N).
+        Matrix previous_hidden; ///< h_prev of every step (zero for step 0), hidden x (steps * N).
+        Matrix step_hidden; ///< Hidden state of the current step, hidden x N.
+        Matrix step_gates; ///< Recurrent projection of the current step, gate_rows x N.
+        Matrix zero_state; ///< Zeros, hidden x N: the initial state.
+        Matrix gate_gradient; ///< dL/d(gate pre-activations), input side, gate_rows x (steps * N).
+        Matrix recurrent_gate_gradient; ///< GRU: dL/d(recurrent projection) of every step (the LSTM uses gate_gradient).
+        Matrix step_gradient; ///< dL/d(recurrent projection) of the current step, gate_rows x N.
+        Matrix hidden_gradient; ///< W_h^T step_gradient: dL/dh_prev through the recurrent GEMM.
+        Matrix carry_gradient; ///< LSTM dL/dc_prev, GRU z * dL/dh: the part that bypasses the GEMM.
+};
+
+#endif
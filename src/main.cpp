@@ -3,6 +3,13 @@
 #include "../tests/matrix/matrix_test.h"
 #include "../tests/functions/functions_test.h"
 #include "../tests/ann/ann_test.h"
+#include "../tests/profiling/profiling_test.h"
+#include "../tests/random/random_test.h"
+#include "../tests/data/data_test.h"
+#include "../tests/layers/layers_test.h"
+#include "../tests/graph/graph_test.h"
+#include "../tests/inference/inference_test.h"
+#include "../tests/compare/compare_test.h"
 
 int main()
 {
@@ -12,6 +19,13 @@ int main()
     if (run_matrix_tests() != 0) status = -1;
     if (run_functions_tests() != 0) status = -1;
     if (run_ann_tests() != 0) status = -1;
+    if (run_profiling_tests() != 0) status = -1;
+    if (run_random_tests() != 0) status = -1;
+    if (run_data_tests() != 0) status = -1;
+    if (run_layers_tests() != 0) status = -1;
+    if (run_graph_tests() != 0) status = -1;
+    if (run_inference_tests() != 0) status = -1;
+    if (run_compare_tests() != 0) status = -1;
 
     if (status == 0) {
         std::cout << "All tests passed successfully!\n";
@@ -19,6 +33,6 @@ int main()
         std::cerr << "Some tests failed.\n";
     }
 
-    return 0;
+    return status == 0 ? 0 : 1;
 }
 
@@ -0,0 +1,62 @@
+#include "allocation.h"
+
+static std::atomic<long unsigned> allocations(0);
+static std::atomic<long unsigned> deallocations(0);
+static std::atomic<long unsigned> allocated_bytes(0);
+static std::atomic<long unsigned> live_bytes(0);
+static std::atomic<long unsigned> peak_live_bytes(0);
+
+/**
+ * @brief Returns the current Matrix storage allocation counters.
+ * @return A snapshot of the counters.
+ */
+AllocationStats allocation_stats() {
+    AllocationStats stats;
+    stats.allocations = allocations.load(std::memory_order_relaxed);
+    stats.deallocations = deallocations.load(std::memory_order_relaxed);
+    stats.allocated_bytes = allocated_bytes.load(std::memory_order_relaxed);
+    stats.live_bytes = live_bytes.load(std::memory_order_relaxed);
+    stats.peak_live_bytes = peak_live_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/**
+ * @brief Counts one allocation and updates the live and peak byte counts.
+ * @param bytes Size of the allocation.
+ */
+void record_allocation(std::size_t bytes) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    long unsigned live = live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    long unsigned peak = peak_live_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+/**
+ * @brief Counts one deallocation.
+ * @param bytes Size of the freed allocation.
+ */
+void record_deallocation(std::size_t bytes) {
+    deallocations.fetch_add(1, std::memory_order_relaxed);
+    live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Starts measuring the peak live bytes of a scope by lowering the peak to the current
+ * live bytes. Scopes may nest; they must not overlap across threads.
+ * @return The outer peak, to be passed to end_peak_scope().
+ */
+long unsigned begin_peak_scope() {
+    return peak_live_bytes.exchange(live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Ends a peak scope.
+ * @param saved_peak The value returned by begin_peak_scope().
+ * @return The highest live bytes reached inside the scope.
+ */
+long unsigned end_peak_scope(long unsigned saved_peak) {
+    long unsigned scope_peak = peak_live_bytes.load(std::memory_order_relaxed);
+    if (saved_peak > scope_peak) peak_live_bytes.store(saved_peak, std::memory_order_relaxed);
+    return scope_peak;
+}
@@ -0,0 +1,57 @@
+#ifndef ALLOCATION_H
+#define ALLOCATION_H
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+/**
+ * @brief Snapshot of the Matrix storage allocation counters.
+ */
+struct AllocationStats {
+    long unsigned allocations = 0; ///< Number of allocations since program start.
+    long unsigned deallocations = 0; ///< Number of deallocations since program start.
+    long unsigned allocated_bytes = 0; ///< Total bytes allocated since program start.
+    long unsigned live_bytes = 0; ///< Bytes currently allocated.
+    long unsigned peak_live_bytes = 0; ///< Highest live_bytes since start (or since the enclosing peak scope began).
+};
+
+AllocationStats allocation_stats(); ///< Returns the current Matrix storage allocation counters.
+void record_allocation(std::size_t bytes); ///< Counts one allocation of Matrix storage.
+void record_deallocation(std::size_t bytes); ///< Counts one deallocation of Matrix storage.
+long unsigned begin_peak_scope(); ///< Starts measuring the peak live bytes of a scope; returns the state to restore.
+long unsigned end_peak_scope(long unsigned saved_peak); ///< Returns the peak live bytes of the scope and restores the outer peak.
+
+/**
+ * @class CountingAllocator
+ * @brief std::allocator replacement that counts allocations, bytes and live memory.
+ *
+ * Used for the storage of every Matrix and BF16Matrix so heap traffic of the training step can be attributed
+ * to phases (see Profiler) and regressions caught by the benchmarks.
+ */
+template <typename T>
+class CountingAllocator {
+    public:
+        using value_type = T;
+
+        CountingAllocator() noexcept = default;
+        template <typename U>
+        CountingAllocator(const CountingAllocator<U>&) noexcept {}
+
+        T* allocate(std::size_t n) {
+            T* p = static_cast<T*>(::operator new(n * sizeof(T)));
+            record_allocation(n * sizeof(T));
+            return p;
+        }
+        void deallocate(T* p, std::size_t n) noexcept {
+            record_deallocation(n * sizeof(T));
+            ::operator delete(p);
+        }
+
+        template <typename U>
+        bool operator==(const CountingAllocator<U>&) const noexcept { return true; }
+        template <typename U>
+        bool operator!=(const CountingAllocator<U>&) const noexcept { return false; }
+};
+
+#endif
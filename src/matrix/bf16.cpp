@@ -0,0 +1,281 @@
+#include "bf16.h"
+#include "matrix.h"
+#include "../profiling/perf_counters.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BF16_X86 1
+#endif
+
+/**
+ * @brief Rounds a float to the nearest bfloat16 value (round-to-nearest-even).
+ * Denormal inputs are flushed to a signed zero, matching the AVX512-BF16 conversion
+ * instructions so the hardware and emulated paths produce identical bit patterns.
+ * @param val The value to convert.
+ * @return The bfloat16 bit pattern.
+ */
+uint16_t float_to_bf16(float val) {
+    uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    if ((bits & 0x7F800000u) == 0x7F800000u) {
+        // Inf stays Inf; NaN keeps a set mantissa bit so it does not round to Inf.
+        return uint16_t((bits >> 16) | ((bits & 0x007FFFFFu) ? 0x0040u : 0u));
+    }
+    if ((bits & 0x7F800000u) == 0) {
+        return uint16_t((bits >> 16) & 0x8000u);
+    }
+    bits += 0x7FFFu + ((bits >> 16) & 1u);
+    return uint16_t(bits >> 16);
+}
+
+/**
+ * @brief Widens a bfloat16 value to float (exact).
+ * @param val The bfloat16 bit pattern.
+ * @return The float value.
+ */
+float bf16_to_float(uint16_t val) {
+    uint32_t bits = uint32_t(val) << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+/**
+ * @brief Returns true if the CPU supports the AVX512-BF16 conversion and dot-product instructions.
+ * The result is computed once; set ANN_NO_BF16_HW in the environment to force the emulated path.
+ */
+bool bf16_hardware_supported() {
+#ifdef BF16_X86
+    static const bool supported = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                                  __builtin_cpu_supports("avx512bf16") && std::getenv("ANN_NO_BF16_HW") == nullptr;
+    return supported;
+#else
+    return false;
+#endif
+}
+
+#ifdef BF16_X86
+__attribute__((target("avx512f,avx512bw,avx512bf16")))
+static void convert_to_bf16_avx512(const float* src, uint16_t* dst, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256bh converted = _mm512_cvtneps_pbh(_mm512_loadu_ps(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), reinterpret_cast<__m256i&>(converted));
+    }
+    for (; i < n; i++) dst[i] = float_to_bf16(src[i]);
+}
+
+__attribute__((target("avx512f")))
+static inline float horizontal_sum_avx512(__m512 v) {
+    // Reduces through memory: _mm512_reduce_add_ps trips -Wmaybe-uninitialized in GCC 12 headers at -O3.
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, v);
+    float sum = 0.0f;
+    for (int i = 0; i < 16; i++) sum += lanes[i];
+    return sum;
+}
+
+__attribute__((target("avx512f,avx512bw,avx512bf16")))
+static void gemm_nt_avx512(int m, int n, int k, const uint16_t* a, const uint16_t* b, float* c) {
+    int tail = k % 32;
+    __mmask32 tail_mask = tail ? __mmask32((1u << tail) - 1u) : 0;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("bf16_gemm_nt", double(m) * n);
+        #pragma omp for nowait
+        for (int i = 0; i < m; i++) {
+            const uint16_t* a_row = a + long(i) * k;
+            for (int j = 0; j < n; j++) {
+                const uint16_t* b_row = b + long(j) * k;
+                __m512 acc = _mm512_setzero_ps();
+                int p = 0;
+                for (; p + 32 <= k; p += 32) {
+                    __m512i va = _mm512_loadu_si512(a_row + p);
+                    __m512i vb = _mm512_loadu_si512(b_row + p);
+                    acc = _mm512_dpbf16_ps(acc, reinterpret_cast<__m512bh&>(va), reinterpret_cast<__m512bh&>(vb));
+                }
+                if (tail) {
+                    __m512i va = _mm512_maskz_loadu_epi16(tail_mask, a_row + p);
+                    __m512i vb = _mm512_maskz_loadu_epi16(tail_mask, b_row + p);
+                    acc = _mm512_dpbf16_ps(acc, reinterpret_cast<__m512bh&>(va), reinterpret_cast<__m512bh&>(vb));
+                }
+                c[long(i) * n + j] = horizontal_sum_avx512(acc);
+            }
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Converts an array of floats to bfloat16, using AVX512-BF16 when available.
+ * @param src Source values.
+ * @param dst Destination bfloat16 bit patterns.
+ * @param n Number of values.
+ */
+static void convert_to_bf16(const float* src, uint16_t* dst, int n) {
+#ifdef BF16_X86
+    if (bf16_hardware_supported()) {
+        convert_to_bf16_avx512(src, dst, n);
+        return;
+    }
+#endif
+    for (int i = 0; i < n; i++) dst[i] = float_to_bf16(src[i]);
+}
+
+/**
+ * @brief Computes c = a * b^T for bfloat16 operands with float accumulation.
+ * Both operands are row-major with the shared dimension k contiguous, so every output is a
+ * dot product of two contiguous rows. Uses VDPBF16PS when available; the emulated path
+ * widens to float and accumulates in float.
+ * @param m Rows of a (and c).
+ * @param n Rows of b (columns of c).
+ * @param k Shared dimension.
+ * @param a Matrix of m x k bfloat16 values.
+ * @param b Matrix of n x k bfloat16 values.
+ * @param c Output matrix of m x n floats.
+ */
+void bf16_gemm_nt(int m, int n, int k, const uint16_t* a, const uint16_t* b, float* c) {
+#ifdef BF16_X86
+    if (bf16_hardware_supported()) {
+        gemm_nt_avx512(m, n, k, a, b, c);
+        return;
+    }
+#endif
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("bf16_gemm_nt", double(m) * n);
+        #pragma omp for nowait
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < n; j++) {
+                float acc = 0.0f;
+                for (int p = 0; p < k; p++) {
+                    acc += bf16_to_float(a[long(i) * k + p]) * bf16_to_float(b[long(j) * k + p]);
+                }
+                c[long(i) * n + j] = acc;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Rounds an array of floats in place to bfloat16 precision.
+ * @param vals Values to round.
+ * @param n Number of values.
+ */
+void round_to_bf16(float* vals, int n) {
+    const int chunk = 256;
+    uint16_t tmp[chunk];
+    for (int first = 0; first < n; first += chunk) {
+        int count = std::min(chunk, n - first);
+        convert_to_bf16(vals + first, tmp, count);
+        for (int i = 0; i < count; i++) vals[first + i] = bf16_to_float(tmp[i]);
+    }
+}
+
+/**
+ * @brief Constructs a bfloat16 matrix with specified dimensions and initializes all values to zero.
+ * @param r Number of rows.
+ * @param c Number of columns.
+ */
+BF16Matrix::BF16Matrix(int r, int c) {
+    rows = r;
+    columns = c;
+    matrix_vals.resize(r * c, 0);
+}
+
+/**
+ * @brief Returns the number of rows in the matrix.
+ * @return The number of rows.
+ */
+int BF16Matrix::get_rows_num() {
+    return this->rows;
+}
+
+/**
+ * @brief Returns the number of columns in the matrix.
+ * @return The number of columns.
+ */
+int BF16Matrix::get_columns_num() {
+    return this->columns;
+}
+
+/**
+ * @brief Retrieves the value at a specific position in the matrix.
+ * @param row The row index.
+ * @param col The column index.
+ * @return The value widened to float.
+ */
+float BF16Matrix::get_val(int row, int col) {
+    return bf16_to_float(this->matrix_vals[row * this->columns + col]);
+}
+
+/**
+ * @brief Stores a bfloat16 copy of a float matrix, resizing this matrix to its dimensions.
+ * The existing allocation is reused when it is large enough.
+ * @param m The float matrix to convert.
+ */
+void BF16Matrix::convertFrom(const Matrix& m) {
+    rows = m.get_rows_num();
+    columns = m.get_columns_num();
+    matrix_vals.resize(rows * columns);
+    convert_to_bf16(m.data(), matrix_vals.data(), rows * columns);
+}
+
+/**
+ * @brief Stores a bfloat16 copy of the transpose of a float matrix.
+ * Used to lay a batch of column samples out sample-major, so the shared dimension of
+ * a product is contiguous for bf16_gemm_nt.
+ * @param m The float matrix to transpose and convert.
+ */
+void BF16Matrix::convertTransposedFrom(const Matrix& m) {
+    rows = m.get_columns_num();
+    columns = m.get_rows_num();
+    matrix_vals.resize(rows * columns);
+    const float* vals = m.data();
+    if (rows == 1) {
+        convert_to_bf16(vals, matrix_vals.data(), columns);
+        return;
+    }
+    #pragma omp parallel for
+    for (int r = 0; r < columns; r++) {
+        for (int c = 0; c < rows; c++) {
+            matrix_vals[c * columns + r] = float_to_bf16(vals[r * rows + c]);
+        }
+    }
+}
+
+/**
+ * @brief Widens the values into a float matrix of matching dimensions.
+ * @param m The destination matrix.
+ * @throws std::runtime_error if the dimensions do not match.
+ */
+void BF16Matrix::convertTo(Matrix& m) const {
+    if (m.get_rows_num() != rows || m.get_columns_num() != columns) {
+        throw std::runtime_error("Matrix dimensions must match for bf16 conversion.");
+    }
+    float* vals = m.data();
+    for (int i = 0; i < rows * columns; i++) vals[i] = bf16_to_float(matrix_vals[i]);
+}
+
+/**
+ * @brief Widens the transpose of the values into a float matrix, resizing it to columns x rows.
+ * Inverse of convertTransposedFrom: brings a sample-major batch back to one sample per column.
+ * @param m The destination matrix.
+ */
+void BF16Matrix::convertTransposedTo(Matrix& m) const {
+    m.resize(columns, rows);
+    float* vals = m.data();
+    if (rows == 1) {
+        for (int i = 0; i < columns; i++) vals[i] = bf16_to_float(matrix_vals[i]);
+        return;
+    }
+    #pragma omp parallel for
+    for (int r = 0; r < columns; r++) {
+        for (int c = 0; c < rows; c++) {
+            vals[r * rows + c] = bf16_to_float(matrix_vals[c * columns + r]);
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef BF16_H
+#define BF16_H
+
+#include <cstdint>
+#include <vector>
+
+#include "allocation.h"
+
+class Matrix; ///< Forward declaration of Matrix class
+
+uint16_t float_to_bf16(float val); ///< Rounds a float to the nearest bfloat16 (round-to-nearest-even).
+float bf16_to_float(uint16_t val); ///< Widens a bfloat16 value to float.
+bool bf16_hardware_supported(); ///< Returns true if the CPU supports AVX512-BF16 instructions.
+void round_to_bf16(float* vals, int n); ///< Rounds an array of floats in place to bfloat16 precision.
+void bf16_gemm_nt(int m, int n, int k, const uint16_t* a, const uint16_t* b, float* c); ///< Computes c = a * b^T with float accumulation.
+
+/**
+ * @class BF16Matrix
+ * @brief Compact 2D matrix storing bfloat16 values (half the memory of a float Matrix).
+ *
+ * Used for the weight copies, stored activations and error signals of mixed-precision training.
+ * Values are converted from and to float Matrix objects; products are computed by
+ * Matrix::matrixMultiplyBF16 with float accumulation.
+ */
+class BF16Matrix {
+    public:
+        BF16Matrix(int r, int c); ///< Constructs a matrix with specified dimensions and initializes all values to zero.
+        int get_rows_num(); ///< Gets the number of rows in the matrix.
+        int get_columns_num(); ///< Gets the number of columns in the matrix.
+        float get_val(int row, int col); ///< Gets the value at a specific position, widened to float.
+
+        void convertFrom(const Matrix& m); ///< Stores a rounded copy of a float matrix, resizing to its dimensions.
+        void convertTransposedFrom(const Matrix& m); ///< Stores a rounded copy of the transpose of a float matrix.
+        void convertTo(Matrix& m) const; ///< Widens the values into a float matrix of matching dimensions.
+        void convertTransposedTo(Matrix& m) const; ///< Widens the transpose of the values into a float matrix, resizing it.
+        long unsigned memory_bytes() const { return matrix_vals.capacity() * sizeof(uint16_t); } ///< Bytes held by the value storage.
+
+        friend class Matrix; ///< Allows Matrix kernels to read the raw bfloat16 values.
+
+    private:
+        int rows; ///< Number of rows in the matrix.
+        int columns; ///< Number of columns in the matrix.
+        std::vector<uint16_t, CountingAllocator<uint16_t>> matrix_vals; ///< Flattened 1D vector storing bfloat16 bit patterns (allocations are counted).
+};
+
+#endif
@@ -1,7 +1,11 @@
 #include "matrix.h"
+#include "bf16.h"
+#include "sparse.h"
+#include "../profiling/perf_counters.h"
+#include "../random/philox.h"
+#include <algorithm>
 #include <iostream>
 #include <cmath>
-#include <random>
 
 /**
  * @brief Constructs a matrix with specified dimensions and initializes values from an array.
@@ -45,22 +49,6 @@ void Matrix::printMatrix() {
     }
 }
 
-/**
- * @brief Returns the number of rows in the matrix.
- * @return The number of rows.
- */
-int Matrix::get_rows_num() { 
-    return this->rows; 
-}
-
-/**
- * @brief Returns the number of columns in the matrix.
- * @return The number of columns.
- */
-int Matrix::get_columns_num() { 
-    return this->columns; 
-}
-
 /**
  * @brief Retrieves the value at a specific position in the matrix.
  * @param row The row index.
@@ -89,8 +77,12 @@ Matrix& Matrix::operator+=(const Matrix& other) {
         throw std::runtime_error("Matrix dimensions must match for addition.");
     }
     
-    #pragma omp parallel for
-    for (int i=0; i<rows*columns; i++) matrix_vals[i] += other.matrix_vals[i];
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::operator+=", double(rows) * columns);
+        #pragma omp for nowait
+        for (int i=0; i<rows*columns; i++) matrix_vals[i] += other.matrix_vals[i];
+    }
     return *this;
 }
 /**
@@ -104,9 +96,13 @@ Matrix& Matrix::operator+=(const Matrix& other) {
         throw std::runtime_error("Matrix dimensions must match for subtraction.");
     }
 
-    #pragma omp parallel for
-    for (int i = 0; i < rows * columns; i++) {
-        matrix_vals[i] -= other.matrix_vals[i];
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::operator-=", double(rows) * columns);
+        #pragma omp for nowait
+        for (int i = 0; i < rows * columns; i++) {
+            matrix_vals[i] -= other.matrix_vals[i];
+        }
     }
     return *this;
 }
@@ -117,9 +113,13 @@ Matrix& Matrix::operator+=(const Matrix& other) {
  * @return A reference to the updated matrix.
  */
 Matrix& Matrix::operator*=(double scalar) {
-    #pragma omp parallel for
-    for (int i = 0; i < rows * columns; i++) {
-        matrix_vals[i] *= scalar;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::operator*=", double(rows) * columns);
+        #pragma omp for nowait
+        for (int i = 0; i < rows * columns; i++) {
+            matrix_vals[i] *= scalar;
+        }
     }
     return *this;
 }
@@ -135,9 +135,13 @@ Matrix& Matrix::operator/=(double scalar) {
         throw std::runtime_error("division by 0!");
     }
 
-    #pragma omp parallel for
-    for (int i = 0; i < rows * columns; i++) {
-        matrix_vals[i] /= scalar;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::operator/=", double(rows) * columns);
+        #pragma omp for nowait
+        for (int i = 0; i < rows * columns; i++) {
+            matrix_vals[i] /= scalar;
+        }
     }
     return *this;
 }
@@ -154,9 +158,13 @@ Matrix& Matrix::operator/=(double scalar) {
     }
 
     Matrix result(a.rows, a.columns);
-    #pragma omp parallel for
-    for (int i = 0; i < a.rows * a.columns; i++) {
-        result.matrix_vals[i] = a.matrix_vals[i] + b.matrix_vals[i];
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("operator+(Matrix,Matrix)", double(result.rows) * result.columns);
+        #pragma omp for nowait
+        for (int i = 0; i < a.rows * a.columns; i++) {
+            result.matrix_vals[i] = a.matrix_vals[i] + b.matrix_vals[i];
+        }
     }
     return result;
 }
@@ -174,9 +182,13 @@ Matrix operator-(const Matrix& a, const Matrix& b) {
     }
 
     Matrix result(a.rows, a.columns);
-    #pragma omp parallel for
-    for (int i = 0; i < a.rows * a.columns; i++) {
-        result.matrix_vals[i] = a.matrix_vals[i] - b.matrix_vals[i];
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("operator-(Matrix,Matrix)", double(result.rows) * result.columns);
+        #pragma omp for nowait
+        for (int i = 0; i < a.rows * a.columns; i++) {
+            result.matrix_vals[i] = a.matrix_vals[i] - b.matrix_vals[i];
+        }
     }
     return result;
 }
@@ -189,9 +201,13 @@ Matrix operator-(const Matrix& a, const Matrix& b) {
  */
 Matrix operator*(const Matrix& m, double scalar) {
     Matrix result(m.rows, m.columns);
-    #pragma omp parallel for
-    for (int i = 0; i < m.rows * m.columns; i++) {
-        result.matrix_vals[i] = m.matrix_vals[i] * scalar;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("operator*(Matrix,scalar)", double(result.rows) * result.columns);
+        #pragma omp for nowait
+        for (int i = 0; i < m.rows * m.columns; i++) {
+            result.matrix_vals[i] = m.matrix_vals[i] * scalar;
+        }
     }
     return result;
 }
@@ -236,9 +252,13 @@ Matrix operator^(const Matrix& a, const Matrix& b) {
     }
 
     Matrix result(a.rows, a.columns);
-    #pragma omp parallel for
-    for (int i = 0; i < a.rows * a.columns; i++) {
-        result.matrix_vals[i] = a.matrix_vals[i] * b.matrix_vals[i];
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("operator^", double(result.rows) * result.columns);
+        #pragma omp for nowait
+        for (int i = 0; i < a.rows * a.columns; i++) {
+            result.matrix_vals[i] = a.matrix_vals[i] * b.matrix_vals[i];
+        }
     }
     return result;
 }
@@ -256,9 +276,13 @@ Matrix operator/(const Matrix& m, double scalar) {
     }
 
     Matrix result(m.rows, m.columns);
-    #pragma omp parallel for
-    for (int i = 0; i < m.rows * m.columns; i++) {
-        result.matrix_vals[i] = m.matrix_vals[i] / scalar;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("operator/(Matrix,scalar)", double(result.rows) * result.columns);
+        #pragma omp for nowait
+        for (int i = 0; i < m.rows * m.columns; i++) {
+            result.matrix_vals[i] = m.matrix_vals[i] / scalar;
+        }
     }
     return result;
 }
@@ -271,9 +295,13 @@ Matrix operator/(const Matrix& m, double scalar) {
  */
 Matrix operator+(const Matrix& m, double scalar) {
     Matrix result(m.rows, m.columns);
-    #pragma omp parallel for
-    for (int i = 0; i < m.rows * m.columns; i++) {
-        result.matrix_vals[i] = m.matrix_vals[i] + scalar;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("operator+(Matrix,scalar)", double(result.rows) * result.columns);
+        #pragma omp for nowait
+        for (int i = 0; i < m.rows * m.columns; i++) {
+            result.matrix_vals[i] = m.matrix_vals[i] + scalar;
+        }
     }
     return result;
 }
@@ -296,9 +324,13 @@ Matrix operator+(double scalar, const Matrix& m) {
  */
 Matrix operator-(const Matrix& m, double scalar) {
     Matrix result(m.rows, m.columns);
-    #pragma omp parallel for
-    for (int i = 0; i < m.rows * m.columns; i++) {
-        result.matrix_vals[i] = m.matrix_vals[i] - scalar;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("operator-(Matrix,scalar)", double(result.rows) * result.columns);
+        #pragma omp for nowait
+        for (int i = 0; i < m.rows * m.columns; i++) {
+            result.matrix_vals[i] = m.matrix_vals[i] - scalar;
+        }
     }
     return result;
 }
@@ -311,9 +343,13 @@ Matrix operator-(const Matrix& m, double scalar) {
  */
 Matrix operator-(double scalar, const Matrix& m) {
     Matrix result(m.rows, m.columns);
-    #pragma omp parallel for
-    for (int i = 0; i < m.rows * m.columns; i++) {
-        result.matrix_vals[i] = scalar - m.matrix_vals[i];
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("operator-(scalar,Matrix)", double(result.rows) * result.columns);
+        #pragma omp for nowait
+        for (int i = 0; i < m.rows * m.columns; i++) {
+            result.matrix_vals[i] = scalar - m.matrix_vals[i];
+        }
     }
     return result;
 }
@@ -335,17 +371,222 @@ Matrix operator-(double scalar, const Matrix& m) {
 
     std::fill(this->matrix_vals.begin(), this->matrix_vals.end(), 0.0f);
 
-    #pragma omp parallel for
-    for (int a_row = 0; a_row < a.rows; a_row++) {
-        for (int b_col = 0; b_col < b.columns; b_col++) {
-            for (int k = 0; k < a.columns; k++) {
-                this->matrix_vals[a_row * b.columns + b_col] += 
-                    a.matrix_vals[a_row * a.columns + k] * b.matrix_vals[k * b.columns + b_col];
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::matrixMultiply", double(rows) * columns);
+        #pragma omp for nowait
+        for (int a_row = 0; a_row < a.rows; a_row++) {
+            for (int b_col = 0; b_col < b.columns; b_col++) {
+                for (int k = 0; k < a.columns; k++) {
+                    this->matrix_vals[a_row * b.columns + b_col] += 
+                        a.matrix_vals[a_row * a.columns + k] * b.matrix_vals[k * b.columns + b_col];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Computes a^T * b and stores the result in the current matrix without forming a^T.
+ * Used to back-propagate error signals through a weight matrix (W^T * e).
+ * @param a The first matrix (k x rows of the result), used transposed.
+ * @param b The second matrix (k x columns of the result).
+ * @throws std::runtime_error if the dimensions of the matrices are incompatible for multiplication.
+ */
+void Matrix::matrixMultiplyTransposeA(const Matrix& a, const Matrix& b) {
+    if (a.rows != b.rows) {
+        throw std::runtime_error("Matrix dimensions must match for multiplication.");
+    }
+
+    if (this->rows != a.columns || this->columns != b.columns) {
+        throw std::runtime_error("Result matrix dimensions do not match.");
+    }
+
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::matrixMultiplyTransposeA", double(rows) * columns);
+        #pragma omp for nowait
+        for (int r = 0; r < this->rows; r++) {
+            float* out_row = &this->matrix_vals[r * this->columns];
+            std::fill(out_row, out_row + this->columns, 0.0f);
+            for (int k = 0; k < a.rows; k++) {
+                float a_val = a.matrix_vals[k * a.columns + r];
+                const float* b_row = &b.matrix_vals[k * b.columns];
+                for (int c = 0; c < this->columns; c++) out_row[c] += a_val * b_row[c];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Computes a * b^T and stores the result in the current matrix without forming b^T.
+ * Every output is the dot product of two contiguous rows; used for weight gradients (e * a^T).
+ * @param a The first matrix (rows of the result x k).
+ * @param b The second matrix (columns of the result x k), used transposed.
+ * @throws std::runtime_error if the dimensions of the matrices are incompatible for multiplication.
+ */
+void Matrix::matrixMultiplyTransposeB(const Matrix& a, const Matrix& b) {
+    if (a.columns != b.columns) {
+        throw std::runtime_error("Matrix dimensions must match for multiplication.");
+    }
+
+    if (this->rows != a.rows || this->columns != b.rows) {
+        throw std::runtime_error("Result matrix dimensions do not match.");
+    }
+
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::matrixMultiplyTransposeB", double(rows) * columns);
+        #pragma omp for nowait
+        for (int r = 0; r < this->rows; r++) {
+            const float* a_row = &a.matrix_vals[r * a.columns];
+            for (int c = 0; c < this->columns; c++) {
+                const float* b_row = &b.matrix_vals[c * b.columns];
+                float sum = 0.0f;
+                for (int k = 0; k < a.columns; k++) sum += a_row[k] * b_row[k];
+                this->matrix_vals[r * this->columns + c] = sum;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Adds a scaled matrix to this matrix in place (this += scale * m), without a temporary.
+ * @param m The matrix to add.
+ * @param scale The factor applied to m.
+ * @throws std::runtime_error if the dimensions of the matrices do not match.
+ */
+void Matrix::addScaled(const Matrix& m, float scale) {
+    if (rows != m.rows || columns != m.columns) {
+        throw std::runtime_error("Matrix dimensions must match for addition.");
+    }
+
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::addScaled", double(rows) * columns);
+        #pragma omp for nowait
+        for (int i = 0; i < rows * columns; i++) {
+            matrix_vals[i] += scale * m.matrix_vals[i];
+        }
+    }
+}
+
+/**
+ * @brief Multiplies two bfloat16 matrices with float accumulation and stores the result in the current matrix.
+ * The second operand is passed transposed (b^T, with the shared dimension contiguous), which is
+ * the layout the AVX512-BF16 dot-product instructions need.
+ * @param a The first matrix (rows x k).
+ * @param b_transposed The transpose of the second matrix (columns x k).
+ * @throws std::runtime_error if the dimensions of the matrices are incompatible for multiplication.
+ */
+void Matrix::matrixMultiplyBF16(const BF16Matrix& a, const BF16Matrix& b_transposed) {
+    if (a.columns != b_transposed.columns) {
+        throw std::runtime_error("Matrix dimensions must match for multiplication.");
+    }
+
+    if (this->rows != a.rows || this->columns != b_transposed.rows) {
+        throw std::runtime_error("Result matrix dimensions do not match.");
+    }
+
+    bf16_gemm_nt(a.rows, b_transposed.rows, a.columns, a.matrix_vals.data(), b_transposed.matrix_vals.data(), this->matrix_vals.data());
+}
+
+/**
+ * @brief Multiplies a dense matrix by the transpose of a sparse one: this(r, c) is the dot
+ * product of row r of a with the nonzeros of row c of b. Each output row is a work item, so
+ * rows are written contiguously and a is read once; the cost is rows * nnz(b) instead of
+ * rows * a.columns * b.rows.
+ * @param a Dense matrix (rows x k), e.g. weights.
+ * @param b Sparse matrix (columns x k), e.g. an input batch with one sample per row.
+ * @throws std::runtime_error if the dimensions of the matrices are incompatible for multiplication.
+ */
+void Matrix::matrixMultiplyCSRTransposeB(const Matrix& a, const CSRMatrix& b) {
+    if (a.columns != b.columns) {
+        throw std::runtime_error("Matrix dimensions must match for multiplication.");
+    }
+
+    if (this->rows != a.rows || this->columns != b.rows) {
+        throw std::runtime_error("Result matrix dimensions do not match.");
+    }
+
+    const long* start = b.row_start.data();
+    const int* index = b.column_index.data();
+    const float* vals = b.values.data();
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::matrixMultiplyCSRTransposeB", double(rows) * b.get_nnz());
+        #pragma omp for nowait
+        for (int r = 0; r < this->rows; r++) {
+            const float* a_row = &a.matrix_vals[long(r) * a.columns];
+            float* out_row = &this->matrix_vals[long(r) * this->columns];
+            for (int c = 0; c < this->columns; c++) {
+                float sum = 0.0f;
+                for (long k = start[c]; k < start[c + 1]; k++) sum += a_row[index[k]] * vals[k];
+                out_row[c] = sum;
             }
         }
     }
 }
 
+/**
+ * @brief Adds the product of a dense and a sparse matrix: this(r, j) += sum over c of
+ * a(r, c) * b(c, j). Only the columns j where b has nonzeros are read or written, so for a
+ * weight gradient e * x the cost is rows * nnz(x) and untouched weight columns stay as they are.
+ * @param a Dense matrix (rows x k), e.g. error signals.
+ * @param b Sparse matrix (k x columns), e.g. an input batch with one sample per row.
+ * @throws std::runtime_error if the dimensions of the matrices are incompatible for multiplication.
+ */
+void Matrix::addMatrixProductCSR(const Matrix& a, const CSRMatrix& b) {
+    if (a.columns != b.rows) {
+        throw std::runtime_error("Matrix dimensions must match for multiplication.");
+    }
+
+    if (this->rows != a.rows || this->columns != b.columns) {
+        throw std::runtime_error("Result matrix dimensions do not match.");
+    }
+
+    const long* start = b.row_start.data();
+    const int* index = b.column_index.data();
+    const float* vals = b.values.data();
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::addMatrixProductCSR", double(rows) * b.get_nnz());
+        #pragma omp for nowait
+        for (int r = 0; r < this->rows; r++) {
+            const float* a_row = &a.matrix_vals[long(r) * a.columns];
+            float* out_row = &this->matrix_vals[long(r) * this->columns];
+            for (int c = 0; c < a.columns; c++) {
+                float scale = a_row[c];
+                if (scale == 0.0f) continue;
+                for (long k = start[c]; k < start[c + 1]; k++) out_row[index[k]] += scale * vals[k];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Rounds every value to bfloat16 precision in place.
+ * Emulates bfloat16 storage of a float buffer, e.g. for activations in mixed-precision training.
+ */
+void Matrix::roundToBF16() {
+    round_to_bf16(this->matrix_vals.data(), this->rows * this->columns);
+}
+
+/**
+ * @brief Checks the matrix for overflowed values.
+ * @return True if no value is infinite or NaN.
+ */
+bool Matrix::allFinite() {
+    bool finite = true;
+    for (int i = 0; i < rows * columns; i++) {
+        if (!std::isfinite(matrix_vals[i])) {
+            finite = false;
+            break;
+        }
+    }
+    return finite;
+}
+
 /**
  * @brief Performs element-wise multiplication and stores the result in the current matrix.
  * @param a The first matrix.
@@ -361,9 +602,13 @@ void Matrix::elementWiseMultiply(const Matrix& a, const Matrix& b) {
         throw std::runtime_error("Result matrix dimensions do not match.");
     }
 
-    #pragma omp parallel for
-    for (int i = 0; i < a.rows * a.columns; i++) {
-        this->matrix_vals[i] = a.matrix_vals[i] * b.matrix_vals[i];
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::elementWiseMultiply", double(rows) * columns);
+        #pragma omp for nowait
+        for (int i = 0; i < a.rows * a.columns; i++) {
+            this->matrix_vals[i] = a.matrix_vals[i] * b.matrix_vals[i];
+        }
     }
 }
 
@@ -376,69 +621,213 @@ void Matrix::setValsFormMatrix(const Matrix& m) {
         throw std::runtime_error("Matrix dimensions must match for assignment.");
     }
 
-    #pragma omp parallel for
-    for (int i = 0; i < m.rows * m.columns; i++) {
-        this->matrix_vals[i] = m.matrix_vals[i];
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::setValsFormMatrix", double(rows) * columns);
+        #pragma omp for nowait
+        for (int i = 0; i < m.rows * m.columns; i++) {
+            this->matrix_vals[i] = m.matrix_vals[i];
+        }
     }
 }
 
 /**
- * @brief Initializes the matrix with random values.
+ * @brief Copies a column vector into one column of this matrix.
+ * Runs serially so that it can be called from inside a parallel loop over columns.
+ * @param col The destination column index.
+ * @param m The source column vector (rows x 1).
+ * @throws std::runtime_error if the dimensions do not match or the column is out of range.
  */
-void Matrix::randomInit() {
-    for (int i = 0; i < this->rows * this->columns; i++) {
-        this->matrix_vals[i] = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+void Matrix::setColumnFromMatrix(int col, const Matrix& m) {
+    if (m.rows != this->rows || m.columns != 1) {
+        throw std::runtime_error("Source must be a column vector with matching rows.");
+    }
+    if (col < 0 || col >= this->columns) {
+        throw std::out_of_range("Column index out of bounds");
+    }
+
+    for (int r = 0; r < this->rows; r++) {
+        this->matrix_vals[r * this->columns + col] = m.matrix_vals[r];
     }
 }
 
-void Matrix::randomHeNormalInit() {
-    int fan_in = this->rows; // Assuming the number of input features is equal to the number of rows
-    float stddev = std::sqrt(2.0f / fan_in);
+/**
+ * @brief Adds a column vector to every column of this matrix (e.g. a bias over a batch).
+ * @param v The column vector to add (rows x 1).
+ * @throws std::runtime_error if the dimensions do not match.
+ */
+void Matrix::addColumnVector(const Matrix& v) {
+    if (v.rows != this->rows || v.columns != 1) {
+        throw std::runtime_error("Matrix dimensions must match for column vector addition.");
+    }
+
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::addColumnVector", double(rows) * columns);
+        #pragma omp for nowait
+        for (int r = 0; r < this->rows; r++) {
+            for (int c = 0; c < this->columns; c++) {
+                this->matrix_vals[r * this->columns + c] += v.matrix_vals[r];
+            }
+        }
+    }
+}
 
-    // Create a random number generator
-    static std::random_device rd;
-    static std::mt19937 gen(rd());  // Mersenne Twister engine
+/**
+ * @brief Sets this column vector to the row-wise sum over the columns of another matrix
+ * (e.g. a bias gradient summed over a batch).
+ * @param m The matrix whose columns are summed (rows x batch).
+ * @throws std::runtime_error if the dimensions do not match.
+ */
+void Matrix::setValsFromColumnSum(const Matrix& m) {
+    if (this->rows != m.rows || this->columns != 1) {
+        throw std::runtime_error("Matrix dimensions must match for column sum.");
+    }
+
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::setValsFromColumnSum", double(rows) * columns);
+        #pragma omp for nowait
+        for (int r = 0; r < m.rows; r++) {
+            float sum = 0.0f;
+            for (int c = 0; c < m.columns; c++) sum += m.matrix_vals[r * m.columns + c];
+            this->matrix_vals[r] = sum;
+        }
+    }
+}
 
-    // Create a normal distribution with mean 0 and computed stddev
-    std::normal_distribution<float> dist(0.0f, stddev);
+/**
+ * @brief Changes the dimensions of the matrix.
+ * The existing allocation is reused when it is large enough, so resizing a buffer
+ * between batch sizes does not reallocate. The values are left unspecified.
+ * @param r Number of rows.
+ * @param c Number of columns.
+ */
+void Matrix::resize(int r, int c) {
+    rows = r;
+    columns = c;
+    matrix_vals.resize(r * c);
+}
 
-    // Generate and return a sample
-    for (int i = 0; i < this->rows * this->columns; i++) {
-        this->matrix_vals[i] = dist(gen);
+/**
+ * @brief Reinterprets the row-major values with new dimensions of the same size. Nothing is
+ * moved, so a (channels * pixels) x batch activation can be used as a
+ * channels x (pixels * batch) operand of a matrix product and back.
+ * @param r Number of rows.
+ * @param c Number of columns.
+ * @throws std::runtime_error if r * c differs from the current size.
+ */
+void Matrix::reshape(int r, int c) {
+    if (long(r) * c != long(rows) * columns) {
+        throw std::runtime_error("Reshape must keep the number of elements.");
     }
+    rows = r;
+    columns = c;
 }
 
-void Matrix::randomHeUniformInit() {
+static constexpr long random_chunk = 4096; // Elements per parallel work item of the random initializers
+
+/**
+ * @brief Fills values[0, n) from a Philox stream in parallel. Element i always receives element i
+ * of the stream, so the result is bit-identical for any number of threads.
+ * @param name Kernel name for tracing and counters; must be a string literal.
+ * @param values Destination.
+ * @param n Number of elements.
+ * @param fill Writes elements [first, first + count): fill(first, count, values + first).
+ */
+template <typename Fill>
+static void parallel_random_fill(const char* name, float* values, long n, Fill fill) {
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE(name, double(n));
+        #pragma omp for nowait
+        for (long first = 0; first < n; first += random_chunk) {
+            fill(uint64_t(first), std::min(random_chunk, n - first), values + first);
+        }
+    }
+}
+
+/**
+ * @brief Initializes the matrix with uniform random values in [0, 1).
+ * @param seed Seed of the Philox stream.
+ * @param stream Stream id, e.g. the tensor or layer index.
+ */
+void Matrix::randomInit(uint64_t seed, uint64_t stream) {
+    PhiloxStream rng(seed, stream);
+    parallel_random_fill("randomInit", matrix_vals.data(), long(rows) * columns,
+                         [&](uint64_t first, long count, float* out) { rng.fill_uniform(first, count, out); });
+}
+
+/**
+ * @brief He-normal initialization: normal values with mean 0 and standard deviation sqrt(2 / fan_in).
+ * @param seed Seed of the Philox stream.
+ * @param stream Stream id, e.g. the tensor or layer index.
+ */
+void Matrix::randomHeNormalInit(uint64_t seed, uint64_t stream) {
+    int fan_in = this->rows; // Assuming the number of input features is equal to the number of rows
+    float stddev = std::sqrt(2.0f / fan_in);
+    PhiloxStream rng(seed, stream);
+    parallel_random_fill("randomHeNormalInit", matrix_vals.data(), long(rows) * columns,
+                         [&](uint64_t first, long count, float* out) { rng.fill_normal(first, count, out, 0.0f, stddev); });
+}
+
+/**
+ * @brief He-uniform initialization: uniform values in [-sqrt(6 / fan_in), sqrt(6 / fan_in)).
+ * @param seed Seed of the Philox stream.
+ * @param stream Stream id, e.g. the tensor or layer index.
+ */
+void Matrix::randomHeUniformInit(uint64_t seed, uint64_t stream) {
     int fan_in = this->rows; // Assuming the number of input features is equal to the number of rows
     float limit = std::sqrt(6.0f / fan_in);
+    PhiloxStream rng(seed, stream);
+    parallel_random_fill("randomHeUniformInit", matrix_vals.data(), long(rows) * columns,
+                         [&](uint64_t first, long count, float* out) { rng.fill_uniform(first, count, out, -limit, limit); });
+}
 
-    // Create a random number generator
-    static std::random_device rd;
-    static std::mt19937 gen(rd());  // Mersenne Twister engine
+/**
+ * @brief Initializes the matrix with uniform random values in [0, 1), using the global seed
+ * (see set_random_seed) and a fresh stream.
+ */
+void Matrix::randomInit() {
+    randomInit(random_seed(), next_random_stream());
+}
 
-    // Create a normal distribution with mean 0 and computed stddev
-    std::uniform_real_distribution<float> dist(-limit, limit);
+/**
+ * @brief He-normal initialization using the global seed and a fresh stream.
+ */
+void Matrix::randomHeNormalInit() {
+    randomHeNormalInit(random_seed(), next_random_stream());
+}
 
-    // Generate and return a sample
-    for (int i = 0; i < this->rows * this->columns; i++) {
-        this->matrix_vals[i] = dist(gen);
-    }
+/**
+ * @brief He-uniform initialization using the global seed and a fresh stream.
+ */
+void Matrix::randomHeUniformInit() {
+    randomHeUniformInit(random_seed(), next_random_stream());
 }
 
 Matrix transpose(const Matrix& m) {
     Matrix result(m.columns, m.rows);
-    #pragma omp parallel for
-    for (int r = 0; r < m.rows; r++) {
-        for (int c = 0; c < m.columns; c++) {
-            result.matrix_vals[c * m.rows + r] = m.matrix_vals[r * m.columns + c];
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("transpose", double(result.rows) * result.columns);
+        #pragma omp for nowait
+        for (int r = 0; r < m.rows; r++) {
+            for (int c = 0; c < m.columns; c++) {
+                result.matrix_vals[c * m.rows + r] = m.matrix_vals[r * m.columns + c];
+            }
         }
     }
     return result;
 }
 
 void Matrix::resetWithVal(float val) {
-    #pragma omp parallel for
-    for (int i = 0; i < rows * columns; i++) {
-        matrix_vals[i] = val;
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Matrix::resetWithVal", double(rows) * columns);
+        #pragma omp for nowait
+        for (int i = 0; i < rows * columns; i++) {
+            matrix_vals[i] = val;
+        }
     }
 }
\ No newline at end of file
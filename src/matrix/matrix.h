@@ -1,8 +1,12 @@
 #ifndef MATRIX_H
 #define MATRIX_H
+#include <cstdint>
 #include <vector>
+#include "allocation.h"
 
 class Functions; ///< Forward declaration of Functions class
+class BF16Matrix; ///< Forward declaration of BF16Matrix class
+class CSRMatrix; ///< Forward declaration of CSRMatrix class
 
 /**
  * @class Matrix
@@ -12,14 +16,19 @@ class Matrix {
     public:
         Matrix(int r, int c, float* mat); ///< Constructs a matrix with specified dimensions and initializes values from an array.
         Matrix(int r, int c); ///< Constructs a matrix with specified dimensions and initializes all values to zero.
-        int get_rows_num(); ///< Gets the number of rows in the matrix.
-        int get_columns_num(); ///< Gets the number of columns in the matrix.
+        int get_rows_num() const { return rows; } ///< Gets the number of rows in the matrix.
+        int get_columns_num() const { return columns; } ///< Gets the number of columns in the matrix.
+        float* data() { return matrix_vals.data(); } ///< Raw row-major values, for kernels outside Matrix (rows * columns floats).
+        const float* data() const { return matrix_vals.data(); } ///< Raw row-major values, read-only.
         void printMatrix(); ///< Prints the matrix to the console.
         float get_val(int row, int col); ///< Gets the value at a specific position in the matrix.
         void set_val(int row, int col, float val); ///< Sets the value at a specific position in the matrix.
-        void randomInit(); ///< Initializes the matrix with random values.
-        void randomHeNormalInit(); ///< Initializes the matrix with random values.
-        void randomHeUniformInit(); ///< Initializes the matrix with random values.
+        void randomInit(); ///< Initializes the matrix with uniform values in [0, 1) from the global seed and a fresh stream.
+        void randomHeNormalInit(); ///< He-normal initialization from the global seed and a fresh stream.
+        void randomHeUniformInit(); ///< He-uniform initialization from the global seed and a fresh stream.
+        void randomInit(uint64_t seed, uint64_t stream); ///< Uniform values in [0, 1) from stream (seed, stream).
+        void randomHeNormalInit(uint64_t seed, uint64_t stream); ///< He-normal initialization from stream (seed, stream).
+        void randomHeUniformInit(uint64_t seed, uint64_t stream); ///< He-uniform initialization from stream (seed, stream).
         
         void resetWithVal(float val);
         // Operator overloads for matrix operations
@@ -29,9 +38,22 @@ class Matrix {
         Matrix& operator/=(double scalar); ///< Divides this matrix by a scalar.
 
         void matrixMultiply(const Matrix& a, const Matrix& b); ///< Performs matrix multiplication and stores the result in the current matrix.
+        void matrixMultiplyTransposeA(const Matrix& a, const Matrix& b); ///< Stores a^T * b in the current matrix without forming a^T.
+        void matrixMultiplyTransposeB(const Matrix& a, const Matrix& b); ///< Stores a * b^T in the current matrix without forming b^T.
+        void addScaled(const Matrix& m, float scale); ///< Adds scale * m to this matrix in place.
         void elementWiseMultiply(const Matrix& a, const Matrix& b); ///< Performs element-wise multiplication and stores the result in the current matrix.
+        void matrixMultiplyBF16(const BF16Matrix& a, const BF16Matrix& b_transposed); ///< Multiplies bfloat16 matrices (a * b) with float accumulation, taking b in transposed layout.
+        void roundToBF16(); ///< Rounds every value to bfloat16 precision in place.
+        void matrixMultiplyCSRTransposeB(const Matrix& a, const CSRMatrix& b); ///< Stores a * b^T for a sparse b (one sample per row), reading only its nonzeros.
+        void addMatrixProductCSR(const Matrix& a, const CSRMatrix& b); ///< Adds a * b for a sparse b, writing only the columns where b has nonzeros.
+        bool allFinite(); ///< Returns true if no value is infinite or NaN.
 
         void setValsFormMatrix(const Matrix& m); ///< Sets the values of this matrix from another matrix.
+        void setColumnFromMatrix(int col, const Matrix& m); ///< Copies a column vector into the given column of this matrix.
+        void addColumnVector(const Matrix& v); ///< Adds a column vector to every column of this matrix.
+        void setValsFromColumnSum(const Matrix& m); ///< Sets this column vector to the sum of the columns of another matrix.
+        void resize(int r, int c); ///< Changes the dimensions of the matrix, reusing the existing storage when possible.
+        void reshape(int r, int c); ///< Reinterprets the values with new dimensions of the same size, without moving them.
 
         // Friend functions for operator overloads
         friend Matrix operator+(const Matrix& a, const Matrix& b); ///< Adds two matrices.
@@ -52,7 +74,7 @@ class Matrix {
     private:
         int rows; ///< Number of rows in the matrix.
         int columns; ///< Number of columns in the matrix.
-        std::vector<float> matrix_vals; ///< Flattened 1D vector storing matrix values.
+        std::vector<float, CountingAllocator<float>> matrix_vals; ///< Flattened 1D vector storing matrix values (allocations are counted).
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "sparse.h"
+#include "matrix.h"
+#include <stdexcept>
+
+/**
+ * @brief Constructs a matrix without nonzeros.
+ * @param r Number of rows.
+ * @param c Number of columns.
+ */
+CSRMatrix::CSRMatrix(int r, int c) : rows(r), columns(c), row_start(r + 1, 0) {}
+
+/**
+ * @brief Gets the number of rows (samples).
+ */
+int CSRMatrix::get_rows_num() const {
+    return rows;
+}
+
+/**
+ * @brief Gets the number of columns (features).
+ */
+int CSRMatrix::get_columns_num() const {
+    return columns;
+}
+
+/**
+ * @brief Gets the number of stored values.
+ */
+long CSRMatrix::get_nnz() const {
+    return row_start[rows];
+}
+
+/**
+ * @brief Gets the value at a position by a binary search of the row.
+ * @param row Row index.
+ * @param col Column index.
+ * @return The stored value, or 0 if none is stored.
+ * @throws std::runtime_error if the position is out of range.
+ */
+float CSRMatrix::get_val(int row, int col) const {
+    if (row < 0 || row >= rows || col < 0 || col >= columns) {
+        throw std::runtime_error("Index out of bounds.");
+    }
+    long low = row_start[row];
+    long high = row_start[row + 1];
+    while (low < high) {
+        long mid = (low + high) / 2;
+        if (column_index[mid] < col) low = mid + 1;
+        else high = mid;
+    }
+    return (low < row_start[row + 1] && column_index[low] == col) ? values[low] : 0.0f;
+}
+
+/**
+ * @brief Bytes of the compressed arrays.
+ */
+long unsigned CSRMatrix::memory_bytes() const {
+    return row_start.size() * sizeof(long) + column_index.size() * sizeof(int) + values.size() * sizeof(float);
+}
+
+/**
+ * @brief Removes all rows and sets the number of columns. The arrays keep their capacity, so
+ * refilling a batch of the same size does not allocate.
+ * @param c Number of columns of the rows appended next.
+ */
+void CSRMatrix::clear(int c) {
+    rows = 0;
+    columns = c;
+    row_start.assign(1, 0);
+    column_index.clear();
+    values.clear();
+}
+
+/**
+ * @brief Adds a row given by its nonzeros.
+ * @param count Number of nonzeros.
+ * @param cols Column indices, strictly increasing.
+ * @param vals Values.
+ * @throws std::runtime_error if the column indices are out of range or not increasing.
+ */
+void CSRMatrix::appendRow(int count, const int* cols, const float* vals) {
+    for (int k = 0; k < count; k++) {
+        if (cols[k] < 0 || cols[k] >= columns || (k > 0 && cols[k] <= cols[k - 1])) {
+            throw std::runtime_error("Sparse row columns must be increasing and within the matrix.");
+        }
+    }
+    column_index.insert(column_index.end(), cols, cols + count);
+    values.insert(values.end(), vals, vals + count);
+    row_start.push_back(long(values.size()));
+    rows++;
+}
+
+/**
+ * @brief Stores the nonzeros of a dense matrix.
+ * @param m The dense matrix.
+ */
+void CSRMatrix::convertFrom(const Matrix& m) {
+    const int m_rows = m.get_rows_num();
+    const int m_columns = m.get_columns_num();
+    clear(m_columns);
+    for (int r = 0; r < m_rows; r++) {
+        const float* row = m.data() + long(r) * m_columns;
+        for (int c = 0; c < m_columns; c++) {
+            if (row[c] != 0.0f) {
+                column_index.push_back(c);
+                values.push_back(row[c]);
+            }
+        }
+        row_start.push_back(long(values.size()));
+    }
+    rows = m_rows;
+}
+
+/**
+ * @brief Stores the nonzeros of the transpose of a dense matrix, so a features x batch input
+ * with one sample per column becomes one row per sample.
+ * @param m The dense matrix.
+ */
+void CSRMatrix::convertTransposedFrom(const Matrix& m) {
+    const int m_rows = m.get_rows_num();
+    const int m_columns = m.get_columns_num();
+    const float* vals = m.data();
+    clear(m_rows);
+    for (int c = 0; c < m_columns; c++) {
+        for (int r = 0; r < m_rows; r++) {
+            float v = vals[long(r) * m_columns + c];
+            if (v != 0.0f) {
+                column_index.push_back(r);
+                values.push_back(v);
+            }
+        }
+        row_start.push_back(long(values.size()));
+    }
+    rows = m_columns;
+}
+
+/**
+ * @brief Expands the matrix into a dense one.
+ * @param m The destination matrix; resized to rows x columns.
+ */
+void CSRMatrix::convertTo(Matrix& m) const {
+    m.resize(rows, columns);
+    m.resetWithVal(0.0f);
+    float* vals = m.data();
+    for (int r = 0; r < rows; r++) {
+        for (long k = row_start[r]; k < row_start[r + 1]; k++) vals[long(r) * columns + column_index[k]] = values[k];
+    }
+}
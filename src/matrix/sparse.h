@@ -0,0 +1,44 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <vector>
+
+class Matrix; ///< Forward declaration of Matrix class
+
+/**
+ * @class CSRMatrix
+ * @brief Compressed sparse row matrix: only the nonzero values are stored, with their column
+ * indices, row by row.
+ *
+ * Used for sparse input batches (bag-of-words, hashed features): each row is one sample and each
+ * column one feature, i.e. the transpose of the dense features x batch layout, so the nonzeros
+ * of a sample are contiguous. Memory is proportional to the number of nonzeros; products with
+ * dense weights are computed by Matrix::matrixMultiplyCSRTransposeB and
+ * Matrix::addMatrixProductCSR.
+ */
+class CSRMatrix {
+    public:
+        CSRMatrix(int r, int c); ///< Constructs an r x c matrix without nonzeros.
+        int get_rows_num() const; ///< Gets the number of rows (samples).
+        int get_columns_num() const; ///< Gets the number of columns (features).
+        long get_nnz() const; ///< Gets the number of stored values.
+        float get_val(int row, int col) const; ///< Gets the value at a position (0 if not stored).
+        long unsigned memory_bytes() const; ///< Bytes of the row pointers, column indices and values.
+
+        void clear(int c); ///< Removes all rows and sets the number of columns; keeps the capacity.
+        void appendRow(int count, const int* cols, const float* vals); ///< Adds a row from its nonzeros, in increasing column order.
+        void convertFrom(const Matrix& m); ///< Stores the nonzeros of a dense matrix, row by row.
+        void convertTransposedFrom(const Matrix& m); ///< Stores the nonzeros of the transpose: one row per column sample of m.
+        void convertTo(Matrix& m) const; ///< Expands into a dense matrix, resizing it.
+
+        friend class Matrix; ///< Allows Matrix kernels to read the compressed arrays.
+
+    private:
+        int rows; ///< Number of rows in the matrix.
+        int columns; ///< Number of columns in the matrix.
+        std::vector<long> row_start; ///< Offset of the first value of each row, plus the total at the end.
+        std::vector<int> column_index; ///< Column of each stored value.
+        std::vector<float> values; ///< Stored values, row by row.
+};
+
+#endif
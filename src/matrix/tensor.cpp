@@ -0,0 +1,457 @@
+#include "tensor.h"
+#include "matrix.h"
+#include "../profiling/perf_counters.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <omp.h>
+
+/**
+ * @brief Constructs an empty one-dimensional tensor of size 0.
+ */
+Tensor::Tensor() : base(nullptr), extents{}, steps{}, start(0), ndim(1) {
+    steps[0] = 1;
+}
+
+/**
+ * @brief Constructs a packed tensor filled with zeros.
+ * @param shape Extent of each dimension.
+ * @throws std::runtime_error if the shape has no or more than max_dims dimensions, or a negative extent.
+ */
+Tensor::Tensor(std::initializer_list<int> shape) : Tensor(std::vector<int>(shape)) {}
+
+/**
+ * @brief Constructs a packed tensor filled with zeros.
+ * @param shape Extent of each dimension.
+ * @throws std::runtime_error if the shape has no or more than max_dims dimensions, or a negative extent.
+ */
+Tensor::Tensor(const std::vector<int>& shape) : Tensor() {
+    set_shape(shape.data(), int(shape.size()));
+    storage = std::make_shared<Storage>(numel(), 0.0f);
+    base = storage->data();
+}
+
+/**
+ * @brief Views the values of a matrix as a rows x columns tensor without copying them. The view
+ * does not own the values: it is valid until the matrix is resized or destroyed, and writes
+ * through it are seen by the matrix.
+ * @param m The matrix.
+ */
+Tensor::Tensor(Matrix& m) : Tensor() {
+    int shape[2] = {m.get_rows_num(), m.get_columns_num()};
+    set_shape(shape, 2);
+    base = m.data();
+}
+
+/**
+ * @brief Constructs a view of a storage whose shape is set by the caller.
+ * @param storage Owner of the values (null for borrowed values).
+ * @param base First element of the storage.
+ */
+Tensor::Tensor(std::shared_ptr<Storage> storage, float* base) : Tensor() {
+    this->storage = std::move(storage);
+    this->base = base;
+}
+
+/**
+ * @brief Sets a packed row-major shape.
+ * @param shape Extent of each dimension.
+ * @param n Number of dimensions.
+ * @throws std::runtime_error if n is not in [1, max_dims] or an extent is negative.
+ */
+void Tensor::set_shape(const int* shape, int n) {
+    if (n < 1 || n > max_dims) {
+        throw std::runtime_error("Tensor must have between 1 and " + std::to_string(max_dims) + " dimensions.");
+    }
+    long step = 1;
+    for (int d = n - 1; d >= 0; d--) {
+        if (shape[d] < 0) {
+            throw std::runtime_error("Tensor extents must not be negative.");
+        }
+        extents[d] = shape[d];
+        steps[d] = step;
+        step *= shape[d];
+    }
+    ndim = n;
+    start = 0;
+}
+
+/**
+ * @brief Resolves a dimension index.
+ * @param dim Dimension; negative values count from the last one.
+ * @return The dimension in [0, dims()).
+ * @throws std::runtime_error if the dimension does not exist.
+ */
+int Tensor::wrap_dim(int dim) const {
+    if (dim < 0) dim += ndim;
+    if (dim < 0 || dim >= ndim) {
+        throw std::runtime_error("Tensor dimension out of range.");
+    }
+    return dim;
+}
+
+/**
+ * @brief Gets the extent of a dimension.
+ * @param dim Dimension; negative values count from the last one.
+ * @return The extent.
+ */
+int Tensor::size(int dim) const {
+    return extents[wrap_dim(dim)];
+}
+
+/**
+ * @brief Gets the stride of a dimension.
+ * @param dim Dimension; negative values count from the last one.
+ * @return Distance in elements between neighbouring indices of the dimension.
+ */
+long Tensor::stride(int dim) const {
+    return steps[wrap_dim(dim)];
+}
+
+/**
+ * @brief Gets the extents of all dimensions.
+ * @return The shape.
+ */
+std::vector<int> Tensor::shape() const {
+    return std::vector<int>(extents.begin(), extents.begin() + ndim);
+}
+
+/**
+ * @brief Counts the elements of the tensor.
+ * @return The product of the extents.
+ */
+long Tensor::numel() const {
+    long n = 1;
+    for (int d = 0; d < ndim; d++) n *= extents[d];
+    return n;
+}
+
+/**
+ * @brief Checks whether the elements are packed in row-major order, i.e. data()[i] is element i.
+ * Dimensions of extent 1 may have any stride.
+ * @return True if the tensor is packed.
+ */
+bool Tensor::is_contiguous() const {
+    long expected = 1;
+    for (int d = ndim - 1; d >= 0; d--) {
+        if (extents[d] == 0) return true;
+        if (extents[d] != 1 && steps[d] != expected) return false;
+        expected *= extents[d];
+    }
+    return true;
+}
+
+/**
+ * @brief Checks whether two tensors are views of the same values.
+ * @param other The other tensor.
+ * @return True if the storages are the same.
+ */
+bool Tensor::shares_storage(const Tensor& other) const {
+    return base != nullptr && base == other.base;
+}
+
+/**
+ * @brief Computes the storage position of a multi-index.
+ * @param index One index per dimension.
+ * @return Offset from base.
+ * @throws std::runtime_error if the number of indices or an index is out of range.
+ */
+long Tensor::position(std::initializer_list<int> index) const {
+    if (int(index.size()) != ndim) {
+        throw std::runtime_error("Tensor index must have one entry per dimension.");
+    }
+    long pos = start;
+    int d = 0;
+    for (int i : index) {
+        if (i < 0 || i >= extents[d]) {
+            throw std::runtime_error("Tensor index out of range.");
+        }
+        pos += i * steps[d++];
+    }
+    return pos;
+}
+
+/**
+ * @brief Gets the value at a multi-index.
+ * @param index One index per dimension.
+ * @return The value.
+ */
+float Tensor::get_val(std::initializer_list<int> index) const {
+    return base[position(index)];
+}
+
+/**
+ * @brief Sets the value at a multi-index.
+ * @param index One index per dimension.
+ * @param val The value.
+ */
+void Tensor::set_val(std::initializer_list<int> index, float val) {
+    base[position(index)] = val;
+}
+
+/**
+ * @brief Views the same elements, in the same row-major order, with a new shape.
+ * @param shape New extents; one of them may be -1 and is then inferred.
+ * @return The reshaped view.
+ */
+Tensor Tensor::reshape(std::initializer_list<int> shape) const {
+    return reshape(std::vector<int>(shape));
+}
+
+/**
+ * @brief Views the same elements, in the same row-major order, with a new shape. Packed tensors
+ * can take any shape; for strided views each group of dimensions that is merged or split must be
+ * packed within itself (e.g. a permuted tensor can split its dimensions but not merge two that
+ * were swapped). Nothing is ever copied, so the result always aliases this tensor.
+ * @param shape New extents; one of them may be -1 and is then inferred.
+ * @return The reshaped view.
+ * @throws std::runtime_error if the element count differs or the strides cannot express the
+ * new shape without a copy (use contiguous().reshape(...) then).
+ */
+Tensor Tensor::reshape(const std::vector<int>& shape) const {
+    int n = int(shape.size());
+    if (n < 1 || n > max_dims) {
+        throw std::runtime_error("Tensor must have between 1 and " + std::to_string(max_dims) + " dimensions.");
+    }
+    std::array<int, max_dims> new_extents{};
+    int inferred = -1;
+    long known = 1;
+    for (int d = 0; d < n; d++) {
+        if (shape[d] == -1 && inferred < 0) {
+            inferred = d;
+            continue;
+        }
+        if (shape[d] < 0) {
+            throw std::runtime_error("Reshape extents must not be negative (one may be -1).");
+        }
+        new_extents[d] = shape[d];
+        known *= shape[d];
+    }
+    long count = numel();
+    if (inferred >= 0) {
+        if (known == 0 || count % known != 0) {
+            throw std::runtime_error("Cannot infer the reshape extent.");
+        }
+        new_extents[inferred] = int(count / known);
+        known *= new_extents[inferred];
+    }
+    if (known != count) {
+        throw std::runtime_error("Reshape must keep the number of elements.");
+    }
+
+    Tensor result(storage, base);
+    result.set_shape(new_extents.data(), n);
+    result.start = start;
+    if (count == 0 || is_contiguous()) {
+        return result;
+    }
+
+    // Walk both shapes from the last dimension, matching each run of old dimensions that is
+    // packed within itself (a chunk) with new dimensions of the same total size.
+    int view_d = n - 1;
+    long chunk_step = steps[ndim - 1];
+    long old_count = 1;
+    long new_count = 1;
+    for (int d = ndim - 1; d >= 0; d--) {
+        old_count *= extents[d];
+        bool chunk_ends = d == 0 || (extents[d - 1] != 1 && steps[d - 1] != old_count * chunk_step);
+        if (!chunk_ends) continue;
+        while (view_d >= 0 && (new_count < old_count || new_extents[view_d] == 1)) {
+            result.steps[view_d] = new_count * chunk_step;
+            new_count *= new_extents[view_d];
+            view_d--;
+        }
+        if (new_count != old_count) {
+            throw std::runtime_error("Reshape of this strided view needs a copy; call contiguous() first.");
+        }
+        if (d > 0) {
+            chunk_step = steps[d - 1];
+            old_count = 1;
+            new_count = 1;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Reorders the dimensions without moving any value.
+ * @param order Dimension d of the result is dimension order[d] of this tensor.
+ * @return The permuted view.
+ * @throws std::runtime_error if order is not a permutation of the dimensions.
+ */
+Tensor Tensor::permute(std::initializer_list<int> order) const {
+    if (int(order.size()) != ndim) {
+        throw std::runtime_error("Permutation must list every dimension once.");
+    }
+    Tensor result = *this;
+    bool used[max_dims] = {};
+    int d = 0;
+    for (int source : order) {
+        source = wrap_dim(source);
+        if (used[source]) {
+            throw std::runtime_error("Permutation must list every dimension once.");
+        }
+        used[source] = true;
+        result.extents[d] = extents[source];
+        result.steps[d] = steps[source];
+        d++;
+    }
+    return result;
+}
+
+/**
+ * @brief Swaps two dimensions without moving any value.
+ * @param dim_a First dimension.
+ * @param dim_b Second dimension.
+ * @return The transposed view.
+ */
+Tensor Tensor::transpose(int dim_a, int dim_b) const {
+    dim_a = wrap_dim(dim_a);
+    dim_b = wrap_dim(dim_b);
+    Tensor result = *this;
+    std::swap(result.extents[dim_a], result.extents[dim_b]);
+    std::swap(result.steps[dim_a], result.steps[dim_b]);
+    return result;
+}
+
+/**
+ * @brief Restricts one dimension to the indices begin, begin + step, ... below end.
+ * @param dim Dimension to slice.
+ * @param begin First index.
+ * @param end One past the last index.
+ * @param step Distance between the kept indices.
+ * @return The sliced view.
+ * @throws std::runtime_error if the range is not inside the dimension or step is not positive.
+ */
+Tensor Tensor::slice(int dim, int begin, int end, int step) const {
+    dim = wrap_dim(dim);
+    if (begin < 0 || begin > end || end > extents[dim] || step < 1) {
+        throw std::runtime_error("Slice range must satisfy 0 <= begin <= end <= size and step >= 1.");
+    }
+    Tensor result = *this;
+    result.start += begin * steps[dim];
+    result.extents[dim] = (end - begin + step - 1) / step;
+    result.steps[dim] *= step;
+    return result;
+}
+
+/**
+ * @brief Fixes the index of one dimension and removes the dimension, e.g. one sample of a batch.
+ * @param dim Dimension to remove.
+ * @param index Index kept.
+ * @return The view, with one dimension less.
+ * @throws std::runtime_error if the index is out of range or the tensor is one-dimensional.
+ */
+Tensor Tensor::select(int dim, int index) const {
+    dim = wrap_dim(dim);
+    if (ndim == 1) {
+        throw std::runtime_error("Cannot select from a one-dimensional tensor.");
+    }
+    if (index < 0 || index >= extents[dim]) {
+        throw std::runtime_error("Tensor index out of range.");
+    }
+    Tensor result = *this;
+    result.start += index * steps[dim];
+    for (int d = dim; d < ndim - 1; d++) {
+        result.extents[d] = extents[d + 1];
+        result.steps[d] = steps[d + 1];
+    }
+    result.ndim--;
+    return result;
+}
+
+/**
+ * @brief Returns a packed version of the tensor, for kernels that need unit-stride values.
+ * @return This tensor if it already is packed (no copy), else a packed copy.
+ */
+Tensor Tensor::contiguous() const {
+    if (is_contiguous()) return *this;
+    Tensor result(shape());
+    result.copy_from(*this);
+    return result;
+}
+
+/**
+ * @brief Copies the values of a tensor of the same shape into this view, element by element in
+ * row-major order. Any strides are allowed on both sides; the innermost dimension is copied as
+ * a strided run and the runs are split across threads.
+ * @param src Tensor to copy from; must not overlap this view unless it is identical to it.
+ * @throws std::runtime_error if the shapes differ.
+ */
+void Tensor::copy_from(const Tensor& src) {
+    if (src.ndim != ndim || !std::equal(extents.begin(), extents.begin() + ndim, src.extents.begin())) {
+        throw std::runtime_error("Tensor copy requires equal shapes.");
+    }
+    long count = numel();
+    if (count == 0) return;
+    int inner = extents[ndim - 1];
+    long dst_step = steps[ndim - 1];
+    long src_step = src.steps[ndim - 1];
+    long runs = count / inner;
+
+    #pragma omp parallel
+    {
+        KERNEL_SCOPE("Tensor::copy_from", double(count));
+        int threads = omp_get_num_threads();
+        int id = omp_get_thread_num();
+        long first = runs * id / threads;
+        long last = runs * (id + 1) / threads;
+        if (first < last) {
+            // Position of run `first`, then an odometer over the outer dimensions.
+            int index[max_dims] = {};
+            long dst = start;
+            long src_pos = src.start;
+            long rest = first;
+            for (int d = ndim - 2; d >= 0; d--) {
+                index[d] = int(rest % extents[d]);
+                rest /= extents[d];
+                dst += index[d] * steps[d];
+                src_pos += index[d] * src.steps[d];
+            }
+            for (long run = first; run < last; run++) {
+                float* out = base + dst;
+                const float* in = src.base + src_pos;
+                if (dst_step == 1 && src_step == 1) {
+                    std::copy(in, in + inner, out);
+                }
+                else {
+                    for (int i = 0; i < inner; i++) out[i * dst_step] = in[i * src_step];
+                }
+                for (int d = ndim - 2; d >= 0; d--) {
+                    dst += steps[d];
+                    src_pos += src.steps[d];
+                    if (++index[d] < extents[d]) break;
+                    dst -= long(extents[d]) * steps[d];
+                    src_pos -= long(extents[d]) * src.steps[d];
+                    index[d] = 0;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Packs a two-dimensional tensor into a matrix for the Matrix kernels. The matrix is
+ * resized in place, so its storage is reused when it already holds enough values.
+ * @param m Destination matrix; becomes size(0) x size(1). Must not be viewed by this tensor.
+ * @throws std::runtime_error if the tensor is not two-dimensional.
+ */
+void Tensor::copy_to(Matrix& m) const {
+    if (ndim != 2) {
+        throw std::runtime_error("Only two-dimensional tensors can be copied to a Matrix.");
+    }
+    m.resize(extents[0], extents[1]);
+    Tensor(m).copy_from(*this);
+}
+
+/**
+ * @brief Sets every element of the view.
+ * @param val The value.
+ */
+void Tensor::fill(float val) {
+    Tensor source = *this;
+    source.base = &val;
+    source.start = 0;
+    for (int d = 0; d < ndim; d++) source.steps[d] = 0;
+    copy_from(source);
+}
@@ -0,0 +1,76 @@
+#ifndef TENSOR_H
+#define TENSOR_H
+
+#include <array>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+#include "allocation.h"
+
+class Matrix; ///< Forward declaration of Matrix class
+
+/**
+ * @class Tensor
+ * @brief N-dimensional strided view of float values (up to Tensor::max_dims dimensions).
+ *
+ * A tensor is a shape, per-dimension strides (in elements) and an offset into a storage that
+ * may be shared with other tensors. reshape (when the strides allow it), permute, transpose,
+ * slice and select only compute new metadata, so layout changes of batched activations cost
+ * no copy; contiguous() and copy_to() materialize a view when a kernel needs packed values.
+ *
+ * A Matrix is the packed row-major 2D case: Tensor(Matrix&) views its values with shape
+ * {rows, columns} and strides {columns, 1}, and copy_to(Matrix&) brings any 2D view back to the
+ * Matrix kernels.
+ */
+class Tensor {
+    public:
+        static constexpr int max_dims = 6; ///< Highest supported number of dimensions.
+
+        Tensor(); ///< Empty one-dimensional tensor of size 0.
+        Tensor(std::initializer_list<int> shape); ///< Packed tensor of the given shape filled with zeros.
+        Tensor(const std::vector<int>& shape); ///< Packed tensor of the given shape filled with zeros.
+        explicit Tensor(Matrix& m); ///< rows x columns view of a matrix; valid until the matrix is resized or destroyed.
+
+        int dims() const { return ndim; } ///< Number of dimensions.
+        int size(int dim) const; ///< Extent of a dimension (negative dim counts from the end).
+        long stride(int dim) const; ///< Step between neighbours of a dimension, in elements.
+        long offset() const { return start; } ///< Position of element (0, ..., 0) in the storage.
+        std::vector<int> shape() const; ///< Extents of all dimensions.
+        long numel() const; ///< Number of elements.
+        bool is_contiguous() const; ///< True if the elements are packed in row-major order.
+        bool shares_storage(const Tensor& other) const; ///< True if both tensors view the same storage.
+
+        float get_val(std::initializer_list<int> index) const; ///< Value at a multi-index.
+        void set_val(std::initializer_list<int> index, float val); ///< Sets the value at a multi-index.
+        float* data() { return base + start; } ///< Pointer to element (0, ..., 0).
+        const float* data() const { return base + start; } ///< Pointer to element (0, ..., 0).
+
+        Tensor reshape(std::initializer_list<int> shape) const; ///< Same elements with a new shape (one extent may be -1); never copies.
+        Tensor reshape(const std::vector<int>& shape) const; ///< Same elements with a new shape (one extent may be -1); never copies.
+        Tensor permute(std::initializer_list<int> order) const; ///< Reorders the dimensions: dimension d of the result is order[d] of this tensor.
+        Tensor transpose(int dim_a, int dim_b) const; ///< Swaps two dimensions.
+        Tensor slice(int dim, int begin, int end, int step = 1) const; ///< Indices begin, begin + step, ... below end of one dimension.
+        Tensor select(int dim, int index) const; ///< Fixes one index, removing the dimension.
+        Tensor contiguous() const; ///< This tensor if packed, else a packed copy.
+
+        void copy_from(const Tensor& src); ///< Copies the values of a tensor of the same shape into this view.
+        void copy_to(Matrix& m) const; ///< Packs a 2D tensor into a matrix, resizing it (storage is reused).
+        void fill(float val); ///< Sets every element of the view.
+
+    private:
+        using Storage = std::vector<float, CountingAllocator<float>>;
+
+        Tensor(std::shared_ptr<Storage> storage, float* base); ///< Zero-sized view of a storage, shaped by the caller.
+        void set_shape(const int* extents, int n); ///< Sets a packed shape and its row-major strides.
+        long position(std::initializer_list<int> index) const; ///< Storage position of a multi-index.
+        int wrap_dim(int dim) const; ///< Resolves negative dimensions and checks the range.
+
+        std::shared_ptr<Storage> storage; ///< Owned values; null for views of a Matrix.
+        float* base; ///< First element of the storage.
+        std::array<int, max_dims> extents; ///< Size of each dimension.
+        std::array<long, max_dims> steps; ///< Stride of each dimension, in elements.
+        long start; ///< Offset of element (0, ..., 0) from base.
+        int ndim; ///< Number of dimensions in use.
+};
+
+#endif
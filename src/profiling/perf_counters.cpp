@@ -0,0 +1,266 @@
+#include "perf_counters.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <omp.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::atomic<bool> perf_active(false);
+
+static std::mutex perf_mutex; // Guards the kernel aggregates
+static std::map<std::string, PerfKernelStats> perf_kernels;
+
+/**
+ * @brief Returns a printable name of an event.
+ * @param event The event.
+ * @return The event name.
+ */
+const char* perf_event_name(PerfEvent event) {
+    switch (event) {
+        case PerfEvent::Cycles: return "cycles";
+        case PerfEvent::Instructions: return "instructions";
+        case PerfEvent::L1DMisses: return "L1d_misses";
+        case PerfEvent::LLCMisses: return "LLC_misses";
+        case PerfEvent::DTLBMisses: return "dTLB_misses";
+        case PerfEvent::BranchMisses: return "branch_misses";
+        default: return "unknown";
+    }
+}
+
+/**
+ * @brief Returns instructions per cycle.
+ * @return IPC, or 0 if cycles or instructions were not counted.
+ */
+double PerfCounts::ipc() const {
+    if (!has(PerfEvent::Cycles) || !has(PerfEvent::Instructions) || get(PerfEvent::Cycles) <= 0.0) return 0.0;
+    return get(PerfEvent::Instructions) / get(PerfEvent::Cycles);
+}
+
+/**
+ * @brief Returns the count of an event per element.
+ * @param event The event.
+ * @param elements Number of elements the counts cover.
+ * @return The count divided by elements, or 0 if the event was not counted or elements is 0.
+ */
+double PerfCounts::per_element(PerfEvent event, double elements) const {
+    if (!has(event) || elements <= 0.0) return 0.0;
+    return get(event) / elements;
+}
+
+/**
+ * @brief Adds the counts of another region to these counts.
+ * Empty counts take the events of the other region; afterwards an event stays available only
+ * if every added region counted it.
+ * @param other Counts of the other region.
+ */
+void PerfCounts::add(const PerfCounts& other) {
+    if (other.available == 0) return;
+    for (int i = 0; i < int(PerfEvent::Count); i++) values[i] += other.values[i];
+    available = available ? (available & other.available) : other.available;
+}
+
+/**
+ * @brief Adds the difference of two readings to these counts.
+ * @param start Reading at the start of the region.
+ * @param end Reading at the end of the region.
+ */
+void PerfCounts::add_delta(const PerfCounts& start, const PerfCounts& end) {
+    PerfCounts delta;
+    delta.available = start.available & end.available;
+    for (int i = 0; i < int(PerfEvent::Count); i++) {
+        if (delta.available & (1u << i)) delta.values[i] = std::max(0.0, end.values[i] - start.values[i]);
+    }
+    add(delta);
+}
+
+#ifdef __linux__
+/**
+ * @brief Counter group of one thread. The first event that opens leads the group, so all
+ * events are scheduled together and read with a single read() call.
+ */
+struct PerfGroup {
+    int fds[int(PerfEvent::Count)];
+    uint64_t ids[int(PerfEvent::Count)];
+    int leader = -1;
+    unsigned available = 0;
+
+    PerfGroup() {
+        std::fill(fds, fds + int(PerfEvent::Count), -1);
+        if (std::getenv("ANN_NO_PERF_COUNTERS") != nullptr) return;
+        const uint32_t cache_read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        const uint32_t types[] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+                                  PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+        const uint64_t configs[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                    PERF_COUNT_HW_CACHE_L1D | cache_read_miss, PERF_COUNT_HW_CACHE_MISSES,
+                                    PERF_COUNT_HW_CACHE_DTLB | cache_read_miss, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int i = 0; i < int(PerfEvent::Count); i++) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = types[i];
+            attr.config = configs[i];
+            attr.disabled = leader < 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC));
+            if (fd < 0) continue;
+            if (ioctl(fd, PERF_EVENT_IOC_ID, &ids[i]) != 0) {
+                close(fd);
+                continue;
+            }
+            fds[i] = fd;
+            if (leader < 0) leader = fd;
+            available |= 1u << i;
+        }
+        if (leader >= 0) {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+    ~PerfGroup() {
+        for (int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+    PerfGroup(const PerfGroup&) = delete;
+    PerfGroup& operator=(const PerfGroup&) = delete;
+};
+
+/**
+ * @brief Returns the calling thread's counter group, opening it on first use.
+ */
+static PerfGroup& thread_group() {
+    thread_local PerfGroup group;
+    return group;
+}
+#endif
+
+/**
+ * @brief Returns true if at least one event can be counted on the calling thread.
+ * Hardware events are unavailable in most virtual machines and containers and when
+ * /proc/sys/kernel/perf_event_paranoid forbids them; ANN_NO_PERF_COUNTERS disables them too.
+ */
+bool perf_counters_available() {
+#ifdef __linux__
+    return thread_group().leader >= 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Starts or stops counter collection for PerfScope and the profiler.
+ * Collection is only switched on if counters are available, so instrumented code costs nothing
+ * extra on hosts without them.
+ * @param enabled Whether to collect counters.
+ * @return Whether counters are available on this host.
+ */
+bool perf_counters_set_enabled(bool enabled) {
+    bool available = perf_counters_available();
+    perf_active = enabled && available;
+    return available;
+}
+
+/**
+ * @brief Reads the calling thread's counter group with a single read() call.
+ * Counts are scaled by time enabled / time running in case the kernel multiplexed the group.
+ * @param counts Receives the cumulative counts of the thread.
+ * @return False if no event is available.
+ */
+bool perf_read(PerfCounts& counts) {
+    counts = PerfCounts();
+#ifdef __linux__
+    PerfGroup& group = thread_group();
+    if (group.leader < 0) return false;
+    uint64_t buffer[3 + 2 * int(PerfEvent::Count)];
+    ssize_t size = read(group.leader, buffer, sizeof(buffer));
+    if (size < ssize_t(3 * sizeof(uint64_t))) return false;
+    uint64_t nr = buffer[0];
+    double scale = buffer[2] > 0 ? double(buffer[1]) / double(buffer[2]) : 0.0;
+    for (uint64_t n = 0; n < nr && n < uint64_t(PerfEvent::Count); n++) {
+        uint64_t value = buffer[3 + 2 * n];
+        uint64_t id = buffer[4 + 2 * n];
+        for (int i = 0; i < int(PerfEvent::Count); i++) {
+            if ((group.available & (1u << i)) && group.ids[i] == id) {
+                counts.values[i] = double(value) * scale;
+                counts.available |= 1u << i;
+            }
+        }
+    }
+    return counts.available != 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Returns true outside parallel regions and on the master thread inside them.
+ */
+bool PerfScope::perf_is_master_thread() {
+    return omp_get_thread_num() == 0;
+}
+
+/**
+ * @brief Adds the counts of one thread's share of a kernel call to the aggregates.
+ * @param name Kernel name.
+ * @param start Counters at entry.
+ * @param end Counters at exit.
+ * @param calls Calls to add (1 from the master thread, 0 from the other threads of the team).
+ * @param elements Output elements to add.
+ */
+void perf_record_kernel(const char* name, const PerfCounts& start, const PerfCounts& end, long unsigned calls, double elements) {
+    std::lock_guard<std::mutex> lock(perf_mutex);
+    PerfKernelStats& stats = perf_kernels[name];
+    if (stats.name.empty()) stats.name = name;
+    stats.calls += calls;
+    stats.elements += elements;
+    stats.counts.add_delta(start, end);
+}
+
+/**
+ * @brief Returns the per-kernel aggregates.
+ * @return One entry per kernel that was called while collection was enabled, sorted by name.
+ */
+std::vector<PerfKernelStats> perf_kernel_report() {
+    std::lock_guard<std::mutex> lock(perf_mutex);
+    std::vector<PerfKernelStats> result;
+    for (auto& kernel : perf_kernels) result.push_back(kernel.second);
+    return result;
+}
+
+/**
+ * @brief Clears the per-kernel aggregates.
+ */
+void perf_kernel_reset() {
+    std::lock_guard<std::mutex> lock(perf_mutex);
+    perf_kernels.clear();
+}
+
+/**
+ * @brief Prints IPC and misses per output element of every kernel; "-" marks events the host cannot count.
+ */
+void print_perf_kernel_report() {
+    std::vector<PerfKernelStats> kernels = perf_kernel_report();
+    std::printf("%-36s %8s %12s %6s %10s %10s %10s %10s\n", "kernel", "calls", "elements", "IPC",
+                "L1d/elem", "LLC/elem", "dTLB/elem", "br/elem");
+    for (auto& kernel : kernels) {
+        std::printf("%-36s %8lu %12.0f", kernel.name.c_str(), kernel.calls, kernel.elements);
+        if (kernel.counts.ipc() > 0.0) std::printf(" %6.2f", kernel.counts.ipc());
+        else std::printf(" %6s", "-");
+        PerfEvent misses[] = {PerfEvent::L1DMisses, PerfEvent::LLCMisses, PerfEvent::DTLBMisses, PerfEvent::BranchMisses};
+        for (PerfEvent event : misses) {
+            if (kernel.counts.has(event)) std::printf(" %10.4f", kernel.counts.per_element(event, kernel.elements));
+            else std::printf(" %10s", "-");
+        }
+        std::printf("\n");
+    }
+}
@@ -0,0 +1,111 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "trace.h"
+
+/**
+ * @brief Hardware events read by the performance counter layer.
+ */
+enum class PerfEvent {
+    Cycles, ///< Core cycles.
+    Instructions, ///< Retired instructions.
+    L1DMisses, ///< L1 data cache read misses.
+    LLCMisses, ///< Last-level cache misses.
+    DTLBMisses, ///< Data TLB read misses.
+    BranchMisses, ///< Mispredicted branches.
+    Count ///< Number of events.
+};
+
+const char* perf_event_name(PerfEvent event); ///< Returns a printable name of an event.
+
+/**
+ * @brief Counter values of the events, scaled for multiplexing.
+ * Events the host cannot count are absent from the available mask and read as zero.
+ */
+struct PerfCounts {
+    double values[int(PerfEvent::Count)] = {}; ///< Event counts indexed by PerfEvent.
+    unsigned available = 0; ///< Bit i is set if event i was counted.
+
+    bool has(PerfEvent event) const { return available & (1u << int(event)); } ///< Whether an event was counted.
+    double get(PerfEvent event) const { return values[int(event)]; } ///< Count of an event.
+    double ipc() const; ///< Instructions per cycle, or 0 if either is unavailable.
+    double per_element(PerfEvent event, double elements) const; ///< Count of an event divided by elements (0 if unavailable).
+    void add(const PerfCounts& other); ///< Adds counts of another region; keeps the events counted in both.
+    void add_delta(const PerfCounts& start, const PerfCounts& end); ///< Adds end - start for the events counted in both readings.
+};
+
+/**
+ * @brief Counters aggregated over the calls of one instrumented kernel.
+ */
+struct PerfKernelStats {
+    std::string name; ///< Kernel name.
+    long unsigned calls = 0; ///< Number of calls.
+    double elements = 0.0; ///< Output elements produced over all calls.
+    PerfCounts counts; ///< Counters summed over all calls and threads.
+};
+
+extern std::atomic<bool> perf_active; ///< True while perf_counters_set_enabled(true) is in effect.
+
+/// Returns true if counters are being collected (always false when profiling is compiled out).
+inline bool perf_counters_enabled() {
+#ifdef ANN_DISABLE_PROFILING
+    return false;
+#else
+    return __builtin_expect(perf_active.load(std::memory_order_relaxed), false);
+#endif
+}
+
+bool perf_counters_available(); ///< Returns true if at least one event can be counted on the calling thread.
+bool perf_counters_set_enabled(bool enabled); ///< Starts or stops collection; returns whether counters are available.
+bool perf_read(PerfCounts& counts); ///< Reads the calling thread's counter group; false if no event is available.
+void perf_record_kernel(const char* name, const PerfCounts& start, const PerfCounts& end, long unsigned calls, double elements); ///< Adds one call of a kernel.
+std::vector<PerfKernelStats> perf_kernel_report(); ///< Returns the per-kernel aggregates, sorted by name.
+void perf_kernel_reset(); ///< Clears the per-kernel aggregates.
+void print_perf_kernel_report(); ///< Prints IPC and misses per element of every kernel.
+
+/**
+ * @class PerfScope
+ * @brief Counts the enclosing scope on the calling thread and adds it to the kernel aggregates.
+ *
+ * Placed inside an OpenMP parallel region, every thread adds its own counts while only the
+ * master thread adds the call and the elements, so the aggregate covers the whole team.
+ */
+class PerfScope {
+    public:
+        /**
+         * @brief Reads the counters if collection is enabled.
+         * @param name Kernel name; must be a string literal (it is stored by pointer).
+         * @param elements Output elements produced by the whole call.
+         */
+        PerfScope(const char* name, double elements) : name(name), elements(elements), active(perf_counters_enabled()) {
+            if (active) active = perf_read(start);
+        }
+        ~PerfScope() {
+            if (!active) return;
+            PerfCounts end;
+            perf_read(end);
+            bool master = perf_is_master_thread();
+            perf_record_kernel(name, start, end, master ? 1 : 0, master ? elements : 0.0);
+        }
+        PerfScope(const PerfScope&) = delete;
+        PerfScope& operator=(const PerfScope&) = delete;
+
+    private:
+        static bool perf_is_master_thread(); ///< True outside parallel regions and on thread 0 inside them.
+        const char* name; ///< Kernel name.
+        double elements; ///< Output elements of the call.
+        bool active; ///< Whether the start counters were read.
+        PerfCounts start; ///< Counters at entry.
+};
+
+/// Counts the rest of the enclosing scope: PERF_SCOPE("name", elements). The elements expression
+/// is only evaluated while counters are being collected.
+#define PERF_SCOPE(name, elements) \
+    PerfScope TRACE_CONCAT(perf_scope_, __LINE__)(name, perf_counters_enabled() ? double(elements) : 0.0)
+/// Traces and counts a matrix kernel: KERNEL_SCOPE("name", output elements).
+#define KERNEL_SCOPE(name, elements) TRACE_SCOPE(name, "matrix"); PERF_SCOPE(name, elements)
+
+#endif
@@ -0,0 +1,231 @@
+#include "profiler.h"
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_TSC 1
+#endif
+
+/**
+ * @brief Returns a printable name of a phase.
+ * @param phase The phase.
+ * @return The name, e.g. "backward".
+ */
+const char* profile_phase_name(ProfilePhase phase) {
+    switch (phase) {
+        case ProfilePhase::Forward: return "forward";
+        case ProfilePhase::Recompute: return "recompute";
+        case ProfilePhase::Loss: return "loss";
+        case ProfilePhase::Backward: return "backward";
+        case ProfilePhase::ClipGradients: return "clip_gradients";
+        case ProfilePhase::UpdateWeights: return "update_weights";
+        case ProfilePhase::Step: return "step";
+        default: return "unknown";
+    }
+}
+
+/**
+ * @brief Reads the time-stamp counter. On targets without a TSC this falls back to steady_clock
+ * nanoseconds, so timestamp_ticks_per_second() stays consistent with it.
+ * @return The current time stamp in ticks.
+ */
+uint64_t read_timestamp() {
+#ifdef PROFILER_TSC
+    return __rdtsc();
+#else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+/**
+ * @brief Returns the frequency of read_timestamp(). The TSC rate is measured once against
+ * steady_clock over about 20 ms (modern x86 CPUs have a constant-rate TSC).
+ * @return Ticks per second.
+ */
+double timestamp_ticks_per_second() {
+#ifdef PROFILER_TSC
+    static const double ticks_per_second = []() {
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = read_timestamp();
+        while (std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(20)) {}
+        uint64_t c1 = read_timestamp();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        return double(c1 - c0) / seconds;
+    }();
+    return ticks_per_second;
+#else
+    return 1e9;
+#endif
+}
+
+/**
+ * @brief Returns the achieved GFLOP/s of the entry (0 if it took no time).
+ */
+double ProfileEntry::gflops() const {
+    return seconds > 0.0 ? flops / seconds * 1e-9 : 0.0;
+}
+
+/**
+ * @brief Returns the achieved GB/s of the entry (0 if it took no time).
+ */
+double ProfileEntry::gbps() const {
+    return seconds > 0.0 ? bytes / seconds * 1e-9 : 0.0;
+}
+
+/**
+ * @brief Returns the number of floats read and written, the unit of the per-element counter rates.
+ * @return bytes / sizeof(float).
+ */
+double ProfileEntry::elements() const {
+    return bytes / sizeof(float);
+}
+
+/**
+ * @brief Finds the entry of a (phase, layer) pair.
+ * @param phase The phase.
+ * @param layer The layer index, or -1 for network-level phases.
+ * @return Pointer to the entry, or nullptr if the pair was never recorded.
+ */
+const ProfileEntry* ProfileReport::find(ProfilePhase phase, int layer) const {
+    for (auto& entry : entries) {
+        if (entry.phase == phase && entry.layer == layer) return &entry;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Returns the time of a phase summed over all its layers.
+ * @param phase The phase.
+ * @return Seconds spent in the phase.
+ */
+double ProfileReport::phase_seconds(ProfilePhase phase) const {
+    double seconds = 0.0;
+    for (auto& entry : entries) {
+        if (entry.phase == phase) seconds += entry.seconds;
+    }
+    return seconds;
+}
+
+/**
+ * @brief Prints the entries as a table, one row per (phase, layer) pair, followed by IPC and
+ * misses per element when hardware counters were collected.
+ */
+void ProfileReport::print() const {
+    std::printf("%-16s %6s %10s %12s %8s %9s %9s %10s %12s %12s\n", "phase", "layer", "calls", "total_ms", "share",
+                "GFLOP/s", "GB/s", "allocs", "alloc_bytes", "peak_bytes");
+    for (auto& entry : entries) {
+        std::printf("%-16s %6d %10lu %12.3f %7.1f%% %9.3f %9.3f %10lu %12lu %12lu\n", profile_phase_name(entry.phase), entry.layer,
+                    entry.calls, entry.seconds * 1e3, entry.fraction * 100.0, entry.gflops(), entry.gbps(),
+                    entry.allocations, entry.allocated_bytes, entry.peak_live_bytes);
+    }
+    std::printf("total: %.3f ms\n", total_seconds * 1e3);
+
+    bool counted = false;
+    for (auto& entry : entries) counted = counted || entry.counters.available != 0;
+    if (!counted) return;
+    std::printf("\n%-16s %6s %6s %10s %10s %10s %10s\n", "phase", "layer", "IPC", "L1d/elem", "LLC/elem", "dTLB/elem", "br/elem");
+    PerfEvent misses[] = {PerfEvent::L1DMisses, PerfEvent::LLCMisses, PerfEvent::DTLBMisses, PerfEvent::BranchMisses};
+    for (auto& entry : entries) {
+        std::printf("%-16s %6d", profile_phase_name(entry.phase), entry.layer);
+        if (entry.counters.ipc() > 0.0) std::printf(" %6.2f", entry.counters.ipc());
+        else std::printf(" %6s", "-");
+        for (PerfEvent event : misses) {
+            if (entry.counters.has(event) && entry.elements() > 0.0) std::printf(" %10.4f", entry.counters.per_element(event, entry.elements()));
+            else std::printf(" %10s", "-");
+        }
+        std::printf("\n");
+    }
+}
+
+/**
+ * @brief Constructs a disabled profiler with no layers.
+ */
+Profiler::Profiler() : enabled(false), layers(0) {
+    set_layers(0);
+}
+
+/**
+ * @brief Starts or stops recording. Aggregates are kept, so profiling can cover selected steps only.
+ * @param enabled Whether to record.
+ */
+void Profiler::set_enabled(bool enabled) {
+    this->enabled = enabled;
+}
+
+/**
+ * @brief Sizes the aggregates for a network and clears them.
+ * @param layers Number of weight layers.
+ */
+void Profiler::set_layers(int layers) {
+    this->layers = layers;
+    slots.assign(size_t(ProfilePhase::Count) * (layers + 1), Slot());
+}
+
+/**
+ * @brief Adds one call to the aggregates of a (phase, layer) pair.
+ * @param phase The phase.
+ * @param layer The layer index, or -1 for network-level phases.
+ * @param ticks Duration in read_timestamp() ticks.
+ * @param flops Floating-point operations of the call.
+ * @param bytes Bytes read and written by the call.
+ * @param allocated Matrix allocations, allocated bytes and peak live bytes of the call.
+ * @param counters Hardware counters of the call (empty if not collected).
+ * @throws std::out_of_range if the layer index is invalid.
+ */
+void Profiler::record(ProfilePhase phase, int layer, uint64_t ticks, double flops, double bytes,
+                      const AllocationStats& allocated, const PerfCounts& counters) {
+    if (layer < -1 || layer >= layers) {
+        throw std::out_of_range("Profiled layer index out of range.");
+    }
+    Slot& slot = slots[size_t(phase) * (layers + 1) + layer + 1];
+    slot.calls++;
+    slot.ticks += ticks;
+    slot.flops += flops;
+    slot.bytes += bytes;
+    slot.allocations += allocated.allocations;
+    slot.allocated_bytes += allocated.allocated_bytes;
+    if (allocated.peak_live_bytes > slot.peak_live_bytes) slot.peak_live_bytes = allocated.peak_live_bytes;
+    slot.counters.add(counters);
+}
+
+/**
+ * @brief Clears all aggregates.
+ */
+void Profiler::reset() {
+    set_layers(layers);
+}
+
+/**
+ * @brief Converts the aggregates to a report ordered by phase, then layer.
+ * @return The report; fractions are relative to the total profiled time, which excludes the
+ * Step phase because it already contains the other phases.
+ */
+ProfileReport Profiler::report() const {
+    ProfileReport result;
+    double ticks_per_second = timestamp_ticks_per_second();
+    for (size_t phase = 0; phase < size_t(ProfilePhase::Count); phase++) {
+        for (int layer = -1; layer < layers; layer++) {
+            const Slot& slot = slots[phase * (layers + 1) + layer + 1];
+            if (slot.calls == 0) continue;
+            ProfileEntry entry;
+            entry.phase = ProfilePhase(phase);
+            entry.layer = layer;
+            entry.calls = slot.calls;
+            entry.seconds = double(slot.ticks) / ticks_per_second;
+            entry.flops = slot.flops;
+            entry.bytes = slot.bytes;
+            entry.allocations = slot.allocations;
+            entry.allocated_bytes = slot.allocated_bytes;
+            entry.peak_live_bytes = slot.peak_live_bytes;
+            entry.counters = slot.counters;
+            if (entry.phase != ProfilePhase::Step) result.total_seconds += entry.seconds;
+            result.entries.push_back(entry);
+        }
+    }
+    for (auto& entry : result.entries) {
+        entry.fraction = result.total_seconds > 0.0 ? entry.seconds / result.total_seconds : 0.0;
+    }
+    return result;
+}
@@ -0,0 +1,172 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <vector>
+#include "timestamp.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "../matrix/allocation.h"
+
+/**
+ * @brief Phases of a training step that the profiler attributes time to.
+ */
+enum class ProfilePhase {
+    Forward, ///< forward(): z = W a + b and the activation of one layer.
+    Recompute, ///< backprop(): re-running the forward pass of a checkpoint segment.
+    Loss, ///< calcualte_loss(): loss value and output error signal (network-level, layer -1).
+    Backward, ///< backprop(): weight/bias gradients and the error signal of one layer.
+    ClipGradients, ///< clip_gradients(): gradient norm and rescaling of one layer.
+    UpdateWeights, ///< update_weights(): optimizer step of one layer.
+    Step, ///< train_epoch(): one whole training batch (spans the other phases, layer -1).
+    Count ///< Number of phases.
+};
+
+const char* profile_phase_name(ProfilePhase phase); ///< Returns a printable name of a phase.
+
+/**
+ * @brief Aggregated cost of one (phase, layer) pair.
+ */
+struct ProfileEntry {
+    ProfilePhase phase; ///< Phase of the training step.
+    int layer; ///< Weight layer index, or -1 for network-level phases.
+    long unsigned calls = 0; ///< Number of timed calls.
+    double seconds = 0.0; ///< Total wall time.
+    double flops = 0.0; ///< Total floating-point operations (nominal, see ANN for the counts).
+    double bytes = 0.0; ///< Total bytes read and written (lower bound, ignores cache reuse).
+    double fraction = 0.0; ///< Share of the total profiled time.
+    long unsigned allocations = 0; ///< Matrix storage allocations made inside the phase.
+    long unsigned allocated_bytes = 0; ///< Bytes of those allocations.
+    long unsigned peak_live_bytes = 0; ///< Highest live Matrix memory reached during any call.
+    PerfCounts counters; ///< Hardware counters of the calling thread, when collected (see perf_counters_set_enabled).
+
+    double gflops() const; ///< Achieved GFLOP/s.
+    double gbps() const; ///< Achieved GB/s.
+    double elements() const; ///< Floats read and written (bytes / 4), the unit of the per-element counter rates.
+};
+
+/**
+ * @brief Snapshot of the profiler aggregates, returned by ANN::profile_report().
+ */
+struct ProfileReport {
+    std::vector<ProfileEntry> entries; ///< One entry per (phase, layer) pair that was called.
+    double total_seconds = 0.0; ///< Sum of the time of all entries except Step (which spans the others).
+
+    const ProfileEntry* find(ProfilePhase phase, int layer) const; ///< Entry of a (phase, layer) pair, or nullptr.
+    double phase_seconds(ProfilePhase phase) const; ///< Time of a phase summed over its layers.
+    void print() const; ///< Prints the entries as a table.
+};
+
+/**
+ * @class Profiler
+ * @brief Opt-in per-layer, per-phase timing of the training step using the time-stamp counter.
+ *
+ * Disabled profilers cost one predictable branch per PROFILE_SCOPE, which skips the flop and byte
+ * estimates entirely. Building with ANN_DISABLE_PROFILING makes is_enabled() a constant false so the instrumentation compiles away.
+ */
+class Profiler {
+    public:
+        Profiler(); ///< Constructs a disabled profiler with no layers.
+        void set_enabled(bool enabled); ///< Starts or stops recording (aggregates are kept).
+#ifdef ANN_DISABLE_PROFILING
+        bool is_enabled() const { return false; }
+#else
+        bool is_enabled() const { return __builtin_expect(enabled, 0); } ///< Whether calls are being recorded.
+#endif
+        void set_layers(int layers); ///< Sizes the aggregates for a network with this many weight layers and resets them.
+        void record(ProfilePhase phase, int layer, uint64_t ticks, double flops, double bytes,
+                    const AllocationStats& allocated = AllocationStats(),
+                    const PerfCounts& counters = PerfCounts()); ///< Adds one call to the aggregates.
+        void reset(); ///< Clears all aggregates.
+        ProfileReport report() const; ///< Returns the aggregates converted to seconds.
+
+    private:
+        /**
+         * @brief Raw aggregates of one (phase, layer) pair.
+         */
+        struct Slot {
+            long unsigned calls = 0;
+            uint64_t ticks = 0;
+            double flops = 0.0;
+            double bytes = 0.0;
+            long unsigned allocations = 0;
+            long unsigned allocated_bytes = 0;
+            long unsigned peak_live_bytes = 0;
+            PerfCounts counters;
+        };
+
+        bool enabled; ///< Whether calls are being recorded.
+        int layers; ///< Number of weight layers.
+        std::vector<Slot> slots; ///< Aggregates indexed by phase * (layers + 1) + layer + 1.
+};
+
+/**
+ * @class ProfileScope
+ * @brief Times the enclosing scope and records it in a profiler when profiling is enabled,
+ * and as a trace event named after the phase when a trace is being recorded. With profiling
+ * enabled the Matrix allocations and peak live Matrix memory of the scope are recorded too,
+ * and so are the calling thread's hardware counters while they are being collected.
+ */
+class ProfileScope {
+    public:
+        /**
+         * @brief Starts timing if the profiler is enabled.
+         * @param profiler The profiler to record into.
+         * @param phase Phase of the training step.
+         * @param layer Weight layer index, or -1 for network-level phases.
+         * @param flops Floating-point operations performed in the scope.
+         * @param bytes Bytes read and written in the scope.
+         */
+        ProfileScope(Profiler& profiler, ProfilePhase phase, int layer, double flops, double bytes)
+            : profiler(profiler.is_enabled() ? &profiler : nullptr), tracing(trace_enabled()), phase(phase), layer(layer),
+              flops(flops), bytes(bytes) {
+            if (this->profiler) {
+                allocations_at_start = allocation_stats();
+                saved_peak = begin_peak_scope();
+                if (perf_counters_enabled()) perf_read(counters_at_start);
+            }
+            start = this->profiler || tracing ? read_timestamp() : 0;
+        }
+        ~ProfileScope() {
+            if (!profiler && !tracing) return;
+            uint64_t end = read_timestamp();
+            if (profiler) {
+                AllocationStats now = allocation_stats();
+                AllocationStats allocated;
+                allocated.allocations = now.allocations - allocations_at_start.allocations;
+                allocated.allocated_bytes = now.allocated_bytes - allocations_at_start.allocated_bytes;
+                allocated.peak_live_bytes = end_peak_scope(saved_peak);
+                PerfCounts counters;
+                if (counters_at_start.available) {
+                    PerfCounts counters_at_end;
+                    perf_read(counters_at_end);
+                    counters.add_delta(counters_at_start, counters_at_end);
+                }
+                profiler->record(phase, layer, end - start, flops, bytes, allocated, counters);
+            }
+            if (tracing) trace_event(profile_phase_name(phase), "ann", start, end, layer);
+        }
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+        Profiler* profiler; ///< Target profiler, nullptr when disabled.
+        bool tracing; ///< Whether a trace was being recorded at entry.
+        ProfilePhase phase; ///< Phase being timed.
+        int layer; ///< Layer being timed.
+        double flops; ///< Operations of the scope.
+        double bytes; ///< Bytes of the scope.
+        uint64_t start; ///< Time stamp at entry.
+        AllocationStats allocations_at_start; ///< Allocation counters at entry (profiling only).
+        long unsigned saved_peak = 0; ///< Peak of the enclosing scope, restored at exit.
+        PerfCounts counters_at_start; ///< Hardware counters at entry (profiling with counters only).
+};
+
+/// Profiles the rest of the enclosing scope: PROFILE_SCOPE(profiler, phase, layer, flops, bytes).
+/// The flops and bytes expressions are only evaluated while the profiler is enabled.
+#define PROFILE_SCOPE(profiler, phase, layer, flops, bytes)                                                   \
+    ProfileScope TRACE_CONCAT(profile_scope_, __LINE__)((profiler), (phase), (layer),                        \
+                                                        (profiler).is_enabled() ? double(flops) : 0.0,       \
+                                                        (profiler).is_enabled() ? double(bytes) : 0.0)
+
+#endif
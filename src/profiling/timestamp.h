@@ -0,0 +1,9 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <cstdint>
+
+uint64_t read_timestamp(); ///< Reads the time-stamp counter (steady_clock nanoseconds where no TSC is available).
+double timestamp_ticks_per_second(); ///< Frequency of read_timestamp(), calibrated once against steady_clock.
+
+#endif
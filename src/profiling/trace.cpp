@@ -0,0 +1,142 @@
+#include "trace.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+std::atomic<bool> trace_active(false);
+
+/**
+ * @brief One buffered complete event.
+ */
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    uint64_t start;
+    uint64_t end;
+    int layer;
+};
+
+/**
+ * @brief Event buffer of one thread. Only its owner appends, so recording takes no lock;
+ * flushing reads it from another thread, which is safe once parallel regions have joined.
+ */
+struct TraceBuffer {
+    int tid;
+    std::vector<TraceEvent> events;
+};
+
+static std::mutex trace_mutex; // Guards registration of buffers and the output file
+static std::vector<std::unique_ptr<TraceBuffer>> trace_buffers;
+static std::ofstream trace_file;
+static uint64_t trace_origin = 0;
+static bool trace_first_event = true;
+static std::atomic<unsigned> trace_generation(0); // Bumped by trace_start so stale thread-local buffers re-register
+
+/**
+ * @brief Returns the calling thread's buffer, registering it on first use in this trace.
+ */
+static TraceBuffer* thread_buffer() {
+    thread_local TraceBuffer* buffer = nullptr;
+    thread_local unsigned generation = 0;
+    if (buffer == nullptr || generation != trace_generation) {
+        std::lock_guard<std::mutex> lock(trace_mutex);
+        trace_buffers.push_back(std::make_unique<TraceBuffer>());
+        buffer = trace_buffers.back().get();
+        buffer->tid = int(trace_buffers.size()) - 1;
+        buffer->events.reserve(4096);
+        generation = trace_generation;
+    }
+    return buffer;
+}
+
+/**
+ * @brief Opens a Chrome trace (JSON array format, viewable in chrome://tracing or Perfetto)
+ * and starts recording. Events are buffered per thread until trace_flush() or trace_stop().
+ * @param path Output file.
+ * @throws std::runtime_error if a trace is already active or the file cannot be opened.
+ */
+void trace_start(const std::string& path) {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (trace_active) {
+        throw std::runtime_error("A trace is already being recorded.");
+    }
+    trace_file.open(path, std::ios::out | std::ios::trunc);
+    if (!trace_file) {
+        throw std::runtime_error("Cannot open trace file: " + path);
+    }
+    trace_buffers.clear();
+    trace_generation++;
+    trace_first_event = true;
+    trace_file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    timestamp_ticks_per_second(); // Calibrate before the first event, not inside it
+    trace_origin = read_timestamp();
+    trace_active = true;
+}
+
+/**
+ * @brief Buffers one complete event on the calling thread.
+ * @param name Event name (string literal).
+ * @param category Event category (string literal).
+ * @param start Time stamp at the start of the event.
+ * @param end Time stamp at the end of the event.
+ * @param layer Layer argument, or -1 for none.
+ */
+void trace_event(const char* name, const char* category, uint64_t start, uint64_t end, int layer) {
+    if (!trace_enabled()) return;
+    thread_buffer()->events.push_back({name, category, start, end, layer});
+}
+
+/**
+ * @brief Writes one separator-prefixed JSON event object.
+ */
+static void write_event_prefix() {
+    trace_file << (trace_first_event ? "\n" : ",\n");
+    trace_first_event = false;
+}
+
+/**
+ * @brief Appends the buffered events of all threads to the trace file and empties the buffers.
+ * Call it between parallel regions (e.g. after a batch or an epoch) to bound memory use.
+ */
+void trace_flush() {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    if (!trace_file.is_open()) return;
+    double us_per_tick = 1e6 / timestamp_ticks_per_second();
+    for (auto& buffer : trace_buffers) {
+        for (auto& event : buffer->events) {
+            // Signed differences: counters of different cores may be slightly apart, so a scope can
+            // start before the origin or end before it started
+            int64_t start = int64_t(event.start - trace_origin);
+            int64_t duration = std::max<int64_t>(int64_t(event.end - event.start), 0);
+            write_event_prefix();
+            trace_file << "{\"name\": \"" << event.name << "\", \"cat\": \"" << event.category << "\", \"ph\": \"X\", \"ts\": "
+                       << double(start) * us_per_tick << ", \"dur\": " << double(duration) * us_per_tick
+                       << ", \"pid\": 1, \"tid\": " << buffer->tid;
+            if (event.layer >= 0) trace_file << ", \"args\": {\"layer\": " << event.layer << "}";
+            trace_file << "}";
+        }
+        buffer->events.clear();
+    }
+    trace_file.flush();
+}
+
+/**
+ * @brief Stops recording, flushes the remaining events, names the threads and closes the file.
+ */
+void trace_stop() {
+    if (!trace_active) return;
+    trace_active = false;
+    trace_flush();
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    for (auto& buffer : trace_buffers) {
+        write_event_prefix();
+        trace_file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->tid
+                   << ", \"args\": {\"name\": \"thread " << buffer->tid << "\"}}";
+    }
+    trace_file << "\n]}\n";
+    trace_file.close();
+}
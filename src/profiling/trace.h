@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "timestamp.h"
+
+extern std::atomic<bool> trace_active; ///< Set while a trace is being recorded.
+
+void trace_start(const std::string& path); ///< Opens a Chrome trace file and starts recording on all threads.
+void trace_flush(); ///< Appends the buffered events of all threads to the trace file (call outside parallel regions).
+void trace_stop(); ///< Flushes, closes the trace file and stops recording.
+void trace_event(const char* name, const char* category, uint64_t start, uint64_t end, int layer); ///< Buffers one complete event on the calling thread.
+
+/**
+ * @brief Returns true while a trace is being recorded. Building with ANN_DISABLE_PROFILING
+ * makes this a constant false so trace scopes compile away.
+ */
+inline bool trace_enabled() {
+#ifdef ANN_DISABLE_PROFILING
+    return false;
+#else
+    return __builtin_expect(trace_active.load(std::memory_order_relaxed), 0);
+#endif
+}
+
+/**
+ * @class TraceScope
+ * @brief Records the enclosing scope as a complete ("X") event on the calling thread's buffer.
+ */
+class TraceScope {
+    public:
+        /**
+         * @brief Starts the event if tracing is active.
+         * @param name Event name; must be a string literal (it is stored by pointer).
+         * @param category Event category shown in the trace viewer.
+         * @param layer Layer index stored as an event argument, or -1 for none.
+         */
+        TraceScope(const char* name, const char* category = "ann", int layer = -1)
+            : name(name), category(category), layer(layer), start(trace_enabled() ? read_timestamp() : 0) {}
+        ~TraceScope() {
+            if (start != 0) trace_event(name, category, start, read_timestamp(), layer);
+        }
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+        const char* name; ///< Event name.
+        const char* category; ///< Event category.
+        int layer; ///< Layer argument (-1 for none).
+        uint64_t start; ///< Time stamp at entry, 0 when tracing was inactive.
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+/// Traces the rest of the enclosing scope: TRACE_SCOPE("name"), TRACE_SCOPE("name", "category") or TRACE_SCOPE("name", "category", layer).
+#define TRACE_SCOPE(...) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
+
+#endif
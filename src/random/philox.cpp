@@ -0,0 +1,321 @@
+#include "philox.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PHILOX_X86 1
+#endif
+
+static constexpr uint32_t philox_m0 = 0xD2511F53u; // Multiplier of counter word 0
+static constexpr uint32_t philox_m1 = 0xCD9E8D57u; // Multiplier of counter word 2
+static constexpr uint32_t philox_w0 = 0x9E3779B9u; // Key schedule increment of key word 0 (golden ratio)
+static constexpr uint32_t philox_w1 = 0xBB67AE85u; // Key schedule increment of key word 1 (sqrt(3) - 1)
+static constexpr int philox_rounds = 10;
+static constexpr float two_pi = 6.28318530717958647692f;
+static constexpr float inv_2_24 = 1.0f / 16777216.0f;
+
+static std::once_flag seed_once;
+static std::atomic<uint64_t> global_seed(0);
+static std::atomic<uint64_t> stream_counter(0);
+
+/**
+ * @brief Computes one Philox4x32-10 block (Salmon et al., "Parallel random numbers: as easy
+ * as 1, 2, 3", SC 2011). Ten rounds of two 32x32->64 bit multiplications mix the counter
+ * under a Weyl-sequence key schedule; the output passes BigCrush for any counter sequence.
+ * @param counter The 128-bit counter.
+ * @param key The 64-bit key.
+ * @return The 128 random bits of the block.
+ */
+std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key) {
+    for (int round = 0; round < philox_rounds; round++) {
+        uint64_t p0 = uint64_t(philox_m0) * counter[0];
+        uint64_t p1 = uint64_t(philox_m1) * counter[2];
+        counter = {uint32_t(p1 >> 32) ^ counter[1] ^ key[0], uint32_t(p1), uint32_t(p0 >> 32) ^ counter[3] ^ key[1], uint32_t(p0)};
+        key[0] += philox_w0;
+        key[1] += philox_w1;
+    }
+    return counter;
+}
+
+/**
+ * @brief Sets the seed used by the initializers that take no seed and restarts the stream ids,
+ * so a model built after this call gets the same weights in every run.
+ * @param seed The seed.
+ */
+void set_random_seed(uint64_t seed) {
+    std::call_once(seed_once, [] {});
+    global_seed = seed;
+    stream_counter = 0;
+}
+
+/**
+ * @brief Returns the global seed. Unless set_random_seed was called, it is read once from the
+ * ANN_SEED environment variable or, if that is unset, drawn from std::random_device.
+ * @return The seed.
+ */
+uint64_t random_seed() {
+    std::call_once(seed_once, [] {
+        const char* env = std::getenv("ANN_SEED");
+        if (env != nullptr) {
+            global_seed = std::strtoull(env, nullptr, 0);
+        } else {
+            std::random_device rd;
+            global_seed = (uint64_t(rd()) << 32) | rd();
+        }
+    });
+    return global_seed;
+}
+
+/**
+ * @brief Returns a fresh stream id, so tensors initialized without an explicit stream draw
+ * independent values under the same seed. Ids count up from 2^32 to stay clear of the small
+ * ids that callers pass explicitly (layer indices, for example).
+ * @return The stream id.
+ */
+uint64_t next_random_stream() {
+    return (uint64_t(1) << 32) + stream_counter.fetch_add(1);
+}
+
+/**
+ * @brief Returns true if the CPU supports AVX-512F, which generates 16 blocks per iteration.
+ * The result is computed once; set ANN_NO_SIMD_RNG in the environment to force the scalar path.
+ * Both paths produce identical bits.
+ */
+bool philox_simd_supported() {
+#ifdef PHILOX_X86
+    static const bool supported = __builtin_cpu_supports("avx512f") && std::getenv("ANN_NO_SIMD_RNG") == nullptr;
+    return supported;
+#else
+    return false;
+#endif
+}
+
+#ifdef PHILOX_X86
+// GCC 12 reports the _mm512_undefined_* placeholders inside these intrinsics as maybe-uninitialized at -O3.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+/**
+ * @brief High and low halves of the 32x32->64 bit products of 16 lanes with a constant.
+ * vpmuludq multiplies the even lanes only, so the odd lanes are shifted down and multiplied
+ * separately, then the high halves of both are merged.
+ */
+__attribute__((target("avx512f")))
+static inline void mul_hi_lo_avx512(__m512i a, __m512i m, __m512i& hi, __m512i& lo) {
+    __m512i even = _mm512_mul_epu32(a, m);
+    __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), m);
+    hi = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+    lo = _mm512_mullo_epi32(a, m);
+}
+
+/**
+ * @brief Generates blocks [block, block + count) with count a multiple of 16, one block per lane.
+ * The four output words of each lane are transposed back to block order before the store.
+ */
+__attribute__((target("avx512f")))
+static void philox_blocks_avx512(uint64_t block, long count, std::array<uint32_t, 2> key, uint32_t stream_lo,
+                                 uint32_t stream_hi, uint32_t* out) {
+    const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m512i m0 = _mm512_set1_epi32(int(philox_m0));
+    const __m512i m1 = _mm512_set1_epi32(int(philox_m1));
+    for (long b = 0; b < count; b += 16, out += 64) {
+        uint64_t first = block + uint64_t(b);
+        __m512i c0 = _mm512_add_epi32(_mm512_set1_epi32(int(uint32_t(first))), lane);
+        // Lanes whose low word wrapped carry into the high word of the block index.
+        __mmask16 carry = _mm512_cmplt_epu32_mask(c0, _mm512_set1_epi32(int(uint32_t(first))));
+        __m512i c1 = _mm512_mask_add_epi32(_mm512_set1_epi32(int(uint32_t(first >> 32))), carry,
+                                           _mm512_set1_epi32(int(uint32_t(first >> 32))), _mm512_set1_epi32(1));
+        __m512i c2 = _mm512_set1_epi32(int(stream_lo));
+        __m512i c3 = _mm512_set1_epi32(int(stream_hi));
+        uint32_t k0 = key[0];
+        uint32_t k1 = key[1];
+        for (int round = 0; round < philox_rounds; round++) {
+            __m512i hi0, lo0, hi1, lo1;
+            mul_hi_lo_avx512(c0, m0, hi0, lo0);
+            mul_hi_lo_avx512(c2, m1, hi1, lo1);
+            c0 = _mm512_xor_si512(_mm512_xor_si512(hi1, c1), _mm512_set1_epi32(int(k0)));
+            c1 = lo1;
+            c2 = _mm512_xor_si512(_mm512_xor_si512(hi0, c3), _mm512_set1_epi32(int(k1)));
+            c3 = lo0;
+            k0 += philox_w0;
+            k1 += philox_w1;
+        }
+        // 4x16 transpose: c<j> holds word j of all blocks; per 128-bit lane L, t<i> holds block 4L+i.
+        __m512i ab_lo = _mm512_unpacklo_epi32(c0, c1);
+        __m512i ab_hi = _mm512_unpackhi_epi32(c0, c1);
+        __m512i cd_lo = _mm512_unpacklo_epi32(c2, c3);
+        __m512i cd_hi = _mm512_unpackhi_epi32(c2, c3);
+        __m512i t0 = _mm512_unpacklo_epi64(ab_lo, cd_lo);
+        __m512i t1 = _mm512_unpackhi_epi64(ab_lo, cd_lo);
+        __m512i t2 = _mm512_unpacklo_epi64(ab_hi, cd_hi);
+        __m512i t3 = _mm512_unpackhi_epi64(ab_hi, cd_hi);
+        __m512i s0 = _mm512_shuffle_i32x4(t0, t1, 0x44);
+        __m512i s1 = _mm512_shuffle_i32x4(t2, t3, 0x44);
+        __m512i s2 = _mm512_shuffle_i32x4(t0, t1, 0xEE);
+        __m512i s3 = _mm512_shuffle_i32x4(t2, t3, 0xEE);
+        _mm512_storeu_si512(out, _mm512_shuffle_i32x4(s0, s1, 0x88));
+        _mm512_storeu_si512(out + 16, _mm512_shuffle_i32x4(s0, s1, 0xDD));
+        _mm512_storeu_si512(out + 32, _mm512_shuffle_i32x4(s2, s3, 0x88));
+        _mm512_storeu_si512(out + 48, _mm512_shuffle_i32x4(s2, s3, 0xDD));
+    }
+}
+#pragma GCC diagnostic pop
+#endif
+
+/**
+ * @brief Generates the blocks [block, block + count) of a stream into out (4 words per block).
+ */
+static void philox_blocks(uint64_t block, long count, std::array<uint32_t, 2> key, uint32_t stream_lo, uint32_t stream_hi,
+                          uint32_t* out) {
+    long b = 0;
+#ifdef PHILOX_X86
+    if (philox_simd_supported()) {
+        long vectorized = count - count % 16;
+        philox_blocks_avx512(block, vectorized, key, stream_lo, stream_hi, out);
+        b = vectorized;
+    }
+#endif
+    for (; b < count; b++) {
+        uint64_t index = block + uint64_t(b);
+        std::array<uint32_t, 4> words = philox4x32({uint32_t(index), uint32_t(index >> 32), stream_lo, stream_hi}, key);
+        for (int w = 0; w < 4; w++) out[4 * b + w] = words[w];
+    }
+}
+
+/**
+ * @brief Maps 32 random bits to a float in [0, 1) using the top 24 bits, so every value is exact.
+ */
+static inline float bits_to_uniform(uint32_t bits) {
+    return float(bits >> 8) * inv_2_24;
+}
+
+/**
+ * @brief Box-Muller transform of two 32-bit words into two standard normal floats.
+ * The first uniform is taken in (0, 1] so the logarithm is finite.
+ */
+static inline void box_muller(uint32_t a, uint32_t b, float& n0, float& n1) {
+    float radius = std::sqrt(-2.0f * std::log(float((a >> 8) + 1u) * inv_2_24));
+    float angle = two_pi * bits_to_uniform(b);
+    n0 = radius * std::cos(angle);
+    n1 = radius * std::sin(angle);
+}
+
+/**
+ * @brief Creates the stream of a (seed, stream) pair; construction does no work.
+ * @param seed Run seed, used as the Philox key.
+ * @param stream Stream id, e.g. a tensor or layer index; occupies the upper counter words.
+ */
+PhiloxStream::PhiloxStream(uint64_t seed, uint64_t stream)
+    : key{uint32_t(seed), uint32_t(seed >> 32)}, stream_lo(uint32_t(stream)), stream_hi(uint32_t(stream >> 32)) {}
+
+/**
+ * @brief Returns 32 random bits of one element.
+ * @param index Element index within the stream.
+ * @return Word index % 4 of block index / 4.
+ */
+uint32_t PhiloxStream::bits(uint64_t index) const {
+    uint64_t block = index >> 2;
+    return philox4x32({uint32_t(block), uint32_t(block >> 32), stream_lo, stream_hi}, key)[index & 3];
+}
+
+/**
+ * @brief Returns a uniform float in [0, 1) of one element.
+ * @param index Element index within the stream.
+ */
+float PhiloxStream::uniform(uint64_t index) const {
+    return bits_to_uniform(bits(index));
+}
+
+/**
+ * @brief Returns a standard normal float of one element. Words 0 and 1 and words 2 and 3 of a
+ * block form the Box-Muller pairs, so the value of an element does not depend on the range it
+ * is generated in.
+ * @param index Element index within the stream.
+ */
+float PhiloxStream::normal(uint64_t index) const {
+    uint64_t block = index >> 2;
+    std::array<uint32_t, 4> words = philox4x32({uint32_t(block), uint32_t(block >> 32), stream_lo, stream_hi}, key);
+    int pair = int(index & 2);
+    float n0, n1;
+    box_muller(words[pair], words[pair + 1], n0, n1);
+    return (index & 1) ? n1 : n0;
+}
+
+/**
+ * @brief Returns an integer in [0, bound) of one element, by the multiply-shift mapping
+ * (bias below bound / 2^32, negligible for shuffling indices).
+ * @param index Element index within the stream.
+ * @param bound Exclusive upper bound.
+ */
+uint32_t PhiloxStream::below(uint64_t index, uint32_t bound) const {
+    return uint32_t((uint64_t(bits(index)) * bound) >> 32);
+}
+
+/**
+ * @brief Writes the raw bits of elements [first, first + n). Whole blocks are generated in
+ * batches (16 per iteration with AVX-512); a partial block at either end is generated per element.
+ * @param first Index of the first element.
+ * @param n Number of elements.
+ * @param out Destination of n words.
+ */
+void PhiloxStream::fill_bits(uint64_t first, long n, uint32_t* out) const {
+    while (n > 0 && (first & 3) != 0) {
+        *out++ = bits(first++);
+        n--;
+    }
+    long blocks = n / 4;
+    philox_blocks(first >> 2, blocks, key, stream_lo, stream_hi, out);
+    out += 4 * blocks;
+    first += uint64_t(4 * blocks);
+    for (long i = 4 * blocks; i < n; i++) *out++ = bits(first++);
+}
+
+static constexpr long fill_batch = 256; // Words generated per batch by the float fills (stays in L1)
+
+/**
+ * @brief Writes uniform floats in [low, high) of elements [first, first + n).
+ * @param first Index of the first element.
+ * @param n Number of elements.
+ * @param out Destination of n floats.
+ * @param low Inclusive lower bound.
+ * @param high Exclusive upper bound.
+ */
+void PhiloxStream::fill_uniform(uint64_t first, long n, float* out, float low, float high) const {
+    uint32_t words[fill_batch];
+    float scale = high - low;
+    for (long done = 0; done < n; done += fill_batch) {
+        long count = std::min(fill_batch, n - done);
+        fill_bits(first + uint64_t(done), count, words);
+        for (long i = 0; i < count; i++) out[done + i] = low + scale * bits_to_uniform(words[i]);
+    }
+}
+
+/**
+ * @brief Writes normal floats of elements [first, first + n); element values match normal().
+ * @param first Index of the first element.
+ * @param n Number of elements.
+ * @param out Destination of n floats.
+ * @param mean Mean of the distribution.
+ * @param stddev Standard deviation of the distribution.
+ */
+void PhiloxStream::fill_normal(uint64_t first, long n, float* out, float mean, float stddev) const {
+    // Work in whole Box-Muller pairs: start at an even element and drop the extra values.
+    uint64_t start = first & ~uint64_t(1);
+    long skip = long(first - start);
+    uint32_t words[fill_batch];
+    long written = 0;
+    for (uint64_t pair_start = start; written < n; pair_start += fill_batch) {
+        long count = std::min(fill_batch, ((skip + n - written) + 1) & ~1L);
+        fill_bits(pair_start, count, words);
+        for (long i = 0; i < count && written < n; i += 2) {
+            float n0, n1;
+            box_muller(words[i], words[i + 1], n0, n1);
+            if (skip == 0) out[written++] = mean + stddev * n0;
+            else skip--;
+            if (written < n) out[written++] = mean + stddev * n1;
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <array>
+#include <cstdint>
+
+std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key); ///< One Philox4x32-10 block.
+
+void set_random_seed(uint64_t seed); ///< Sets the seed used by the initializers that take no seed and restarts their stream ids.
+uint64_t random_seed(); ///< Returns the global seed (ANN_SEED from the environment, else drawn once from std::random_device).
+uint64_t next_random_stream(); ///< Returns a fresh stream id for a tensor initialized without an explicit stream.
+
+/**
+ * @class PhiloxStream
+ * @brief Seekable random stream identified by (seed, stream), e.g. (run seed, tensor id).
+ *
+ * Element i of the stream depends only on seed, stream and i: block i / 4 of the generator
+ * (counter = {block, stream}, key = seed) supplies the 32 bits of lane i % 4. Any range of a
+ * stream can therefore be produced independently, which lets threads fill disjoint chunks of
+ * a tensor and obtain the same values for any thread count.
+ */
+class PhiloxStream {
+    public:
+        PhiloxStream(uint64_t seed, uint64_t stream);
+
+        uint32_t bits(uint64_t index) const; ///< 32 random bits of element index.
+        float uniform(uint64_t index) const; ///< Uniform float in [0, 1) of element index.
+        float normal(uint64_t index) const; ///< Standard normal float of element index (Box-Muller).
+        uint32_t below(uint64_t index, uint32_t bound) const; ///< Integer in [0, bound) of element index.
+
+        void fill_bits(uint64_t first, long n, uint32_t* out) const; ///< Elements [first, first + n) as raw bits.
+        void fill_uniform(uint64_t first, long n, float* out, float low = 0.0f, float high = 1.0f) const; ///< Uniform in [low, high).
+        void fill_normal(uint64_t first, long n, float* out, float mean = 0.0f, float stddev = 1.0f) const; ///< Normal(mean, stddev).
+
+    private:
+        std::array<uint32_t, 2> key; ///< Seed as the Philox key.
+        uint32_t stream_lo; ///< Low half of the stream id (counter word 2).
+        uint32_t stream_hi; ///< High half of the stream id (counter word 3).
+};
+
+bool philox_simd_supported(); ///< Returns true if block generation uses AVX-512.
+
+#endif
@@ -0,0 +1,30 @@
+#include <algorithm>
+#include <cmath>
+#include "../../src/random/philox.h"
+#include "test_values.h"
+
+/**
+ * @brief Fills a matrix with uniform values in [-1, 1). Every stream gives different values
+ * and the same stream always gives the same ones, whatever the global seed.
+ * @param m The matrix to fill.
+ * @param stream Philox stream of the test seed.
+ */
+void fill_test_values(Matrix& m, uint64_t stream) {
+    PhiloxStream rng(77, stream);
+    for (int r = 0; r < m.get_rows_num(); r++) {
+        for (int c = 0; c < m.get_columns_num(); c++) m.set_val(r, c, 2.0f * rng.uniform(uint64_t(r) * m.get_columns_num() + c) - 1.0f);
+    }
+}
+
+/**
+ * @brief Returns the largest absolute difference of two matrices of equal shape.
+ * @param a The first matrix.
+ * @param b The second matrix.
+ * @return The largest |a - b| over all elements.
+ */
+float max_difference(Matrix& a, Matrix& b) {
+    float worst = 0.0f;
+    for (int r = 0; r < a.get_rows_num(); r++)
+        for (int c = 0; c < a.get_columns_num(); c++) worst = std::max(worst, std::fabs(a.get_val(r, c) - b.get_val(r, c)));
+    return worst;
+}
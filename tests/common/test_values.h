@@ -0,0 +1,10 @@
+#ifndef TEST_VALUES_H
+#define TEST_VALUES_H
+
+#include <cstdint>
+#include "../../src/matrix/matrix.h"
+
+void fill_test_values(Matrix& m, uint64_t stream); ///< Fills a matrix with uniform values in [-1, 1) from a fixed Philox stream.
+float max_difference(Matrix& a, Matrix& b); ///< Returns the largest absolute difference of two matrices of equal shape.
+
+#endif
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <vector>
+#include "../../bench/common/compare.h"
+#include "compare_test.h"
+
+/**
+ * @brief Builds a case with one median per run and a few repetitions spread around each.
+ */
+static BenchResult bench_case(const std::vector<double>& run_medians_us) {
+    BenchResult result{"case", {}, run_medians_us};
+    for (double median : run_medians_us) {
+        for (double offset : {-2.0, -1.0, 0.0, 1.0, 2.0}) result.samples_us.push_back(median + offset);
+    }
+    return result;
+}
+
+/**
+ * @brief Checks the regression gate with 3, 4 and 5 runs per side: a clear slowdown is flagged
+ * whatever the run count (3 runs per side cannot reach alpha = 0.05 on the per-run medians, so
+ * those fall back to the pooled repetitions), and run-to-run noise is not.
+ */
+int test_bench_comparison() {
+    std::vector<double> baseline_runs = {100.0, 101.0, 99.0, 100.5, 99.5};
+    std::vector<double> slower_runs = {150.0, 151.0, 149.0, 150.5, 149.5};
+    std::vector<double> noisy_runs = {101.0, 99.0, 100.0, 99.5, 100.5};
+    for (size_t runs = 3; runs <= 5; runs++) {
+        std::vector<double> before(baseline_runs.begin(), baseline_runs.begin() + runs);
+        std::vector<double> after(slower_runs.begin(), slower_runs.begin() + runs);
+        std::vector<double> noise(noisy_runs.begin(), noisy_runs.begin() + runs);
+        std::vector<BenchComparison> regressed = compare_bench_results({bench_case(before)}, {bench_case(after)}, 5.0, 0.05);
+        if (regressed.size() != 1 || !regressed[0].regression || regressed[0].p_value >= 0.05) {
+            std::cout << "test_bench_comparison FAILED: a 50% slowdown over " << runs << " runs per side was not flagged.\n";
+            return -1;
+        }
+        if (regressed[0].per_run != (runs >= 4)) {
+            std::cout << "test_bench_comparison FAILED: " << runs << " runs per side tested "
+                      << (regressed[0].per_run ? "per-run medians" : "pooled repetitions") << ".\n";
+            return -1;
+        }
+        std::vector<BenchComparison> same = compare_bench_results({bench_case(before)}, {bench_case(noise)}, 5.0, 0.05);
+        if (same.size() != 1 || same[0].regression || same[0].improvement) {
+            std::cout << "test_bench_comparison FAILED: noise over " << runs << " runs per side was flagged.\n";
+            return -1;
+        }
+    }
+    std::cout << "test_bench_comparison passed.\n";
+    return 0;
+}
+
+int run_compare_tests() {
+    int status = 0;
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "###########   RUNNING COMPARE TESTS... ############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << std::endl;
+
+    if (test_bench_comparison() != 0) status = -1;
+
+    if (status == 0) {
+        std::cout << "All compare tests passed successfully!\n";
+    } else {
+        std::cerr << "Some compare tests failed.\n";
+    }
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "##############  COMPARE TESTS DONE... #############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+
+    return status;
+}
@@ -0,0 +1 @@
+int run_compare_tests();
@@ -0,0 +1,237 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "../../src/ann/ann.h"
+#include "../../src/data/sampler.h"
+#include "../../src/matrix/allocation.h"
+#include "../../src/random/philox.h"
+#include "data_test.h"
+
+/**
+ * @brief Returns true if order holds every index in [0, n) exactly once.
+ */
+static bool is_permutation_of_range(const std::vector<long unsigned>& order, long unsigned n) {
+    std::vector<long unsigned> sorted(order);
+    std::sort(sorted.begin(), sorted.end());
+    if (sorted.size() != n) return false;
+    for (long unsigned i = 0; i < n; i++) {
+        if (sorted[i] != i) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Tests that shuffled epochs are permutations that change between epochs and are
+ * reproducible from the seed, and that the sequential order is the identity.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_sampler_shuffle() {
+    const long unsigned n = 10007;
+    Sampler sequential;
+    std::vector<long unsigned> identity = sequential.epoch_order(n, 5);
+    for (long unsigned i = 0; i < n; i++) {
+        if (identity[i] != i) {
+            std::cout << "test_sampler_shuffle FAILED: sequential order is not the identity\n";
+            return -1;
+        }
+    }
+
+    Sampler sampler(SamplerMode::Shuffle, 64, 17);
+    std::vector<long unsigned> epoch0 = sampler.epoch_order(n, 0);
+    std::vector<long unsigned> epoch1 = sampler.epoch_order(n, 1);
+    Sampler replay(SamplerMode::Shuffle, 64, 17);
+    std::vector<long unsigned> replayed = replay.epoch_order(n, 1);
+    if (!is_permutation_of_range(epoch0, n) || !is_permutation_of_range(epoch1, n)) {
+        std::cout << "test_sampler_shuffle FAILED: epoch order is not a permutation\n";
+        return -1;
+    }
+    long unsigned fixed_points = 0;
+    for (long unsigned i = 0; i < n; i++) fixed_points += epoch0[i] == i;
+    if (epoch0 == epoch1 || epoch1 != replayed || fixed_points > 10) {
+        std::cout << "test_sampler_shuffle FAILED: epochs repeat, differ between runs or barely move (" << fixed_points
+                  << " fixed points)\n";
+        return -1;
+    }
+
+    // Each of the 6 orders of 3 elements should come up about equally often.
+    std::vector<long unsigned> counts(6, 0);
+    std::vector<uint32_t> scratch;
+    for (uint64_t trial = 0; trial < 6000; trial++) {
+        long unsigned values[3] = {0, 1, 2};
+        shuffle_indices(values, 3, 99, trial, scratch);
+        counts[values[0] * 2 + (values[1] > values[2] ? 1 : 0)]++;
+    }
+    for (long unsigned count : counts) {
+        if (count < 850 || count > 1150) {
+            std::cout << "test_sampler_shuffle FAILED: biased shuffle, an order of 3 came up " << count << " of 6000 times\n";
+            return -1;
+        }
+    }
+    std::cout << "test_sampler_shuffle passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests that block shuffling keeps contiguous runs of block_size samples (the last block
+ * may be partial) and visits every sample once.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_sampler_block_shuffle() {
+    const long unsigned n = 1000;
+    const long unsigned block = 64;
+    Sampler sampler(SamplerMode::BlockShuffle, block, 3);
+    std::vector<long unsigned> order = sampler.epoch_order(n, 0);
+    if (!is_permutation_of_range(order, n)) {
+        std::cout << "test_sampler_block_shuffle FAILED: not a permutation\n";
+        return -1;
+    }
+    long unsigned breaks = 0;
+    for (long unsigned i = 1; i < n; i++) {
+        if (order[i] != order[i - 1] + 1) {
+            breaks++;
+            if (order[i] % block != 0) {
+                std::cout << "test_sampler_block_shuffle FAILED: run broken inside a block at " << order[i] << "\n";
+                return -1;
+            }
+        }
+    }
+    long unsigned sequential_breaks = 0;
+    Sampler sequential(SamplerMode::BlockShuffle, n, 3); // One block: the identity
+    std::vector<long unsigned> single = sequential.epoch_order(n, 0);
+    for (long unsigned i = 1; i < n; i++) sequential_breaks += single[i] != single[i - 1] + 1;
+    if (breaks == 0 || breaks > (n + block - 1) / block - 1 || sequential_breaks != 0) {
+        std::cout << "test_sampler_block_shuffle FAILED: " << breaks << " block boundaries moved\n";
+        return -1;
+    }
+    std::cout << "test_sampler_block_shuffle passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests that the shards of an epoch are disjoint, balanced and cover the data set.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_sampler_shards() {
+    const long unsigned n = 103;
+    const int workers = 4;
+    std::vector<long unsigned> all;
+    for (int shard = 0; shard < workers; shard++) {
+        Sampler sampler(SamplerMode::Shuffle, 64, 11);
+        sampler.set_shard(shard, workers);
+        const std::vector<long unsigned>& order = sampler.epoch_order(n, 2);
+        if (order.size() < n / workers || order.size() > n / workers + 1) {
+            std::cout << "test_sampler_shards FAILED: shard " << shard << " holds " << order.size() << " samples\n";
+            return -1;
+        }
+        all.insert(all.end(), order.begin(), order.end());
+    }
+    Sampler whole(SamplerMode::Shuffle, 64, 11);
+    if (!is_permutation_of_range(all, n) || all != whole.epoch_order(n, 2)) {
+        std::cout << "test_sampler_shards FAILED: shards do not partition the epoch permutation\n";
+        return -1;
+    }
+    try {
+        whole.set_shard(4, 4);
+        std::cout << "test_sampler_shards FAILED: invalid shard accepted\n";
+        return -1;
+    }
+    catch (const std::runtime_error&) {
+    }
+    std::cout << "test_sampler_shards passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests that gathering writes the indexed samples into the batch columns and reuses the
+ * batch storage, and that shuffled training is reproducible from the sampler seed.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_gather_samples() {
+    std::vector<std::array<Matrix, 2>> set;
+    for (int s = 0; s < 12; s++) {
+        Matrix x(3, 1);
+        Matrix y(2, 1);
+        for (int r = 0; r < 3; r++) x.set_val(r, 0, float(10 * s + r));
+        for (int r = 0; r < 2; r++) y.set_val(r, 0, std::cos(float(2 * s + r)));
+        set.push_back({x, y});
+    }
+    Matrix inputs(0, 0);
+    Matrix targets(0, 0);
+    long unsigned indices[4] = {7, 2, 11, 2};
+    gather_samples(set, indices, 4, inputs, targets);
+    long unsigned before = allocation_stats().allocations;
+    gather_samples(set, indices, 4, inputs, targets);
+    if (allocation_stats().allocations != before || inputs.get_columns_num() != 4) {
+        std::cout << "test_gather_samples FAILED: gathering into a sized batch allocated\n";
+        return -1;
+    }
+    for (int col = 0; col < 4; col++) {
+        for (int r = 0; r < 3; r++) {
+            if (inputs.get_val(r, col) != float(10 * indices[col] + r)) {
+                std::cout << "test_gather_samples FAILED: wrong value in column " << col << "\n";
+                return -1;
+            }
+        }
+    }
+    long unsigned out_of_range[1] = {12};
+    try {
+        gather_samples(set, out_of_range, 1, inputs, targets);
+        std::cout << "test_gather_samples FAILED: out-of-range index accepted\n";
+        return -1;
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    // With fixed weights the epoch loss is an average over all samples, whatever their order.
+    float losses[3];
+    for (int run = 0; run < 3; run++) {
+        set_random_seed(5);
+        ANN ann({3, 5, 2}, {"Tanh", "linear"});
+        ann.set_optimizer("SGD", "MSE", 0.0f);
+        if (run < 2) ann.set_sampler(SamplerMode::Shuffle);
+        ann.set_sampler_seed(5);
+        ann.set_micro_batch_size(3);
+        losses[run] = ann.train_epoch(set, 4);
+    }
+    if (losses[0] != losses[1] || std::fabs(losses[0] - losses[2]) > 1e-5f * std::fabs(losses[2])) {
+        std::cout << "test_gather_samples FAILED: shuffled losses " << losses[0] << ", " << losses[1] << " vs sequential "
+                  << losses[2] << "\n";
+        return -1;
+    }
+    std::cout << "test_gather_samples passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Runs all data pipeline tests.
+ * @return 0 if all tests pass, -1 otherwise.
+ */
+int run_data_tests() {
+    int status = 0;
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "############   RUNNING DATA TESTS... ##############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << std::endl;
+
+    if (test_sampler_shuffle() != 0) status = -1;
+    if (test_sampler_block_shuffle() != 0) status = -1;
+    if (test_sampler_shards() != 0) status = -1;
+    if (test_gather_samples() != 0) status = -1;
+
+    if (status == 0) {
+        std::cout << "All data tests passed successfully!\n";
+    } else {
+        std::cerr << "Some data tests failed.\n";
+    }
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "###############  DATA TESTS DONE... ###############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << std::endl;
+
+    return status;
+}
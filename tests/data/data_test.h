@@ -0,0 +1 @@
+int run_data_tests();
\ No newline at end of file
@@ -71,6 +71,61 @@ int test_softmax() {
     return 0;
 }
 
+/**
+ * @brief Tests that softmax stays finite for logits that would overflow std::exp.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_softmax_large_logits() {
+    float vals[] = {1000, 1001, 1002};
+    float column_vals[3][2] = {{1000, -1000}, {1001, -1001}, {1002, -1002}};
+    Matrix m(1, 3, vals);
+    Matrix columns(3, 2, *column_vals);
+    Functions F;
+    F.softmax(m);
+    F.softmax_columns(columns);
+
+    float denom = 1.0f + std::exp(1.0f) + std::exp(2.0f);
+    for (int i = 0; i < 3; i++) {
+        float expected = std::exp(float(i)) / denom;
+        if (!std::isfinite(m.get_val(0, i)) || std::abs(m.get_val(0, i) - expected) > 1e-6 ||
+            std::abs(columns.get_val(i, 0) - expected) > 1e-6 ||
+            std::abs(columns.get_val(2 - i, 1) - expected) > 1e-6) {
+            std::cout << "test_softmax_large_logits Failed at index " << i << ".\n";
+            return -1;
+        }
+    }
+    std::cout << "test_softmax_large_logits passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests that softmax_columns normalizes every column of a batch independently.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_softmax_columns() {
+    // Two samples (columns) with three classes each.
+    float vals[3][2] = {{1, 0}, {2, 0}, {3, 0}};
+    Matrix m(3, 2, *vals);
+    Functions F;
+    F.softmax_columns(m);
+
+    float denom = std::exp(1.0f) + std::exp(2.0f) + std::exp(3.0f);
+    float expected[3][2] = {{std::exp(1.0f) / denom, 1.0f / 3.0f},
+                            {std::exp(2.0f) / denom, 1.0f / 3.0f},
+                            {std::exp(3.0f) / denom, 1.0f / 3.0f}};
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 2; c++) {
+            if (std::abs(m.get_val(r, c) - expected[r][c]) > 1e-6) {
+                std::cout << "test_softmax_columns FAILED at row " << r << " col " << c << "\n";
+                return -1;
+            }
+        }
+    }
+
+    std::cout << "test_softmax_columns passed.\n";
+    return 0;
+}
+
 /**
  * @brief Tests the hyperbolic tangent (tanh) activation function.
  * @return 0 if the test passes, -1 otherwise.
@@ -314,6 +369,73 @@ int test_cross_entropy() {
     return 0;
 }
 
+/**
+ * @brief Tests the fused softmax + cross-entropy kernel on a batch of logits.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_softmax_cross_entropy() {
+    // Two samples (columns), three classes; the second column has very large logits.
+    float logit_vals[3][2] = {{1.0f, 500.0f}, {2.0f, 502.0f}, {0.5f, 501.0f}};
+    float y_vals[3][2] = {{0.0f, 0.0f}, {1.0f, 0.0f}, {0.0f, 1.0f}};
+    Matrix logits(3, 2, *logit_vals);
+    Matrix y(3, 2, *y_vals);
+    Matrix probabilities(3, 2);
+    Matrix gradient(3, 2);
+
+    Functions F;
+    float loss = F.softmax_cross_entropy(logits, y, probabilities, gradient);
+
+    float expected_loss = 0.0f;
+    for (int c = 0; c < 2; c++) {
+        float shift = logit_vals[2][c];
+        float denom = 0.0f;
+        for (int r = 0; r < 3; r++) denom += std::exp(logit_vals[r][c] - shift);
+        for (int r = 0; r < 3; r++) {
+            float p = std::exp(logit_vals[r][c] - shift) / denom;
+            if (std::abs(probabilities.get_val(r, c) - p) > 1e-6 ||
+                std::abs(gradient.get_val(r, c) - (p - y_vals[r][c])) > 1e-6) {
+                std::cout << "test_softmax_cross_entropy FAILED at row " << r << " col " << c << "\n";
+                return -1;
+            }
+            if (y_vals[r][c] > 0) expected_loss -= std::log(p);
+        }
+    }
+    if (!std::isfinite(loss) || std::abs(loss - expected_loss) > 1e-4) {
+        std::cout << "test_softmax_cross_entropy FAILED: expected loss " << expected_loss << ", got " << loss << "\n";
+        return -1;
+    }
+    std::cout << "test_softmax_cross_entropy passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests the batched evaluation metrics (squared error, cross-entropy, accuracy).
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_batch_metrics() {
+    // Three samples (columns), two classes. The last sample is misclassified.
+    float pred_vals[2][3] = {{0.9f, 0.2f, 0.6f}, {0.1f, 0.8f, 0.4f}};
+    float y_vals[2][3] = {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 1.0f}};
+    Matrix predictions(2, 3, *pred_vals);
+    Matrix y(2, 3, *y_vals);
+
+    Functions F;
+    BatchMetrics metrics = F.batch_metrics(predictions, y);
+
+    double expected_se = 0.01 + 0.01 + 0.04 + 0.04 + 0.36 + 0.36;
+    double expected_ce = -std::log(0.9) - std::log(0.8) - std::log(0.4);
+    if (std::abs(metrics.squared_error - expected_se) > 1e-5 ||
+        std::abs(metrics.cross_entropy - expected_ce) > 1e-5 ||
+        metrics.correct != 2) {
+        std::cout << "test_batch_metrics Failed.\n";
+        std::cout << "Got: " << metrics.squared_error << ", " << metrics.cross_entropy << ", " << metrics.correct << "\n";
+        return -1;
+    }
+
+    std::cout << "test_batch_metrics passed.\n";
+    return 0;
+}
+
 /**
  * @brief Tests the derivative of the cross-entropy loss.
  * @return 0 if the test passes, -1 otherwise.
@@ -391,6 +513,33 @@ int test_softmax_derivative() {
     return 0;
 }
 
+/**
+ * @brief Tests that softmax_backward matches multiplying by the softmax Jacobian.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_softmax_backward() {
+    float softmax_vals[] = {0.2f, 0.5f, 0.3f};
+    float grad_vals[] = {1.0f, -2.0f, 0.5f};
+    Matrix softmax_output(3, 1, softmax_vals);
+    Matrix gradient(3, 1, grad_vals);
+    Matrix jacobian(3, 3);
+
+    Functions F;
+    F.softmax_derivative(jacobian, softmax_output);
+    Matrix expected = transpose(jacobian) * Matrix(3, 1, grad_vals);
+    F.softmax_backward(gradient, softmax_output);
+
+    for (int r = 0; r < 3; r++) {
+        if (std::abs(gradient.get_val(r, 0) - expected.get_val(r, 0)) > 1e-6) {
+            std::cout << "test_softmax_backward FAILED at row " << r << "\n";
+            std::cout << "Expected: " << expected.get_val(r, 0) << ", Got: " << gradient.get_val(r, 0) << "\n";
+            return -1;
+        }
+    }
+    std::cout << "test_softmax_backward passed.\n";
+    return 0;
+}
+
 /**
  * @brief Runs all function-related tests.
  * @return 0 if all tests pass, -1 otherwise.
@@ -409,6 +558,8 @@ int run_functions_tests() {
     if (test_sigmoid() != 0) status = -1;
     if (test_sigmoid_derivative() != 0) status = -1;
     if (test_softmax() != 0) status = -1;
+    if (test_softmax_columns() != 0) status = -1;
+    if (test_softmax_large_logits() != 0) status = -1;
     if (test_softmax_derivative() != 0) status = -1;
     if (test_tanh() != 0) status = -1;
     if (test_tanh_derivative() != 0) status = -1;
@@ -419,6 +570,9 @@ int run_functions_tests() {
     if (test_mse_derivative() != 0) status = -1;
     if (test_cross_entropy() != 0) status = -1;
     if (test_cross_entropy_derivative() != 0) status = -1;
+    if (test_softmax_cross_entropy() != 0) status = -1;
+    if (test_softmax_backward() != 0) status = -1;
+    if (test_batch_metrics() != 0) status = -1;
 
     if (status == 0) {
         std::cout << "All functions tests passed successfully!\n";
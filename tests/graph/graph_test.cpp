@@ -0,0 +1,286 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include "../../src/graph/graph.h"
+#include "../../src/matrix/allocation.h"
+#include "../../src/random/philox.h"
+#include "../common/test_values.h"
+#include "graph_test.h"
+
+/**
+ * @brief Builds input(3) -> a = Tanh(4) -> split a into s0, s1 (2 rows each) -> b = sigmoid(4) of s0,
+ * r = a + b, c = concat(r, s1) -> out = dense(c, 2, output_activation): a residual connection, a
+ * split and a concatenation in one graph.
+ */
+static Graph branchy_graph(const std::string& output_activation) {
+    Graph graph;
+    int in = graph.input(3);
+    int a = graph.dense(in, 4, "Tanh");
+    std::vector<int> parts = graph.split(a, {2, 2});
+    int b = graph.dense(parts[0], 4, "sigmoid");
+    int r = graph.add({a, b});
+    int c = graph.concat({r, parts[1]});
+    graph.dense(c, 2, output_activation);
+    uint64_t stream = 10;
+    for (int id = 0; id < graph.node_count(); id++) {
+        if (graph.node(id).op == GraphOp::Dense) {
+            fill_test_values(graph.node(id).weights, stream++);
+            fill_test_values(graph.node(id).bias, stream++);
+        }
+    }
+    graph.refresh_weights();
+    return graph;
+}
+
+/**
+ * @brief Checks Add, Concat and Slice nodes against a manual computation from the Dense outputs,
+ * and the level of every node.
+ */
+int test_graph_forward() {
+    Graph graph = branchy_graph("linear");
+    Matrix input(3, 5);
+    fill_test_values(input, 1);
+    Matrix output = graph.forward(input);
+
+    Matrix& a = graph.node(1).output;
+    Matrix& b = graph.node(4).output;
+    Matrix expected_r(4, 5);
+    Matrix expected_c(6, 5);
+    for (int col = 0; col < 5; col++) {
+        for (int row = 0; row < 4; row++) {
+            expected_r.set_val(row, col, a.get_val(row, col) + b.get_val(row, col));
+            expected_c.set_val(row, col, a.get_val(row, col) + b.get_val(row, col));
+        }
+        for (int row = 0; row < 2; row++) {
+            if (graph.node(2).output.get_val(row, col) != a.get_val(row, col) ||
+                graph.node(3).output.get_val(row, col) != a.get_val(row + 2, col)) {
+                std::cout << "test_graph_forward FAILED: split rows differ from the input.\n";
+                return -1;
+            }
+            expected_c.set_val(row + 4, col, a.get_val(row + 2, col));
+        }
+    }
+    if (max_difference(graph.node(5).output, expected_r) > 1e-6f || max_difference(graph.node(6).output, expected_c) > 1e-6f) {
+        std::cout << "test_graph_forward FAILED: add or concat output differs from the reference.\n";
+        return -1;
+    }
+
+    Matrix expected_out(2, 5);
+    for (int col = 0; col < 5; col++)
+        for (int row = 0; row < 2; row++) {
+            float sum = graph.node(7).bias.get_val(row, 0);
+            for (int k = 0; k < 6; k++) sum += graph.node(7).weights.get_val(row, k) * expected_c.get_val(k, col);
+            expected_out.set_val(row, col, sum);
+        }
+    if (max_difference(output, expected_out) > 1e-5f) {
+        std::cout << "test_graph_forward FAILED: output differs from the reference.\n";
+        return -1;
+    }
+
+    // in | a | s0 s1 | b | r | c | out
+    const int expected_levels[] = {0, 1, 2, 2, 3, 4, 5, 6};
+    for (int id = 0; id < graph.node_count(); id++) {
+        if (graph.node(id).level != expected_levels[id]) {
+            std::cout << "test_graph_forward FAILED: node " << id << " is on level " << graph.node(id).level << ".\n";
+            return -1;
+        }
+    }
+    if (graph.level_count() != 7 || graph.level_nodes(2).size() != 2) {
+        std::cout << "test_graph_forward FAILED: wrong level schedule.\n";
+        return -1;
+    }
+
+    try {
+        graph.add({1, 2});
+        std::cout << "test_graph_forward FAILED: add of different sizes was accepted.\n";
+        return -1;
+    }
+    catch (const std::runtime_error&) {}
+    try {
+        graph.split(1, {3, 2});
+        std::cout << "test_graph_forward FAILED: split sizes that do not cover the input were accepted.\n";
+        return -1;
+    }
+    catch (const std::runtime_error&) {}
+
+    std::cout << "test_graph_forward passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Compares the gradients of every Dense node with central finite differences of the loss,
+ * for MSE and for softmax cross-entropy, and checks that repeated steps allocate nothing.
+ */
+int test_graph_backward() {
+    const char* outputs[] = {"linear", "softmax"};
+    for (const char* activation : outputs) {
+        Graph graph = branchy_graph(activation);
+        graph.set_loss(std::string(activation) == "softmax" ? "Cross_Entropy" : "MSE");
+        Matrix input(3, 4);
+        Matrix target(2, 4);
+        fill_test_values(input, 2);
+        fill_test_values(target, 3);
+        if (std::string(activation) == "softmax") {
+            for (int col = 0; col < 4; col++) {
+                target.set_val(0, col, col % 2 ? 1.0f : 0.0f);
+                target.set_val(1, col, col % 2 ? 0.0f : 1.0f);
+            }
+        }
+        auto loss = [&]() {
+            graph.forward(input);
+            return double(graph.calculate_loss(target));
+        };
+        const float h = 1e-2f;
+        for (int id = 0; id < graph.node_count(); id++) {
+            GraphNode& node = graph.node(id);
+            if (node.op != GraphOp::Dense) continue;
+            for (int r = 0; r < node.weights.get_rows_num(); r++) {
+                for (int c = 0; c <= node.weights.get_columns_num(); c++) {
+                    bool is_bias = c == node.weights.get_columns_num();
+                    Matrix& values = is_bias ? node.bias : node.weights;
+                    int col = is_bias ? 0 : c;
+                    auto perturbed_loss = [&](float delta) {
+                        float saved = values.get_val(r, col);
+                        values.set_val(r, col, saved + delta);
+                        graph.refresh_weights();
+                        double value = loss();
+                        values.set_val(r, col, saved);
+                        graph.refresh_weights();
+                        return value;
+                    };
+                    float expected = float((perturbed_loss(h) - perturbed_loss(-h)) / (2.0 * h));
+                    loss();
+                    graph.backward();
+                    Matrix& gradient = is_bias ? node.bias_gradient : node.weight_gradient;
+                    if (std::fabs(gradient.get_val(r, col) - expected) > 2e-3f) {
+                        std::cout << "test_graph_backward FAILED: " << activation << " output, node " << id
+                                  << (is_bias ? " bias" : " weight") << " (" << r << ", " << col << "): "
+                                  << gradient.get_val(r, col) << " vs " << expected << "\n";
+                        return -1;
+                    }
+                }
+            }
+        }
+
+        graph.train_batch(input, target, 0.01f);
+        long unsigned before = allocation_stats().allocations;
+        for (int pass = 0; pass < 3; pass++) graph.train_batch(input, target, 0.01f);
+        if (allocation_stats().allocations != before) {
+            std::cout << "test_graph_backward FAILED: training steps allocated memory.\n";
+            return -1;
+        }
+    }
+    std::cout << "test_graph_backward passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Runs a graph with several parallel branches with concurrent and sequential levels and
+ * checks that outputs and gradients are identical.
+ */
+int test_graph_parallel_branches() {
+    auto build = []() {
+        Graph graph;
+        int in = graph.input(8);
+        std::vector<int> branches;
+        for (int b = 0; b < 6; b++) {
+            int hidden = graph.dense(in, 16, "ReLu");
+            branches.push_back(graph.dense(hidden, 8, "Tanh"));
+        }
+        int merged = graph.concat(branches);
+        graph.dense(merged, 3, "linear");
+        return graph;
+    };
+    Graph concurrent = build();
+    Graph sequential = build();
+    sequential.set_parallel_branches(false);
+    for (int id = 0; id < concurrent.node_count(); id++) {
+        if (concurrent.node(id).op != GraphOp::Dense) continue;
+        fill_test_values(concurrent.node(id).weights, 100 + id);
+        sequential.node(id).weights.setValsFormMatrix(concurrent.node(id).weights);
+    }
+    concurrent.refresh_weights();
+    sequential.refresh_weights();
+    if (concurrent.level_nodes(1).size() != 6) {
+        std::cout << "test_graph_parallel_branches FAILED: branches are not on one level.\n";
+        return -1;
+    }
+
+    Matrix input(8, 33);
+    Matrix target(3, 33);
+    fill_test_values(input, 4);
+    fill_test_values(target, 5);
+    for (int step = 0; step < 3; step++) {
+        float a = concurrent.train_batch(input, target, 0.05f);
+        float b = sequential.train_batch(input, target, 0.05f);
+        if (a != b) {
+            std::cout << "test_graph_parallel_branches FAILED: losses differ at step " << step << ": " << a << " vs " << b << "\n";
+            return -1;
+        }
+    }
+    for (int id = 0; id < concurrent.node_count(); id++) {
+        if (concurrent.node(id).op != GraphOp::Dense) continue;
+        if (max_difference(concurrent.node(id).weights, sequential.node(id).weights) != 0.0f) {
+            std::cout << "test_graph_parallel_branches FAILED: weights of node " << id << " differ.\n";
+            return -1;
+        }
+    }
+    std::cout << "test_graph_parallel_branches passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Trains a small residual network on y = sin(x0) + x1^2 and checks that the loss drops.
+ */
+int test_graph_training() {
+    set_random_seed(49); // Independent of how much of the global stream earlier tests used
+    Graph graph;
+    int in = graph.input(2);
+    int h = graph.dense(in, 16, "Tanh");
+    int f = graph.dense(h, 16, "Tanh");
+    int r = graph.add({h, f});
+    graph.dense(r, 1, "linear");
+
+    Matrix input(2, 64);
+    Matrix target(1, 64);
+    fill_test_values(input, 6);
+    for (int c = 0; c < 64; c++) target.set_val(0, c, std::sin(input.get_val(0, c)) + input.get_val(1, c) * input.get_val(1, c));
+
+    float first = graph.train_batch(input, target, 0.1f);
+    float last = first;
+    for (int epoch = 0; epoch < 300; epoch++) last = graph.train_batch(input, target, 0.1f);
+    if (!(last < 0.2f * first)) {
+        std::cout << "test_graph_training FAILED: loss went from " << first << " to " << last << "\n";
+        return -1;
+    }
+    std::cout << "test_graph_training passed.\n";
+    return 0;
+}
+
+int run_graph_tests() {
+    int status = 0;
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "###########   RUNNING GRAPH TESTS... ##############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << std::endl;
+
+    if (test_graph_forward() != 0) status = -1;
+    if (test_graph_backward() != 0) status = -1;
+    if (test_graph_parallel_branches() != 0) status = -1;
+    if (test_graph_training() != 0) status = -1;
+
+    if (status == 0) {
+        std::cout << "All graph tests passed successfully!\n";
+    } else {
+        std::cerr << "Some graph tests failed.\n";
+    }
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "##############  GRAPH TESTS DONE... ###############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+
+    return status;
+}
@@ -0,0 +1 @@
+int run_graph_tests();
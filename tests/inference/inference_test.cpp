@@ -0,0 +1,183 @@
+#include <iostream>
+#include <vector>
+#include "../../src/inference/inference_model.h"
+#include "../../src/inference/memory_plan.h"
+#include "../../src/matrix/allocation.h"
+#include "../common/test_values.h"
+#include "inference_test.h"
+
+/**
+ * @brief Checks the slot assignment of a layer chain (two ping-pong slots) and of values with
+ * overlapping live ranges.
+ */
+int test_memory_plan() {
+    // Chain: step i reads value i - 1 and writes value i.
+    std::vector<BufferLifetime> chain = {{512, 0, 1}, {256, 1, 2}, {1024, 2, 3}, {128, 3, 4}, {64, 4, 5}};
+    MemoryPlan plan = plan_buffers(chain);
+    if (plan.slot_size.size() != 2 || plan.slot[0] != plan.slot[2] || plan.slot[2] != plan.slot[4] ||
+        plan.slot[1] != plan.slot[3] || plan.slot[0] == plan.slot[1]) {
+        std::cout << "test_memory_plan FAILED: a chain did not get two alternating slots.\n";
+        return -1;
+    }
+    if (plan.slot_size[plan.slot[0]] != 1024 || plan.slot_size[plan.slot[1]] != 256 || plan.total_size() != 1280) {
+        std::cout << "test_memory_plan FAILED: wrong chain slot sizes.\n";
+        return -1;
+    }
+
+    // Three values live at step 2; the fourth reuses the smallest slot that fits it.
+    std::vector<BufferLifetime> overlapping = {{100, 0, 2}, {40, 1, 2}, {300, 2, 3}, {30, 3, 4}};
+    plan = plan_buffers(overlapping);
+    if (plan.slot_size.size() != 3 || plan.slot[3] != plan.slot[1] || plan.total_size() != 440) {
+        std::cout << "test_memory_plan FAILED: wrong assignment of overlapping values.\n";
+        return -1;
+    }
+
+    try {
+        plan_buffers({{10, 3, 2}});
+        std::cout << "test_memory_plan FAILED: a value ending before it starts was accepted.\n";
+        return -1;
+    }
+    catch (const std::runtime_error&) {}
+    std::cout << "test_memory_plan passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Compares InferenceModel with ANN::predict on a trained network with a BatchNorm and a
+ * softmax output, and checks that steady-state requests do not allocate.
+ */
+int test_inference_model_predict() {
+    ANN ann({6, 32, 64, 16, 3}, {"ReLu", "Tanh", "sigmoid", "softmax"});
+    ann.set_optimizer("SGD", "MSE", 0.05f);
+    ann.set_normalization(1, NormType::BatchNorm);
+    ann.set_micro_batch_size(8);
+    std::vector<std::array<Matrix, 2>> train_set;
+    for (int i = 0; i < 32; i++) {
+        Matrix input(6, 1);
+        Matrix target(3, 1);
+        fill_test_values(input, i);
+        target.set_val(i % 3, 0, 1.0f);
+        train_set.push_back({input, target});
+    }
+    for (int epoch = 0; epoch < 3; epoch++) ann.train_epoch(train_set, 8);
+
+    InferenceModel model(ann);
+    if (model.input_size() != 6 || model.output_size() != 3 || model.num_layers() != 4 || model.memory_plan().slot_size.size() != 2) {
+        std::cout << "test_inference_model_predict FAILED: wrong model shape or plan.\n";
+        return -1;
+    }
+    for (int batch : {1, 7, 64}) {
+        Matrix input(6, batch);
+        Matrix expected(3, batch);
+        Matrix output(3, batch);
+        fill_test_values(input, 100 + batch);
+        ann.predict(input, expected);
+        model.predict(input, output);
+        if (max_difference(output, expected) > 1e-5f) {
+            std::cout << "test_inference_model_predict FAILED: batch " << batch << " outputs differ by "
+                      << max_difference(output, expected) << "\n";
+            return -1;
+        }
+    }
+
+    Matrix input(6, 16);
+    Matrix output(3, 16);
+    fill_test_values(input, 5);
+    model.predict(input, output); // Grows the sample-major buffer to 16 samples
+    long unsigned before = allocation_stats().allocations;
+    for (int pass = 0; pass < 3; pass++) model.predict(input, output);
+    if (allocation_stats().allocations != before) {
+        std::cout << "test_inference_model_predict FAILED: steady-state requests allocated memory.\n";
+        return -1;
+    }
+
+    ANN layer_norm({4, 8, 2}, {"ReLu", "linear"});
+    layer_norm.set_normalization(0, NormType::LayerNorm);
+    try {
+        InferenceModel unsupported(layer_norm);
+        std::cout << "test_inference_model_predict FAILED: a LayerNorm network was accepted.\n";
+        return -1;
+    }
+    catch (const std::runtime_error&) {}
+    std::cout << "test_inference_model_predict passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Compares the resident memory of a deep network served by ANN and by InferenceModel, and
+ * runs concurrent requests with separate workspaces.
+ */
+int test_inference_model_memory() {
+    const std::vector<int> layers = {64, 256, 256, 256, 256, 256, 10};
+    const int batch = 64;
+    Matrix input(64, batch);
+    Matrix output(10, batch);
+    fill_test_values(input, 9);
+
+    long unsigned start = allocation_stats().live_bytes;
+    ANN ann(layers, {"ReLu", "ReLu", "ReLu", "ReLu", "ReLu", "linear"});
+    ann.predict(input, output);
+    long unsigned ann_bytes = allocation_stats().live_bytes - start;
+
+    start = allocation_stats().live_bytes;
+    InferenceModel model(ann);
+    InferenceWorkspace workspace;
+    model.predict(input, output, workspace);
+    long unsigned model_bytes = allocation_stats().live_bytes - start;
+
+    // Two slots of the widest hidden layer, whatever the depth.
+    if (workspace.bytes() != 2ul * 256 * batch * sizeof(float) || model.workspace_bytes(batch) != workspace.bytes()) {
+        std::cout << "test_inference_model_memory FAILED: workspace holds " << workspace.bytes() << " bytes.\n";
+        return -1;
+    }
+    if (model_bytes != model.model_bytes() + workspace.bytes() || 2.5 * model_bytes > ann_bytes) {
+        std::cout << "test_inference_model_memory FAILED: model and workspace take " << model_bytes << " bytes, ANN "
+                  << ann_bytes << ".\n";
+        return -1;
+    }
+
+    // Requests with their own workspaces share the model.
+    Matrix expected(10, batch);
+    ann.predict(input, expected);
+    std::vector<Matrix> outputs(4, Matrix(10, batch));
+    std::vector<InferenceWorkspace> workspaces(4);
+    const InferenceModel& shared = model;
+    #pragma omp parallel for num_threads(4)
+    for (int request = 0; request < 4; request++) shared.predict(input, outputs[request], workspaces[request]);
+    for (Matrix& result : outputs) {
+        if (max_difference(result, expected) > 1e-4f) {
+            std::cout << "test_inference_model_memory FAILED: a concurrent request output differs by "
+                      << max_difference(result, expected) << "\n";
+            return -1;
+        }
+    }
+    std::cout << "test_inference_model_memory passed.\n";
+    return 0;
+}
+
+int run_inference_tests() {
+    int status = 0;
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "#########   RUNNING INFERENCE TESTS... ############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << std::endl;
+
+    if (test_memory_plan() != 0) status = -1;
+    if (test_inference_model_predict() != 0) status = -1;
+    if (test_inference_model_memory() != 0) status = -1;
+
+    if (status == 0) {
+        std::cout << "All inference tests passed successfully!\n";
+    } else {
+        std::cerr << "Some inference tests failed.\n";
+    }
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "############  INFERENCE TESTS DONE... #############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+
+    return status;
+}
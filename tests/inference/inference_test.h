@@ -0,0 +1 @@
+int run_inference_tests();
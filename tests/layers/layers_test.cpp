@@ -0,0 +1,898 @@
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include "../../src/layers/conv2d.h"
+#include "../../src/layers/normalization.h"
+#include "../../src/layers/dropout.h"
+#include "../../src/layers/embedding.h"
+#include "../../src/layers/recurrent.h"
+#include "../../src/layers/attention.h"
+#include "../../src/matrix/allocation.h"
+#include "../common/test_values.h"
+#include "layers_test.h"
+
+/**
+ * @brief Textbook seven-loop convolution used as the reference.
+ */
+static Matrix reference_conv(Conv2D& conv, Matrix& input) {
+    const Conv2DShape& s = conv.get_shape();
+    int batch = input.get_columns_num();
+    Matrix output(s.output_size(), batch);
+    for (int n = 0; n < batch; n++)
+        for (int o = 0; o < s.out_channels; o++)
+            for (int oh = 0; oh < s.out_height(); oh++)
+                for (int ow = 0; ow < s.out_width(); ow++) {
+                    float sum = conv.get_bias().get_val(o, 0);
+                    for (int c = 0; c < s.in_channels; c++)
+                        for (int kh = 0; kh < s.kernel_h; kh++)
+                            for (int kw = 0; kw < s.kernel_w; kw++) {
+                                int ih = oh * s.stride - s.padding + kh * s.dilation;
+                                int iw = ow * s.stride - s.padding + kw * s.dilation;
+                                if (ih < 0 || ih >= s.height || iw < 0 || iw >= s.width) continue;
+                                sum += conv.get_weights().get_val(o, (c * s.kernel_h + kh) * s.kernel_w + kw) *
+                                       input.get_val((c * s.height + ih) * s.width + iw, n);
+                            }
+                    output.set_val((o * s.out_height() + oh) * s.out_width() + ow, n, sum);
+                }
+    return output;
+}
+
+/**
+ * @brief Returns the convolution geometries exercised by the tests.
+ */
+static std::vector<Conv2DShape> test_shapes() {
+    std::vector<Conv2DShape> shapes;
+    //                C  H  W  OC kh kw stride pad dil
+    shapes.push_back({2, 6, 5, 5, 3, 3, 1, 1, 1}); // 3x3 "same", partial output-channel block
+    shapes.push_back({3, 7, 7, 4, 3, 3, 2, 0, 1}); // strided 3x3
+    shapes.push_back({2, 5, 6, 3, 1, 1, 1, 0, 1}); // pointwise
+    shapes.push_back({2, 6, 6, 4, 1, 1, 2, 1, 1}); // strided, padded 1x1
+    shapes.push_back({1, 9, 8, 2, 5, 3, 1, 2, 1}); // rectangular kernel
+    shapes.push_back({2, 9, 9, 3, 3, 3, 1, 2, 2}); // dilated 3x3
+    return shapes;
+}
+
+/**
+ * @brief Tests the output geometry and that the im2col and direct kernels match the reference.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_conv2d_forward() {
+    Conv2DShape same{1, 5, 5, 1, 3, 3, 1, 1, 1};
+    Conv2DShape strided{1, 7, 7, 1, 3, 3, 2, 0, 2};
+    if (same.out_height() != 5 || same.out_width() != 5 || strided.out_height() != 2) {
+        std::cout << "test_conv2d_forward FAILED: wrong output size\n";
+        return -1;
+    }
+    try {
+        Conv2D too_large(Conv2DShape{1, 2, 2, 1, 5, 5, 1, 0, 1});
+        std::cout << "test_conv2d_forward FAILED: kernel larger than the input accepted\n";
+        return -1;
+    }
+    catch (const std::runtime_error&) {
+    }
+
+    uint64_t stream = 0;
+    for (const Conv2DShape& shape : test_shapes()) {
+        Conv2D conv(shape);
+        fill_test_values(conv.get_bias(), stream++);
+        Matrix input(shape.input_size(), 3);
+        fill_test_values(input, stream++);
+        Matrix expected = reference_conv(conv, input);
+        ConvAlgorithm algorithms[] = {ConvAlgorithm::Im2col, ConvAlgorithm::Direct, ConvAlgorithm::Auto};
+        for (ConvAlgorithm algorithm : algorithms) {
+            conv.set_algorithm(algorithm);
+            Matrix output(0, 0);
+            conv.forward(input, output);
+            if (output.get_rows_num() != shape.output_size() || output.get_columns_num() != 3 ||
+                max_difference(output, expected) > 1e-5f || input.get_rows_num() != shape.input_size()) {
+                std::cout << "test_conv2d_forward FAILED: kernel " << int(algorithm) << " differs from the reference for a "
+                          << shape.kernel_h << "x" << shape.kernel_w << " kernel\n";
+                return -1;
+            }
+        }
+    }
+    std::cout << "test_conv2d_forward passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests the filter, bias and input gradients of both kernels against central differences
+ * of the loss L = sum(output * R) for a fixed random R.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_conv2d_backward() {
+    uint64_t stream = 100;
+    for (const Conv2DShape& shape : test_shapes()) {
+        Conv2D conv(shape);
+        Matrix input(shape.input_size(), 2);
+        Matrix grad_output(shape.output_size(), 2);
+        fill_test_values(input, stream++);
+        fill_test_values(grad_output, stream++);
+        auto loss = [&]() {
+            Matrix output = reference_conv(conv, input);
+            double sum = 0.0;
+            for (int r = 0; r < output.get_rows_num(); r++)
+                for (int c = 0; c < 2; c++) sum += double(output.get_val(r, c)) * grad_output.get_val(r, c);
+            return sum;
+        };
+        const float h = 1e-2f;
+        auto numeric = [&](Matrix& m, int r, int c) {
+            float saved = m.get_val(r, c);
+            m.set_val(r, c, saved + h);
+            double up = loss();
+            m.set_val(r, c, saved - h);
+            double down = loss();
+            m.set_val(r, c, saved);
+            return float((up - down) / (2.0 * h));
+        };
+
+        ConvAlgorithm algorithms[] = {ConvAlgorithm::Im2col, ConvAlgorithm::Direct};
+        for (ConvAlgorithm algorithm : algorithms) {
+            conv.set_algorithm(algorithm);
+            Matrix output(0, 0);
+            Matrix grad_input(0, 0);
+            conv.forward(input, output);
+            conv.backward(input, grad_output, &grad_input);
+            for (int r = 0; r < conv.get_weights().get_rows_num(); r++)
+                for (int c = 0; c < conv.get_weights().get_columns_num(); c++) {
+                    if (std::fabs(conv.get_weight_gradient().get_val(r, c) - numeric(conv.get_weights(), r, c)) > 2e-3f) {
+                        std::cout << "test_conv2d_backward FAILED: filter gradient (" << r << ", " << c << ") of kernel " << int(algorithm) << "\n";
+                        return -1;
+                    }
+                }
+            for (int r = 0; r < shape.out_channels; r++) {
+                if (std::fabs(conv.get_bias_gradient().get_val(r, 0) - numeric(conv.get_bias(), r, 0)) > 2e-3f) {
+                    std::cout << "test_conv2d_backward FAILED: bias gradient " << r << " of kernel " << int(algorithm) << "\n";
+                    return -1;
+                }
+            }
+            for (int r = 0; r < shape.input_size(); r++)
+                for (int c = 0; c < 2; c++) {
+                    if (std::fabs(grad_input.get_val(r, c) - numeric(input, r, c)) > 2e-3f) {
+                        std::cout << "test_conv2d_backward FAILED: input gradient (" << r << ", " << c << ") of kernel " << int(algorithm) << "\n";
+                        return -1;
+                    }
+                }
+        }
+    }
+
+    // One SGD step on a 1x1 regression target reduces the loss.
+    Conv2D conv(Conv2DShape{2, 4, 4, 1, 3, 3, 1, 1, 1});
+    Matrix input(32, 4);
+    Matrix target(16, 4);
+    fill_test_values(input, 300);
+    fill_test_values(target, 301);
+    Matrix output(0, 0);
+    Matrix error(16, 4);
+    float previous = 0.0f;
+    for (int step = 0; step < 20; step++) {
+        conv.forward(input, output);
+        error = output - target;
+        float current = 0.0f;
+        for (int r = 0; r < 16; r++)
+            for (int c = 0; c < 4; c++) current += error.get_val(r, c) * error.get_val(r, c);
+        if (step > 0 && current >= previous) {
+            std::cout << "test_conv2d_backward FAILED: SGD step increased the loss " << previous << " -> " << current << "\n";
+            return -1;
+        }
+        previous = current;
+        conv.backward(input, error, nullptr);
+        conv.update_weights(0.01f);
+    }
+    std::cout << "test_conv2d_backward passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Double-precision normalization of a features x batch matrix, statistics per row
+ * (BatchNorm) or per column (LayerNorm), used as the reference.
+ */
+static Matrix reference_norm(Normalization& norm, Matrix& input, double epsilon) {
+    int rows = input.get_rows_num();
+    int columns = input.get_columns_num();
+    bool per_row = norm.get_type() == NormType::BatchNorm;
+    int groups = per_row ? rows : columns;
+    int size = per_row ? columns : rows;
+    Matrix output(rows, columns);
+    for (int g = 0; g < groups; g++) {
+        double mean = 0.0, variance = 0.0;
+        for (int k = 0; k < size; k++) mean += per_row ? input.get_val(g, k) : input.get_val(k, g);
+        mean /= size;
+        for (int k = 0; k < size; k++) {
+            double d = (per_row ? input.get_val(g, k) : input.get_val(k, g)) - mean;
+            variance += d * d;
+        }
+        variance /= size;
+        for (int k = 0; k < size; k++) {
+            int r = per_row ? g : k;
+            int c = per_row ? k : g;
+            double xhat = (input.get_val(r, c) - mean) / std::sqrt(variance + epsilon);
+            output.set_val(r, c, float(xhat * norm.get_gamma().get_val(r, 0) + norm.get_beta().get_val(r, 0)));
+        }
+    }
+    return output;
+}
+
+/**
+ * @brief Tests both normalizations against the double-precision reference (on data with a large
+ * mean, which a naive single-pass variance would cancel), in-place use, the BatchNorm running
+ * statistics and inference mode.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_normalization_forward() {
+    const int features = 5;
+    const int batch = 300; // More than one LayerNorm block, not a multiple of 8
+    NormType types[] = {NormType::BatchNorm, NormType::LayerNorm};
+    for (NormType type : types) {
+        Normalization norm(type, features, 1e-5f, 1.0f);
+        Matrix input(features, batch);
+        fill_test_values(input, 400);
+        for (int r = 0; r < features; r++)
+            for (int c = 0; c < batch; c++) input.set_val(r, c, 100.0f + float(r + 1) * input.get_val(r, c));
+        fill_test_values(norm.get_gamma(), 401);
+        fill_test_values(norm.get_beta(), 402);
+
+        Matrix output(0, 0);
+        norm.forward(input, output, true);
+        Matrix expected = reference_norm(norm, input, 1e-5);
+        if (output.get_rows_num() != features || output.get_columns_num() != batch || max_difference(output, expected) > 2e-3f) {
+            std::cout << "test_normalization_forward FAILED: type " << int(type) << " differs from the reference by "
+                      << max_difference(output, expected) << "\n";
+            return -1;
+        }
+        Matrix in_place = input;
+        norm.forward(in_place, in_place, true);
+        if (max_difference(in_place, output) != 0.0f) {
+            std::cout << "test_normalization_forward FAILED: in-place result of type " << int(type) << " differs\n";
+            return -1;
+        }
+    }
+
+    // With momentum 1 the running statistics are those of the last batch (unbiased variance).
+    Normalization norm(NormType::BatchNorm, 2, 0.0f, 1.0f);
+    float v[2][4] = {{1.0f, 2.0f, 3.0f, 6.0f}, {-1.0f, -1.0f, 1.0f, 1.0f}};
+    Matrix input(2, 4, *v);
+    Matrix output(0, 0);
+    norm.forward(input, output, true);
+    norm.update_running_stats();
+    if (std::fabs(norm.get_running_mean().get_val(0, 0) - 3.0f) > 1e-6f || std::fabs(norm.get_running_var().get_val(0, 0) - 14.0f / 3.0f) > 1e-5f ||
+        std::fabs(norm.get_running_mean().get_val(1, 0)) > 1e-6f || std::fabs(norm.get_running_var().get_val(1, 0) - 4.0f / 3.0f) > 1e-5f) {
+        std::cout << "test_normalization_forward FAILED: running statistics\n";
+        return -1;
+    }
+    norm.forward(input, output, false);
+    if (std::fabs(output.get_val(0, 3) - 3.0f / std::sqrt(14.0f / 3.0f)) > 1e-5f || std::fabs(output.get_val(1, 0) + 1.0f / std::sqrt(4.0f / 3.0f)) > 1e-5f) {
+        std::cout << "test_normalization_forward FAILED: inference mode\n";
+        return -1;
+    }
+
+    Matrix single(2, 1);
+    try {
+        norm.forward(single, output, true);
+        std::cout << "test_normalization_forward FAILED (no exception for a one-sample BatchNorm batch).\n";
+        return -1;
+    } catch (const std::runtime_error&) {
+    }
+    std::cout << "test_normalization_forward passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests the gamma, beta and input gradients of both normalizations against central
+ * differences, the accumulation of the parameter gradients and in-place input gradients.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_normalization_backward() {
+    const int features = 6;
+    const int batch = 11;
+    NormType types[] = {NormType::BatchNorm, NormType::LayerNorm};
+    for (NormType type : types) {
+        Normalization norm(type, features);
+        Matrix input(features, batch);
+        Matrix grad_output(features, batch);
+        fill_test_values(input, 500);
+        fill_test_values(grad_output, 501);
+        fill_test_values(norm.get_gamma(), 502);
+        fill_test_values(norm.get_beta(), 503);
+        auto loss = [&]() {
+            Matrix output = reference_norm(norm, input, 1e-5);
+            double sum = 0.0;
+            for (int r = 0; r < features; r++)
+                for (int c = 0; c < batch; c++) sum += double(output.get_val(r, c)) * grad_output.get_val(r, c);
+            return sum;
+        };
+        const float h = 1e-2f;
+        auto numeric = [&](Matrix& m, int r, int c) {
+            float saved = m.get_val(r, c);
+            m.set_val(r, c, saved + h);
+            double up = loss();
+            m.set_val(r, c, saved - h);
+            double down = loss();
+            m.set_val(r, c, saved);
+            return float((up - down) / (2.0 * h));
+        };
+
+        Matrix output(0, 0);
+        Matrix grad_input(0, 0);
+        norm.forward(input, output, true);
+        norm.backward(input, grad_output, grad_input);
+        for (int r = 0; r < features; r++) {
+            if (std::fabs(norm.get_gamma_gradient().get_val(r, 0) - numeric(norm.get_gamma(), r, 0)) > 2e-3f ||
+                std::fabs(norm.get_beta_gradient().get_val(r, 0) - numeric(norm.get_beta(), r, 0)) > 2e-3f) {
+                std::cout << "test_normalization_backward FAILED: parameter gradient " << r << " of type " << int(type) << "\n";
+                return -1;
+            }
+            for (int c = 0; c < batch; c++) {
+                if (std::fabs(grad_input.get_val(r, c) - numeric(input, r, c)) > 2e-3f) {
+                    std::cout << "test_normalization_backward FAILED: input gradient (" << r << ", " << c << ") of type " << int(type) << "\n";
+                    return -1;
+                }
+            }
+        }
+
+        // A second backward accumulates; writing the input gradient over grad_output gives the same values.
+        float gamma_gradient = norm.get_gamma_gradient().get_val(2, 0);
+        Matrix in_place = grad_output;
+        norm.backward(input, in_place, in_place);
+        if (max_difference(in_place, grad_input) > 1e-6f || std::fabs(norm.get_gamma_gradient().get_val(2, 0) - 2.0f * gamma_gradient) > 1e-5f) {
+            std::cout << "test_normalization_backward FAILED: accumulation or in-place gradient of type " << int(type) << "\n";
+            return -1;
+        }
+    }
+    std::cout << "test_normalization_backward passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests the dropout mask: the kept fraction, determinism per stream, independence of
+ * streams, the tail bits of a partial word and a zero rate.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_dropout_mask() {
+    const long n = 100003; // Not a multiple of 64
+    Dropout dropout(0.3f, ElementwiseActivation::ReLu);
+    dropout.generate_mask(n, 11, 5);
+    long kept = 0;
+    std::vector<bool> first(n);
+    for (long i = 0; i < n; i++) {
+        first[i] = dropout.kept(i);
+        kept += first[i];
+    }
+    double fraction = double(kept) / n;
+    if (std::fabs(fraction - 0.7) > 0.01 || dropout.mask_bytes() != ((n + 63) / 64) * sizeof(uint64_t)) {
+        std::cout << "test_dropout_mask FAILED: kept fraction " << fraction << "\n";
+        return -1;
+    }
+
+    // The same stream gives the same mask; another stream a different one.
+    dropout.generate_mask(n, 11, 5);
+    long same = 0;
+    for (long i = 0; i < n; i++) same += dropout.kept(i) == first[i];
+    dropout.generate_mask(n, 11, 6);
+    long agree = 0;
+    for (long i = 0; i < n; i++) agree += dropout.kept(i) == first[i];
+    // Independent masks agree with probability 0.7^2 + 0.3^2 = 0.58.
+    if (same != n || std::fabs(double(agree) / n - 0.58) > 0.01) {
+        std::cout << "test_dropout_mask FAILED: determinism (" << same << " of " << n << ") or stream independence (" << agree << ")\n";
+        return -1;
+    }
+
+    Dropout none(0.0f, ElementwiseActivation::Linear);
+    none.generate_mask(70, 1, 1);
+    for (long i = 0; i < 70; i++) {
+        if (!none.kept(i)) {
+            std::cout << "test_dropout_mask FAILED: rate 0 dropped activation " << i << "\n";
+            return -1;
+        }
+    }
+    try {
+        Dropout invalid(1.0f, ElementwiseActivation::ReLu);
+        std::cout << "test_dropout_mask FAILED (no exception for rate 1).\n";
+        return -1;
+    } catch (const std::runtime_error&) {
+    }
+    std::cout << "test_dropout_mask passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests the fused forward and backward kernels of every activation against the unfused
+ * reference f(z) * mask / (1 - rate) and e * f'(z) * mask / (1 - rate).
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_dropout_forward_backward() {
+    const int rows = 7;
+    const int columns = 29;
+    const float rate = 0.25f;
+    const float scale = 1.0f / (1.0f - rate);
+    ElementwiseActivation activations[] = {ElementwiseActivation::ReLu, ElementwiseActivation::Sigmoid,
+                                           ElementwiseActivation::Tanh, ElementwiseActivation::Linear};
+    for (ElementwiseActivation activation : activations) {
+        auto f = [&](float z) -> double {
+            switch (activation) {
+                case ElementwiseActivation::ReLu: return z > 0.0f ? z : 0.0;
+                case ElementwiseActivation::Sigmoid: return 1.0 / (1.0 + std::exp(-double(z)));
+                case ElementwiseActivation::Tanh: return std::tanh(double(z));
+                default: return z;
+            }
+        };
+        auto derivative = [&](float z) -> double {
+            switch (activation) {
+                case ElementwiseActivation::ReLu: return z > 0.0f ? 1.0 : 0.0;
+                case ElementwiseActivation::Sigmoid: return f(z) * (1.0 - f(z));
+                case ElementwiseActivation::Tanh: return 1.0 - f(z) * f(z);
+                default: return 1.0;
+            }
+        };
+        Dropout dropout(rate, activation);
+        Matrix z(rows, columns);
+        Matrix error(rows, columns);
+        fill_test_values(z, 600);
+        fill_test_values(error, 601);
+        dropout.generate_mask(long(rows) * columns, 3, 9);
+        Matrix a(0, 0);
+        dropout.forward(z, a);
+        Matrix gradient = error;
+        dropout.backward(a, gradient);
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < columns; c++) {
+                bool kept = dropout.kept(long(r) * columns + c);
+                double expected_a = kept ? f(z.get_val(r, c)) * scale : 0.0;
+                double expected_gradient = kept ? error.get_val(r, c) * derivative(z.get_val(r, c)) * scale : 0.0;
+                if (std::fabs(a.get_val(r, c) - expected_a) > 1e-5 || std::fabs(gradient.get_val(r, c) - expected_gradient) > 1e-5) {
+                    std::cout << "test_dropout_forward_backward FAILED: (" << r << ", " << c << ") of activation " << int(activation) << "\n";
+                    return -1;
+                }
+            }
+        }
+    }
+    std::cout << "test_dropout_forward_backward passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests the embedding lookup, the sparse row gradients (repeated IDs accumulate, unused
+ * rows stay untouched), the row-wise update, the reset and the ID validation.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_embedding() {
+    const long vocab = 10;
+    const int dim = 3;
+    const int fields = 2;
+    const int batch = 5;
+    float id_values[fields][batch] = {{4, 1, 4, 7, 0}, {1, 1, 9, 3, 4}};
+    Matrix ids(fields, batch, *id_values);
+    Embedding embedding(vocab, dim);
+    Matrix table_before = embedding.get_table();
+    Matrix output(0, 0);
+    embedding.forward(ids, output, true);
+    if (output.get_rows_num() != fields * dim || output.get_columns_num() != batch) {
+        std::cout << "test_embedding FAILED: output shape\n";
+        return -1;
+    }
+    for (int f = 0; f < fields; f++)
+        for (int d = 0; d < dim; d++)
+            for (int c = 0; c < batch; c++) {
+                if (output.get_val(f * dim + d, c) != table_before.get_val(int(id_values[f][c]), d)) {
+                    std::cout << "test_embedding FAILED: lookup (" << f * dim + d << ", " << c << ")\n";
+                    return -1;
+                }
+            }
+
+    Matrix grad_output(fields * dim, batch);
+    fill_test_values(grad_output, 700);
+    embedding.backward(grad_output);
+    embedding.backward(grad_output); // Accumulates
+    std::vector<double> expected(vocab * dim, 0.0);
+    for (int f = 0; f < fields; f++)
+        for (int d = 0; d < dim; d++)
+            for (int c = 0; c < batch; c++) expected[long(id_values[f][c]) * dim + d] += 2.0 * grad_output.get_val(f * dim + d, c);
+    if (embedding.get_touched_rows().size() != 6) { // IDs 0, 1, 3, 4, 7, 9
+        std::cout << "test_embedding FAILED: " << embedding.get_touched_rows().size() << " touched rows\n";
+        return -1;
+    }
+    for (long r = 0; r < vocab; r++)
+        for (int d = 0; d < dim; d++) {
+            if (std::fabs(embedding.get_row_gradient(r, d) - expected[r * dim + d]) > 1e-5) {
+                std::cout << "test_embedding FAILED: gradient of row " << r << "\n";
+                return -1;
+            }
+        }
+
+    const float learning_rate = 0.5f;
+    embedding.update_weights(learning_rate);
+    for (long r = 0; r < vocab; r++)
+        for (int d = 0; d < dim; d++) {
+            float want = table_before.get_val(int(r), d) - learning_rate * float(expected[r * dim + d]);
+            if (std::fabs(embedding.get_table().get_val(int(r), d) - want) > 1e-5f) {
+                std::cout << "test_embedding FAILED: updated row " << r << "\n";
+                return -1;
+            }
+        }
+    embedding.reset_gradients();
+    if (!embedding.get_touched_rows().empty() || embedding.get_row_gradient(4, 0) != 0.0f || embedding.gradient_squared_norm() != 0.0) {
+        std::cout << "test_embedding FAILED: reset\n";
+        return -1;
+    }
+
+    float bad_values[2][1] = {{10}, {1.5f}};
+    for (int b = 0; b < 2; b++) {
+        Matrix bad(1, 1, bad_values[b]);
+        try {
+            embedding.forward(bad, output, false);
+            std::cout << "test_embedding FAILED (no exception for ID " << bad_values[b][0] << ").\n";
+            return -1;
+        } catch (const std::runtime_error&) {
+        }
+    }
+    std::cout << "test_embedding passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Double-precision step-by-step LSTM/GRU over an input_size x (steps * N) batch, used as
+ * the reference.
+ */
+static Matrix reference_recurrent(Recurrent& layer, Matrix& input, int steps) {
+    const int hidden = layer.get_recurrent_weights().get_columns_num();
+    const int inputs = input.get_rows_num();
+    const int batch = input.get_columns_num() / steps;
+    const bool lstm = layer.get_cell() == RecurrentCell::LSTM;
+    Matrix& wx = layer.get_input_weights();
+    Matrix& wh = layer.get_recurrent_weights();
+    auto sigmoid = [](double x) { return 1.0 / (1.0 + std::exp(-x)); };
+    Matrix output(hidden, steps * batch);
+    for (int n = 0; n < batch; n++) {
+        std::vector<double> h(hidden, 0.0), c(hidden, 0.0), next_h(hidden), next_c(hidden);
+        for (int t = 0; t < steps; t++) {
+            int column = t * batch + n;
+            auto x_part = [&](int row) {
+                double sum = layer.get_bias().get_val(row, 0);
+                for (int k = 0; k < inputs; k++) sum += double(wx.get_val(row, k)) * input.get_val(k, column);
+                return sum;
+            };
+            auto h_part = [&](int row) {
+                double sum = 0.0;
+                for (int k = 0; k < hidden; k++) sum += double(wh.get_val(row, k)) * h[k];
+                return sum;
+            };
+            for (int j = 0; j < hidden; j++) {
+                if (lstm) {
+                    double i = sigmoid(x_part(j) + h_part(j));
+                    double f = sigmoid(x_part(hidden + j) + h_part(hidden + j));
+                    double g = std::tanh(x_part(2 * hidden + j) + h_part(2 * hidden + j));
+                    double o = sigmoid(x_part(3 * hidden + j) + h_part(3 * hidden + j));
+                    next_c[j] = f * c[j] + i * g;
+                    next_h[j] = o * std::tanh(next_c[j]);
+                } else {
+                    double r = sigmoid(x_part(j) + h_part(j));
+                    double z = sigmoid(x_part(hidden + j) + h_part(hidden + j));
+                    double candidate = std::tanh(x_part(2 * hidden + j) +
+                                                 r * (h_part(2 * hidden + j) + layer.get_recurrent_bias().get_val(j, 0)));
+                    next_h[j] = (1.0 - z) * candidate + z * h[j];
+                }
+            }
+            h = next_h;
+            c = next_c;
+            for (int j = 0; j < hidden; j++) output.set_val(j, column, float(h[j]));
+        }
+    }
+    return output;
+}
+
+/**
+ * @brief Tests both cells against the double-precision reference, including a second batch of
+ * a different shape through the same layer.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_recurrent_forward() {
+    RecurrentCell cells[] = {RecurrentCell::LSTM, RecurrentCell::GRU};
+    uint64_t stream = 400;
+    for (RecurrentCell cell : cells) {
+        Recurrent layer(cell, 3, 4);
+        if (layer.gate_rows() != (cell == RecurrentCell::LSTM ? 16 : 12)) {
+            std::cout << "test_recurrent_forward FAILED: gate rows " << layer.gate_rows() << "\n";
+            return -1;
+        }
+        fill_test_values(layer.get_recurrent_bias(), stream++);
+        int shapes[][2] = {{5, 2}, {3, 7}}; // steps, batch
+        for (auto& shape : shapes) {
+            Matrix input(3, shape[0] * shape[1]);
+            fill_test_values(input, stream++);
+            Matrix output(0, 0);
+            layer.forward(input, output, shape[0]);
+            Matrix expected = reference_recurrent(layer, input, shape[0]);
+            float difference = max_difference(output, expected);
+            if (output.get_rows_num() != 4 || output.get_columns_num() != shape[0] * shape[1] || difference > 1e-5f) {
+                std::cout << "test_recurrent_forward FAILED: cell " << int(cell) << ", " << shape[0] << " steps, difference "
+                          << difference << "\n";
+                return -1;
+            }
+        }
+        try {
+            Matrix bad(3, 7);
+            Matrix output(0, 0);
+            layer.forward(bad, output, 2);
+            std::cout << "test_recurrent_forward FAILED (no exception for 7 columns in 2 steps).\n";
+            return -1;
+        } catch (const std::runtime_error&) {
+        }
+    }
+    std::cout << "test_recurrent_forward passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Checks the back-propagation through time of both cells against central differences of
+ * the reference, and that repeated passes of one shape do not allocate.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_recurrent_backward() {
+    RecurrentCell cells[] = {RecurrentCell::LSTM, RecurrentCell::GRU};
+    uint64_t stream = 500;
+    const int steps = 4;
+    const int batch = 2;
+    for (RecurrentCell cell : cells) {
+        Recurrent layer(cell, 3, 4);
+        fill_test_values(layer.get_recurrent_bias(), stream++);
+        Matrix input(3, steps * batch);
+        Matrix grad_output(4, steps * batch);
+        fill_test_values(input, stream++);
+        fill_test_values(grad_output, stream++);
+        auto loss = [&]() {
+            Matrix output = reference_recurrent(layer, input, steps);
+            double sum = 0.0;
+            for (int r = 0; r < 4; r++)
+                for (int c = 0; c < steps * batch; c++) sum += double(output.get_val(r, c)) * grad_output.get_val(r, c);
+            return sum;
+        };
+        const float h = 1e-2f;
+        auto numeric = [&](Matrix& m, int r, int c) {
+            float saved = m.get_val(r, c);
+            m.set_val(r, c, saved + h);
+            double up = loss();
+            m.set_val(r, c, saved - h);
+            double down = loss();
+            m.set_val(r, c, saved);
+            return float((up - down) / (2.0 * h));
+        };
+
+        Matrix output(0, 0);
+        Matrix grad_input(0, 0);
+        layer.forward(input, output, steps);
+        layer.backward(input, grad_output, &grad_input);
+        struct Check {
+            const char* name;
+            Matrix& values;
+            Matrix& gradient;
+        };
+        Check checks[] = {{"input weight", layer.get_input_weights(), layer.get_input_weight_gradient()},
+                          {"recurrent weight", layer.get_recurrent_weights(), layer.get_recurrent_weight_gradient()},
+                          {"bias", layer.get_bias(), layer.get_bias_gradient()},
+                          {"recurrent bias", layer.get_recurrent_bias(), layer.get_recurrent_bias_gradient()},
+                          {"input", input, grad_input}};
+        for (Check& check : checks) {
+            if (cell == RecurrentCell::LSTM && &check.values == &layer.get_recurrent_bias()) continue; // GRU only
+            for (int r = 0; r < check.values.get_rows_num(); r++)
+                for (int c = 0; c < check.values.get_columns_num(); c++) {
+                    float expected = numeric(check.values, r, c);
+                    if (std::fabs(check.gradient.get_val(r, c) - expected) > 2e-3f) {
+                        std::cout << "test_recurrent_backward FAILED: " << check.name << " gradient (" << r << ", " << c
+                                  << ") of cell " << int(cell) << ": " << check.gradient.get_val(r, c) << " vs " << expected << "\n";
+                        return -1;
+                    }
+                }
+        }
+
+        long unsigned before = allocation_stats().allocations;
+        for (int pass = 0; pass < 3; pass++) {
+            layer.forward(input, output, steps);
+            layer.backward(input, grad_output, &grad_input);
+            layer.update_weights(0.0f);
+        }
+        if (allocation_stats().allocations != before) {
+            std::cout << "test_recurrent_backward FAILED: repeated passes allocated " << allocation_stats().allocations - before
+                      << " times\n";
+            return -1;
+        }
+    }
+    std::cout << "test_recurrent_backward passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Double-precision multi-head self-attention over a model_dim x (N * seq) batch, with the
+ * full score matrix of every head, used as the reference.
+ */
+static Matrix reference_attention(MultiHeadAttention& layer, Matrix& input, int seq) {
+    const int dim = input.get_rows_num();
+    const int batch = input.get_columns_num() / seq;
+    const int head_dim = layer.head_dim();
+    Matrix& w = layer.get_qkv_weights();
+    std::vector<double> qkv(size_t(3) * dim * seq), context(size_t(dim) * seq), scores(seq);
+    Matrix output(dim, batch * seq);
+    for (int n = 0; n < batch; n++) {
+        for (int r = 0; r < 3 * dim; r++)
+            for (int t = 0; t < seq; t++) {
+                double sum = layer.get_qkv_bias().get_val(r, 0);
+                for (int k = 0; k < dim; k++) sum += double(w.get_val(r, k)) * input.get_val(k, n * seq + t);
+                qkv[size_t(r) * seq + t] = sum;
+            }
+        for (int h = 0; h < layer.get_heads(); h++)
+            for (int i = 0; i < seq; i++) {
+                double max_score = -1e300, total = 0.0;
+                for (int j = 0; j < seq; j++) {
+                    double dot = 0.0;
+                    for (int d = 0; d < head_dim; d++)
+                        dot += qkv[size_t(h * head_dim + d) * seq + i] * qkv[size_t(dim + h * head_dim + d) * seq + j];
+                    scores[j] = dot / std::sqrt(double(head_dim));
+                    max_score = std::max(max_score, scores[j]);
+                }
+                for (int j = 0; j < seq; j++) total += scores[j] = std::exp(scores[j] - max_score);
+                for (int d = 0; d < head_dim; d++) {
+                    double sum = 0.0;
+                    for (int j = 0; j < seq; j++) sum += scores[j] * qkv[size_t(2 * dim + h * head_dim + d) * seq + j];
+                    context[size_t(h * head_dim + d) * seq + i] = sum / total;
+                }
+            }
+        for (int r = 0; r < dim; r++)
+            for (int t = 0; t < seq; t++) {
+                double sum = layer.get_output_bias().get_val(r, 0);
+                for (int k = 0; k < dim; k++) sum += double(layer.get_output_weights().get_val(r, k)) * context[size_t(k) * seq + t];
+                output.set_val(r, n * seq + t, float(sum));
+            }
+    }
+    return output;
+}
+
+/**
+ * @brief Tests the blocked and materialized kernels against the double-precision reference for
+ * sequences shorter than one tile and spanning several query and key tiles, with scaled-up
+ * inputs so later key tiles raise the running maximum.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_attention_forward() {
+    MultiHeadAttention layer(8, 2);
+    fill_test_values(layer.get_qkv_bias(), 600);
+    fill_test_values(layer.get_output_bias(), 601);
+    int shapes[][2] = {{5, 3}, {70, 2}, {131, 1}}; // seq, batch
+    uint64_t stream = 610;
+    for (auto& shape : shapes) {
+        Matrix input(8, shape[0] * shape[1]);
+        fill_test_values(input, stream++);
+        input = input * 3.0;
+        Matrix expected = reference_attention(layer, input, shape[0]);
+        AttentionAlgorithm algorithms[] = {AttentionAlgorithm::Blocked, AttentionAlgorithm::Materialized};
+        for (AttentionAlgorithm algorithm : algorithms) {
+            layer.set_algorithm(algorithm);
+            Matrix output(0, 0);
+            layer.forward(input, output, shape[0]);
+            float difference = max_difference(output, expected);
+            if (output.get_rows_num() != 8 || output.get_columns_num() != shape[0] * shape[1] || difference > 1e-4f) {
+                std::cout << "test_attention_forward FAILED: kernel " << int(algorithm) << ", seq " << shape[0] << ", difference "
+                          << difference << "\n";
+                return -1;
+            }
+        }
+    }
+    try {
+        MultiHeadAttention bad(10, 4);
+        std::cout << "test_attention_forward FAILED (no exception for 4 heads of 10 rows).\n";
+        return -1;
+    } catch (const std::runtime_error&) {
+    }
+    std::cout << "test_attention_forward passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Checks the tiled backward pass against central differences of the reference on a
+ * sequence spanning several query and key tiles, and that both forward kernels lead to the same
+ * gradients.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_attention_backward() {
+    const int seq = 136;
+    const int batch = 1;
+    MultiHeadAttention layer(4, 2);
+    fill_test_values(layer.get_qkv_bias(), 700);
+    Matrix input(4, seq * batch);
+    Matrix grad_output(4, seq * batch);
+    fill_test_values(input, 701);
+    fill_test_values(grad_output, 702);
+    auto loss = [&]() {
+        Matrix output = reference_attention(layer, input, seq);
+        double sum = 0.0;
+        for (int r = 0; r < 4; r++)
+            for (int c = 0; c < seq * batch; c++) sum += double(output.get_val(r, c)) * grad_output.get_val(r, c);
+        return sum;
+    };
+    const float h = 1e-2f;
+    auto numeric = [&](Matrix& m, int r, int c) {
+        float saved = m.get_val(r, c);
+        m.set_val(r, c, saved + h);
+        double up = loss();
+        m.set_val(r, c, saved - h);
+        double down = loss();
+        m.set_val(r, c, saved);
+        return float((up - down) / (2.0 * h));
+    };
+
+    Matrix output(0, 0);
+    Matrix grad_input(0, 0);
+    layer.forward(input, output, seq);
+    layer.backward(input, grad_output, &grad_input);
+    struct Check {
+        const char* name;
+        Matrix& values;
+        Matrix& gradient;
+    };
+    Check checks[] = {{"qkv weight", layer.get_qkv_weights(), layer.get_qkv_weight_gradient()},
+                      {"qkv bias", layer.get_qkv_bias(), layer.get_qkv_bias_gradient()},
+                      {"output weight", layer.get_output_weights(), layer.get_output_weight_gradient()},
+                      {"output bias", layer.get_output_bias(), layer.get_output_bias_gradient()},
+                      {"input", input, grad_input}};
+    for (Check& check : checks) {
+        int column_step = &check.values == &input ? 9 : 1; // every 9th position: both key tiles, fewer reference runs
+        for (int r = 0; r < check.values.get_rows_num(); r++)
+            for (int c = 0; c < check.values.get_columns_num(); c += column_step) {
+                float expected = numeric(check.values, r, c);
+                if (std::fabs(check.gradient.get_val(r, c) - expected) > 2e-3f * std::max(1.0f, std::fabs(expected))) {
+                    std::cout << "test_attention_backward FAILED: " << check.name << " gradient (" << r << ", " << c
+                              << "): " << check.gradient.get_val(r, c) << " vs " << expected << "\n";
+                    return -1;
+                }
+            }
+    }
+
+    Matrix blocked_gradient = layer.get_qkv_weight_gradient();
+    layer.set_algorithm(AttentionAlgorithm::Materialized);
+    layer.forward(input, output, seq);
+    layer.backward(input, grad_output, &grad_input);
+    if (max_difference(blocked_gradient, layer.get_qkv_weight_gradient()) > 1e-4f) {
+        std::cout << "test_attention_backward FAILED: gradients differ after the materialized forward\n";
+        return -1;
+    }
+    std::cout << "test_attention_backward passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Runs all layer tests.
+ * @return 0 if all tests pass, -1 otherwise.
+ */
+int run_layers_tests() {
+    int status = 0;
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "###########   RUNNING LAYERS TESTS... #############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << std::endl;
+
+    if (test_conv2d_forward() != 0) status = -1;
+    if (test_conv2d_backward() != 0) status = -1;
+    if (test_normalization_forward() != 0) status = -1;
+    if (test_normalization_backward() != 0) status = -1;
+    if (test_dropout_mask() != 0) status = -1;
+    if (test_dropout_forward_backward() != 0) status = -1;
+    if (test_embedding() != 0) status = -1;
+    if (test_recurrent_forward() != 0) status = -1;
+    if (test_recurrent_backward() != 0) status = -1;
+    if (test_attention_forward() != 0) status = -1;
+    if (test_attention_backward() != 0) status = -1;
+
+    if (status == 0) {
+        std::cout << "All layers tests passed successfully!\n";
+    } else {
+        std::cerr << "Some layers tests failed.\n";
+    }
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "##############  LAYERS TESTS DONE... ##############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << std::endl;
+
+    return status;
+}
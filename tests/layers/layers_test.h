@@ -0,0 +1 @@
+int run_layers_tests();
\ No newline at end of file
@@ -1,9 +1,13 @@
 #include <iostream>
 #include <thread>
 #include "../src/matrix/matrix.h"
+#include "../src/matrix/bf16.h"
+#include "../src/matrix/tensor.h"
+#include "../src/matrix/sparse.h"
 #include "matrix_test.h"
 #include <cassert>
 #include <chrono>
+#include <cmath>
 
 int func1(int c, const std::string& m)
 {
@@ -507,6 +511,487 @@ int test_elementWiseMultiply() {
     return 0;
 }
 
+/**
+ * @brief Tests copying column vectors into the columns of a batch matrix.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_setColumnFromMatrix() {
+    float col0[] = {1, 2, 3};
+    float col1[] = {4, 5, 6};
+    Matrix v0(3, 1, col0);
+    Matrix v1(3, 1, col1);
+    Matrix batch(3, 2);
+
+    batch.setColumnFromMatrix(0, v0);
+    batch.setColumnFromMatrix(1, v1);
+    for (int r = 0; r < 3; r++) {
+        if (batch.get_val(r, 0) != col0[r] || batch.get_val(r, 1) != col1[r]) {
+            std::cout << "test_setColumnFromMatrix FAILED at row " << r << "\n";
+            return -1;
+        }
+    }
+
+    try {
+        batch.setColumnFromMatrix(2, v0);
+        std::cout << "test_setColumnFromMatrix FAILED (no exception for out of range column).\n";
+        return -1;
+    } catch (const std::out_of_range&) {
+    }
+
+    std::cout << "test_setColumnFromMatrix passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests adding a column vector to every column of a matrix.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_addColumnVector() {
+    float arr[2][3] = {{1, 2, 3}, {4, 5, 6}};
+    float bias[] = {10, 20};
+    Matrix m(2, 3, *arr);
+    Matrix b(2, 1, bias);
+
+    m.addColumnVector(b);
+    float expected[2][3] = {{11, 12, 13}, {24, 25, 26}};
+    for (int r = 0; r < 2; r++) {
+        for (int c = 0; c < 3; c++) {
+            if (m.get_val(r, c) != expected[r][c]) {
+                std::cout << "test_addColumnVector FAILED at row " << r << " col " << c << "\n";
+                return -1;
+            }
+        }
+    }
+
+    Matrix wrong(3, 1);
+    try {
+        m.addColumnVector(wrong);
+        std::cout << "test_addColumnVector FAILED (no exception for size mismatch).\n";
+        return -1;
+    } catch (const std::runtime_error&) {
+    }
+
+    std::cout << "test_addColumnVector passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests float <-> bfloat16 conversion and rounding.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_bf16_conversion() {
+    // 1 + 2^-8 is exactly half way between two bf16 values and rounds to even (1.0);
+    // 1 + 3 * 2^-8 rounds up to 1 + 2^-6.
+    float vals[] = {1.0f, -2.5f, 1.0f + 1.0f / 256.0f, 1.0f + 3.0f / 256.0f, 0.0f, 1e-40f, 255.5f};
+    float expected[] = {1.0f, -2.5f, 1.0f, 1.0f + 1.0f / 64.0f, 0.0f, 0.0f, 256.0f};
+    for (int i = 0; i < 7; i++) {
+        if (bf16_to_float(float_to_bf16(vals[i])) != expected[i]) {
+            std::cout << "test_bf16_conversion FAILED at index " << i << ": got "
+                      << bf16_to_float(float_to_bf16(vals[i])) << "\n";
+            return -1;
+        }
+    }
+
+    // The (possibly hardware) bulk conversion must agree with the scalar one.
+    Matrix m(1, 7, vals);
+    Matrix rounded(1, 7, vals);
+    BF16Matrix stored(0, 0);
+    stored.convertFrom(m);
+    rounded.roundToBF16();
+    for (int i = 0; i < 7; i++) {
+        if (stored.get_val(0, i) != expected[i] || rounded.get_val(0, i) != expected[i]) {
+            std::cout << "test_bf16_conversion FAILED (bulk conversion) at index " << i << "\n";
+            return -1;
+        }
+    }
+    std::cout << "test_bf16_conversion passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests the bfloat16 matrix multiplication against the float one.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_matrixMultiplyBF16() {
+    // Shared dimension of 37 exercises both the full and the masked tail of the dot product.
+    int M = 5, K = 37, N = 3;
+    Matrix a(M, K);
+    Matrix b(K, N);
+    for (int r = 0; r < M; r++)
+        for (int c = 0; c < K; c++) a.set_val(r, c, float((r + 2 * c) % 7) - 3.0f);
+    for (int r = 0; r < K; r++)
+        for (int c = 0; c < N; c++) b.set_val(r, c, float((3 * r + c) % 5) * 0.5f);
+
+    BF16Matrix a_bf16(0, 0);
+    BF16Matrix b_t_bf16(0, 0);
+    a_bf16.convertFrom(a);
+    b_t_bf16.convertTransposedFrom(b);
+    if (b_t_bf16.get_rows_num() != N || b_t_bf16.get_columns_num() != K) {
+        std::cout << "test_matrixMultiplyBF16 FAILED (transposed dimensions)\n";
+        return -1;
+    }
+
+    Matrix expected = a * b;
+    Matrix result(M, N);
+    result.matrixMultiplyBF16(a_bf16, b_t_bf16);
+    for (int r = 0; r < M; r++) {
+        for (int c = 0; c < N; c++) {
+            // All inputs are exact in bf16 and all partial sums are small integers or halves.
+            if (result.get_val(r, c) != expected.get_val(r, c)) {
+                std::cout << "test_matrixMultiplyBF16 FAILED at row " << r << " col " << c << "\n";
+                std::cout << "Expected: " << expected.get_val(r, c) << ", Got: " << result.get_val(r, c) << "\n";
+                return -1;
+            }
+        }
+    }
+
+    Matrix wrong(M, N + 1);
+    try {
+        wrong.matrixMultiplyBF16(a_bf16, b_t_bf16);
+        std::cout << "test_matrixMultiplyBF16 FAILED (no exception for size mismatch).\n";
+        return -1;
+    } catch (const std::runtime_error&) {
+    }
+
+    std::cout << "test_matrixMultiplyBF16 passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests the transposed products and addScaled against the allocating operators.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_transposed_multiply() {
+    Matrix a(4, 3);
+    Matrix b(4, 5);
+    Matrix c(6, 3);
+    for (int r = 0; r < 4; r++)
+        for (int col = 0; col < 3; col++) a.set_val(r, col, float((r + 2 * col) % 5) - 2.0f);
+    for (int r = 0; r < 4; r++)
+        for (int col = 0; col < 5; col++) b.set_val(r, col, float((3 * r + col) % 7) * 0.5f);
+    for (int r = 0; r < 6; r++)
+        for (int col = 0; col < 3; col++) c.set_val(r, col, float((r * col) % 4) - 1.5f);
+
+    Matrix expected_ta = transpose(a) * b;
+    Matrix expected_tb = a * transpose(c);
+    Matrix result_ta(3, 5);
+    Matrix result_tb(4, 6);
+    AllocationStats before = allocation_stats();
+    result_ta.matrixMultiplyTransposeA(a, b);
+    result_tb.matrixMultiplyTransposeB(a, c);
+    if (allocation_stats().allocations != before.allocations) {
+        std::cout << "test_transposed_multiply FAILED (kernel allocated)\n";
+        return -1;
+    }
+    for (int r = 0; r < 3; r++) {
+        for (int col = 0; col < 5; col++) {
+            if (result_ta.get_val(r, col) != expected_ta.get_val(r, col)) {
+                std::cout << "test_transposed_multiply FAILED (a^T b) at row " << r << " col " << col << "\n";
+                return -1;
+            }
+        }
+    }
+    for (int r = 0; r < 4; r++) {
+        for (int col = 0; col < 6; col++) {
+            if (result_tb.get_val(r, col) != expected_tb.get_val(r, col)) {
+                std::cout << "test_transposed_multiply FAILED (a b^T) at row " << r << " col " << col << "\n";
+                return -1;
+            }
+        }
+    }
+
+    Matrix scaled = result_ta;
+    Matrix step(3, 5);
+    for (int r = 0; r < 3; r++)
+        for (int col = 0; col < 5; col++) step.set_val(r, col, float(r - col));
+    scaled.addScaled(step, -0.5f);
+    for (int r = 0; r < 3; r++) {
+        for (int col = 0; col < 5; col++) {
+            if (scaled.get_val(r, col) != result_ta.get_val(r, col) - 0.5f * float(r - col)) {
+                std::cout << "test_transposed_multiply FAILED (addScaled) at row " << r << " col " << col << "\n";
+                return -1;
+            }
+        }
+    }
+
+    try {
+        result_ta.matrixMultiplyTransposeA(a, c);
+        std::cout << "test_transposed_multiply FAILED (no exception for size mismatch).\n";
+        return -1;
+    } catch (const std::runtime_error&) {
+    }
+
+    std::cout << "test_transposed_multiply passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests CSR conversion and construction and the two sparse products against the dense
+ * ones: a * b^T reads only the nonzeros, and the accumulated a * b leaves columns without
+ * nonzeros untouched.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_csr_matrix() {
+    // 6 features x 4 samples, mostly zero; sample 2 is empty.
+    Matrix dense(6, 4);
+    dense.set_val(0, 0, 1.5f);
+    dense.set_val(4, 0, -2.0f);
+    dense.set_val(2, 1, 3.0f);
+    dense.set_val(5, 3, 0.5f);
+    dense.set_val(0, 3, -1.0f);
+    CSRMatrix sparse(0, 0);
+    sparse.convertTransposedFrom(dense);
+    if (sparse.get_rows_num() != 4 || sparse.get_columns_num() != 6 || sparse.get_nnz() != 5) {
+        std::cout << "test_csr_matrix FAILED: shape or nnz\n";
+        return -1;
+    }
+    for (int r = 0; r < 6; r++) {
+        for (int c = 0; c < 4; c++) {
+            if (sparse.get_val(c, r) != dense.get_val(r, c)) {
+                std::cout << "test_csr_matrix FAILED: value (" << c << ", " << r << ")\n";
+                return -1;
+            }
+        }
+    }
+    CSRMatrix built(0, 0);
+    built.clear(6);
+    int cols0[] = {0, 4};
+    float vals0[] = {1.5f, -2.0f};
+    int cols1[] = {2};
+    float vals1[] = {3.0f};
+    int cols3[] = {0, 5};
+    float vals3[] = {-1.0f, 0.5f};
+    built.appendRow(2, cols0, vals0);
+    built.appendRow(1, cols1, vals1);
+    built.appendRow(0, nullptr, nullptr);
+    built.appendRow(2, cols3, vals3);
+    Matrix expanded(0, 0);
+    built.convertTo(expanded);
+    if (expanded.get_rows_num() != 4 || expanded.get_columns_num() != 6) {
+        std::cout << "test_csr_matrix FAILED: expanded shape\n";
+        return -1;
+    }
+    for (int r = 0; r < 6; r++) {
+        for (int c = 0; c < 4; c++) {
+            if (expanded.get_val(c, r) != dense.get_val(r, c)) {
+                std::cout << "test_csr_matrix FAILED: appended row " << c << "\n";
+                return -1;
+            }
+        }
+    }
+    int unordered[] = {3, 1};
+    try {
+        built.appendRow(2, unordered, vals0);
+        std::cout << "test_csr_matrix FAILED (no exception for unordered columns).\n";
+        return -1;
+    } catch (const std::runtime_error&) {
+    }
+
+    Matrix weights(3, 6);
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 6; c++) weights.set_val(r, c, float((r + 2 * c) % 5) - 2.0f);
+    Matrix expected(3, 4);
+    expected.matrixMultiply(weights, dense);
+    Matrix product(3, 4);
+    product.matrixMultiplyCSRTransposeB(weights, sparse);
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            if (product.get_val(r, c) != expected.get_val(r, c)) {
+                std::cout << "test_csr_matrix FAILED: w * x at (" << r << ", " << c << ")\n";
+                return -1;
+            }
+        }
+    }
+
+    Matrix errors(3, 4);
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 4; c++) errors.set_val(r, c, float(r - c) * 0.25f);
+    Matrix gradient(3, 6);
+    gradient.resetWithVal(7.0f); // Accumulates on top; columns 1 and 3 have no nonzeros
+    Matrix dense_gradient(3, 6);
+    dense_gradient.matrixMultiplyTransposeB(errors, dense);
+    gradient.addMatrixProductCSR(errors, sparse);
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 6; c++) {
+            if (std::fabs(gradient.get_val(r, c) - (7.0f + dense_gradient.get_val(r, c))) > 1e-6f) {
+                std::cout << "test_csr_matrix FAILED: e * x at (" << r << ", " << c << ")\n";
+                return -1;
+            }
+        }
+    }
+    try {
+        product.matrixMultiplyCSRTransposeB(errors, sparse);
+        std::cout << "test_csr_matrix FAILED (no exception for size mismatch).\n";
+        return -1;
+    } catch (const std::runtime_error&) {
+    }
+    std::cout << "test_csr_matrix passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests that permute, transpose, slice and select are views: the strides and offset
+ * change, the storage is shared, and the values follow the index mapping.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_tensor_views() {
+    // t[n][c][h][w] = 1000 n + 100 c + 10 h + w
+    Tensor t({2, 3, 4, 5});
+    for (int n = 0; n < 2; n++)
+        for (int c = 0; c < 3; c++)
+            for (int h = 0; h < 4; h++)
+                for (int w = 0; w < 5; w++) t.set_val({n, c, h, w}, float(1000 * n + 100 * c + 10 * h + w));
+
+    if (!t.is_contiguous() || t.stride(0) != 60 || t.stride(-1) != 1 || t.numel() != 120) {
+        std::cout << "test_tensor_views FAILED (packed strides)\n";
+        return -1;
+    }
+
+    AllocationStats before = allocation_stats();
+    Tensor nhwc = t.permute({0, 2, 3, 1});
+    Tensor rows = t.slice(2, 1, 4, 2);
+    Tensor sample = t.select(0, 1);
+    Tensor swapped = t.transpose(1, 3);
+    if (allocation_stats().allocations != before.allocations) {
+        std::cout << "test_tensor_views FAILED (view allocated storage)\n";
+        return -1;
+    }
+    if (!nhwc.shares_storage(t) || nhwc.is_contiguous() || nhwc.shape() != std::vector<int>({2, 4, 5, 3})) {
+        std::cout << "test_tensor_views FAILED (permute metadata)\n";
+        return -1;
+    }
+    if (rows.size(2) != 2 || rows.offset() != 5 || sample.dims() != 3 || sample.offset() != 60) {
+        std::cout << "test_tensor_views FAILED (slice/select metadata)\n";
+        return -1;
+    }
+    for (int n = 0; n < 2; n++) {
+        for (int c = 0; c < 3; c++) {
+            for (int h = 0; h < 4; h++) {
+                for (int w = 0; w < 5; w++) {
+                    float expected = float(1000 * n + 100 * c + 10 * h + w);
+                    if (nhwc.get_val({n, h, w, c}) != expected || swapped.get_val({n, w, h, c}) != expected ||
+                        (n == 1 && sample.get_val({c, h, w}) != expected) ||
+                        (h % 2 == 1 && rows.get_val({n, c, h / 2, w}) != expected)) {
+                        std::cout << "test_tensor_views FAILED at " << n << "," << c << "," << h << "," << w << "\n";
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+
+    // Writes through a view reach the original, and contiguous() packs a strided view.
+    nhwc.set_val({1, 3, 4, 2}, -1.0f);
+    Tensor packed = nhwc.contiguous();
+    if (t.get_val({1, 2, 3, 4}) != -1.0f || !packed.is_contiguous() || packed.shares_storage(t) ||
+        packed.data()[1 * 60 + 3 * 15 + 4 * 3 + 2] != -1.0f || packed.data()[1] != 100.0f) {
+        std::cout << "test_tensor_views FAILED (write through view / contiguous)\n";
+        return -1;
+    }
+    rows.fill(7.0f);
+    if (t.get_val({0, 0, 1, 0}) != 7.0f || t.get_val({0, 0, 3, 4}) != 7.0f || t.get_val({0, 0, 2, 0}) != 20.0f) {
+        std::cout << "test_tensor_views FAILED (fill of a slice)\n";
+        return -1;
+    }
+
+    try {
+        t.permute({0, 1, 1, 2});
+        std::cout << "test_tensor_views FAILED (no exception for an invalid permutation).\n";
+        return -1;
+    } catch (const std::runtime_error&) {
+    }
+    try {
+        t.slice(1, 2, 4);
+        std::cout << "test_tensor_views FAILED (no exception for an out-of-range slice).\n";
+        return -1;
+    } catch (const std::runtime_error&) {
+    }
+
+    std::cout << "test_tensor_views passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests reshape of packed and strided tensors, and the zero-copy Matrix round trip.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_tensor_reshape() {
+    Tensor t({2, 3, 4});
+    for (int i = 0; i < 24; i++) t.data()[i] = float(i);
+
+    Tensor flat = t.reshape({-1});
+    Tensor split = t.reshape({6, 2, 2});
+    if (flat.size(0) != 24 || !flat.shares_storage(t) || split.get_val({4, 1, 0}) != 18.0f) {
+        std::cout << "test_tensor_reshape FAILED (packed reshape)\n";
+        return -1;
+    }
+
+    // Splitting a dimension of a permuted view, and merging dimensions that stayed packed
+    // relative to each other, only need new strides.
+    Tensor swapped = t.permute({2, 0, 1}); // 4 x 2 x 3, strides 1, 12, 4
+    Tensor swapped_split = swapped.reshape({2, 2, 2, 3});
+    Tensor merged = swapped.reshape({4, 6});
+    if (!swapped_split.shares_storage(t) || !merged.shares_storage(t) || merged.stride(1) != 4) {
+        std::cout << "test_tensor_reshape FAILED (strided reshape metadata)\n";
+        return -1;
+    }
+    for (int a = 0; a < 4; a++) {
+        for (int b = 0; b < 2; b++) {
+            for (int c = 0; c < 3; c++) {
+                float expected = t.get_val({b, c, a});
+                if (swapped_split.get_val({a / 2, a % 2, b, c}) != expected || merged.get_val({a, b * 3 + c}) != expected) {
+                    std::cout << "test_tensor_reshape FAILED at " << a << "," << b << "," << c << "\n";
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // Merging the swapped dimensions back would need a copy.
+    try {
+        swapped.reshape({24});
+        std::cout << "test_tensor_reshape FAILED (no exception for a reshape needing a copy).\n";
+        return -1;
+    } catch (const std::runtime_error&) {
+    }
+    Tensor packed_flat = swapped.contiguous().reshape({24});
+    if (packed_flat.get_val({1}) != 4.0f || packed_flat.get_val({6}) != 1.0f) {
+        std::cout << "test_tensor_reshape FAILED (contiguous reshape)\n";
+        return -1;
+    }
+    try {
+        t.reshape({5, 5});
+        std::cout << "test_tensor_reshape FAILED (no exception for a size change).\n";
+        return -1;
+    } catch (const std::runtime_error&) {
+    }
+
+    // A Matrix is the packed 2D case: its transpose is a view, and copy_to packs it back.
+    Matrix m(3, 4);
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 4; c++) m.set_val(r, c, float(r * 4 + c));
+    Tensor view(m);
+    view.set_val({2, 1}, 42.0f);
+    Matrix transposed(1, 1);
+    view.transpose(0, 1).copy_to(transposed);
+    Matrix expected = transpose(m);
+    if (m.get_val(2, 1) != 42.0f || transposed.get_rows_num() != 4 || transposed.get_columns_num() != 3) {
+        std::cout << "test_tensor_reshape FAILED (matrix view)\n";
+        return -1;
+    }
+    for (int r = 0; r < 4; r++) {
+        for (int c = 0; c < 3; c++) {
+            if (transposed.get_val(r, c) != expected.get_val(r, c)) {
+                std::cout << "test_tensor_reshape FAILED (copy_to) at row " << r << " col " << c << "\n";
+                return -1;
+            }
+        }
+    }
+
+    std::cout << "test_tensor_reshape passed.\n";
+    return 0;
+}
+
 /**
  * @brief Tests the execution time of a matrix operation.
  * @return 0 if the test passes.
@@ -574,6 +1059,14 @@ int run_matrix_tests() {
     if (test_invalid_elementwise_multiplication() != 0) status = -1;
     if (test_matrixMultiply() != 0) status = -1;
     if (test_elementWiseMultiply() != 0) status = -1;
+    if (test_setColumnFromMatrix() != 0) status = -1;
+    if (test_addColumnVector() != 0) status = -1;
+    if (test_bf16_conversion() != 0) status = -1;
+    if (test_matrixMultiplyBF16() != 0) status = -1;
+    if (test_transposed_multiply() != 0) status = -1;
+    if (test_tensor_views() != 0) status = -1;
+    if (test_tensor_reshape() != 0) status = -1;
+    if (test_csr_matrix() != 0) status = -1;
     //test_exec_time();
 
     if (status == 0) {
@@ -0,0 +1,266 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <omp.h>
+#include "../../src/matrix/matrix.h"
+#include "../../src/profiling/perf_counters.h"
+#include "../../src/profiling/profiler.h"
+#include "../../src/profiling/trace.h"
+#include "profiling_test.h"
+
+/**
+ * @brief Tests that the time-stamp counter is monotonic and calibrated against wall time.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_timestamp_calibration() {
+    uint64_t start = read_timestamp();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t stop = read_timestamp();
+    double seconds = double(stop - start) / timestamp_ticks_per_second();
+
+    if (stop <= start || seconds < 0.015 || seconds > 0.5) {
+        std::cout << "test_timestamp_calibration FAILED: 20 ms sleep measured as " << seconds * 1e3 << " ms\n";
+        return -1;
+    }
+    std::cout << "test_timestamp_calibration passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests aggregation, fractions, scopes and reset of the profiler.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_profiler_aggregates() {
+    Profiler profiler;
+    profiler.set_layers(2);
+    int evaluations = 0;
+    auto counted = [&evaluations](double value) { evaluations++; return value; };
+    {
+        PROFILE_SCOPE(profiler, ProfilePhase::Forward, 0, counted(10.0), counted(20.0)); // Disabled: not recorded
+    }
+    if (!profiler.report().entries.empty() || evaluations != 0) {
+        std::cout << "test_profiler_aggregates FAILED: disabled profiler recorded a scope or evaluated its arguments\n";
+        return -1;
+    }
+
+    profiler.set_enabled(true);
+    {
+        PROFILE_SCOPE(profiler, ProfilePhase::Forward, 0, counted(10.0), counted(20.0));
+    }
+    double ticks = timestamp_ticks_per_second();
+    profiler.record(ProfilePhase::Backward, 1, uint64_t(3e-3 * ticks), 100.0, 200.0);
+    profiler.record(ProfilePhase::Backward, 1, uint64_t(1e-3 * ticks), 100.0, 200.0);
+    profiler.record(ProfilePhase::Loss, -1, uint64_t(4e-3 * ticks), 5.0, 6.0);
+
+    ProfileReport report = profiler.report();
+    const ProfileEntry* forward = report.find(ProfilePhase::Forward, 0);
+    const ProfileEntry* backward = report.find(ProfilePhase::Backward, 1);
+    const ProfileEntry* loss = report.find(ProfilePhase::Loss, -1);
+    if (report.entries.size() != 3 || !forward || !backward || !loss || report.find(ProfilePhase::Backward, 0)) {
+        std::cout << "test_profiler_aggregates FAILED: unexpected entries\n";
+        return -1;
+    }
+    double fractions = 0.0;
+    for (auto& entry : report.entries) fractions += entry.fraction;
+    if (forward->calls != 1 || forward->flops != 10.0 || backward->calls != 2 || backward->flops != 200.0 ||
+        backward->bytes != 400.0 || std::abs(backward->seconds - 4e-3) > 1e-5 || std::abs(fractions - 1.0) > 1e-9 ||
+        std::abs(report.phase_seconds(ProfilePhase::Loss) - 4e-3) > 1e-5) {
+        std::cout << "test_profiler_aggregates FAILED: wrong aggregates\n";
+        return -1;
+    }
+
+    try {
+        profiler.record(ProfilePhase::Forward, 2, 1, 0.0, 0.0);
+        std::cout << "test_profiler_aggregates FAILED: no exception for an invalid layer\n";
+        return -1;
+    } catch (const std::out_of_range&) {}
+
+    profiler.reset();
+    if (!profiler.report().entries.empty()) {
+        std::cout << "test_profiler_aggregates FAILED: reset kept entries\n";
+        return -1;
+    }
+    std::cout << "test_profiler_aggregates passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Counts the occurrences of a substring.
+ */
+static int count_occurrences(const std::string& text, const std::string& pattern) {
+    int count = 0;
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) count++;
+    return count;
+}
+
+/**
+ * @brief Tests the Chrome trace export: scopes on several OpenMP threads, periodic flushes and
+ * a well-formed file after trace_stop().
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_trace_export() {
+    const char* path = "test_trace.json";
+    int default_threads = omp_get_max_threads();
+    omp_set_num_threads(4);
+    Matrix a(64, 64);
+    Matrix b(64, 64);
+    Matrix c(64, 64);
+    a.resetWithVal(1.0f);
+    b.resetWithVal(2.0f);
+
+    { TRACE_SCOPE("before_start"); } // Not recorded
+    trace_start(path);
+    bool threw = false;
+    try {
+        trace_start(path);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    {
+        TRACE_SCOPE("outer", "test", 3);
+        c.matrixMultiply(a, b);
+    }
+    uint64_t now = read_timestamp();
+    trace_event("early", "test", now - uint64_t(timestamp_ticks_per_second()), now, -1); // Started before the trace
+    trace_flush();
+    Profiler profiler;
+    profiler.set_layers(1);
+    {
+        ProfileScope scope(profiler, ProfilePhase::Backward, 0, 1.0, 1.0); // Traced even with profiling disabled
+        c += a;
+    }
+    trace_stop();
+    { TRACE_SCOPE("after_stop"); } // Not recorded
+    omp_set_num_threads(default_threads);
+
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string trace = contents.str();
+    std::remove(path);
+
+    if (!threw || trace.rfind("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [", 0) != 0 || trace.find("]}") == std::string::npos) {
+        std::cout << "test_trace_export FAILED: malformed trace file\n";
+        return -1;
+    }
+    if (count_occurrences(trace, "\"name\": \"outer\"") != 1 || trace.find("\"args\": {\"layer\": 3}") == std::string::npos ||
+        count_occurrences(trace, "\"name\": \"backward\"") != 1 || trace.find("before_start") != std::string::npos ||
+        trace.find("after_stop") != std::string::npos) {
+        std::cout << "test_trace_export FAILED: wrong scope events\n";
+        return -1;
+    }
+    size_t early = trace.find("\"name\": \"early\"");
+    size_t early_ts = early == std::string::npos ? early : trace.find("\"ts\": ", early);
+    if (early_ts == std::string::npos || trace.compare(early_ts + 6, 1, "-") != 0) {
+        std::cout << "test_trace_export FAILED: event starting before the trace needs a negative time stamp\n";
+        return -1;
+    }
+    // Every OpenMP thread records its share of each kernel in its own buffer.
+    if (count_occurrences(trace, "\"name\": \"Matrix::matrixMultiply\"") != 4 || count_occurrences(trace, "\"name\": \"Matrix::operator+=\"") != 4 ||
+        count_occurrences(trace, "\"thread_name\"") != 4) {
+        std::cout << "test_trace_export FAILED: expected kernel events from 4 threads\n";
+        return -1;
+    }
+    std::cout << "test_trace_export passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests the counter arithmetic and, where the host has hardware counters, that kernels are
+ * counted; elsewhere that enabling falls back to collecting nothing.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_perf_counters() {
+    PerfCounts start;
+    PerfCounts end;
+    start.available = end.available = (1u << int(PerfEvent::Cycles)) | (1u << int(PerfEvent::Instructions)) |
+                                      (1u << int(PerfEvent::L1DMisses));
+    end.available &= ~(1u << int(PerfEvent::L1DMisses));
+    start.values[int(PerfEvent::Cycles)] = 100.0;
+    end.values[int(PerfEvent::Cycles)] = 300.0;
+    start.values[int(PerfEvent::Instructions)] = 1000.0;
+    end.values[int(PerfEvent::Instructions)] = 1500.0;
+    PerfCounts delta;
+    delta.add_delta(start, end);
+    if (delta.ipc() != 2.5 || delta.per_element(PerfEvent::Cycles, 50.0) != 4.0 || delta.has(PerfEvent::L1DMisses) ||
+        delta.per_element(PerfEvent::L1DMisses, 50.0) != 0.0 || PerfCounts().ipc() != 0.0) {
+        std::cout << "test_perf_counters FAILED: wrong counter arithmetic\n";
+        return -1;
+    }
+
+    Matrix a(32, 16);
+    Matrix b(16, 8);
+    Matrix c(32, 8);
+    a.resetWithVal(1.0f);
+    b.resetWithVal(0.5f);
+    perf_kernel_reset();
+    bool available = perf_counters_set_enabled(true);
+    if (available != perf_counters_enabled()) {
+        std::cout << "test_perf_counters FAILED: enabled without available counters\n";
+        perf_counters_set_enabled(false);
+        return -1;
+    }
+    c.matrixMultiply(a, b);
+    perf_counters_set_enabled(false);
+    c.matrixMultiply(a, b);
+
+    std::vector<PerfKernelStats> kernels = perf_kernel_report();
+    if (!available) {
+        if (!kernels.empty()) {
+            std::cout << "test_perf_counters FAILED: recorded without counters\n";
+            return -1;
+        }
+        std::cout << "test_perf_counters passed (no hardware counters on this host).\n";
+        return 0;
+    }
+    if (kernels.size() != 1 || kernels[0].name != "Matrix::matrixMultiply" || kernels[0].calls != 1 ||
+        kernels[0].elements != 32.0 * 8.0 || kernels[0].counts.available == 0) {
+        std::cout << "test_perf_counters FAILED: kernel not counted once\n";
+        return -1;
+    }
+    if (kernels[0].counts.has(PerfEvent::Instructions) && kernels[0].counts.get(PerfEvent::Instructions) < 32.0 * 8.0 * 16.0) {
+        std::cout << "test_perf_counters FAILED: fewer instructions than multiply-adds\n";
+        return -1;
+    }
+    perf_kernel_reset();
+    std::cout << "test_perf_counters passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Runs all profiling-related tests.
+ * @return 0 if all tests pass, -1 otherwise.
+ */
+int run_profiling_tests() {
+    int status = 0;
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "#########   RUNNING PROFILING TESTS... ############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << std::endl;
+
+    if (test_timestamp_calibration() != 0) status = -1;
+    if (test_profiler_aggregates() != 0) status = -1;
+    if (test_trace_export() != 0) status = -1;
+    if (test_perf_counters() != 0) status = -1;
+
+    if (status == 0) {
+        std::cout << "All profiling tests passed successfully!\n";
+    } else {
+        std::cerr << "Some profiling tests failed.\n";
+    }
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "############  PROFILING TESTS DONE... #############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << std::endl;
+
+    return status;
+}
@@ -0,0 +1 @@
+int run_profiling_tests();
\ No newline at end of file
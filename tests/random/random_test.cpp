@@ -0,0 +1,215 @@
+#include <iostream>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <omp.h>
+#include "../../src/matrix/matrix.h"
+#include "../../src/random/philox.h"
+#include "random_test.h"
+
+/**
+ * @brief Tests philox4x32 against the known-answer vectors of the Random123 reference implementation.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_philox_known_answers() {
+    struct Vector {
+        std::array<uint32_t, 4> counter;
+        std::array<uint32_t, 2> key;
+        std::array<uint32_t, 4> expected;
+    };
+    const Vector vectors[] = {
+        {{0, 0, 0, 0}, {0, 0}, {0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u}},
+        {{0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu}, {0xffffffffu, 0xffffffffu},
+         {0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu}},
+        {{0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}, {0xa4093822u, 0x299f31d0u},
+         {0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u}},
+    };
+    for (auto& v : vectors) {
+        if (philox4x32(v.counter, v.key) != v.expected) {
+            std::cout << "test_philox_known_answers FAILED: wrong block for counter " << std::hex << v.counter[0] << std::dec << "\n";
+            return -1;
+        }
+    }
+    std::cout << "test_philox_known_answers passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests that batch generation (including the SIMD path) matches per-element access for
+ * ranges starting and ending inside blocks, and that distinct streams differ.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_philox_stream_seek() {
+    PhiloxStream rng(42, 7);
+    const long n = 203;
+    const uint64_t offsets[] = {0, 1, 3, 64, 4294967290ull * 4}; // The last crosses a 2^32 block boundary
+    for (uint64_t first : offsets) {
+        std::vector<uint32_t> bits(n);
+        std::vector<float> uniform(n);
+        std::vector<float> normal(n);
+        rng.fill_bits(first, n, bits.data());
+        rng.fill_uniform(first, n, uniform.data(), -2.0f, 2.0f);
+        rng.fill_normal(first, n, normal.data(), 1.0f, 3.0f);
+        for (long i = 0; i < n; i++) {
+            if (bits[i] != rng.bits(first + i) || uniform[i] != -2.0f + 4.0f * rng.uniform(first + i) ||
+                normal[i] != 1.0f + 3.0f * rng.normal(first + i)) {
+                std::cout << "test_philox_stream_seek FAILED: element " << first + i << " differs from the batch\n";
+                return -1;
+            }
+        }
+    }
+    if (PhiloxStream(42, 7).bits(5) == PhiloxStream(42, 8).bits(5) && PhiloxStream(42, 7).bits(6) == PhiloxStream(42, 8).bits(6)) {
+        std::cout << "test_philox_stream_seek FAILED: streams 7 and 8 coincide\n";
+        return -1;
+    }
+    std::cout << "test_philox_stream_seek passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Tests the mean, variance and range of the uniform, normal and bounded integer outputs.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_philox_distributions() {
+    PhiloxStream rng(1234, 0);
+    const long n = 200000;
+    std::vector<float> values(n);
+    rng.fill_uniform(0, n, values.data());
+    double sum = 0.0, sum_sq = 0.0;
+    for (float v : values) {
+        if (v < 0.0f || v >= 1.0f) {
+            std::cout << "test_philox_distributions FAILED: uniform value " << v << " outside [0, 1)\n";
+            return -1;
+        }
+        sum += v;
+        sum_sq += double(v) * v;
+    }
+    double mean = sum / n;
+    double variance = sum_sq / n - mean * mean;
+    if (std::fabs(mean - 0.5) > 0.005 || std::fabs(variance - 1.0 / 12.0) > 0.002) {
+        std::cout << "test_philox_distributions FAILED: uniform mean " << mean << ", variance " << variance << "\n";
+        return -1;
+    }
+
+    rng.fill_normal(0, n, values.data());
+    sum = sum_sq = 0.0;
+    for (float v : values) {
+        if (!std::isfinite(v)) {
+            std::cout << "test_philox_distributions FAILED: non-finite normal value\n";
+            return -1;
+        }
+        sum += v;
+        sum_sq += double(v) * v;
+    }
+    mean = sum / n;
+    variance = sum_sq / n - mean * mean;
+    if (std::fabs(mean) > 0.01 || std::fabs(variance - 1.0) > 0.02) {
+        std::cout << "test_philox_distributions FAILED: normal mean " << mean << ", variance " << variance << "\n";
+        return -1;
+    }
+
+    std::vector<long> histogram(10, 0);
+    for (long i = 0; i < n; i++) histogram[rng.below(uint64_t(i), 10)]++;
+    for (long count : histogram) {
+        if (std::fabs(double(count) - n / 10.0) > 0.05 * n / 10.0) {
+            std::cout << "test_philox_distributions FAILED: below(10) bucket holds " << count << " of " << n << "\n";
+            return -1;
+        }
+    }
+    std::cout << "test_philox_distributions passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Returns the values of a matrix in row-major order.
+ */
+static std::vector<float> values_of(Matrix& m) {
+    std::vector<float> values;
+    for (int r = 0; r < m.get_rows_num(); r++) {
+        for (int c = 0; c < m.get_columns_num(); c++) values.push_back(m.get_val(r, c));
+    }
+    return values;
+}
+
+/**
+ * @brief Tests that the Matrix initializers give bit-identical values for 1 and 4 threads, and
+ * that the seeded initializers are reproducible through set_random_seed.
+ * @return 0 if the test passes, -1 otherwise.
+ */
+int test_random_init_thread_invariance() {
+    const int threads_before = omp_get_max_threads();
+    Matrix single(300, 70);
+    Matrix multi(300, 70);
+    for (int kind = 0; kind < 3; kind++) {
+        omp_set_num_threads(1);
+        if (kind == 0) single.randomInit(99, 3);
+        else if (kind == 1) single.randomHeNormalInit(99, 3);
+        else single.randomHeUniformInit(99, 3);
+        omp_set_num_threads(4);
+        if (kind == 0) multi.randomInit(99, 3);
+        else if (kind == 1) multi.randomHeNormalInit(99, 3);
+        else multi.randomHeUniformInit(99, 3);
+        std::vector<float> a = values_of(single);
+        std::vector<float> b = values_of(multi);
+        if (std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) != 0) {
+            omp_set_num_threads(threads_before);
+            std::cout << "test_random_init_thread_invariance FAILED: initializer " << kind << " depends on the thread count\n";
+            return -1;
+        }
+    }
+    omp_set_num_threads(threads_before);
+
+    float limit = std::sqrt(6.0f / 300.0f);
+    for (float v : values_of(multi)) {
+        if (v < -limit || v >= limit) {
+            std::cout << "test_random_init_thread_invariance FAILED: He-uniform value " << v << " outside the limit\n";
+            return -1;
+        }
+    }
+
+    set_random_seed(2024);
+    single.randomHeUniformInit();
+    set_random_seed(2024);
+    multi.randomHeUniformInit();
+    Matrix next(300, 70);
+    next.randomHeUniformInit();
+    if (values_of(single) != values_of(multi) || values_of(next) == values_of(multi)) {
+        std::cout << "test_random_init_thread_invariance FAILED: global seed not reproducible or streams repeat\n";
+        return -1;
+    }
+    std::cout << "test_random_init_thread_invariance passed.\n";
+    return 0;
+}
+
+/**
+ * @brief Runs all random number generator tests.
+ * @return 0 if all tests pass, -1 otherwise.
+ */
+int run_random_tests() {
+    int status = 0;
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "###########   RUNNING RANDOM TESTS... #############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << std::endl;
+
+    if (test_philox_known_answers() != 0) status = -1;
+    if (test_philox_stream_seek() != 0) status = -1;
+    if (test_philox_distributions() != 0) status = -1;
+    if (test_random_init_thread_invariance() != 0) status = -1;
+
+    if (status == 0) {
+        std::cout << "All random tests passed successfully!\n";
+    } else {
+        std::cerr << "Some random tests failed.\n";
+    }
+
+    std::cout << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << "##############  RANDOM TESTS DONE... ##############" << std::endl;
+    std::cout << "###################################################" << std::endl;
+    std::cout << std::endl;
+
+    return status;
+}
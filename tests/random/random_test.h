@@ -0,0 +1 @@
+int run_random_tests();
\ No newline at end of file